@@ -0,0 +1,35 @@
+#ifndef BEEPER_H_
+#define BEEPER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define BEEPER_FREQUENCY 440.0f
+#define BEEPER_AMPLITUDE 0x1000
+// Gate ramp length in samples, keeps start/stop free of clicks
+#define BEEPER_RAMP_SAMPLES 32
+
+typedef struct beeper
+{
+    uint32_t sample_rate;
+    float phase_step; // oscillator cycles per sample
+    float phase; // position in the current oscillator cycle, 0 to 1
+    float level; // current gate envelope, 0 to 1
+    float pattern_position; // XO-CHIP pattern bit being played, 0 to 128
+} beeper_t;
+
+void beeper_init(beeper_t *p_beeper, uint32_t sample_rate);
+
+/**
+ * Render the audio for the frame p_cpu has just executed, stretching its
+ * cycles over `samples` mono samples. Sound starts and stops at the sample
+ * matching the cycle that wrote the sound timer. Must be called before
+ * cpu_timer_tick() ends the frame. Once a program has loaded an XO-CHIP
+ * audio pattern, that pattern is played at its pitch instead of the tone.
+ */
+void beeper_render_frame(beeper_t *p_beeper, const chip8_t *p_cpu, int16_t *p_out, size_t samples);
+
+#endif // BEEPER_H_
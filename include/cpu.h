@@ -2,20 +2,50 @@
 #define CPU_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#ifdef EMUEIGHT_PROFILE
+#include "profile.h"
+#endif
 
 #define START_ADDRESS 0x200
 
 #define NUM_REGISTERS 16
 #define MEMORY_SIZE 4096
-#define PROGRAM_MEMORY_SIZE MEMORY_SIZE - START_ADDRESS
+#define XOCHIP_MEMORY_SIZE 0x10000
+#define PROGRAM_MEMORY_SIZE (MEMORY_SIZE - START_ADDRESS)
 #define STACK_SIZE 16
-#define DISPLAY_W 64
-#define DISPLAY_H 32
+#define DISPLAY_W 128 // SUPER-CHIP hi-res, lo-res uses the top left quarter
+#define DISPLAY_H 64
+#define DISPLAY_LORES_W 64
+#define DISPLAY_LORES_H 32
+#define DISPLAY_WORDS (DISPLAY_W / 64) // packed 64 bit words per row
+#define DISPLAY_PLANES 4 // XO-CHIP bit planes
+#define DISPLAY_COLORS (1 << DISPLAY_PLANES)
 #define FONT_SPRITES_SIZE 80
 #define FONT_ADDRESS 0
 #define FONT_BYTES 5
+#define BIG_FONT_SPRITES_SIZE 160
+#define BIG_FONT_ADDRESS (FONT_ADDRESS + FONT_SPRITES_SIZE)
+#define BIG_FONT_BYTES 10
+#define RPL_FLAGS 16
+#define AUDIO_PATTERN_SIZE 16 // XO-CHIP 1 bit, 128 sample audio pattern
+#define AUDIO_DEFAULT_PITCH 64 // 4000Hz pattern playback
+#define SOUND_EDGES_MAX 8
+#define CPU_DEFAULT_SEED 0x2545F491u
+#define CPU_CACHE_LINE 64
+
+// Behaviour that differs between CHIP-8 interpreters
+#define QUIRK_VF_RESET (1u << 0) // 8xy1/8xy2/8xy3 reset VF
+#define QUIRK_MEMORY_INCREMENT (1u << 1) // Fx55/Fx65 leave I past the last register
+#define QUIRK_DISPLAY_WAIT (1u << 2) // Dxyn waits for the next timer tick
+#define QUIRK_CLIPPING (1u << 3) // sprites clip at the screen edge instead of wrapping
+#define QUIRK_SHIFT_VX (1u << 4) // 8xy6/8xyE shift Vx in place, ignoring Vy
+#define QUIRK_JUMP_VX (1u << 5) // Bnnn jumps to xnn + Vx
+#define QUIRKS_CHIP8 (QUIRK_VF_RESET | QUIRK_MEMORY_INCREMENT | QUIRK_DISPLAY_WAIT | QUIRK_CLIPPING)
+#define QUIRKS_SCHIP (QUIRK_CLIPPING | QUIRK_SHIFT_VX | QUIRK_JUMP_VX)
+#define QUIRKS_XOCHIP (QUIRK_MEMORY_INCREMENT)
 
 typedef struct opcode 
 {
@@ -29,25 +59,222 @@ typedef struct opcode
 } opcode_t;
 
 
+/*
+ * Everything an instruction reads or writes besides the stack, memory and
+ * the display is packed into the first CPU_CACHE_LINE bytes, and
+ * cpu_init_memory() aligns the allocation so they share a single line.
+ * Colder state follows, then the display and memory. Frontends should go
+ * through the accessors below rather than the fields.
+ */
 typedef struct chip8
 {
     uint8_t V[NUM_REGISTERS]; // V registers
-    uint8_t memory[MEMORY_SIZE];
     uint16_t index;
-    uint16_t keypad_register;
     uint16_t pc; // Program counter
-    uint16_t stack[STACK_SIZE];
+    uint16_t keypad_register;
     uint8_t sp; // stack pointer
     uint8_t delayTimer;
     uint8_t soundTimer;
-    uint32_t vram[DISPLAY_H * DISPLAY_W];
     uint8_t key_held;
+    uint8_t planes; // planes selected for drawing, bit 0 is plane 0
+    bool hires;
     bool display_wait;
+    bool display_dirty; // vram changed since the frontend last rendered it
+    bool sound_gate; // sound timer was running when the frame started
+    uint8_t sound_edge_count;
+    uint32_t frame_cycle; // cycles executed since the last timer tick
+    uint32_t quirks; // QUIRK_* flags
+    uint32_t rng_state;
+    uint32_t memory_size; // power of two, MEMORY_SIZE or XOCHIP_MEMORY_SIZE
+    struct debug *p_debug; // breakpoints and watchpoints, see debug.h
+    struct trace *p_trace; // instruction trace, see trace.h
+    // End of the hot line
+    uint16_t stack[STACK_SIZE];
+    uint64_t idle_cycles; // of all the cycles since reset, how many were skipped as idle
+    uint32_t sound_edges[SOUND_EDGES_MAX]; // frame cycles at which the sound gate toggled
+    uint32_t rng_seed;
+    uint8_t rpl[RPL_FLAGS]; // SUPER-CHIP HP48 flag registers
+    uint8_t audio_pattern[AUDIO_PATTERN_SIZE];
+    uint8_t pitch;
+    bool audio_pattern_active; // F002 has run, the beeper plays the pattern
+#ifdef EMUEIGHT_PROFILE
+    profile_t *p_profile; // counts every cpu_cycle() when not NULL
+#endif
+    // One bit per pixel, leftmost pixel in the most significant bit of word 0
+    uint64_t vram[DISPLAY_PLANES][DISPLAY_H][DISPLAY_WORDS];
+    uint8_t memory[]; // allocated along with the struct, cpu_free() releases both
 } chip8_t;
 
+// Bytes allocated for a cpu with memory_size bytes of RAM
+static inline size_t cpu_state_size(uint32_t memory_size)
+{
+    return sizeof(chip8_t) + memory_size;
+}
+
 chip8_t *cpu_init(void);
+// Allocate a cpu with memory_size bytes of RAM, 64KB for XO-CHIP.
+chip8_t *cpu_init_memory(uint32_t memory_size);
+// Release a cpu from cpu_init() or cpu_init_memory(), NULL is ignored.
+void cpu_free(chip8_t *p_cpu);
 bool cpu_reset(chip8_t *p_cpu);
-bool cpu_load_program(chip8_t *p_cpu, char *p_filename);
+// Load a ROM file at START_ADDRESS, reading it through a memory mapping.
+bool cpu_load_program(chip8_t *p_cpu, const char *p_filename);
+// Load a ROM that is already in memory, the buffer is copied.
+bool cpu_load_program_mem(chip8_t *p_cpu, const uint8_t *p_program, size_t size);
 void cpu_cycle(chip8_t *p_cpu);
+void cpu_run(chip8_t *p_cpu, uint32_t cycles);
+void cpu_timer_tick(chip8_t *p_cpu);
+void cpu_seed_rng(chip8_t *p_cpu, uint32_t seed);
+uint64_t cpu_display_hash(const chip8_t *p_cpu);
+
+// The 4x5 hex digits loaded at FONT_ADDRESS, FONT_BYTES each, the top four bits of each row
+extern const uint8_t cpu_font_sprites[FONT_SPRITES_SIZE];
+
+// ARGB8888, black and white for single plane programs
+extern const uint32_t cpu_default_palette[DISPLAY_COLORS];
+
+/**
+ * Composite the planes of the visible display into 32 bit pixels, looking
+ * each pixel's plane bits up in a DISPLAY_COLORS entry palette. pitch is the
+ * number of pixels between the start of two rows. Clears display_dirty.
+ */
+void cpu_display_render(chip8_t *p_cpu, uint32_t *p_pixels, size_t pitch, const uint32_t *p_palette);
+
+// Registers, for debugger views
+static inline uint16_t cpu_pc(const chip8_t *p_cpu)
+{
+    return p_cpu->pc;
+}
+
+static inline uint16_t cpu_index(const chip8_t *p_cpu)
+{
+    return p_cpu->index;
+}
+
+static inline uint8_t cpu_sp(const chip8_t *p_cpu)
+{
+    return p_cpu->sp;
+}
+
+static inline uint8_t cpu_register(const chip8_t *p_cpu, unsigned x)
+{
+    return p_cpu->V[x & 0xF];
+}
+
+static inline uint8_t cpu_delay_timer(const chip8_t *p_cpu)
+{
+    return p_cpu->delayTimer;
+}
+
+static inline uint8_t cpu_sound_timer(const chip8_t *p_cpu)
+{
+    return p_cpu->soundTimer;
+}
+
+// Memory, addresses wrap at the end the same way the interpreter's do
+static inline uint32_t cpu_memory_size(const chip8_t *p_cpu)
+{
+    return p_cpu->memory_size;
+}
+
+static inline const uint8_t *cpu_memory(const chip8_t *p_cpu)
+{
+    return p_cpu->memory;
+}
+
+static inline uint8_t cpu_read(const chip8_t *p_cpu, uint32_t address)
+{
+    return p_cpu->memory[address & (p_cpu->memory_size - 1)];
+}
+
+static inline uint16_t cpu_read_word(const chip8_t *p_cpu, uint32_t address)
+{
+    return (uint16_t)(cpu_read(p_cpu, address) << 8 | cpu_read(p_cpu, address + 1));
+}
+
+// Input, one bit per key, bit 0 is key 0
+static inline uint16_t cpu_keypad(const chip8_t *p_cpu)
+{
+    return p_cpu->keypad_register;
+}
+
+static inline void cpu_set_keypad(chip8_t *p_cpu, uint16_t keys)
+{
+    p_cpu->keypad_register = keys;
+}
+
+static inline uint32_t cpu_quirks(const chip8_t *p_cpu)
+{
+    return p_cpu->quirks;
+}
+
+static inline void cpu_set_quirks(chip8_t *p_cpu, uint32_t quirks)
+{
+    p_cpu->quirks = quirks;
+}
+
+// Cycles run since the last cpu_timer_tick()
+static inline uint32_t cpu_frame_cycle(const chip8_t *p_cpu)
+{
+    return p_cpu->frame_cycle;
+}
+
+// The display changed since it was last rendered
+static inline bool cpu_display_dirty(const chip8_t *p_cpu)
+{
+    return p_cpu->display_dirty;
+}
+
+// Have the next check see the display as changed, to redraw an overlay
+static inline void cpu_display_invalidate(chip8_t *p_cpu)
+{
+    p_cpu->display_dirty = true;
+}
+
+// Attachments, each kept across cpu_reset(), NULL detaches
+static inline struct debug *cpu_debug(const chip8_t *p_cpu)
+{
+    return p_cpu->p_debug;
+}
+
+static inline void cpu_attach_debug(chip8_t *p_cpu, struct debug *p_debug)
+{
+    p_cpu->p_debug = p_debug;
+}
+
+static inline void cpu_attach_trace(chip8_t *p_cpu, struct trace *p_trace)
+{
+    p_cpu->p_trace = p_trace;
+}
+
+#ifdef EMUEIGHT_PROFILE
+static inline void cpu_attach_profile(chip8_t *p_cpu, profile_t *p_profile)
+{
+    p_cpu->p_profile = p_profile;
+}
+#endif
+
+static inline unsigned cpu_display_width(const chip8_t *p_cpu)
+{
+    return p_cpu->hires ? DISPLAY_W : DISPLAY_LORES_W;
+}
+
+static inline unsigned cpu_display_height(const chip8_t *p_cpu)
+{
+    return p_cpu->hires ? DISPLAY_H : DISPLAY_LORES_H;
+}
+
+// Palette index of a pixel, one bit per plane
+static inline uint8_t cpu_pixel(const chip8_t *p_cpu, unsigned x, unsigned y)
+{
+    uint8_t color = 0;
+
+    for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        color |= (uint8_t)(((p_cpu->vram[plane][y][x >> 6] >> (63 - (x & 63))) & 1) << plane);
+    }
+
+    return color;
+}
 
 #endif // CPU_H_
@@ -0,0 +1,80 @@
+#ifndef DEBUG_H_
+#define DEBUG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define DEBUG_BITMAP_SIZE (XOCHIP_MEMORY_SIZE / 8) // a bit for every address
+#define DEBUG_WATCH_READ 0x1
+#define DEBUG_WATCH_WRITE 0x2
+
+// Why the cpu isn't running
+typedef enum debug_stop
+{
+    DEBUG_RUNNING,
+    DEBUG_PAUSED, // asked to stop by the frontend
+    DEBUG_BREAKPOINT, // about to execute stop_address
+    DEBUG_WATCH_READ_HIT, // the last instruction read stop_address
+    DEBUG_WATCH_WRITE_HIT, // the last instruction wrote stop_address
+    DEBUG_STEPPED // finished a step or step over
+} debug_stop_t;
+
+/**
+ * Breakpoints and watchpoints for a cpu, attached through p_debug. cpu_run()
+ * only looks at them when it is entered: with nothing set it takes the
+ * usual fast path, otherwise the whole batch runs one instruction at a time
+ * with the checks in between. While stopped, cpu_run() executes nothing
+ * until debug_continue() or a step, so frontends should hold the frame
+ * (and its timer tick) until frame_cycle reaches the frame's cycles.
+ */
+typedef struct debug
+{
+    uint8_t breakpoints[DEBUG_BITMAP_SIZE];
+    uint8_t read_watch[DEBUG_BITMAP_SIZE];
+    uint8_t write_watch[DEBUG_BITMAP_SIZE];
+    uint32_t breakpoint_count;
+    uint32_t watch_count;
+    debug_stop_t stop;
+    uint16_t stop_address;
+    bool resuming; // don't stop on the breakpoint at resume_pc until pc has left it
+    uint16_t resume_pc;
+    bool stepping_over; // run until pc and sp are back to return_pc and return_sp
+    uint16_t return_pc;
+    uint8_t return_sp;
+} debug_t;
+
+void debug_init(debug_t *p_debug);
+
+void debug_set_breakpoint(debug_t *p_debug, uint16_t address, bool enabled);
+// kinds is DEBUG_WATCH_READ and/or DEBUG_WATCH_WRITE, for length bytes from address
+void debug_set_watch(debug_t *p_debug, uint16_t address, uint16_t length, uint8_t kinds, bool enabled);
+
+static inline bool debug_has_breakpoint(const debug_t *p_debug, uint16_t address)
+{
+    return 0 != (p_debug->breakpoints[address >> 3] & (1u << (address & 7)));
+}
+
+// Anything that needs cpu_run() to take the slow path
+static inline bool debug_active(const debug_t *p_debug)
+{
+    return 0 != p_debug->breakpoint_count || 0 != p_debug->watch_count ||
+           p_debug->stepping_over || DEBUG_RUNNING != p_debug->stop;
+}
+
+// Stop before the next instruction
+void debug_pause(debug_t *p_debug);
+// These need the debugger attached to the cpu
+void debug_continue(chip8_t *p_cpu);
+// Execute the instruction at pc on its own and stay stopped
+void debug_step(chip8_t *p_cpu);
+// As debug_step(), except 2nnn runs until the subroutine returns
+void debug_step_over(chip8_t *p_cpu);
+
+// For cpu_run(). Whether to stop before executing the instruction at pc.
+bool debug_break_before(debug_t *p_debug, const chip8_t *p_cpu);
+// For cpu_run(). Work out which watched memory the instruction at pc will touch.
+debug_stop_t debug_watch(debug_t *p_debug, const chip8_t *p_cpu);
+
+#endif // DEBUG_H_
@@ -0,0 +1,70 @@
+#ifndef DISASM_H_
+#define DISASM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Per byte flags, indexed by offset from START_ADDRESS
+#define DISASM_CODE 0x01       // a reachable instruction starts here
+#define DISASM_OPERAND 0x02    // second word of F000 nnnn
+#define DISASM_LEADER 0x04     // first instruction of a basic block
+#define DISASM_WRITTEN 0x08    // a store with a known I writes this byte
+#define DISASM_INDIRECT 0x10   // Bnnn, where it goes isn't known until it runs
+#define DISASM_UNRESOLVED 0x20 // store through an I the analysis lost track of
+
+typedef enum disasm_edge
+{
+    DISASM_EDGE_NEXT, // falls through, or the skip wasn't taken
+    DISASM_EDGE_JUMP,
+    DISASM_EDGE_CALL,
+    DISASM_EDGE_SKIP
+} disasm_edge_t;
+
+typedef struct disasm_block
+{
+    uint32_t start; // address of the first instruction
+    uint32_t end;   // address after the last one
+    uint32_t targets[2];
+    uint8_t edges[2]; // disasm_edge_t per target
+    uint8_t edge_count;
+    bool indirect; // ends in Bnnn
+    bool modified; // a store writes one of its instructions
+} disasm_block_t;
+
+/*
+ * Static control flow analysis of a ROM loaded at START_ADDRESS. Every path
+ * from the entry point is followed through jumps, calls, returns and both
+ * sides of each skip, splitting the reachable code into basic blocks.
+ * Whatever isn't reached is data. Bnnn ends a path since its target
+ * depends on V0, and stores are checked against the code they may
+ * overwrite when I was set by a constant earlier in the same block.
+ */
+typedef struct disasm
+{
+    const uint8_t *p_rom;
+    size_t size;
+    uint8_t *p_flags; // DISASM_* per ROM byte
+    disasm_block_t *p_blocks; // in address order
+    size_t block_count;
+    size_t instruction_count;
+    size_t indirect_count;
+    size_t modified_count; // instructions a store writes to
+    size_t unresolved_count;
+} disasm_t;
+
+// The ROM must outlive the analysis. False when out of memory or too big for 64KB.
+bool disasm_analyse(disasm_t *p_disasm, const uint8_t *p_rom, size_t size);
+void disasm_free(disasm_t *p_disasm);
+
+// Instruction length at offset, F000 nnnn is the only four byte one
+size_t disasm_length(const uint8_t *p_rom, size_t size, size_t offset);
+// Mnemonic with operands, "DRW V1, V2, 5". Returns what snprintf() would.
+int disasm_format(char *p_buffer, size_t size, uint16_t opcode, uint16_t operand);
+
+// Listing with block labels, or a Graphviz digraph of the blocks
+bool disasm_write_text(const disasm_t *p_disasm, FILE *p_fp);
+bool disasm_write_dot(const disasm_t *p_disasm, FILE *p_fp);
+
+#endif // DISASM_H_
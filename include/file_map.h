@@ -0,0 +1,23 @@
+#ifndef FILE_MAP_H_
+#define FILE_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A read-only view of a whole file. Where the OS supports it the file is
+ * memory mapped, so the bytes are read straight from the page cache with
+ * no stdio buffering and no copy. Elsewhere it falls back to a single
+ * fread() into the heap.
+ */
+typedef struct file_map
+{
+    const uint8_t *p_data; // NULL for an empty file
+    size_t size;
+} file_map_t;
+
+bool file_map_open(file_map_t *p_map, const char *p_filename);
+void file_map_close(file_map_t *p_map);
+
+#endif // FILE_MAP_H_
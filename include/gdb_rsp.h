@@ -0,0 +1,60 @@
+#ifndef GDB_RSP_H_
+#define GDB_RSP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "debug.h"
+#include "history.h"
+
+#define GDB_RSP_PACKET_SIZE 4096 // advertised to the client, payload bytes
+#define GDB_RSP_OUTPUT_SIZE (2 * GDB_RSP_PACKET_SIZE)
+
+// Register numbers for p and P, and their order in g and G
+#define GDB_RSP_REG_I 16 // after V0 to VF
+#define GDB_RSP_REG_PC 17
+#define GDB_RSP_REG_SP 18
+#define GDB_RSP_REG_DT 19
+#define GDB_RSP_REG_ST 20
+#define GDB_RSP_REGS 21
+
+/**
+ * The GDB remote serial protocol for a cpu with a debugger attached,
+ * without the transport. Bytes from the client go in through
+ * gdb_rsp_receive() and replies collect in the output buffer for whatever
+ * carries them back. V0 to VF, SP and the timers are one byte registers,
+ * I and PC two bytes, little endian in g and G. Memory is the cpu's own,
+ * from address 0. Supports ?, g, G, p, P, m, M, c, s, Z0/z0 breakpoints,
+ * Z2/z2 to Z4/z4 watchpoints, D, k, Ctrl-C and no-ack mode, and with
+ * p_history set, bs and bc to step and continue backwards.
+ */
+typedef struct gdb_rsp
+{
+    chip8_t *p_cpu;
+    history_t *p_history; // optional, recorded by the frontend
+    char packet[GDB_RSP_PACKET_SIZE + 1];
+    size_t length;
+    int state; // where in a packet the next byte goes
+    uint8_t checksum;
+    uint8_t received_checksum;
+    bool no_ack;
+    bool running; // continued, a stop reply is owed once the cpu stops
+    bool detached; // the client has let go, by D, k or hanging up
+    bool killed; // k, the program should end
+    char output[GDB_RSP_OUTPUT_SIZE];
+    size_t output_length;
+} gdb_rsp_t;
+
+// The cpu must have p_debug set. It is paused, as the client expects.
+void gdb_rsp_init(gdb_rsp_t *p_rsp, chip8_t *p_cpu);
+void gdb_rsp_receive(gdb_rsp_t *p_rsp, const uint8_t *p_data, size_t size);
+// Call after running the cpu, queues the stop reply a continue is waiting for.
+void gdb_rsp_check_stop(gdb_rsp_t *p_rsp);
+// Drop bytes from the front of the output once they have been sent.
+void gdb_rsp_sent(gdb_rsp_t *p_rsp, size_t size);
+// The client went away, clear what it set and let the cpu run.
+void gdb_rsp_detach(gdb_rsp_t *p_rsp);
+
+#endif // GDB_RSP_H_
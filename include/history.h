@@ -0,0 +1,68 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "movie.h"
+
+#define HISTORY_DEFAULT_INTERVAL 60 // frames between keyframes, a second
+#define HISTORY_PAGE_SIZE 256
+#define HISTORY_PAGES (XOCHIP_MEMORY_SIZE / HISTORY_PAGE_SIZE)
+
+// The cpu at the start of a frame
+typedef struct history_keyframe
+{
+    uint32_t frame;
+    uint8_t pages[HISTORY_PAGES / 8]; // memory pages that differ from the base, stored in p_state
+    uint8_t *p_state; // chip8_t, then the differing pages in order
+} history_keyframe_t;
+
+/**
+ * Time travel for the debugger. A keyframe of the cpu is kept every
+ * interval frames and every frame's keypad goes into an input movie, so
+ * any earlier point is the nearest keyframe before it and a replay, which
+ * costs at most interval frames however long the session has been. Keyframes
+ * only keep the memory pages that differ from memory when the history began.
+ *
+ * A point in time is a frame, counted from history_begin(), and the
+ * frame_cycle inside it. Cycles per frame must stay the same for the
+ * whole history; begin a new one when they change. Going back forgets
+ * everything after the point gone back to, running on records it afresh.
+ * Changes made from outside, like a debugger writing memory, are not
+ * recorded and disappear when going back past them.
+ */
+typedef struct history
+{
+    movie_t input;
+    uint32_t interval;
+    uint32_t frame_count; // frames started, the cpu is in frame_count - 1
+    history_keyframe_t *p_keyframes;
+    size_t keyframe_count;
+    size_t keyframe_capacity;
+    uint8_t *p_base; // memory when the history began
+    uint32_t memory_size;
+} history_t;
+
+bool history_begin(history_t *p_history, const chip8_t *p_cpu, uint32_t cycles_per_frame, uint32_t interval);
+// Call at the start of every frame, after setting the keypad, before running it.
+bool history_frame(history_t *p_history, const chip8_t *p_cpu);
+void history_free(history_t *p_history);
+
+// Go to cycle of frame, which must be no later than now.
+bool history_seek(history_t *p_history, chip8_t *p_cpu, uint32_t frame, uint32_t cycle);
+/**
+ * Undo the last cycle, leaving the attached debugger stopped as after a
+ * step. False at the start of the history.
+ */
+bool history_step_back(history_t *p_history, chip8_t *p_cpu);
+/**
+ * Go back to the last time the attached debugger's breakpoints or
+ * watchpoints stopped the cpu, with the debugger stopped the same way. With
+ * none, go to the start of the history and return false.
+ */
+bool history_continue_back(history_t *p_history, chip8_t *p_cpu);
+
+#endif // HISTORY_H_
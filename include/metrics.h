@@ -0,0 +1,55 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cpu.h"
+
+#define METRICS_FRAME_BUDGET_NS 16666667u // a 60Hz frame
+// Frame times in microseconds, exact below 2 * METRICS_SUB_BUCKETS and
+// within 1 / METRICS_SUB_BUCKETS above, up to about half a minute
+#define METRICS_SUB_BUCKETS 16
+#define METRICS_MAX_SHIFT 20
+#define METRICS_BUCKETS ((METRICS_MAX_SHIFT + 2) * METRICS_SUB_BUCKETS)
+
+/**
+ * How well the emulator is keeping up. Only the emulation thread updates
+ * it, and only the emulation thread writes it out, between frames, so
+ * nothing is shared and nothing waits: readers get a file replaced whole
+ * by metrics_save() or a copy sent down a socket.
+ */
+typedef struct metrics
+{
+    uint64_t frames;
+    uint64_t late_frames; // took longer than METRICS_FRAME_BUDGET_NS
+    uint64_t skipped_frames; // dropped by the frontend to catch up, counted there
+    uint64_t cycles; // run, whether executed or skipped as idle
+    uint64_t idle_cycles; // skipped as idle rather than executed
+    uint64_t audio_underruns; // set by the frontend
+    uint32_t cycles_per_frame; // of the last frame
+    double instructions_per_second; // between the last two metrics_rate() calls
+    uint64_t frame_ns_sum;
+    uint64_t frame_ns_max;
+    uint64_t histogram[METRICS_BUCKETS]; // frame times
+    uint64_t cpu_idle_cycles; // the cpu's count at the last frame
+    uint64_t rate_ns; // time of the last metrics_rate()
+    uint64_t rate_instructions; // instructions then
+} metrics_t;
+
+void metrics_init(metrics_t *p_metrics);
+// Count a frame that took frame_ns, after its cycles ran and before cpu_timer_tick()
+void metrics_frame(metrics_t *p_metrics, const chip8_t *p_cpu, uint64_t frame_ns);
+// Work out instructions_per_second since the last call, now_ns from any fixed start
+void metrics_rate(metrics_t *p_metrics, uint64_t now_ns);
+// The frame time in seconds q of frames took no longer than, 0 without frames
+double metrics_quantile(const metrics_t *p_metrics, double q);
+
+// Prometheus text exposition format
+bool metrics_write(const metrics_t *p_metrics, FILE *p_fp);
+// Written next to p_filename then renamed over it, so readers never see half a file
+bool metrics_save(const metrics_t *p_metrics, const char *p_filename);
+
+#endif // METRICS_H_
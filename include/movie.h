@@ -0,0 +1,68 @@
+#ifndef MOVIE_H_
+#define MOVIE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define MOVIE_MAGIC "E8MV"
+#define MOVIE_VERSION 3 // 3: display hash covers every XO-CHIP plane
+
+// A run of consecutive frames with the same keypad state
+typedef struct movie_run
+{
+    uint16_t keypad;
+    uint32_t frames;
+} movie_run_t;
+
+/*
+ * Deterministic input movie. Everything that can make two runs of the same
+ * ROM differ is captured: the RNG seed, the quirk profile, the number of
+ * cycles per frame and the keypad register for every frame, run-length
+ * encoded. The display hash at the end of recording lets playback prove it
+ * reproduced the session bit for bit.
+ */
+typedef struct movie
+{
+    uint32_t rng_seed;
+    uint32_t quirks;
+    uint32_t cycles_per_frame;
+    uint32_t frame_count;
+    uint64_t display_hash; // cpu_display_hash() after the last frame
+    movie_run_t *p_runs;
+    size_t run_count;
+    size_t run_capacity;
+    size_t play_run; // playback cursor
+    uint32_t play_frame;
+} movie_t;
+
+// Start recording, capturing the RNG seed and quirks of a freshly loaded cpu.
+void movie_record_begin(movie_t *p_movie, const chip8_t *p_cpu, uint32_t cycles_per_frame);
+bool movie_record_frame(movie_t *p_movie, uint16_t keypad);
+void movie_record_end(movie_t *p_movie, const chip8_t *p_cpu);
+
+// Seed and configure a freshly loaded cpu to match the recording.
+void movie_play_begin(movie_t *p_movie, chip8_t *p_cpu);
+// Fetch the keypad state for the next frame, false once the movie has ended.
+bool movie_play_frame(movie_t *p_movie, uint16_t *p_keypad);
+// Move the playback cursor so the next movie_play_frame() returns frame.
+bool movie_play_seek(movie_t *p_movie, uint32_t frame);
+// Forget the input for every frame from frame_count on.
+void movie_truncate(movie_t *p_movie, uint32_t frame_count);
+// True if the cpu shows the same picture as at the end of the recording.
+bool movie_play_verify(const movie_t *p_movie, const chip8_t *p_cpu);
+
+/**
+ * Play a whole movie back as fast as possible: each frame sets the keypad,
+ * runs cycles_per_frame cycles and ticks the timers. Returns the number of
+ * frames played.
+ */
+uint32_t movie_play_all(movie_t *p_movie, chip8_t *p_cpu);
+
+bool movie_save(const movie_t *p_movie, const char *p_filename);
+bool movie_load(movie_t *p_movie, const char *p_filename);
+void movie_free(movie_t *p_movie);
+
+#endif // MOVIE_H_
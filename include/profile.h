@@ -0,0 +1,99 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILE_PC_BUCKETS 2048
+
+// Instruction classes counted by the profiler, one per opcode form
+typedef enum profile_op
+{
+    PROFILE_OP_CLS,         // 00E0
+    PROFILE_OP_RET,         // 00EE
+    PROFILE_OP_SCD,         // 00Cn
+    PROFILE_OP_SCR,         // 00FB
+    PROFILE_OP_SCL,         // 00FC
+    PROFILE_OP_EXIT,        // 00FD
+    PROFILE_OP_LOW,         // 00FE
+    PROFILE_OP_HIGH,        // 00FF
+    PROFILE_OP_JP,          // 1nnn
+    PROFILE_OP_CALL,        // 2nnn
+    PROFILE_OP_SE_IMM,      // 3xnn
+    PROFILE_OP_SNE_IMM,     // 4xnn
+    PROFILE_OP_SE_REG,      // 5xy0
+    PROFILE_OP_SAVE_RANGE,  // 5xy2
+    PROFILE_OP_LOAD_RANGE,  // 5xy3
+    PROFILE_OP_LD_IMM,      // 6xnn
+    PROFILE_OP_ADD_IMM,     // 7xnn
+    PROFILE_OP_LD_REG,      // 8xy0
+    PROFILE_OP_OR,          // 8xy1
+    PROFILE_OP_AND,         // 8xy2
+    PROFILE_OP_XOR,         // 8xy3
+    PROFILE_OP_ADD_REG,     // 8xy4
+    PROFILE_OP_SUB,         // 8xy5
+    PROFILE_OP_SHR,         // 8xy6
+    PROFILE_OP_SUBN,        // 8xy7
+    PROFILE_OP_SHL,         // 8xyE
+    PROFILE_OP_SNE_REG,     // 9xy0
+    PROFILE_OP_LD_I,        // Annn
+    PROFILE_OP_JP_V0,       // Bnnn
+    PROFILE_OP_RND,         // Cxnn
+    PROFILE_OP_DRW,         // Dxyn
+    PROFILE_OP_SKP,         // Ex9E
+    PROFILE_OP_SKNP,        // ExA1
+    PROFILE_OP_LD_I_LONG,   // F000 nnnn
+    PROFILE_OP_PLANE,       // Fn01
+    PROFILE_OP_AUDIO,       // F002
+    PROFILE_OP_LD_VX_DT,    // Fx07
+    PROFILE_OP_LD_KEY,      // Fx0A
+    PROFILE_OP_LD_DT,       // Fx15
+    PROFILE_OP_LD_ST,       // Fx18
+    PROFILE_OP_ADD_I,       // Fx1E
+    PROFILE_OP_LD_FONT,     // Fx29
+    PROFILE_OP_LD_BIG_FONT, // Fx30
+    PROFILE_OP_BCD,         // Fx33
+    PROFILE_OP_PITCH,       // Fx3A
+    PROFILE_OP_STORE,       // Fx55
+    PROFILE_OP_LOAD,        // Fx65
+    PROFILE_OP_SAVE_FLAGS,  // Fx75
+    PROFILE_OP_LOAD_FLAGS,  // Fx85
+    PROFILE_OP_UNKNOWN,
+    PROFILE_OP_COUNT
+} profile_op_t;
+
+/**
+ * Execution counters filled in by cpu_cycle() when the core is built with
+ * EMUEIGHT_PROFILE and a profile is attached to the cpu. Without that
+ * define the hook is compiled out and costs nothing.
+ */
+typedef struct profile
+{
+    uint64_t total;
+    uint64_t op_counts[PROFILE_OP_COUNT];
+    uint64_t pc_counts[PROFILE_PC_BUCKETS];
+    uint8_t pc_shift; // address bits folded into one bucket
+} profile_t;
+
+// Size the PC buckets to cover memory_size bytes of memory.
+void profile_init(profile_t *p_profile, uint32_t memory_size);
+void profile_reset(profile_t *p_profile);
+
+profile_op_t profile_classify(uint16_t opcode);
+const char *profile_op_name(profile_op_t op);
+
+static inline void profile_count(profile_t *p_profile, uint16_t pc, uint16_t opcode)
+{
+    p_profile->total++;
+    p_profile->op_counts[profile_classify(opcode)]++;
+    p_profile->pc_counts[(pc >> p_profile->pc_shift) & (PROFILE_PC_BUCKETS - 1)]++;
+}
+
+// Reports list only the opcode classes and PC buckets that were executed.
+bool profile_write_json(const profile_t *p_profile, FILE *p_fp);
+bool profile_write_csv(const profile_t *p_profile, FILE *p_fp);
+// Pick JSON or CSV from the file extension, JSON unless it ends in ".csv".
+bool profile_save(const profile_t *p_profile, const char *p_filename);
+
+#endif // PROFILE_H_
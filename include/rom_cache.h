@@ -0,0 +1,67 @@
+#ifndef ROM_CACHE_H_
+#define ROM_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "rom_db.h"
+
+#define ROM_CACHE_BUCKETS 256
+
+/*
+ * One immutable copy of a ROM, shared by everything that loads the same
+ * bytes, along with what can be worked out from it up front. Platform,
+ * quirks, tickrate and keys come from the ROM database when the ROM is in
+ * it and are guessed from its instructions otherwise. The code map
+ * has a bit per byte from START_ADDRESS, set where an instruction that can
+ * be reached from the entry point starts; jumps through Bnnn and code that
+ * is only reached by modifying itself aren't followed.
+ */
+typedef struct rom_image
+{
+    uint64_t hash; // rom_hash() of the data
+    size_t size;
+    rom_platform_t platform;
+    uint32_t quirks; // QUIRK_* flags
+    uint32_t memory_size; // what cpu_init_memory() needs for the platform
+    uint32_t tickrate; // cycles per frame, 0 leaves it to the frontend
+    uint8_t keys[ROM_KEYS]; // keypad key per rom_key_t, ROM_DB_KEY_NONE if unknown
+    bool known; // found in the ROM database
+    const uint8_t *p_code_map;
+    uint32_t refs;
+    struct rom_image *p_next; // bucket chain
+    uint8_t data[]; // followed by the code map
+} rom_image_t;
+
+// Content-addressed registry of ROM images. Not thread safe.
+typedef struct rom_cache
+{
+    rom_image_t *p_buckets[ROM_CACHE_BUCKETS];
+    size_t count;
+    const rom_db_entry_t *p_db; // sorted by hash, rom_cache_init() picks the built in table
+    size_t db_count;
+} rom_cache_t;
+
+// FNV-1a over the ROM's bytes, the key for the cache and the ROM database
+uint64_t rom_hash(const uint8_t *p_data, size_t size);
+
+void rom_cache_init(rom_cache_t *p_cache);
+// Look ROMs up in another table from now on, sorted by hash. Images already
+// in the cache keep what they were given.
+void rom_cache_use_db(rom_cache_t *p_cache, const rom_db_entry_t *p_db, size_t count);
+// Frees every image, including ones still referenced.
+void rom_cache_free(rom_cache_t *p_cache);
+
+// Find the image for these bytes or add one, taking a reference to it.
+const rom_image_t *rom_cache_acquire(rom_cache_t *p_cache, const uint8_t *p_data, size_t size);
+const rom_image_t *rom_cache_acquire_file(rom_cache_t *p_cache, const char *p_filename);
+// Drop a reference, the image is freed along with the last one.
+void rom_cache_release(rom_cache_t *p_cache, const rom_image_t *p_image);
+
+bool rom_image_is_code(const rom_image_t *p_image, uint32_t address);
+// A cpu sized and configured for the image with the program loaded. Caller frees with cpu_free().
+chip8_t *rom_image_new_cpu(const rom_image_t *p_image);
+
+#endif // ROM_CACHE_H_
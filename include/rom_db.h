@@ -0,0 +1,49 @@
+#ifndef ROM_DB_H_
+#define ROM_DB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROM_DB_KEY_NONE 0xFF
+
+typedef enum rom_platform
+{
+    ROM_PLATFORM_CHIP8,
+    ROM_PLATFORM_SCHIP,
+    ROM_PLATFORM_XOCHIP
+} rom_platform_t;
+
+// Controls a game uses, mapped onto its keypad keys by the frontends
+typedef enum rom_key
+{
+    ROM_KEY_UP,
+    ROM_KEY_DOWN,
+    ROM_KEY_LEFT,
+    ROM_KEY_RIGHT,
+    ROM_KEY_A,
+    ROM_KEY_B,
+    ROM_KEYS
+} rom_key_t;
+
+/*
+ * What a known ROM needs to run properly. The table is compiled in sorted
+ * by hash, so a lookup is a binary search with nothing parsed at startup.
+ */
+typedef struct rom_db_entry
+{
+    uint64_t hash; // rom_hash() of the ROM
+    uint32_t quirks; // QUIRK_* flags
+    uint32_t tickrate; // cycles per frame
+    uint8_t platform; // rom_platform_t
+    uint8_t keys[ROM_KEYS]; // keypad key per rom_key_t, ROM_DB_KEY_NONE if unused
+} rom_db_entry_t;
+
+extern const rom_db_entry_t rom_db_entries[];
+extern const size_t rom_db_entry_count;
+
+// The built in entry for a ROM hash, NULL for unknown ROMs.
+const rom_db_entry_t *rom_db_find(uint64_t hash);
+// Binary search any table sorted by hash.
+const rom_db_entry_t *rom_db_search(const rom_db_entry_t *p_table, size_t count, uint64_t hash);
+
+#endif // ROM_DB_H_
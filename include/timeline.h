@@ -0,0 +1,91 @@
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TIMELINE_DEFAULT_EVENTS 16384 // a minute or so of frames
+#define TIMELINE_MAX_DEPTH 8 // phases open inside each other
+
+// Nanoseconds from any start, the same one for every thread written to a file
+typedef uint64_t (*timeline_clock_t)(void);
+
+// A finished phase, times in nanoseconds
+typedef struct timeline_event
+{
+    const char *p_name;
+    uint64_t start;
+    uint64_t duration;
+} timeline_event_t;
+
+/**
+ * Where one thread's frame time goes. Phases are timed between
+ * timeline_begin() and timeline_end(), which nest, into a ring of the most
+ * recent events. Only the owning thread touches a timeline, so there is
+ * no locking; several threads go into one file by each writing its own
+ * part in turn. Phase names must outlive the timeline, string literals.
+ * A timeline that was never initialised, or failed to, ignores phases.
+ */
+typedef struct timeline
+{
+    timeline_event_t *p_events;
+    uint32_t mask; // capacity - 1, capacity is a power of two
+    uint64_t head; // events recorded
+    timeline_clock_t clock;
+    const char *p_thread_name;
+    uint32_t thread_id;
+    uint32_t depth; // phases open, deeper than TIMELINE_MAX_DEPTH aren't recorded
+    const char *p_open[TIMELINE_MAX_DEPTH];
+    uint64_t open_start[TIMELINE_MAX_DEPTH];
+} timeline_t;
+
+// capacity is rounded up to a power of two, 0 for the default
+bool timeline_init(timeline_t *p_timeline, uint32_t capacity, timeline_clock_t clock,
+                   const char *p_thread_name, uint32_t thread_id);
+void timeline_free(timeline_t *p_timeline);
+
+static inline void timeline_begin(timeline_t *p_timeline, const char *p_name)
+{
+    if(NULL == p_timeline->p_events)
+    {
+        return;
+    }
+    if(p_timeline->depth < TIMELINE_MAX_DEPTH)
+    {
+        p_timeline->p_open[p_timeline->depth] = p_name;
+        p_timeline->open_start[p_timeline->depth] = p_timeline->clock();
+    }
+    p_timeline->depth++;
+}
+
+// Close the phase begun last
+static inline void timeline_end(timeline_t *p_timeline)
+{
+    timeline_event_t *p_event = NULL;
+
+    if(NULL == p_timeline->p_events || 0 == p_timeline->depth)
+    {
+        return;
+    }
+    if(--p_timeline->depth < TIMELINE_MAX_DEPTH)
+    {
+        p_event = &p_timeline->p_events[p_timeline->head & p_timeline->mask];
+        p_event->p_name = p_timeline->p_open[p_timeline->depth];
+        p_event->start = p_timeline->open_start[p_timeline->depth];
+        p_event->duration = p_timeline->clock() - p_event->start;
+        p_timeline->head++;
+    }
+}
+
+/**
+ * Chrome trace event JSON, for chrome://tracing or Perfetto. Write the
+ * beginning, then each thread's timeline from that thread, then the end.
+ * All return false if writing failed.
+ */
+bool timeline_write_begin(FILE *p_fp);
+bool timeline_write(const timeline_t *p_timeline, FILE *p_fp);
+bool timeline_write_end(FILE *p_fp);
+
+#endif // TIMELINE_H_
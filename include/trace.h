@@ -0,0 +1,103 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cpu.h"
+
+#define TRACE_MAGIC "E8TR"
+#define TRACE_VERSION 1
+#define TRACE_RECORD_SIZE 32 // bytes per record in a trace file
+#define TRACE_CHUNK_RECORDS 4096 // records written to a file at a time
+#define TRACE_DEFAULT_RECORDS (16 * TRACE_CHUNK_RECORDS)
+
+// trace_record_t flags, what else differs from the record before
+#define TRACE_CHANGED_INDEX 0x01
+#define TRACE_CHANGED_SP 0x02
+#define TRACE_CHANGED_DT 0x04
+#define TRACE_CHANGED_ST 0x08
+
+// One executed instruction and the registers it left behind
+typedef struct trace_record
+{
+    uint32_t sequence; // instructions traced before this one, gaps mean records were lost
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t changed; // bit n set when Vn differs from the record before, in the ring when V[n] was stored
+    uint16_t index; // I after the instruction
+    uint8_t flags; // TRACE_CHANGED_*
+    uint8_t sp;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t V[NUM_REGISTERS]; // after the instruction
+} trace_record_t;
+
+/**
+ * Instruction trace of a cpu, attached through p_trace. While attached,
+ * cpu_run() executes one instruction at a time and appends a record for
+ * each to a ring buffer, with no I/O. Instructions skipped as idle aren't
+ * recorded. Whoever owns the trace calls trace_flush() off the hot path,
+ * between frames, to write out full chunks. If the ring fills up before
+ * that, the oldest records are lost and counted in dropped.
+ *
+ * The cpu copies I, SP and the timers into a record but only the V
+ * registers the instruction can write, except for the first record of a
+ * batch which has all of them. trace_flush() takes the rest of V from the
+ * record before, then fills in changed and flags by comparing the two, so
+ * the timers counting down between frames, or a debugger writing
+ * registers, show up against the next instruction.
+ */
+typedef struct trace
+{
+    trace_record_t *p_records;
+    uint32_t mask; // capacity - 1, capacity is a power of two
+    uint64_t head; // records appended
+    uint64_t tail; // records written out or dropped
+    uint64_t dropped;
+    trace_record_t last; // the last record written out
+} trace_t;
+
+// capacity is rounded up to a power of two of at least a chunk, 0 for the default
+bool trace_init(trace_t *p_trace, uint32_t capacity);
+void trace_free(trace_t *p_trace);
+
+// For trace_append(), the oldest record not written out is about to be overwritten
+void trace_overrun(trace_t *p_trace);
+
+// For cpu_run(). The next record to fill in.
+static inline trace_record_t *trace_append(trace_t *p_trace)
+{
+    trace_record_t *p_record = &p_trace->p_records[p_trace->head & p_trace->mask];
+
+    if(p_trace->head - p_trace->tail > p_trace->mask)
+    {
+        trace_overrun(p_trace);
+    }
+    p_record->sequence = (uint32_t)p_trace->head;
+    p_trace->head++;
+
+    return p_record;
+}
+
+bool trace_write_header(FILE *p_fp);
+/**
+ * Write every full chunk of records to p_fp, and with all set whatever is
+ * left over too. Returns false if writing failed.
+ */
+bool trace_flush(trace_t *p_trace, FILE *p_fp, bool all);
+
+// Reading a trace file back
+typedef struct trace_reader
+{
+    FILE *p_fp;
+} trace_reader_t;
+
+bool trace_reader_open(trace_reader_t *p_reader, const char *p_filename);
+// False at the end of the file
+bool trace_reader_next(trace_reader_t *p_reader, trace_record_t *p_record);
+void trace_reader_close(trace_reader_t *p_reader);
+
+#endif // TRACE_H_
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+#include "file_map.h"
+
+typedef struct options
+{
+    const char *p_rom;
+    const char *p_output;
+    bool dot;
+} options_t;
+
+static void usage(const char *p_name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <rom>\n"
+            "  --dot            write a Graphviz digraph of the basic blocks instead of a listing\n"
+            "  --output=FILE    write to FILE rather than stdout\n",
+            p_name);
+}
+
+static bool parse_options(int argc, char *argv[], options_t *p_opts)
+{
+    memset(p_opts, 0, sizeof(*p_opts));
+
+    for(int i = 1; i < argc; i++)
+    {
+        const char *p_arg = argv[i];
+
+        if(0 == strcmp(p_arg, "--dot"))
+        {
+            p_opts->dot = true;
+        }
+        else if(0 == strncmp(p_arg, "--output=", 9))
+        {
+            p_opts->p_output = p_arg + 9;
+        }
+        else if('-' == p_arg[0])
+        {
+            return false;
+        }
+        else
+        {
+            p_opts->p_rom = p_arg;
+        }
+    }
+
+    return NULL != p_opts->p_rom;
+}
+
+int main(int argc, char *argv[])
+{
+    options_t opts;
+    file_map_t rom;
+    disasm_t disasm;
+    FILE *p_fp = stdout;
+    bool ok = false;
+
+    if(!parse_options(argc, argv, &opts))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if(!file_map_open(&rom, opts.p_rom))
+    {
+        fprintf(stderr, "Failed to load program %s.\n", opts.p_rom);
+        return EXIT_FAILURE;
+    }
+    if(!disasm_analyse(&disasm, rom.p_data, rom.size))
+    {
+        fprintf(stderr, "Failed to analyse %s, is it bigger than 64KB?\n", opts.p_rom);
+        file_map_close(&rom);
+        return EXIT_FAILURE;
+    }
+
+    if(NULL != opts.p_output && NULL == (p_fp = fopen(opts.p_output, "w")))
+    {
+        fprintf(stderr, "Failed to open %s.\n", opts.p_output);
+        disasm_free(&disasm);
+        file_map_close(&rom);
+        return EXIT_FAILURE;
+    }
+
+    ok = opts.dot ? disasm_write_dot(&disasm, p_fp) : disasm_write_text(&disasm, p_fp);
+    if(stdout != p_fp && 0 != fclose(p_fp))
+    {
+        ok = false;
+    }
+    if(!ok)
+    {
+        fprintf(stderr, "Failed to write the %s.\n", opts.dot ? "graph" : "listing");
+    }
+
+    disasm_free(&disasm);
+    file_map_close(&rom);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
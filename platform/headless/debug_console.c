@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "debug_console.h"
+#include "disasm.h"
+
+#define DUMP_DEFAULT_LENGTH 16
+#define LIST_DEFAULT_COUNT 8
+
+static void help(void)
+{
+    printf("  c                continue\n"
+           "  s                step one instruction\n"
+           "  n                step, running a whole subroutine for CALL\n"
+           "  S                step back one instruction\n"
+           "  C                continue back to the last breakpoint or watchpoint\n"
+           "  b ADDR           toggle a breakpoint\n"
+           "  w ADDR [LEN]     watch for writes\n"
+           "  r ADDR [LEN]     watch for reads\n"
+           "  d ADDR [LEN]     delete watches\n"
+           "  x ADDR [LEN]     dump memory\n"
+           "  l [COUNT]        list instructions from pc\n"
+           "  p                show the registers\n"
+           "  q                quit\n");
+}
+
+// Instruction at address, without reading past the end of memory
+static void format_instruction(const chip8_t *p_cpu, uint32_t address, char *p_text, size_t size)
+{
+    uint16_t opcode = cpu_read_word(p_cpu, address);
+    uint16_t operand = cpu_read_word(p_cpu, address + 2);
+
+    disasm_format(p_text, size, opcode, operand);
+}
+
+void debug_console_show(const chip8_t *p_cpu)
+{
+    const debug_t *p_debug = cpu_debug(p_cpu);
+    char text[32];
+
+    switch(p_debug->stop)
+    {
+        case DEBUG_BREAKPOINT:
+            printf("breakpoint at 0x%04X\n", p_debug->stop_address);
+            break;
+        case DEBUG_WATCH_READ_HIT:
+            printf("read of 0x%04X\n", p_debug->stop_address);
+            break;
+        case DEBUG_WATCH_WRITE_HIT:
+            printf("write to 0x%04X\n", p_debug->stop_address);
+            break;
+        case DEBUG_STEPPED:
+            break;
+        default:
+            printf("stopped\n");
+            break;
+    }
+
+    printf("pc %04X  I %04X  sp %u  dt %u  st %u  cycle %u\n", cpu_pc(p_cpu), cpu_index(p_cpu),
+           cpu_sp(p_cpu), cpu_delay_timer(p_cpu), cpu_sound_timer(p_cpu), cpu_frame_cycle(p_cpu));
+    for(unsigned i = 0; i < NUM_REGISTERS; i++)
+    {
+        printf("V%X %02X%s", i, cpu_register(p_cpu, i), (7 == (i & 7)) ? "\n" : "  ");
+    }
+    format_instruction(p_cpu, cpu_pc(p_cpu), text, sizeof(text));
+    printf("0x%04X  %s\n", cpu_pc(p_cpu), text);
+}
+
+// "ADDR [LEN]" after the command letter, LEN defaulting to length
+static bool parse_range(const char *p_args, uint16_t *p_address, uint16_t *p_length, uint16_t length)
+{
+    char *p_end = NULL;
+    unsigned long value = strtoul(p_args, &p_end, 16);
+
+    if(p_end == p_args || value > 0xFFFF)
+    {
+        return false;
+    }
+    *p_address = (uint16_t)value;
+    *p_length = length;
+
+    p_args = p_end;
+    value = strtoul(p_args, &p_end, 0);
+    if(p_end != p_args)
+    {
+        if(0 == value || value > 0x10000)
+        {
+            return false;
+        }
+        *p_length = (uint16_t)value;
+    }
+
+    return true;
+}
+
+static void dump(const chip8_t *p_cpu, uint16_t address, uint16_t length)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        uint32_t at = (address + i) & (cpu_memory_size(p_cpu) - 1);
+
+        if(0 == (i & 15))
+        {
+            printf("%s0x%04X ", (0 == i) ? "" : "\n", at);
+        }
+        printf(" %02X", cpu_read(p_cpu, at));
+    }
+    printf("\n");
+}
+
+static void list(const chip8_t *p_cpu, uint32_t count)
+{
+    uint32_t address = cpu_pc(p_cpu);
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        char text[32];
+
+        format_instruction(p_cpu, address, text, sizeof(text));
+        printf("%c 0x%04X  %s\n", debug_has_breakpoint(cpu_debug(p_cpu), (uint16_t)address) ? '*' : ' ',
+               address, text);
+        address = (uint32_t)(address + disasm_length(cpu_memory(p_cpu), cpu_memory_size(p_cpu), address)) & (cpu_memory_size(p_cpu) - 1);
+    }
+}
+
+bool debug_console_prompt(chip8_t *p_cpu, history_t *p_history)
+{
+    debug_t *p_debug = cpu_debug(p_cpu);
+    char line[128];
+    const char *p_args = line + 1;
+    uint16_t address = 0;
+    uint16_t length = 0;
+
+    printf("(debug) ");
+    fflush(stdout);
+    if(NULL == fgets(line, sizeof(line), stdin))
+    {
+        printf("\n");
+        return false;
+    }
+
+    switch(line[0])
+    {
+        case 'c':
+            debug_continue(p_cpu);
+            break;
+        case 's':
+            debug_step(p_cpu);
+            debug_console_show(p_cpu);
+            break;
+        case 'n':
+            debug_step_over(p_cpu);
+            // A call runs on from here, the stop is shown when it comes back
+            if(DEBUG_RUNNING != p_debug->stop)
+            {
+                debug_console_show(p_cpu);
+            }
+            break;
+        case 'S':
+        case 'C':
+            if(NULL == p_history)
+            {
+                printf("no history to go back through\n");
+                break;
+            }
+            if(!(('S' == line[0]) ? history_step_back(p_history, p_cpu) : history_continue_back(p_history, p_cpu)))
+            {
+                printf("at the start of the history\n");
+            }
+            debug_console_show(p_cpu);
+            break;
+        case 'b':
+            if(!parse_range(p_args, &address, &length, 1))
+            {
+                printf("b ADDR\n");
+                break;
+            }
+            debug_set_breakpoint(p_debug, address, !debug_has_breakpoint(p_debug, address));
+            printf("breakpoint at 0x%04X %s\n", address, debug_has_breakpoint(p_debug, address) ? "set" : "cleared");
+            break;
+        case 'w':
+        case 'r':
+        case 'd':
+            if(!parse_range(p_args, &address, &length, 1))
+            {
+                printf("%c ADDR [LEN]\n", line[0]);
+                break;
+            }
+            if('d' == line[0])
+            {
+                debug_set_watch(p_debug, address, length, DEBUG_WATCH_READ | DEBUG_WATCH_WRITE, false);
+            }
+            else
+            {
+                debug_set_watch(p_debug, address, length, ('w' == line[0]) ? DEBUG_WATCH_WRITE : DEBUG_WATCH_READ, true);
+            }
+            break;
+        case 'x':
+            if(!parse_range(p_args, &address, &length, DUMP_DEFAULT_LENGTH))
+            {
+                printf("x ADDR [LEN]\n");
+                break;
+            }
+            dump(p_cpu, address, length);
+            break;
+        case 'l':
+        {
+            char *p_end = NULL;
+            unsigned long count = strtoul(p_args, &p_end, 0);
+            list(p_cpu, (p_end == p_args || 0 == count) ? LIST_DEFAULT_COUNT : (uint32_t)count);
+            break;
+        }
+        case 'p':
+            debug_console_show(p_cpu);
+            break;
+        case 'q':
+            return false;
+        case '\n':
+            break;
+        default:
+            help();
+            break;
+    }
+
+    return true;
+}
@@ -0,0 +1,18 @@
+#ifndef DEBUG_CONSOLE_H_
+#define DEBUG_CONSOLE_H_
+
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "history.h"
+
+// Say why the cpu stopped, then show its registers and next instruction.
+void debug_console_show(const chip8_t *p_cpu);
+/**
+ * Read and carry out one command from stdin while the debugger attached to
+ * the cpu has it stopped. Going backwards needs p_history, which may be
+ * NULL. Returns false to quit, on "q" or end of input.
+ */
+bool debug_console_prompt(chip8_t *p_cpu, history_t *p_history);
+
+#endif // DEBUG_CONSOLE_H_
@@ -0,0 +1,243 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "gdb_server.h"
+
+#if defined(_WIN32)
+
+bool gdb_server_open(gdb_server_t *p_server, const char *p_address, chip8_t *p_cpu)
+{
+    (void)p_address;
+    (void)p_cpu;
+    p_server->listen_fd = -1;
+    p_server->fd = -1;
+    fprintf(stderr, "gdb: not supported on this platform\n");
+
+    return false;
+}
+
+bool gdb_server_poll(gdb_server_t *p_server, bool wait)
+{
+    (void)p_server;
+    (void)wait;
+
+    return true;
+}
+
+void gdb_server_close(gdb_server_t *p_server)
+{
+    (void)p_server;
+}
+
+#else
+
+static int gdb_server_listen(const char *p_address)
+{
+    int fd = -1;
+
+    if(NULL != strchr(p_address, '/'))
+    {
+        struct sockaddr_un address;
+
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(strlen(p_address) >= sizeof(address.sun_path))
+        {
+            return -1;
+        }
+        strcpy(address.sun_path, p_address);
+
+        // A socket left behind by an earlier run is in the way
+        unlink(p_address);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd >= 0 && 0 != bind(fd, (const struct sockaddr *)&address, sizeof(address)))
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_in address;
+        char *p_end = NULL;
+        unsigned long port = strtoul(p_address, &p_end, 10);
+        int reuse = 1;
+
+        if('\0' != *p_end || 0 == port || port > 0xFFFF)
+        {
+            return -1;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t)port);
+        // Nobody else gets to poke at the emulator's memory
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd >= 0)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if(0 != bind(fd, (const struct sockaddr *)&address, sizeof(address)))
+            {
+                close(fd);
+                return -1;
+            }
+        }
+    }
+
+    if(fd >= 0 && 0 != listen(fd, 1))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool gdb_server_open(gdb_server_t *p_server, const char *p_address, chip8_t *p_cpu)
+{
+    int nodelay = 1;
+
+    p_server->fd = -1;
+    p_server->listen_fd = gdb_server_listen(p_address);
+    if(p_server->listen_fd < 0)
+    {
+        fprintf(stderr, "gdb: can't listen on %s\n", p_address);
+        return false;
+    }
+
+    // A client hanging up shows as a failed send rather than ending the program
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "gdb: waiting for a connection on %s\n", p_address);
+    do
+    {
+        p_server->fd = accept(p_server->listen_fd, NULL, NULL);
+    } while(p_server->fd < 0 && EINTR == errno);
+
+    if(p_server->fd < 0)
+    {
+        fprintf(stderr, "gdb: accept failed\n");
+        gdb_server_close(p_server);
+        return false;
+    }
+    // Packets are small and every one is waited on
+    setsockopt(p_server->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    gdb_rsp_init(&p_server->rsp, p_cpu);
+
+    return true;
+}
+
+static void gdb_server_hang_up(gdb_server_t *p_server)
+{
+    if(!p_server->rsp.detached)
+    {
+        gdb_rsp_detach(&p_server->rsp);
+    }
+    close(p_server->fd);
+    p_server->fd = -1;
+}
+
+static void gdb_server_flush(gdb_server_t *p_server)
+{
+    gdb_rsp_t *p_rsp = &p_server->rsp;
+
+    while(0 != p_rsp->output_length)
+    {
+        ssize_t sent = send(p_server->fd, p_rsp->output, p_rsp->output_length, 0);
+
+        if(sent < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if(sent <= 0)
+        {
+            gdb_server_hang_up(p_server);
+            return;
+        }
+        gdb_rsp_sent(p_rsp, (size_t)sent);
+    }
+}
+
+bool gdb_server_poll(gdb_server_t *p_server, bool wait)
+{
+    uint8_t buffer[1024];
+
+    if(p_server->fd < 0)
+    {
+        return !p_server->rsp.killed;
+    }
+
+    gdb_rsp_check_stop(&p_server->rsp);
+    gdb_server_flush(p_server);
+
+    while(p_server->fd >= 0)
+    {
+        struct pollfd readable = { p_server->fd, POLLIN, 0 };
+        int ready = poll(&readable, 1, wait ? -1 : 0);
+        ssize_t received = 0;
+
+        if(ready < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if(ready <= 0)
+        {
+            break;
+        }
+
+        received = recv(p_server->fd, buffer, sizeof(buffer), 0);
+        if(received <= 0)
+        {
+            gdb_server_hang_up(p_server);
+            break;
+        }
+        gdb_rsp_receive(&p_server->rsp, buffer, (size_t)received);
+        gdb_server_flush(p_server);
+
+        if(p_server->rsp.detached && p_server->fd >= 0)
+        {
+            gdb_server_hang_up(p_server);
+        }
+        // One batch is enough to have the caller look at the cpu again
+        if(wait)
+        {
+            break;
+        }
+    }
+
+    return !p_server->rsp.killed;
+}
+
+void gdb_server_close(gdb_server_t *p_server)
+{
+    if(p_server->fd >= 0)
+    {
+        close(p_server->fd);
+        p_server->fd = -1;
+    }
+    if(p_server->listen_fd >= 0)
+    {
+        close(p_server->listen_fd);
+        p_server->listen_fd = -1;
+    }
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef GDB_SERVER_H_
+#define GDB_SERVER_H_
+
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "gdb_rsp.h"
+
+// One gdb client over a local socket, carrying gdb_rsp_t's packets
+typedef struct gdb_server
+{
+    int listen_fd;
+    int fd;
+    gdb_rsp_t rsp;
+} gdb_server_t;
+
+/**
+ * Listen on 127.0.0.1:PORT, or on a Unix socket when p_address has a '/' in
+ * it, and wait for the client to connect. The cpu needs a debugger attached
+ * and starts paused. Only on POSIX systems, elsewhere this fails.
+ */
+bool gdb_server_open(gdb_server_t *p_server, const char *p_address, chip8_t *p_cpu);
+/**
+ * Answer whatever the client has sent, and the stop it may be waiting for.
+ * With wait set, block until something arrives. Returns false once the
+ * client has asked for the program to be killed.
+ */
+bool gdb_server_poll(gdb_server_t *p_server, bool wait);
+void gdb_server_close(gdb_server_t *p_server);
+
+#endif // GDB_SERVER_H_
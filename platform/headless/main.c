@@ -0,0 +1,604 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "debug.h"
+#include "debug_console.h"
+#include "gdb_server.h"
+#include "history.h"
+#include "metrics.h"
+#include "metrics_server.h"
+#include "movie.h"
+#include "rom_cache.h"
+#include "trace.h"
+#ifdef EMUEIGHT_PROFILE
+#include "profile.h"
+#endif
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_CYCLES_PER_FRAME 16
+#define MAX_BREAKPOINTS 16
+#define METRICS_SAVE_FRAMES 60 // once a second of emulated time
+
+// Too big for the stack
+static debug_t debug;
+static gdb_server_t gdb_server;
+static history_t history;
+static history_t *p_history; // while the debugger is attached and there is memory for it
+static trace_t trace;
+static FILE *p_trace_fp;
+static metrics_t metrics;
+static metrics_server_t metrics_server;
+static const char *p_metrics_file;
+static bool metrics_on;
+static uint64_t metrics_clock; // metrics_now_ns() at the end of the last frame
+#ifdef EMUEIGHT_PROFILE
+static profile_t profile;
+#endif
+
+typedef struct options
+{
+    char *p_rom;
+    const char *p_record;
+    const char *p_play;
+    const char *p_profile;
+    const char *p_gdb;
+    const char *p_trace;
+    const char *p_metrics;
+    const char *p_metrics_socket;
+    uint32_t frames;
+    uint32_t cycles_per_frame;
+    uint32_t seed;
+    uint32_t keyframes;
+    bool seeded;
+    bool xochip;
+    bool debug;
+    uint32_t breakpoints[MAX_BREAKPOINTS];
+    uint32_t breakpoint_count;
+} options_t;
+
+static void usage(const char *p_name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <rom>\n"
+            "  --frames=N      frames to run without a movie (default %d)\n"
+            "  --cycles=N      cycles per frame (default from the ROM database, else %d)\n"
+            "  --seed=N        RNG seed\n"
+            "  --xochip        64KB memory and XO-CHIP quirks, whatever the ROM looks like\n"
+            "  --record=FILE   record the run as a movie\n"
+            "  --play=FILE     replay a movie unthrottled and verify its display hash\n"
+            "  --profile=FILE  write opcode and PC counts as JSON, or CSV for *.csv\n"
+            "                  (needs an EMUEIGHT_PROFILE build)\n"
+            "  --debug         stop before the first instruction and take commands from stdin\n"
+            "  --break=ADDR    stop at ADDR and take commands from stdin, up to %d of them\n"
+            "  --gdb=PORT      wait for gdb on 127.0.0.1:PORT, or a Unix socket for a PATH\n"
+            "  --keyframes=N   frames between the snapshots for going backwards while\n"
+            "                  debugging (default %d)\n"
+            "  --trace=FILE    record every instruction executed, see emueight-trace\n"
+            "  --metrics=FILE  keep Prometheus metrics in FILE, rewritten every %d frames\n"
+            "  --metrics-socket=PATH\n"
+            "                  hand the metrics to whoever connects to a Unix socket\n",
+            p_name, DEFAULT_FRAMES, DEFAULT_CYCLES_PER_FRAME, MAX_BREAKPOINTS, HISTORY_DEFAULT_INTERVAL,
+            METRICS_SAVE_FRAMES);
+}
+
+// Match "--name=value" and parse value as an unsigned number.
+static bool parse_number(const char *p_arg, const char *p_name, uint32_t *p_value)
+{
+    size_t length = strlen(p_name);
+    char *p_end = NULL;
+
+    if(0 != strncmp(p_arg, p_name, length) || '=' != p_arg[length])
+    {
+        return false;
+    }
+
+    *p_value = (uint32_t)strtoul(p_arg + length + 1, &p_end, 0);
+    return '\0' == *p_end;
+}
+
+static const char *parse_string(const char *p_arg, const char *p_name)
+{
+    size_t length = strlen(p_name);
+
+    if(0 != strncmp(p_arg, p_name, length) || '=' != p_arg[length])
+    {
+        return NULL;
+    }
+
+    return p_arg + length + 1;
+}
+
+static const char *platform_name(rom_platform_t platform)
+{
+    switch(platform)
+    {
+        case ROM_PLATFORM_SCHIP: return "SUPER-CHIP";
+        case ROM_PLATFORM_XOCHIP: return "XO-CHIP";
+        default: return "CHIP-8";
+    }
+}
+
+/*
+ * Run what is left of the frame. Whenever the debugger stops the cpu part
+ * way through, commands are read until it carries on or a step finishes
+ * the frame. Returns false to quit.
+ */
+static bool run_frame(chip8_t *p_cpu, uint32_t cycles)
+{
+    cpu_run(p_cpu, cycles - cpu_frame_cycle(p_cpu));
+    if(NULL == cpu_debug(p_cpu))
+    {
+        return true;
+    }
+
+    while(DEBUG_RUNNING != debug.stop)
+    {
+        debug_console_show(p_cpu);
+        do
+        {
+            if(!debug_console_prompt(p_cpu, p_history))
+            {
+                return false;
+            }
+        } while(DEBUG_RUNNING != debug.stop && cpu_frame_cycle(p_cpu) < cycles);
+
+        if(cpu_frame_cycle(p_cpu) >= cycles)
+        {
+            break;
+        }
+        cpu_run(p_cpu, cycles - cpu_frame_cycle(p_cpu));
+    }
+
+    return true;
+}
+
+// Keep the start of every frame for going back to, for as long as memory lasts
+static void record_history(const chip8_t *p_cpu)
+{
+    if(NULL != p_history && !history_frame(p_history, p_cpu))
+    {
+        fprintf(stderr, "Out of memory, going backwards is off.\n");
+        history_free(p_history);
+        p_history = NULL;
+        gdb_server.rsp.p_history = NULL;
+    }
+}
+
+// Write out the trace between frames, never from inside cpu_run()
+static void flush_trace(bool all)
+{
+    if(NULL != p_trace_fp && !trace_flush(&trace, p_trace_fp, all))
+    {
+        fprintf(stderr, "Failed to write the trace, tracing is off.\n");
+        fclose(p_trace_fp);
+        p_trace_fp = NULL;
+    }
+}
+
+/*
+ * Wall clock time for frame times and rates, so time spent waiting on I/O
+ * or another process counts. Without a monotonic clock it falls back to
+ * the processor time the emulator used.
+ */
+static uint64_t metrics_now_ns(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec now;
+
+    if(0 == clock_gettime(CLOCK_MONOTONIC, &now))
+    {
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    }
+#endif
+    return (uint64_t)((double)clock() * 1e9 / CLOCKS_PER_SEC);
+}
+
+// Count the frame just run, before its timer tick, and hand the metrics out now and then
+static void update_metrics(const chip8_t *p_cpu)
+{
+    uint64_t now = 0;
+
+    if(!metrics_on)
+    {
+        return;
+    }
+    now = metrics_now_ns();
+    metrics_frame(&metrics, p_cpu, now - metrics_clock);
+    metrics_clock = now;
+    if(0 == metrics.frames % METRICS_SAVE_FRAMES)
+    {
+        metrics_rate(&metrics, now);
+        if(NULL != p_metrics_file && !metrics_save(&metrics, p_metrics_file))
+        {
+            fprintf(stderr, "Failed to save metrics %s.\n", p_metrics_file);
+        }
+    }
+    metrics_server_poll(&metrics_server, &metrics);
+}
+
+// As movie_play_all(), a frame at a time so the trace and metrics can be written out
+static uint32_t play_frames(movie_t *p_movie, chip8_t *p_cpu)
+{
+    uint32_t frames = 0;
+    uint16_t keys = 0;
+
+    movie_play_begin(p_movie, p_cpu);
+    while(movie_play_frame(p_movie, &keys))
+    {
+        cpu_set_keypad(p_cpu, keys);
+        cpu_run(p_cpu, p_movie->cycles_per_frame);
+        update_metrics(p_cpu);
+        cpu_timer_tick(p_cpu);
+        flush_trace(false);
+        frames++;
+    }
+
+    return frames;
+}
+
+// As run_frame(), with the commands coming from a gdb client instead
+static bool run_frame_gdb(chip8_t *p_cpu, uint32_t cycles)
+{
+    // The client only gets looked at between frames while the cpu runs
+    cpu_run(p_cpu, cycles - cpu_frame_cycle(p_cpu));
+    if(!gdb_server_poll(&gdb_server, false))
+    {
+        return false;
+    }
+
+    while(DEBUG_RUNNING != debug.stop && cpu_frame_cycle(p_cpu) < cycles)
+    {
+        if(!gdb_server_poll(&gdb_server, true))
+        {
+            return false;
+        }
+        cpu_run(p_cpu, cycles - cpu_frame_cycle(p_cpu));
+        if(!gdb_server_poll(&gdb_server, false))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool parse_options(int argc, char *argv[], options_t *p_opts)
+{
+    memset(p_opts, 0, sizeof(*p_opts));
+    p_opts->frames = DEFAULT_FRAMES;
+
+    for(int i = 1; i < argc; i++)
+    {
+        const char *p_arg = argv[i];
+        const char *p_value = NULL;
+
+        if(parse_number(p_arg, "--frames", &p_opts->frames) ||
+           parse_number(p_arg, "--cycles", &p_opts->cycles_per_frame) ||
+           parse_number(p_arg, "--keyframes", &p_opts->keyframes))
+        {
+            continue;
+        }
+        if(parse_number(p_arg, "--seed", &p_opts->seed))
+        {
+            p_opts->seeded = true;
+        }
+        else if(0 == strcmp(p_arg, "--xochip"))
+        {
+            p_opts->xochip = true;
+        }
+        else if(0 == strcmp(p_arg, "--debug"))
+        {
+            p_opts->debug = true;
+        }
+        else if(p_opts->breakpoint_count < MAX_BREAKPOINTS &&
+                parse_number(p_arg, "--break", &p_opts->breakpoints[p_opts->breakpoint_count]))
+        {
+            p_opts->breakpoint_count++;
+        }
+        else if(NULL != (p_value = parse_string(p_arg, "--record")))
+        {
+            p_opts->p_record = p_value;
+        }
+        else if(NULL != (p_value = parse_string(p_arg, "--play")))
+        {
+            p_opts->p_play = p_value;
+        }
+        else if(NULL != (p_value = parse_string(p_arg, "--profile")))
+        {
+            p_opts->p_profile = p_value;
+        }
+        else if(NULL != (p_value = parse_string(p_arg, "--gdb")))
+        {
+            p_opts->p_gdb = p_value;
+        }
+        else if(NULL != (p_value = parse_string(p_arg, "--trace")))
+        {
+            p_opts->p_trace = p_value;
+        }
+        else if(NULL != (p_value = parse_string(p_arg, "--metrics")))
+        {
+            p_opts->p_metrics = p_value;
+        }
+        else if(NULL != (p_value = parse_string(p_arg, "--metrics-socket")))
+        {
+            p_opts->p_metrics_socket = p_value;
+        }
+        else if('-' == p_arg[0])
+        {
+            return false;
+        }
+        else
+        {
+            p_opts->p_rom = argv[i];
+        }
+    }
+
+    return NULL != p_opts->p_rom;
+}
+
+int main(int argc, char *argv[])
+{
+    options_t opts;
+    movie_t movie;
+    rom_cache_t roms;
+    const rom_image_t *p_rom = NULL;
+    chip8_t *p_cpu = NULL;
+    uint32_t frames = 0;
+    int status = EXIT_SUCCESS;
+
+    if(!parse_options(argc, argv, &opts))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if(NULL != opts.p_play && (opts.debug || 0 != opts.breakpoint_count))
+    {
+        fprintf(stderr, "--debug and --break can't be used with --play.\n");
+        return EXIT_FAILURE;
+    }
+    if(NULL != opts.p_gdb && (NULL != opts.p_play || opts.debug || 0 != opts.breakpoint_count))
+    {
+        fprintf(stderr, "--gdb can't be used with --play, --debug or --break.\n");
+        return EXIT_FAILURE;
+    }
+
+#ifndef EMUEIGHT_PROFILE
+    if(NULL != opts.p_profile)
+    {
+        fprintf(stderr, "--profile needs a build configured with EMUEIGHT_PROFILE.\n");
+        return EXIT_FAILURE;
+    }
+#endif
+
+    // The ROM database, or a look at the program, picks the platform and speed
+    rom_cache_init(&roms);
+    p_rom = rom_cache_acquire_file(&roms, opts.p_rom);
+    if(NULL == p_rom)
+    {
+        fprintf(stderr, "Failed to load program %s.\n", opts.p_rom);
+        return EXIT_FAILURE;
+    }
+
+    p_cpu = opts.xochip ? cpu_init_memory(XOCHIP_MEMORY_SIZE) : rom_image_new_cpu(p_rom);
+    if(NULL == p_cpu || (opts.xochip && !cpu_load_program_mem(p_cpu, p_rom->data, p_rom->size)))
+    {
+        fprintf(stderr, "Failed to allocate emulator state.\n");
+        cpu_free(p_cpu);
+        rom_cache_free(&roms);
+        return EXIT_FAILURE;
+    }
+
+    if(opts.xochip)
+    {
+        cpu_set_quirks(p_cpu, QUIRKS_XOCHIP);
+    }
+    if(0 == opts.cycles_per_frame)
+    {
+        opts.cycles_per_frame = (0 != p_rom->tickrate) ? p_rom->tickrate : DEFAULT_CYCLES_PER_FRAME;
+    }
+
+    printf("rom: %016" PRIx64 " %s (%s)\n", p_rom->hash, platform_name(p_rom->platform),
+           p_rom->known ? "database" : "detected");
+    rom_cache_free(&roms);
+
+    if(opts.seeded)
+    {
+        cpu_seed_rng(p_cpu, opts.seed);
+    }
+
+    if(opts.debug || 0 != opts.breakpoint_count)
+    {
+        debug_init(&debug);
+        for(uint32_t i = 0; i < opts.breakpoint_count; i++)
+        {
+            debug_set_breakpoint(&debug, (uint16_t)opts.breakpoints[i], true);
+        }
+        if(opts.debug)
+        {
+            debug_pause(&debug);
+        }
+        cpu_attach_debug(p_cpu, &debug);
+    }
+    if(NULL != opts.p_gdb)
+    {
+        debug_init(&debug);
+        cpu_attach_debug(p_cpu, &debug);
+        if(!gdb_server_open(&gdb_server, opts.p_gdb, p_cpu))
+        {
+            cpu_free(p_cpu);
+            return EXIT_FAILURE;
+        }
+    }
+    // Whatever is being debugged can be gone back through
+    if(NULL != cpu_debug(p_cpu))
+    {
+        if(history_begin(&history, p_cpu, opts.cycles_per_frame, opts.keyframes))
+        {
+            p_history = &history;
+        }
+        else
+        {
+            fprintf(stderr, "Not enough memory for a history, going backwards is off.\n");
+        }
+        gdb_server.rsp.p_history = p_history;
+    }
+
+    if(NULL != opts.p_trace)
+    {
+        p_trace_fp = fopen(opts.p_trace, "wb");
+        if(NULL == p_trace_fp || !trace_init(&trace, 0) || !trace_write_header(p_trace_fp))
+        {
+            fprintf(stderr, "Failed to start trace %s.\n", opts.p_trace);
+            if(NULL != p_trace_fp)
+            {
+                fclose(p_trace_fp);
+            }
+            trace_free(&trace);
+            cpu_free(p_cpu);
+            return EXIT_FAILURE;
+        }
+        cpu_attach_trace(p_cpu, &trace);
+    }
+
+    metrics_init(&metrics);
+    metrics_server.listen_fd = -1;
+    p_metrics_file = opts.p_metrics;
+    metrics_on = NULL != opts.p_metrics || NULL != opts.p_metrics_socket;
+    if(NULL != opts.p_metrics_socket && !metrics_server_open(&metrics_server, opts.p_metrics_socket))
+    {
+        if(NULL != p_trace_fp)
+        {
+            fclose(p_trace_fp);
+        }
+        trace_free(&trace);
+        cpu_free(p_cpu);
+        return EXIT_FAILURE;
+    }
+
+#ifdef EMUEIGHT_PROFILE
+    if(NULL != opts.p_profile)
+    {
+        profile_init(&profile, cpu_memory_size(p_cpu));
+        cpu_attach_profile(p_cpu, &profile);
+    }
+#endif
+
+    memset(&movie, 0, sizeof(movie));
+    clock_t start = clock();
+    metrics_clock = metrics_now_ns();
+
+    if(NULL != opts.p_play)
+    {
+        if(!movie_load(&movie, opts.p_play))
+        {
+            fprintf(stderr, "Failed to load movie %s.\n", opts.p_play);
+            cpu_free(p_cpu);
+            return EXIT_FAILURE;
+        }
+        frames = (NULL != opts.p_trace || metrics_on) ? play_frames(&movie, p_cpu) : movie_play_all(&movie, p_cpu);
+    }
+    else
+    {
+        if(NULL != opts.p_record)
+        {
+            movie_record_begin(&movie, p_cpu, opts.cycles_per_frame);
+        }
+        for(frames = 0; frames < opts.frames; frames++)
+        {
+            // No input device, the keypad stays released
+            if(NULL != opts.p_record)
+            {
+                movie_record_frame(&movie, cpu_keypad(p_cpu));
+            }
+            record_history(p_cpu);
+            if(!((NULL != opts.p_gdb) ? run_frame_gdb(p_cpu, opts.cycles_per_frame)
+                                      : run_frame(p_cpu, opts.cycles_per_frame)))
+            {
+                break;
+            }
+            update_metrics(p_cpu);
+            cpu_timer_tick(p_cpu);
+            flush_trace(false);
+        }
+    }
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    uint64_t hash = cpu_display_hash(p_cpu);
+
+    printf("frames: %" PRIu32 "\n", frames);
+    printf("seconds: %.6f\n", seconds);
+    printf("display hash: %016" PRIx64 "\n", hash);
+
+    if(NULL != opts.p_play)
+    {
+        if(movie_play_verify(&movie, p_cpu))
+        {
+            printf("movie: display hash matches\n");
+        }
+        else
+        {
+            printf("movie: display hash MISMATCH, expected %016" PRIx64 "\n", movie.display_hash);
+            status = EXIT_FAILURE;
+        }
+    }
+    else if(NULL != opts.p_record)
+    {
+        movie_record_end(&movie, p_cpu);
+        if(!movie_save(&movie, opts.p_record))
+        {
+            fprintf(stderr, "Failed to save movie %s.\n", opts.p_record);
+            status = EXIT_FAILURE;
+        }
+    }
+
+#ifdef EMUEIGHT_PROFILE
+    if(NULL != opts.p_profile && !profile_save(&profile, opts.p_profile))
+    {
+        fprintf(stderr, "Failed to save profile %s.\n", opts.p_profile);
+        status = EXIT_FAILURE;
+    }
+#endif
+
+    if(NULL != opts.p_trace)
+    {
+        flush_trace(true);
+        printf("trace: %" PRIu64 " instructions, %" PRIu64 " lost\n", trace.head, trace.dropped);
+        if(NULL == p_trace_fp || 0 != fclose(p_trace_fp))
+        {
+            fprintf(stderr, "Failed to save trace %s.\n", opts.p_trace);
+            status = EXIT_FAILURE;
+        }
+        trace_free(&trace);
+    }
+    if(NULL != opts.p_metrics)
+    {
+        metrics_rate(&metrics, metrics_now_ns());
+        if(!metrics_save(&metrics, opts.p_metrics))
+        {
+            fprintf(stderr, "Failed to save metrics %s.\n", opts.p_metrics);
+            status = EXIT_FAILURE;
+        }
+    }
+    metrics_server_close(&metrics_server);
+    if(NULL != opts.p_gdb)
+    {
+        gdb_server_close(&gdb_server);
+    }
+    if(NULL != p_history)
+    {
+        history_free(p_history);
+    }
+    movie_free(&movie);
+    cpu_free(p_cpu);
+
+    return status;
+}
@@ -0,0 +1,113 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "metrics_server.h"
+
+#if defined(_WIN32)
+
+bool metrics_server_open(metrics_server_t *p_server, const char *p_path)
+{
+    (void)p_path;
+    p_server->listen_fd = -1;
+    fprintf(stderr, "metrics: not supported on this platform\n");
+
+    return false;
+}
+
+void metrics_server_poll(metrics_server_t *p_server, const metrics_t *p_metrics)
+{
+    (void)p_server;
+    (void)p_metrics;
+}
+
+void metrics_server_close(metrics_server_t *p_server)
+{
+    (void)p_server;
+}
+
+#else
+
+#define METRICS_SERVER_BACKLOG 4
+
+bool metrics_server_open(metrics_server_t *p_server, const char *p_path)
+{
+    struct sockaddr_un address;
+
+    p_server->listen_fd = -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(p_path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "metrics: path too long %s\n", p_path);
+        return false;
+    }
+    strcpy(address.sun_path, p_path);
+
+    // A socket left behind by an earlier run is in the way
+    unlink(p_path);
+    p_server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(p_server->listen_fd < 0 ||
+       0 != bind(p_server->listen_fd, (const struct sockaddr *)&address, sizeof(address)) ||
+       0 != listen(p_server->listen_fd, METRICS_SERVER_BACKLOG))
+    {
+        fprintf(stderr, "metrics: can't listen on %s\n", p_path);
+        metrics_server_close(p_server);
+        return false;
+    }
+
+    // A client hanging up early shows as a failed write rather than ending the program
+    signal(SIGPIPE, SIG_IGN);
+
+    return true;
+}
+
+void metrics_server_poll(metrics_server_t *p_server, const metrics_t *p_metrics)
+{
+    struct pollfd pfd;
+
+    pfd.fd = p_server->listen_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    while(p_server->listen_fd >= 0 && poll(&pfd, 1, 0) > 0 && 0 != (pfd.revents & POLLIN))
+    {
+        int fd = accept(p_server->listen_fd, NULL, NULL);
+        FILE *p_fp = NULL;
+
+        if(fd < 0)
+        {
+            return;
+        }
+        // A few kilobytes, the socket buffer takes them without waiting on the client
+        p_fp = fdopen(fd, "w");
+        if(NULL == p_fp)
+        {
+            close(fd);
+            return;
+        }
+        metrics_write(p_metrics, p_fp);
+        fclose(p_fp);
+    }
+}
+
+void metrics_server_close(metrics_server_t *p_server)
+{
+    if(p_server->listen_fd >= 0)
+    {
+        close(p_server->listen_fd);
+        p_server->listen_fd = -1;
+    }
+}
+
+#endif
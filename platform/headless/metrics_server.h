@@ -0,0 +1,23 @@
+#ifndef METRICS_SERVER_H_
+#define METRICS_SERVER_H_
+
+#include <stdbool.h>
+
+#include "metrics.h"
+
+// Hands out the metrics to whoever connects to a Unix socket
+typedef struct metrics_server
+{
+    int listen_fd;
+} metrics_server_t;
+
+// Only on POSIX systems, elsewhere this fails
+bool metrics_server_open(metrics_server_t *p_server, const char *p_path);
+/**
+ * Send the metrics to every client waiting to connect, then hang up on
+ * them. Never waits for a client, so it can go between frames.
+ */
+void metrics_server_poll(metrics_server_t *p_server, const metrics_t *p_metrics);
+void metrics_server_close(metrics_server_t *p_server);
+
+#endif // METRICS_SERVER_H_
@@ -1,28 +1,90 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
-#include <math.h>
 
 #include <stdio.h>
 #if defined(_WIN32) && !defined(_XBOX)
 #include <windows.h>
 #endif
 #include "libretro.h"
-
-#define VIDEO_WIDTH 256
-#define VIDEO_HEIGHT 384
-#define VIDEO_PIXELS VIDEO_WIDTH * VIDEO_HEIGHT
-
-static uint8_t *frame_buf;
+#include "beeper.h"
+#include "cpu.h"
+#include "movie.h"
+#include "rom_cache.h"
+#include "timeline.h"
+
+#define VIDEO_WIDTH DISPLAY_LORES_W
+#define VIDEO_HEIGHT DISPLAY_LORES_H
+#define VIDEO_MAX_WIDTH DISPLAY_W
+#define VIDEO_MAX_HEIGHT DISPLAY_H
+#define AUDIO_SAMPLE_RATE 30000
+#define AUDIO_FRAME_SAMPLES (AUDIO_SAMPLE_RATE / 60)
+#define CYCLES_PER_FRAME 16
+#define MOVIE_EXTENSION ".e8m"
+#define TIMELINE_EXTENSION ".timeline.json"
+
+enum movie_mode
+{
+   MOVIE_OFF,
+   MOVIE_RECORD,
+   MOVIE_PLAY
+};
+
+static const unsigned KEYMAP[16] = {
+   RETROK_x, // 0
+   RETROK_1, // 1
+   RETROK_2, // 2
+   RETROK_3, // 3
+   RETROK_q, // 4
+   RETROK_w, // 5
+   RETROK_e, // 6
+   RETROK_a, // 7
+   RETROK_s, // 8
+   RETROK_d, // 9
+   RETROK_z, // A
+   RETROK_c, // B
+   RETROK_4, // C
+   RETROK_r, // D
+   RETROK_f, // E
+   RETROK_v  // F
+};
+
+// RetroPad buttons for each rom_key_t
+static const unsigned PAD_BUTTONS[ROM_KEYS] = {
+   RETRO_DEVICE_ID_JOYPAD_UP,
+   RETRO_DEVICE_ID_JOYPAD_DOWN,
+   RETRO_DEVICE_ID_JOYPAD_LEFT,
+   RETRO_DEVICE_ID_JOYPAD_RIGHT,
+   RETRO_DEVICE_ID_JOYPAD_A,
+   RETRO_DEVICE_ID_JOYPAD_B
+};
+
+static chip8_t *p_cpu;
+static beeper_t beeper;
+static int16_t audio_buf[AUDIO_FRAME_SAMPLES * 2];
+static uint32_t frame_buf[VIDEO_MAX_WIDTH * VIDEO_MAX_HEIGHT];
+static movie_t movie;
+static enum movie_mode movie_mode;
+static unsigned cycles_per_frame = CYCLES_PER_FRAME;
+static unsigned rom_cycles_per_frame = CYCLES_PER_FRAME; // the "auto" speed, from the ROM database
+static uint8_t pad_keys[ROM_KEYS]; // keypad key per RetroPad button, from the ROM database
 static struct retro_log_callback logging;
 static retro_log_printf_t log_cb;
-static bool use_audio_cb;
 static float last_aspect;
 static float last_sample_rate;
+static bool can_dupe;
 char retro_base_directory[4096];
 char retro_game_path[4096];
+// The frontend's copy of the ROM is only valid during retro_load_game()
+static uint8_t retro_rom[XOCHIP_MEMORY_SIZE - START_ADDRESS];
+static size_t retro_rom_size;
+char retro_movie_path[4096 + sizeof(MOVIE_EXTENSION)];
+static struct retro_perf_callback perf_cb;
+static timeline_t timeline; // phases of retro_run() while the option is on
+char retro_timeline_path[4096 + sizeof(TIMELINE_EXTENSION)];
 
 static void fallback_log(enum retro_log_level level, const char *fmt, ...)
 {
@@ -38,7 +100,6 @@ static retro_environment_t environ_cb;
 
 void retro_init(void)
 {
-   frame_buf = (uint8_t*)malloc(VIDEO_PIXELS * sizeof(uint32_t));
    const char *dir = NULL;
    if (environ_cb(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &dir) && dir)
    {
@@ -49,8 +110,8 @@ void retro_init(void)
 
 void retro_deinit(void)
 {
-   free(frame_buf);
-   frame_buf = NULL;
+   cpu_free(p_cpu);
+   p_cpu = NULL;
 }
 
 unsigned retro_api_version(void)
@@ -66,10 +127,10 @@ void retro_set_controller_port_device(unsigned port, unsigned device)
 void retro_get_system_info(struct retro_system_info *info)
 {
    memset(info, 0, sizeof(*info));
-   info->library_name     = "skeleton";
+   info->library_name     = "EmuEight";
    info->library_version  = "0.1";
-   info->need_fullpath    = true;
-   info->valid_extensions = "";
+   info->need_fullpath    = false;
+   info->valid_extensions = "ch8|sc8|xo8";
 }
 
 static retro_video_refresh_t video_cb;
@@ -81,14 +142,16 @@ static retro_input_state_t input_state_cb;
 void retro_get_system_av_info(struct retro_system_av_info *info)
 {
    float aspect                = 0.0f;
-   float sampling_rate         = 30000.0f;
+   float sampling_rate         = (float)AUDIO_SAMPLE_RATE;
 
 
    info->geometry.base_width   = VIDEO_WIDTH;
    info->geometry.base_height  = VIDEO_HEIGHT;
-   info->geometry.max_width    = VIDEO_WIDTH;
-   info->geometry.max_height   = VIDEO_HEIGHT;
+   info->geometry.max_width    = VIDEO_MAX_WIDTH;
+   info->geometry.max_height   = VIDEO_MAX_HEIGHT;
    info->geometry.aspect_ratio = aspect;
+   info->timing.fps            = 60.0;
+   info->timing.sample_rate    = sampling_rate;
 
    last_aspect                 = aspect;
    last_sample_rate            = sampling_rate;
@@ -103,16 +166,26 @@ void retro_set_environment(retro_environment_t cb)
    else
       log_cb = fallback_log;
 
-   static const struct retro_controller_description controllers[] = {
-      { "Nintendo DS", RETRO_DEVICE_SUBCLASS(RETRO_DEVICE_JOYPAD, 0) },
+   static struct retro_controller_description controllers[] = {
+      { "Keyboard", RETRO_DEVICE_KEYBOARD },
+      { "RetroPad", RETRO_DEVICE_JOYPAD },
    };
 
-   static const struct retro_controller_info ports[] = {
-      { controllers, 1 },
+   static struct retro_controller_info ports[] = {
+      { controllers, 2 },
       { NULL, 0 },
    };
 
-   cb(RETRO_ENVIRONMENT_SET_CONTROLLER_INFO, (void*)ports);
+   cb(RETRO_ENVIRONMENT_SET_CONTROLLER_INFO, ports);
+
+   static struct retro_variable vars[] = {
+      { "emueight_cycles", "Instructions per frame; auto|8|10|12|15|16|20|30|50|100|200|500|1000|2000|5000|10000|20000|50000|100000|1000000" },
+      { "emueight_movie", "Input movie (next load, <rom>.e8m); off|record|play" },
+      { "emueight_timeline", "Frame timeline (<rom>.timeline.json, written when turned off); off|on" },
+      { NULL, NULL },
+   };
+
+   cb(RETRO_ENVIRONMENT_SET_VARIABLES, vars);
 }
 
 void retro_set_audio_sample(retro_audio_sample_t cb)
@@ -140,45 +213,217 @@ void retro_set_video_refresh(retro_video_refresh_t cb)
    video_cb = cb;
 }
 
-static unsigned phase;
-
 void retro_reset(void)
 {
+   // Keep the quirks picked when the game was loaded
+   uint32_t quirks = cpu_quirks(p_cpu);
 
+   cpu_reset(p_cpu);
+   cpu_set_quirks(p_cpu, quirks);
+   cpu_load_program_mem(p_cpu, retro_rom, retro_rom_size);
 }
 
 static void update_input(void)
 {
+   uint16_t keypad = 0;
+
+   input_poll_cb();
+   for (unsigned i = 0; i < 16; i++)
+   {
+      if (input_state_cb(0, RETRO_DEVICE_KEYBOARD, 0, KEYMAP[i]))
+         keypad |= (uint16_t)(1u << i);
+   }
+   for (unsigned i = 0; i < ROM_KEYS; i++)
+   {
+      if (pad_keys[i] <= 0xF && input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, PAD_BUTTONS[i]))
+         keypad |= (uint16_t)(1u << pad_keys[i]);
+   }
+   cpu_set_keypad(p_cpu, keypad);
+}
+
+
+static uint64_t timeline_clock(void)
+{
+   return (uint64_t)perf_cb.get_time_usec() * 1000u;
+}
 
+static void start_timeline(void)
+{
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_PERF_INTERFACE, &perf_cb) || !perf_cb.get_time_usec)
+   {
+      log_cb(RETRO_LOG_WARN, "The frontend has no timer, no frame timeline.\n");
+      return;
+   }
+   if (!timeline_init(&timeline, 0, timeline_clock, "retro_run", 1))
+      log_cb(RETRO_LOG_ERROR, "Out of memory, no frame timeline.\n");
 }
 
+// Chrome trace JSON next to the ROM, for chrome://tracing or Perfetto
+static void end_timeline(void)
+{
+   FILE *p_fp = NULL;
+   bool ok = false;
+
+   if (!timeline.p_events)
+      return;
+
+   snprintf(retro_timeline_path, sizeof(retro_timeline_path), "%s%s", retro_game_path, TIMELINE_EXTENSION);
+   p_fp = fopen(retro_timeline_path, "w");
+   if (p_fp)
+   {
+      ok = timeline_write_begin(p_fp) && timeline_write(&timeline, p_fp) && timeline_write_end(p_fp);
+      ok = (0 == fclose(p_fp)) && ok;
+   }
+   if (ok)
+      log_cb(RETRO_LOG_INFO, "Frame timeline written to %s.\n", retro_timeline_path);
+   else
+      log_cb(RETRO_LOG_ERROR, "Failed to write frame timeline %s.\n", retro_timeline_path);
+   timeline_free(&timeline);
+}
 
 static void check_variables(void)
 {
+   struct retro_variable var = { "emueight_cycles", NULL };
+
+   // Movies need one speed from start to finish
+   if (MOVIE_OFF == movie_mode &&
+       environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      // "auto" parses as 0
+      unsigned long cycles = strtoul(var.value, NULL, 10);
+      cycles_per_frame = (cycles > 0) ? (unsigned)cycles : rom_cycles_per_frame;
+   }
 
+   var.key = "emueight_timeline";
+   var.value = NULL;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value && 0 == strcmp(var.value, "on"))
+   {
+      if (!timeline.p_events)
+         start_timeline();
+   }
+   else
+      end_timeline();
+
+   // The movie mode only takes effect when a game is loaded
+   if (p_cpu)
+      return;
+
+   var.key = "emueight_movie";
+   var.value = NULL;
+
+   movie_mode = MOVIE_OFF;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (0 == strcmp(var.value, "record"))
+         movie_mode = MOVIE_RECORD;
+      else if (0 == strcmp(var.value, "play"))
+         movie_mode = MOVIE_PLAY;
+   }
 }
 
-static void audio_callback(void)
+static void begin_movie(void)
 {
-   for (unsigned i = 0; i < 30000 / 60; i++, phase++)
+   snprintf(retro_movie_path, sizeof(retro_movie_path), "%s%s", retro_game_path, MOVIE_EXTENSION);
+
+   if (MOVIE_RECORD == movie_mode)
    {
-      int16_t val = 0x800 * sinf(2.0f * M_PI * phase * 300.0f / 30000.0f);
-      audio_cb(val, val);
+      movie_record_begin(&movie, p_cpu, cycles_per_frame);
+      log_cb(RETRO_LOG_INFO, "Recording movie to %s.\n", retro_movie_path);
    }
+   else if (MOVIE_PLAY == movie_mode)
+   {
+      if (movie_load(&movie, retro_movie_path))
+      {
+         movie_play_begin(&movie, p_cpu);
+         cycles_per_frame = movie.cycles_per_frame;
+         log_cb(RETRO_LOG_INFO, "Playing movie %s.\n", retro_movie_path);
+      }
+      else
+      {
+         log_cb(RETRO_LOG_WARN, "Failed to load movie %s.\n", retro_movie_path);
+         movie_mode = MOVIE_OFF;
+      }
+   }
+}
+
+static void update_movie(void)
+{
+   uint16_t keypad = 0;
+
+   if (MOVIE_PLAY == movie_mode)
+   {
+      if (movie_play_frame(&movie, &keypad))
+         cpu_set_keypad(p_cpu, keypad);
+      else
+      {
+         log_cb(RETRO_LOG_INFO, "Movie finished, display hash %s.\n",
+               movie_play_verify(&movie, p_cpu) ? "matches" : "MISMATCH");
+         movie_mode = MOVIE_OFF;
+      }
+   }
+   else if (MOVIE_RECORD == movie_mode)
+   {
+      if (!movie_record_frame(&movie, cpu_keypad(p_cpu)))
+      {
+         log_cb(RETRO_LOG_ERROR, "Out of memory, movie recording stopped.\n");
+         movie_mode = MOVIE_OFF;
+      }
+   }
+}
 
-   phase %= 100;
+static void end_movie(void)
+{
+   if (MOVIE_RECORD == movie_mode)
+   {
+      movie_record_end(&movie, p_cpu);
+      if (!movie_save(&movie, retro_movie_path))
+         log_cb(RETRO_LOG_ERROR, "Failed to save movie %s.\n", retro_movie_path);
+   }
+   movie_free(&movie);
+   movie_mode = MOVIE_OFF;
 }
 
-static void audio_set_state(bool enable)
+static void render_audio(void)
 {
-   (void)enable;
+   // The beeper is mono, the frontend wants interleaved stereo
+   int16_t *p_mono = audio_buf + AUDIO_FRAME_SAMPLES;
+   beeper_render_frame(&beeper, p_cpu, p_mono, AUDIO_FRAME_SAMPLES);
+   for (unsigned i = 0; i < AUDIO_FRAME_SAMPLES; i++)
+   {
+      audio_buf[i * 2]     = p_mono[i];
+      audio_buf[i * 2 + 1] = p_mono[i];
+   }
+   audio_batch_cb(audio_buf, AUDIO_FRAME_SAMPLES);
 }
 
 void retro_run(void)
 {
+   timeline_begin(&timeline, "retro_run");
+   timeline_begin(&timeline, "input");
    update_input();
-
-
+   update_movie();
+   timeline_end(&timeline);
+
+   timeline_begin(&timeline, "emulate");
+   cpu_run(p_cpu, cycles_per_frame);
+   timeline_end(&timeline);
+   timeline_begin(&timeline, "audio");
+   render_audio();
+   timeline_end(&timeline);
+   cpu_timer_tick(p_cpu);
+
+   // Only composite when something was drawn, otherwise ask for a dupe.
+   // Hi-res and lo-res share the 2:1 aspect, the frontend just sees a new size.
+   timeline_begin(&timeline, "video");
+   const void *p_frame = NULL;
+   if (cpu_display_dirty(p_cpu) || !can_dupe)
+   {
+      cpu_display_render(p_cpu, frame_buf, VIDEO_MAX_WIDTH, cpu_default_palette);
+      p_frame = frame_buf;
+   }
+   video_cb(p_frame, cpu_display_width(p_cpu), cpu_display_height(p_cpu), sizeof(uint32_t) * VIDEO_MAX_WIDTH);
+   timeline_end(&timeline);
+   timeline_end(&timeline); // retro_run
 
    bool updated = false;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
@@ -187,16 +432,6 @@ void retro_run(void)
 
 bool retro_load_game(const struct retro_game_info *info)
 {
-   struct retro_input_descriptor desc[] = {
-      { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_LEFT,  "Left" },
-      { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_UP,    "Up" },
-      { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_DOWN,  "Down" },
-      { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_RIGHT, "Right" },
-      { 0 },
-   };
-
-   environ_cb(RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS, desc);
-
    enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_XRGB8888;
    if (!environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
    {
@@ -204,19 +439,63 @@ bool retro_load_game(const struct retro_game_info *info)
       return false;
    }
 
-   snprintf(retro_game_path, sizeof(retro_game_path), "%s", info->path);
-   struct retro_audio_callback audio_cb = { audio_callback, audio_set_state };
-   use_audio_cb = environ_cb(RETRO_ENVIRONMENT_SET_AUDIO_CALLBACK, &audio_cb);
+   if (!info || !info->data || info->size > sizeof(retro_rom))
+      return false;
+
+   snprintf(retro_game_path, sizeof(retro_game_path), "%s", info->path ? info->path : "");
+   memcpy(retro_rom, info->data, info->size);
+   retro_rom_size = info->size;
+
+   // The ROM database, or a look at the program, picks the platform and speed.
+   // .xo8 files are always XO-CHIP.
+   rom_cache_t roms;
+   rom_cache_init(&roms);
+   const rom_image_t *p_image = rom_cache_acquire(&roms, retro_rom, retro_rom_size);
+   if (!p_image)
+      return false;
+
+   rom_cycles_per_frame = p_image->tickrate ? p_image->tickrate : CYCLES_PER_FRAME;
+   memcpy(pad_keys, p_image->keys, sizeof(pad_keys));
+   log_cb(RETRO_LOG_INFO, "ROM %016" PRIx64 " %s.\n", p_image->hash,
+          p_image->known ? "found in the database" : "not in the database");
 
    check_variables();
 
-   (void)info;
+   const char *p_ext = strrchr(retro_game_path, '.');
+   bool xochip = p_ext && 0 == strcmp(p_ext, ".xo8");
+
+   p_cpu = xochip ? cpu_init_memory(XOCHIP_MEMORY_SIZE) : rom_image_new_cpu(p_image);
+   if (p_cpu && xochip)
+   {
+      if (cpu_load_program_mem(p_cpu, retro_rom, retro_rom_size))
+         cpu_set_quirks(p_cpu, QUIRKS_XOCHIP);
+      else
+      {
+         cpu_free(p_cpu);
+         p_cpu = NULL;
+      }
+   }
+   rom_cache_free(&roms);
+
+   if (!p_cpu)
+      return false;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &can_dupe))
+      can_dupe = false;
+
+   beeper_init(&beeper, AUDIO_SAMPLE_RATE);
+
+   begin_movie();
+
    return true;
 }
 
 void retro_unload_game(void)
 {
-
+   end_movie();
+   end_timeline();
+   cpu_free(p_cpu);
+   p_cpu = NULL;
 }
 
 unsigned retro_get_region(void)
@@ -226,6 +505,9 @@ unsigned retro_get_region(void)
 
 bool retro_load_game_special(unsigned type, const struct retro_game_info *info, size_t num)
 {
+   (void)type;
+   (void)info;
+   (void)num;
    return false;
 }
 
@@ -236,11 +518,15 @@ size_t retro_serialize_size(void)
 
 bool retro_serialize(void *data_, size_t size)
 {
+   (void)data_;
+   (void)size;
    return false;
 }
 
 bool retro_unserialize(const void *data_, size_t size)
 {
+   (void)data_;
+   (void)size;
    return false;
 }
 
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_output.h"
+
+static void audio_callback(void *p_userdata, Uint8 *p_stream, int len)
+{
+    audio_output_t *p_out = p_userdata;
+    int16_t *p_samples = (int16_t *)(void *)p_stream;
+    size_t wanted = (size_t)len / sizeof(*p_samples);
+    size_t got = audio_ring_read(&p_out->ring, p_samples, wanted);
+
+    if(got < wanted)
+    {
+        // Ran dry, pad with silence
+        memset(p_samples + got, 0, (wanted - got) * sizeof(*p_samples));
+        SDL_AtomicAdd(&p_out->underruns, 1);
+    }
+
+    // Wake a producer waiting for room, without letting the count pile up
+    if(0 == SDL_SemValue(p_out->p_drained))
+    {
+        SDL_SemPost(p_out->p_drained);
+    }
+}
+
+bool audio_output_open(audio_output_t *p_out)
+{
+    SDL_AudioSpec want;
+    SDL_AudioSpec have;
+
+    memset(p_out, 0, sizeof(*p_out));
+    audio_ring_init(&p_out->ring);
+    p_out->sample_rate = AUDIO_SAMPLE_RATE;
+
+    memset(&want, 0, sizeof(want));
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = AUDIO_DEVICE_SAMPLES;
+    want.callback = audio_callback;
+    want.userdata = p_out;
+
+    p_out->p_drained = SDL_CreateSemaphore(0);
+    if(NULL == p_out->p_drained)
+    {
+        fprintf(stderr, "SDL_CreateSemaphore Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    p_out->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if(0 == p_out->device)
+    {
+        fprintf(stderr, "SDL_OpenAudioDevice Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    p_out->sample_rate = (uint32_t)have.freq;
+    p_out->device_samples = have.samples;
+    SDL_PauseAudioDevice(p_out->device, 0);
+
+    return true;
+}
+
+void audio_output_close(audio_output_t *p_out)
+{
+    if(0 != p_out->device)
+    {
+        SDL_CloseAudioDevice(p_out->device);
+        p_out->device = 0;
+    }
+    if(NULL != p_out->p_drained)
+    {
+        SDL_DestroySemaphore(p_out->p_drained);
+        p_out->p_drained = NULL;
+    }
+}
+
+size_t audio_output_frame_samples(audio_output_t *p_out, uint64_t elapsed_ms)
+{
+    if(0 == p_out->device)
+    {
+        return 0;
+    }
+
+    double target = (double)p_out->sample_rate * AUDIO_TARGET_LATENCY_MS / 1000.0;
+    size_t limit = p_out->sample_rate * AUDIO_MAX_LATENCY_MS / 1000u;
+    size_t fill = audio_ring_fill(&p_out->ring);
+
+    // A device buffer bigger than the whole budget leaves no room to queue
+    limit = (limit > p_out->device_samples) ? limit - p_out->device_samples : 0;
+
+    // Dynamic rate control: run slightly fast when the ring is draining
+    // and slightly slow when it is filling up.
+    double error = (target - (double)fill) / target;
+    if(error > 1.0)
+    {
+        error = 1.0;
+    }
+    else if(error < -1.0)
+    {
+        error = -1.0;
+    }
+    double ratio = 1.0 + AUDIO_RATE_CONTROL_DELTA * error;
+
+    p_out->pending += (double)elapsed_ms * p_out->sample_rate / 1000.0 * ratio;
+    size_t count = (size_t)p_out->pending;
+    p_out->pending -= (double)count;
+
+    if(fill + count > limit)
+    {
+        count = fill < limit ? limit - fill : 0;
+    }
+    if(count > AUDIO_MAX_FRAME_SAMPLES)
+    {
+        count = AUDIO_MAX_FRAME_SAMPLES;
+    }
+
+    return count;
+}
+
+void audio_output_queue(audio_output_t *p_out, const int16_t *p_samples, size_t count)
+{
+    if(0 != p_out->device)
+    {
+        audio_ring_write(&p_out->ring, p_samples, count);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef AUDIO_OUTPUT_H_
+#define AUDIO_OUTPUT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+#include "audio_ring.h"
+
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_DEVICE_SAMPLES 256 // ~5ms device buffer
+#define AUDIO_TARGET_LATENCY_MS 10 // queued audio the rate control steers towards
+#define AUDIO_MAX_LATENCY_MS 20 // queued plus device audio is never allowed past this
+#define AUDIO_RATE_CONTROL_DELTA 0.005 // maximum +/-0.5% rate adjustment
+#define AUDIO_MAX_FRAME_SAMPLES 2048
+
+typedef struct audio_output
+{
+    SDL_AudioDeviceID device; // 0 when no device could be opened
+    audio_ring_t ring;
+    uint32_t sample_rate;
+    uint32_t device_samples;
+    double pending; // fractional samples carried over between frames
+    SDL_atomic_t underruns;
+    SDL_sem *p_drained; // posted by the callback, lets a producer wait for room
+} audio_output_t;
+
+bool audio_output_open(audio_output_t *p_out);
+void audio_output_close(audio_output_t *p_out);
+
+/**
+ * Number of samples to synthesize for a frame that took elapsed_ms. The
+ * count is nudged up or down by at most AUDIO_RATE_CONTROL_DELTA to steer
+ * the ring towards AUDIO_TARGET_LATENCY_MS, and clamped so the total never
+ * exceeds AUDIO_MAX_LATENCY_MS.
+ */
+size_t audio_output_frame_samples(audio_output_t *p_out, uint64_t elapsed_ms);
+
+void audio_output_queue(audio_output_t *p_out, const int16_t *p_samples, size_t count);
+
+#endif // AUDIO_OUTPUT_H_
@@ -0,0 +1,75 @@
+#include <string.h>
+
+#include "audio_ring.h"
+
+#define AUDIO_RING_MASK (AUDIO_RING_SIZE - 1)
+// Indices run over twice the ring size so full and empty can be told apart
+#define AUDIO_RING_WRAP (2 * AUDIO_RING_SIZE - 1)
+
+void audio_ring_init(audio_ring_t *p_ring)
+{
+    memset(p_ring, 0, sizeof(*p_ring));
+    SDL_AtomicSet(&p_ring->head, 0);
+    SDL_AtomicSet(&p_ring->tail, 0);
+}
+
+size_t audio_ring_fill(audio_ring_t *p_ring)
+{
+    int head = SDL_AtomicGet(&p_ring->head);
+    int tail = SDL_AtomicGet(&p_ring->tail);
+    return (size_t)((head - tail) & AUDIO_RING_WRAP);
+}
+
+size_t audio_ring_write(audio_ring_t *p_ring, const int16_t *p_samples, size_t count)
+{
+    int head = SDL_AtomicGet(&p_ring->head);
+    int tail = SDL_AtomicGet(&p_ring->tail);
+    size_t space = AUDIO_RING_SIZE - (size_t)((head - tail) & AUDIO_RING_WRAP);
+    size_t start = (size_t)(head & AUDIO_RING_MASK);
+
+    if(count > space)
+    {
+        count = space;
+    }
+
+    // Copy in at most two runs, either side of the wrap
+    size_t first = AUDIO_RING_SIZE - start;
+    if(first > count)
+    {
+        first = count;
+    }
+    memcpy(&p_ring->samples[start], p_samples, first * sizeof(*p_samples));
+    memcpy(&p_ring->samples[0], p_samples + first, (count - first) * sizeof(*p_samples));
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&p_ring->head, (int)(((size_t)head + count) & AUDIO_RING_WRAP));
+
+    return count;
+}
+
+size_t audio_ring_read(audio_ring_t *p_ring, int16_t *p_samples, size_t count)
+{
+    int tail = SDL_AtomicGet(&p_ring->tail);
+    int head = SDL_AtomicGet(&p_ring->head);
+    size_t available = (size_t)((head - tail) & AUDIO_RING_WRAP);
+    size_t start = (size_t)(tail & AUDIO_RING_MASK);
+
+    if(count > available)
+    {
+        count = available;
+    }
+
+    SDL_MemoryBarrierAcquire();
+
+    size_t first = AUDIO_RING_SIZE - start;
+    if(first > count)
+    {
+        first = count;
+    }
+    memcpy(p_samples, &p_ring->samples[start], first * sizeof(*p_samples));
+    memcpy(p_samples + first, &p_ring->samples[0], (count - first) * sizeof(*p_samples));
+
+    SDL_AtomicSet(&p_ring->tail, (int)(((size_t)tail + count) & AUDIO_RING_WRAP));
+
+    return count;
+}
@@ -0,0 +1,34 @@
+#ifndef AUDIO_RING_H_
+#define AUDIO_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+// Must be a power of two, ~85ms at 48kHz
+#define AUDIO_RING_SIZE 4096
+
+/*
+ * Lock-free single-producer/single-consumer sample ring. The emulation
+ * thread writes beeper output, the SDL audio callback reads it.
+ */
+typedef struct audio_ring
+{
+    int16_t samples[AUDIO_RING_SIZE];
+    SDL_atomic_t head; // next sample to write, advanced by the producer
+    SDL_atomic_t tail; // next sample to read, advanced by the consumer
+} audio_ring_t;
+
+void audio_ring_init(audio_ring_t *p_ring);
+
+// Number of samples queued and not yet consumed.
+size_t audio_ring_fill(audio_ring_t *p_ring);
+
+// Returns the number of samples actually written (less when full).
+size_t audio_ring_write(audio_ring_t *p_ring, const int16_t *p_samples, size_t count);
+
+// Returns the number of samples actually read (less when running dry).
+size_t audio_ring_read(audio_ring_t *p_ring, int16_t *p_samples, size_t count);
+
+#endif // AUDIO_RING_H_
@@ -0,0 +1,89 @@
+#include "debug.h"
+#include "debug_overlay.h"
+
+#define GLYPH_W 4
+#define GLYPH_H FONT_BYTES
+#define ADVANCE (GLYPH_W + 1)
+#define LINE_H (GLYPH_H + 1)
+#define OVERLAY_LINES 3
+#define OVERLAY_TOP (DISPLAY_H - OVERLAY_LINES * LINE_H - 1)
+#define OVERLAY_WHITE 0xFFFFFFFFu
+#define OVERLAY_RED 0xFFFF4040u
+#define OVERLAY_YELLOW 0xFFFFFF40u
+
+// Draw digits hex digits of value with the top left at column x, returning the next free column
+static unsigned draw_hex(uint32_t *p_pixels, unsigned x, unsigned y, uint32_t value, unsigned digits, uint32_t color)
+{
+    for(unsigned d = 0; d < digits; d++)
+    {
+        const uint8_t *p_glyph = &cpu_font_sprites[((value >> (4 * (digits - 1 - d))) & 0xF) * FONT_BYTES];
+
+        for(unsigned row = 0; row < GLYPH_H; row++)
+        {
+            for(unsigned col = 0; col < GLYPH_W; col++)
+            {
+                if(p_glyph[row] & (0x80 >> col))
+                {
+                    p_pixels[(y + row) * DISPLAY_W + x + col] = color;
+                }
+            }
+        }
+        x += ADVANCE;
+    }
+
+    return x + ADVANCE;
+}
+
+void debug_overlay_render(chip8_t *p_cpu, uint32_t *p_pixels)
+{
+    const debug_t *p_debug = cpu_debug(p_cpu);
+    uint32_t color = OVERLAY_WHITE;
+    uint16_t opcode = 0;
+    unsigned x = 1;
+
+    cpu_display_render(p_cpu, p_pixels, DISPLAY_W, cpu_default_palette);
+    if(DISPLAY_LORES_W == cpu_display_width(p_cpu))
+    {
+        // Double the top left quarter up in place, from the bottom right so nothing is overwritten early
+        for(unsigned y = DISPLAY_H; y-- > 0;)
+        {
+            for(unsigned col = DISPLAY_W; col-- > 0;)
+            {
+                p_pixels[y * DISPLAY_W + col] = p_pixels[(y / 2) * DISPLAY_W + col / 2];
+            }
+        }
+    }
+    cpu_display_invalidate(p_cpu);
+
+    // Darken what is behind the text
+    for(unsigned i = OVERLAY_TOP * DISPLAY_W; i < DISPLAY_H * DISPLAY_W; i++)
+    {
+        p_pixels[i] = 0xFF000000u | ((p_pixels[i] >> 2) & 0x003F3F3Fu);
+    }
+
+    if(NULL != p_debug && DEBUG_BREAKPOINT == p_debug->stop)
+    {
+        color = OVERLAY_RED;
+    }
+    else if(NULL != p_debug && (DEBUG_WATCH_READ_HIT == p_debug->stop || DEBUG_WATCH_WRITE_HIT == p_debug->stop))
+    {
+        color = OVERLAY_YELLOW;
+    }
+
+    opcode = cpu_read_word(p_cpu, cpu_pc(p_cpu));
+    x = draw_hex(p_pixels, x, OVERLAY_TOP + 1, cpu_pc(p_cpu), 4, color);
+    x = draw_hex(p_pixels, x, OVERLAY_TOP + 1, cpu_index(p_cpu), 4, color);
+    x = draw_hex(p_pixels, x, OVERLAY_TOP + 1, opcode, 4, color);
+    x = draw_hex(p_pixels, x, OVERLAY_TOP + 1, cpu_sp(p_cpu), 1, color);
+    x = draw_hex(p_pixels, x, OVERLAY_TOP + 1, cpu_delay_timer(p_cpu), 2, color);
+    draw_hex(p_pixels, x, OVERLAY_TOP + 1, cpu_sound_timer(p_cpu), 2, color);
+
+    for(unsigned line = 0; line < 2; line++)
+    {
+        x = 1;
+        for(unsigned i = 0; i < 8; i++)
+        {
+            x = draw_hex(p_pixels, x, OVERLAY_TOP + 1 + (line + 1) * LINE_H, cpu_register(p_cpu, line * 8 + i), 2, OVERLAY_WHITE);
+        }
+    }
+}
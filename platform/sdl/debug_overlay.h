@@ -0,0 +1,21 @@
+#ifndef DEBUG_OVERLAY_H_
+#define DEBUG_OVERLAY_H_
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+/*
+ * Render the display at DISPLAY_W x DISPLAY_H, lo-res doubled up, with the
+ * registers of a stopped cpu over the bottom of it in hex:
+ *
+ *   pc  I  opcode  sp dt st
+ *   V0 - V7
+ *   V8 - VF
+ *
+ * The first row is red at a breakpoint, yellow at a watchpoint and white
+ * otherwise. Leaves display_dirty set so the next frame replaces it.
+ */
+void debug_overlay_render(chip8_t *p_cpu, uint32_t *p_pixels);
+
+#endif // DEBUG_OVERLAY_H_
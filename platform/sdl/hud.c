@@ -0,0 +1,84 @@
+#include "cpu.h"
+#include "hud.h"
+
+#define GLYPH_W 4
+#define GLYPH_H FONT_BYTES
+#define SCALE 2
+#define ADVANCE ((GLYPH_W + 1) * SCALE)
+#define LINE_H ((GLYPH_H + 1) * SCALE)
+#define MARGIN 2
+#define GRAPH_X ((HUD_W - HUD_GRAPH_FRAMES) / 2)
+#define GRAPH_TOP (MARGIN + 3 * LINE_H + 2)
+#define GRAPH_H (HUD_H - MARGIN - GRAPH_TOP)
+#define GRAPH_FULL_US 33333u // two 60Hz frames fill the graph
+#define FRAME_BUDGET_US 16667u
+#define HUD_BACKGROUND 0xA0000000u
+#define HUD_WHITE 0xFFFFFFFFu
+#define HUD_CYAN 0xFF40FFFFu
+#define HUD_YELLOW 0xFFFFFF40u
+#define HUD_GREEN 0xFF40FF40u
+#define HUD_RED 0xFFFF4040u
+#define HUD_GREY 0xFF808080u
+
+// Draw value in decimal with the top left at x, y
+static void draw_decimal(uint32_t *p_pixels, unsigned x, unsigned y, uint32_t value, uint32_t color)
+{
+    uint8_t digits[10];
+    unsigned count = 0;
+
+    do
+    {
+        digits[count++] = (uint8_t)(value % 10);
+        value /= 10;
+    } while(0 != value && count < sizeof(digits));
+
+    while(count-- > 0 && x + GLYPH_W * SCALE <= HUD_W)
+    {
+        const uint8_t *p_glyph = &cpu_font_sprites[digits[count] * FONT_BYTES];
+
+        for(unsigned row = 0; row < GLYPH_H * SCALE; row++)
+        {
+            uint32_t *p_row = &p_pixels[(y + row) * HUD_W + x];
+
+            for(unsigned col = 0; col < GLYPH_W * SCALE; col++)
+            {
+                if(p_glyph[row / SCALE] & (0x80 >> (col / SCALE)))
+                {
+                    p_row[col] = color;
+                }
+            }
+        }
+        x += ADVANCE;
+    }
+}
+
+void hud_render(const hud_stats_t *p_stats, uint32_t *p_pixels)
+{
+    unsigned budget_y = GRAPH_TOP + GRAPH_H - 1 - (GRAPH_H - 1) * FRAME_BUDGET_US / GRAPH_FULL_US;
+
+    for(unsigned i = 0; i < HUD_W * HUD_H; i++)
+    {
+        p_pixels[i] = HUD_BACKGROUND;
+    }
+
+    draw_decimal(p_pixels, MARGIN, MARGIN, p_stats->instructions_per_second, HUD_WHITE);
+    draw_decimal(p_pixels, MARGIN, MARGIN + LINE_H, p_stats->timer_hz, HUD_CYAN);
+    draw_decimal(p_pixels, MARGIN, MARGIN + 2 * LINE_H, p_stats->undrawn_percent, HUD_YELLOW);
+
+    for(unsigned col = 0; col < HUD_GRAPH_FRAMES; col++)
+    {
+        p_pixels[budget_y * HUD_W + GRAPH_X + col] = HUD_GREY;
+    }
+    // Oldest on the left, each bar up from the bottom, clipped at the top
+    for(unsigned col = 0; col < HUD_GRAPH_FRAMES; col++)
+    {
+        uint32_t us = p_stats->frame_us[(p_stats->head + col) % HUD_GRAPH_FRAMES];
+        uint32_t color = (us > FRAME_BUDGET_US) ? HUD_RED : HUD_GREEN;
+        unsigned height = (us >= GRAPH_FULL_US) ? GRAPH_H : (unsigned)(us * GRAPH_H / GRAPH_FULL_US);
+
+        for(unsigned row = 0; row < height; row++)
+        {
+            p_pixels[(GRAPH_TOP + GRAPH_H - 1 - row) * HUD_W + GRAPH_X + col] = color;
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef HUD_H_
+#define HUD_H_
+
+#include <stdint.h>
+
+#define HUD_W 128
+#define HUD_H 64
+#define HUD_GRAPH_FRAMES 120 // two seconds of frames
+
+// What the emulation thread measured, handed to the render thread whole
+typedef struct hud_stats
+{
+    uint32_t instructions_per_second;
+    uint32_t timer_hz; // delay and sound timer decrements per second
+    uint32_t undrawn_percent; // paced frames that drew nothing, so weren't presented
+    uint32_t frame_us[HUD_GRAPH_FRAMES]; // ring of frame times, oldest at head
+    uint32_t head;
+} hud_stats_t;
+
+/*
+ * Render the stats into HUD_W x HUD_H ARGB8888 pixels over a translucent
+ * background, digits in the CHIP-8 font doubled up:
+ *
+ *   instructions per second    white
+ *   timer Hz                   cyan
+ *   % of frames undrawn        yellow
+ *   frame times                green, red over a 60Hz frame, the line at 1/60s
+ */
+void hud_render(const hud_stats_t *p_stats, uint32_t *p_pixels);
+
+#endif // HUD_H_
@@ -0,0 +1,211 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input_map.h"
+
+#define INPUT_MAP_LINE_MAX 128
+#define INPUT_MAP_PAD_PREFIX "pad:"
+
+static const SDL_Scancode DEFAULT_KEYMAP[16] = {
+    SDL_SCANCODE_X, // 0
+    SDL_SCANCODE_1, // 1
+    SDL_SCANCODE_2, // 2
+    SDL_SCANCODE_3, // 3
+    SDL_SCANCODE_Q, // 4
+    SDL_SCANCODE_W, // 5
+    SDL_SCANCODE_E, // 6
+    SDL_SCANCODE_A, // 7
+    SDL_SCANCODE_S, // 8
+    SDL_SCANCODE_D, // 9
+    SDL_SCANCODE_Z, // A
+    SDL_SCANCODE_C, // B
+    SDL_SCANCODE_4, // C
+    SDL_SCANCODE_R, // D
+    SDL_SCANCODE_F, // E
+    SDL_SCANCODE_V  // F
+};
+
+static void clear_bindings(input_map_t *p_map)
+{
+    memset(p_map->scancodes, INPUT_MAP_NONE, sizeof(p_map->scancodes));
+    memset(p_map->buttons, INPUT_MAP_NONE, sizeof(p_map->buttons));
+}
+
+void input_map_init_default(input_map_t *p_map)
+{
+    memset(p_map, 0, sizeof(*p_map));
+    clear_bindings(p_map);
+
+    for(int8_t i = 0; i < 16; i++)
+    {
+        p_map->scancodes[DEFAULT_KEYMAP[i]] = i;
+    }
+
+    p_map->buttons[SDL_CONTROLLER_BUTTON_DPAD_UP] = 0x2;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_DPAD_LEFT] = 0x4;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_DPAD_RIGHT] = 0x6;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_DPAD_DOWN] = 0x8;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_A] = 0x5;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_B] = 0x0;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_X] = 0xA;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_Y] = 0xB;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_BACK] = 0xE;
+    p_map->buttons[SDL_CONTROLLER_BUTTON_START] = 0xF;
+}
+
+void input_map_bind_keys(input_map_t *p_map, const uint8_t keys[ROM_KEYS])
+{
+    static const SDL_Scancode scancodes[ROM_KEYS] = {
+        SDL_SCANCODE_UP, SDL_SCANCODE_DOWN, SDL_SCANCODE_LEFT, SDL_SCANCODE_RIGHT,
+        SDL_SCANCODE_SPACE, SDL_SCANCODE_LSHIFT
+    };
+    static const SDL_GameControllerButton buttons[ROM_KEYS] = {
+        SDL_CONTROLLER_BUTTON_DPAD_UP, SDL_CONTROLLER_BUTTON_DPAD_DOWN,
+        SDL_CONTROLLER_BUTTON_DPAD_LEFT, SDL_CONTROLLER_BUTTON_DPAD_RIGHT,
+        SDL_CONTROLLER_BUTTON_A, SDL_CONTROLLER_BUTTON_B
+    };
+
+    for(int key = 0; key < ROM_KEYS; key++)
+    {
+        if(keys[key] <= 0xF)
+        {
+            p_map->scancodes[scancodes[key]] = (int8_t)keys[key];
+            p_map->buttons[buttons[key]] = (int8_t)keys[key];
+        }
+    }
+}
+
+// Trim leading and trailing whitespace in place.
+static char *trim(char *p_str)
+{
+    char *p_end = NULL;
+
+    while(isspace((unsigned char)*p_str))
+    {
+        p_str++;
+    }
+
+    p_end = p_str + strlen(p_str);
+    while(p_end > p_str && isspace((unsigned char)p_end[-1]))
+    {
+        p_end--;
+    }
+    *p_end = '\0';
+
+    return p_str;
+}
+
+bool input_map_load(input_map_t *p_map, const char *p_filename)
+{
+    char line[INPUT_MAP_LINE_MAX];
+    unsigned line_number = 0;
+    FILE *p_fp = NULL;
+
+    if(NULL == p_filename)
+    {
+        return false;
+    }
+
+    p_fp = fopen(p_filename, "r");
+    if(NULL == p_fp)
+    {
+        return false;
+    }
+
+    clear_bindings(p_map);
+
+    while(NULL != fgets(line, sizeof(line), p_fp))
+    {
+        char *p_line = trim(line);
+        char *p_binding = NULL;
+        char *p_end = NULL;
+        long key = 0;
+
+        line_number++;
+        if('\0' == *p_line || '#' == *p_line)
+        {
+            continue;
+        }
+
+        key = strtol(p_line, &p_end, 16);
+        if(p_end == p_line || !isspace((unsigned char)*p_end) || key < 0 || key > 0xF)
+        {
+            fprintf(stderr, "%s:%u: expected a keypad digit 0-F\n", p_filename, line_number);
+            continue;
+        }
+        p_binding = trim(p_end);
+
+        if(0 == strncmp(p_binding, INPUT_MAP_PAD_PREFIX, strlen(INPUT_MAP_PAD_PREFIX)))
+        {
+            SDL_GameControllerButton button = SDL_GameControllerGetButtonFromString(p_binding + strlen(INPUT_MAP_PAD_PREFIX));
+            if(SDL_CONTROLLER_BUTTON_INVALID == button)
+            {
+                fprintf(stderr, "%s:%u: unknown controller button '%s'\n", p_filename, line_number, p_binding);
+                continue;
+            }
+            p_map->buttons[button] = (int8_t)key;
+        }
+        else
+        {
+            SDL_Scancode scancode = SDL_GetScancodeFromName(p_binding);
+            if(SDL_SCANCODE_UNKNOWN == scancode)
+            {
+                fprintf(stderr, "%s:%u: unknown key '%s'\n", p_filename, line_number, p_binding);
+                continue;
+            }
+            p_map->scancodes[scancode] = (int8_t)key;
+        }
+    }
+
+    fclose(p_fp);
+
+    return true;
+}
+
+void input_map_add_controller(input_map_t *p_map, int device_index)
+{
+    if(!SDL_IsGameController(device_index))
+    {
+        return;
+    }
+
+    for(int i = 0; i < INPUT_MAP_MAX_CONTROLLERS; i++)
+    {
+        if(NULL == p_map->p_controllers[i])
+        {
+            p_map->p_controllers[i] = SDL_GameControllerOpen(device_index);
+            return;
+        }
+    }
+
+    fprintf(stderr, "Too many game controllers, ignoring device %d.\n", device_index);
+}
+
+void input_map_remove_controller(input_map_t *p_map, SDL_JoystickID instance_id)
+{
+    for(int i = 0; i < INPUT_MAP_MAX_CONTROLLERS; i++)
+    {
+        SDL_GameController *p_controller = p_map->p_controllers[i];
+        if(NULL != p_controller &&
+           instance_id == SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(p_controller)))
+        {
+            SDL_GameControllerClose(p_controller);
+            p_map->p_controllers[i] = NULL;
+            return;
+        }
+    }
+}
+
+void input_map_close_controllers(input_map_t *p_map)
+{
+    for(int i = 0; i < INPUT_MAP_MAX_CONTROLLERS; i++)
+    {
+        if(NULL != p_map->p_controllers[i])
+        {
+            SDL_GameControllerClose(p_map->p_controllers[i]);
+            p_map->p_controllers[i] = NULL;
+        }
+    }
+}
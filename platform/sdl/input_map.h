@@ -0,0 +1,55 @@
+#ifndef INPUT_MAP_H_
+#define INPUT_MAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+#include "rom_db.h"
+
+#define INPUT_MAP_NONE -1
+#define INPUT_MAP_MAX_CONTROLLERS 8
+
+/*
+ * Direct lookup tables from every SDL scancode and game controller button
+ * to a CHIP-8 keypad index, built once at startup so each input event is a
+ * single array read.
+ */
+typedef struct input_map
+{
+    int8_t scancodes[SDL_NUM_SCANCODES];
+    int8_t buttons[SDL_CONTROLLER_BUTTON_MAX];
+    SDL_GameController *p_controllers[INPUT_MAP_MAX_CONTROLLERS];
+} input_map_t;
+
+// Keyboard layout matching the COSMAC VIP keypad, d-pad on 2/4/6/8.
+void input_map_init_default(input_map_t *p_map);
+
+// Put the arrow keys and the d-pad, A and B on the keys a game uses (ROM database keys).
+void input_map_bind_keys(input_map_t *p_map, const uint8_t keys[ROM_KEYS]);
+
+/**
+ * Replace the default bindings with those from a mapping file. Each line
+ * reads "<keypad digit> <binding>", where the binding is an SDL scancode name
+ * ("X", "Keypad 1") or "pad:<button>" with an SDL controller button name
+ * ("pad:a", "pad:dpup"). Blank lines and lines starting with '#' are ignored.
+ */
+bool input_map_load(input_map_t *p_map, const char *p_filename);
+
+static inline int8_t input_map_scancode(const input_map_t *p_map, SDL_Scancode scancode)
+{
+    return ((unsigned)scancode < SDL_NUM_SCANCODES) ? p_map->scancodes[scancode] : INPUT_MAP_NONE;
+}
+
+static inline int8_t input_map_button(const input_map_t *p_map, int button)
+{
+    return ((unsigned)button < SDL_CONTROLLER_BUTTON_MAX) ? p_map->buttons[button] : INPUT_MAP_NONE;
+}
+
+// Hotplug handling for SDL_CONTROLLERDEVICEADDED/REMOVED events.
+void input_map_add_controller(input_map_t *p_map, int device_index);
+void input_map_remove_controller(input_map_t *p_map, SDL_JoystickID instance_id);
+void input_map_close_controllers(input_map_t *p_map);
+
+#endif // INPUT_MAP_H_
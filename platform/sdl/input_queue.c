@@ -0,0 +1,70 @@
+#include <string.h>
+
+#include "input_queue.h"
+
+#define INPUT_QUEUE_MASK (INPUT_QUEUE_SIZE - 1)
+// Indices run over twice the queue size so full and empty can be told apart
+#define INPUT_QUEUE_WRAP (2 * INPUT_QUEUE_SIZE - 1)
+
+void input_queue_init(input_queue_t *p_queue)
+{
+    memset(p_queue, 0, sizeof(*p_queue));
+    SDL_AtomicSet(&p_queue->head, 0);
+    SDL_AtomicSet(&p_queue->tail, 0);
+}
+
+bool input_queue_push(input_queue_t *p_queue, const input_event_t *p_event)
+{
+    int head = SDL_AtomicGet(&p_queue->head);
+    int tail = SDL_AtomicGet(&p_queue->tail);
+
+    if(((head - tail) & INPUT_QUEUE_WRAP) == INPUT_QUEUE_SIZE)
+    {
+        // queue full
+        return false;
+    }
+
+    p_queue->events[head & INPUT_QUEUE_MASK] = *p_event;
+
+    // Publish the slot only once it has been written
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&p_queue->head, (head + 1) & INPUT_QUEUE_WRAP);
+
+    return true;
+}
+
+bool input_queue_peek(input_queue_t *p_queue, input_event_t *p_event)
+{
+    int tail = SDL_AtomicGet(&p_queue->tail);
+    int head = SDL_AtomicGet(&p_queue->head);
+
+    if(head == tail)
+    {
+        // queue empty
+        return false;
+    }
+
+    SDL_MemoryBarrierAcquire();
+    *p_event = p_queue->events[tail & INPUT_QUEUE_MASK];
+
+    return true;
+}
+
+bool input_queue_pop(input_queue_t *p_queue, input_event_t *p_event)
+{
+    int tail = SDL_AtomicGet(&p_queue->tail);
+    int head = SDL_AtomicGet(&p_queue->head);
+
+    if(head == tail)
+    {
+        // queue empty
+        return false;
+    }
+
+    SDL_MemoryBarrierAcquire();
+    *p_event = p_queue->events[tail & INPUT_QUEUE_MASK];
+
+    SDL_AtomicSet(&p_queue->tail, (tail + 1) & INPUT_QUEUE_WRAP);
+
+    return true;
+}
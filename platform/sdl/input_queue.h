@@ -0,0 +1,39 @@
+#ifndef INPUT_QUEUE_H_
+#define INPUT_QUEUE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+// Must be a power of two
+#define INPUT_QUEUE_SIZE 256
+
+typedef struct input_event
+{
+    uint64_t timestamp; // SDL_GetTicks64() when the event was polled
+    uint8_t key; // CHIP-8 keypad index 0x0-0xF
+    bool pressed;
+} input_event_t;
+
+/*
+ * Lock-free single-producer/single-consumer queue carrying keypad events
+ * from the thread that polls SDL to the emulation thread.
+ */
+typedef struct input_queue
+{
+    input_event_t events[INPUT_QUEUE_SIZE];
+    SDL_atomic_t head; // next slot to write, advanced by the producer
+    SDL_atomic_t tail; // next slot to read, advanced by the consumer
+} input_queue_t;
+
+void input_queue_init(input_queue_t *p_queue);
+
+// Returns false if the queue is full and the event was dropped.
+bool input_queue_push(input_queue_t *p_queue, const input_event_t *p_event);
+
+// Returns false if the queue is empty.
+bool input_queue_peek(input_queue_t *p_queue, input_event_t *p_event);
+bool input_queue_pop(input_queue_t *p_queue, input_event_t *p_event);
+
+#endif // INPUT_QUEUE_H_
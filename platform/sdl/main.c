@@ -1,56 +1,786 @@
 #include <SDL2/SDL_scancode.h>
 #include <stdio.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 
+#include "audio_output.h"
+#include "beeper.h"
 #include "cpu.h"
+#include "debug.h"
+#include "debug_overlay.h"
+#include "hud.h"
+#include "history.h"
+#include "input_map.h"
+#include "input_queue.h"
+#include "movie.h"
+#include "rom_cache.h"
+#include "metrics.h"
+#include "timeline.h"
+#include "triple_buffer.h"
+#ifdef EMUEIGHT_PROFILE
+#include "profile.h"
+#endif
 
-#define SCREEN_WIDTH DISPLAY_W * 20
-#define SCREEN_HEIGHT DISPLAY_H * 20
-
-const static SDL_Scancode KEYMAP[16] = {
-    SDL_SCANCODE_X, // 0
-    SDL_SCANCODE_1, // 1
-    SDL_SCANCODE_2, // 2
-    SDL_SCANCODE_3, // 3
-    SDL_SCANCODE_Q, // 4
-    SDL_SCANCODE_W, // 5
-    SDL_SCANCODE_E, // 6
-    SDL_SCANCODE_A, // 7
-    SDL_SCANCODE_S, // 8
-    SDL_SCANCODE_D, // 9
-    SDL_SCANCODE_Z, // A
-    SDL_SCANCODE_C, // B
-    SDL_SCANCODE_4, // C
-    SDL_SCANCODE_R, // D
-    SDL_SCANCODE_F, // E
-    SDL_SCANCODE_V  // F
-};
-
-// maybe do better here
-int8_t get_index_from_scancode(SDL_Scancode scancode)
-{
-    // Iterate through the KEYMAP array to find the matching scancode
-    for (int8_t i = 0; i < 16; i++)
-	{
-        if (KEYMAP[i] == scancode)
-		{
-            return i; // Return the index if found
-        }
-    }
-    return -1; // Return -1 if scancode not found
-}
-
-void update_display(SDL_Texture *p_tex, SDL_Renderer *p_ren, void *p_vram, int pitch) 
-{
-    SDL_UpdateTexture(p_tex, NULL, p_vram, pitch);
+#define SCREEN_WIDTH DISPLAY_W * 10
+#define SCREEN_HEIGHT DISPLAY_H * 10
+#define CYCLES_PER_FRAME 16 // ~1kHz, the classic CHIP-8 speed
+#define CYCLES_PER_FRAME_MAX 10000000
+#define TURBO_SCANCODE SDL_SCANCODE_TAB
+#define TURBO_FRAMES 8 // frames emulated per paced frame while turbo is held
+#define MAX_LAG_FRAMES 6 // drop frames rather than catch up after a stall
+#define PRESENT_INTERVAL_MS 16 // how often unlimited mode shows a frame
+#define PAUSE_SCANCODE SDL_SCANCODE_F5 // stop or continue
+#define BREAKPOINT_SCANCODE SDL_SCANCODE_F8 // toggle a breakpoint at pc
+#define STEP_OVER_SCANCODE SDL_SCANCODE_F10
+#define STEP_SCANCODE SDL_SCANCODE_F11
+#define CONTINUE_BACK_SCANCODE SDL_SCANCODE_F6
+#define STEP_BACK_SCANCODE SDL_SCANCODE_F7
+#define TIMELINE_SCANCODE SDL_SCANCODE_F12
+#define TIMELINE_FILE "emueight-timeline.json"
+#define METRICS_SAVE_NS 1000000000u // how often --metrics rewrites its file, and the HUD its rates
+#define HUD_SCANCODE SDL_SCANCODE_F1
+#define HUD_SCALE 2 // window pixels per HUD pixel
+#define DEBUG_POLL_MS 10
+#define MAX_BREAKPOINTS 16
+#ifdef EMUEIGHT_PROFILE
+#define PROFILE_SCANCODE SDL_SCANCODE_F9
+#define PROFILE_FILE "emueight-profile.json"
+#endif
+
+typedef enum sync_mode
+{
+    SYNC_TICKS, // pace from SDL_GetTicks64 deltas
+    SYNC_AUDIO, // pace from the audio device consuming samples
+    SYNC_UNLIMITED // as fast as the host allows, no sound
+} sync_mode_t;
+
+// Debugger keys, render -> emulation
+typedef enum debug_command
+{
+    DEBUG_COMMAND_NONE,
+    DEBUG_COMMAND_PAUSE,
+    DEBUG_COMMAND_BREAKPOINT,
+    DEBUG_COMMAND_STEP_OVER,
+    DEBUG_COMMAND_STEP,
+    DEBUG_COMMAND_STEP_BACK,
+    DEBUG_COMMAND_CONTINUE_BACK
+} debug_command_t;
+
+typedef enum movie_mode
+{
+    MOVIE_OFF,
+    MOVIE_RECORD,
+    MOVIE_PLAY
+} movie_mode_t;
+
+// A finished picture, sized for hi-res with lo-res using the top left corner
+typedef struct video_frame
+{
+    int width;
+    int height;
+    uint32_t pixels[DISPLAY_H * DISPLAY_W];
+} video_frame_t;
+
+// State shared between the render (main) thread and the emulation thread.
+typedef struct emu_context
+{
+    chip8_t *p_cpu; // owned by the emulation thread once it is started
+    triple_buffer_t frames; // finished frames, emulation -> render
+    input_queue_t input; // keypad events, render -> emulation
+    input_map_t input_map; // owned by the render thread
+    uint8_t key_refs[16]; // per keypad key count of bindings held down, emulation thread only
+    audio_output_t audio; // beeper samples, emulation -> audio callback
+    beeper_t beeper;
+    sync_mode_t sync_mode;
+    movie_mode_t movie_mode;
+    movie_t movie;
+    uint32_t cycles_per_frame;
+    SDL_atomic_t turbo; // turbo key held, render -> emulation
+    SDL_atomic_t running;
+    debug_t debug; // emulation thread only
+    SDL_atomic_t debug_command; // debug_command_t, render -> emulation
+    history_t history; // emulation thread only
+    history_t *p_history; // &history while it is kept
+    timeline_t render_timeline; // render thread only
+    timeline_t emu_timeline; // emulation thread only
+    FILE *p_timeline_fp; // handed render -> emulation with dump_timeline
+    SDL_atomic_t dump_timeline; // render thread has written its part
+    const char *p_metrics_file; // NULL without --metrics
+    metrics_t metrics; // emulation thread only
+    uint64_t frame_start; // timeline_clock() at begin_frame()
+    uint64_t second_start; // and at the last metrics_rate()
+    uint64_t second_frames; // metrics.frames then
+    uint64_t paced_frames; // frames that could be presented, this second
+    uint64_t undrawn_frames; // of those, ones that drew nothing
+    triple_buffer_t hud; // hud_stats_t, emulation -> render
+    hud_stats_t hud_stats; // emulation thread only
+    SDL_atomic_t show_hud; // HUD key toggled, render -> emulation
+    bool hud_on; // show_hud as of begin_frame(), emulation thread only
+#ifdef EMUEIGHT_PROFILE
+    profile_t profile; // emulation thread only
+    SDL_atomic_t dump_profile; // profile key pressed, render -> emulation
+#endif
+} emu_context_t;
+
+// Present the frame, uploading it first when it is new, with the HUD over it unless p_hud_tex is NULL
+void update_display(SDL_Texture *p_tex, SDL_Renderer *p_ren, const video_frame_t *p_frame, bool upload,
+                    SDL_Texture *p_hud_tex, timeline_t *p_timeline)
+{
+    SDL_Rect visible = { 0, 0, p_frame->width, p_frame->height };
+    SDL_Rect hud = { 0, 0, HUD_W * HUD_SCALE, HUD_H * HUD_SCALE };
+
+    timeline_begin(p_timeline, "upload");
+    if(upload)
+    {
+        SDL_UpdateTexture(p_tex, &visible, p_frame->pixels, sizeof(uint32_t) * DISPLAY_W);
+    }
+    timeline_end(p_timeline);
+    timeline_begin(p_timeline, "present");
     SDL_RenderClear(p_ren);
-    SDL_RenderCopy(p_ren, p_tex, NULL, NULL);
+    SDL_RenderCopy(p_ren, p_tex, &visible, NULL);
+    if(NULL != p_hud_tex)
+    {
+        SDL_RenderCopy(p_ren, p_hud_tex, NULL, &hud);
+    }
     SDL_RenderPresent(p_ren);
+    timeline_end(p_timeline);
+}
+
+// Both threads time their phases on the same clock, nothing is cached between them
+static uint64_t timeline_clock(void)
+{
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t counter = SDL_GetPerformanceCounter();
+
+    return counter / frequency * 1000000000u + counter % frequency * 1000000000u / frequency;
+}
+
+/*
+ * The render thread has written the beginning of the file and its own
+ * timeline, the emulation thread adds its timeline and finishes the file.
+ * Neither thread ever reads the other's timeline.
+ */
+static void dump_timeline(emu_context_t *p_ctx)
+{
+    FILE *p_fp = NULL;
+    bool ok = false;
+
+    if(!SDL_AtomicGet(&p_ctx->dump_timeline))
+    {
+        return;
+    }
+    p_fp = p_ctx->p_timeline_fp;
+    ok = timeline_write(&p_ctx->emu_timeline, p_fp);
+    ok = timeline_write_end(p_fp) && ok;
+    ok = (0 == fclose(p_fp)) && ok;
+    if(ok)
+    {
+        printf("Frame timeline written to %s.\n", TIMELINE_FILE);
+    }
+    else
+    {
+        fprintf(stderr, "Failed to write frame timeline %s.\n", TIMELINE_FILE);
+    }
+    p_ctx->p_timeline_fp = NULL;
+    SDL_AtomicSet(&p_ctx->dump_timeline, 0);
+}
+
+/*
+ * Fold every event that happened before the frame boundary into the keypad
+ * in one go. Several keys or buttons can be bound to the same keypad key,
+ * so each key stays down until all of its bindings are released. A key
+ * pressed and released between two frames is still held for one frame, or
+ * the program would never see the tap.
+ */
+static void apply_input(emu_context_t *p_ctx, uint64_t current_time)
+{
+    input_event_t event;
+    uint16_t keypad = 0;
+
+    while(input_queue_peek(&p_ctx->input, &event) && event.timestamp <= current_time)
+    {
+        input_queue_pop(&p_ctx->input, &event);
+        if(event.pressed)
+        {
+            p_ctx->key_refs[event.key]++;
+            keypad |= (uint16_t)(1u << event.key);
+        }
+        else if(p_ctx->key_refs[event.key] > 0)
+        {
+            p_ctx->key_refs[event.key]--;
+        }
+    }
+
+    for(uint8_t i = 0; i < 16; i++)
+    {
+        if(0 != p_ctx->key_refs[i])
+        {
+            keypad |= (uint16_t)(1u << i);
+        }
+    }
+    cpu_set_keypad(p_ctx->p_cpu, keypad);
+}
+
+// Act on the last debugger key pressed, returning false if there wasn't one.
+static bool apply_debug_command(emu_context_t *p_ctx)
+{
+    chip8_t *p_cpu = p_ctx->p_cpu;
+    bool stopped = DEBUG_RUNNING != p_ctx->debug.stop;
+
+    debug_command_t command = (debug_command_t)SDL_AtomicSet(&p_ctx->debug_command, DEBUG_COMMAND_NONE);
+
+    switch(command)
+    {
+        case DEBUG_COMMAND_PAUSE:
+            if(stopped)
+            {
+                debug_continue(p_cpu);
+            }
+            else
+            {
+                debug_pause(&p_ctx->debug);
+            }
+            return true;
+        case DEBUG_COMMAND_BREAKPOINT:
+            debug_set_breakpoint(&p_ctx->debug, cpu_pc(p_cpu), !debug_has_breakpoint(&p_ctx->debug, cpu_pc(p_cpu)));
+            printf("Breakpoint at 0x%04X %s.\n", cpu_pc(p_cpu),
+                   debug_has_breakpoint(&p_ctx->debug, cpu_pc(p_cpu)) ? "set" : "cleared");
+            return true;
+        case DEBUG_COMMAND_STEP_OVER:
+            if(stopped)
+            {
+                debug_step_over(p_cpu);
+            }
+            return true;
+        case DEBUG_COMMAND_STEP:
+            if(stopped)
+            {
+                debug_step(p_cpu);
+            }
+            return true;
+        case DEBUG_COMMAND_STEP_BACK:
+        case DEBUG_COMMAND_CONTINUE_BACK:
+            if(!stopped || NULL == p_ctx->p_history)
+            {
+                return true;
+            }
+            if(!((DEBUG_COMMAND_STEP_BACK == command) ? history_step_back(p_ctx->p_history, p_cpu)
+                                                      : history_continue_back(p_ctx->p_history, p_cpu)))
+            {
+                printf("At the start of the history.\n");
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Show the stopped cpu with its registers over the picture
+static void publish_debug_frame(emu_context_t *p_ctx)
+{
+    video_frame_t *p_frame = triple_buffer_write_slot(&p_ctx->frames);
+
+    p_frame->width = DISPLAY_W;
+    p_frame->height = DISPLAY_H;
+    debug_overlay_render(p_ctx->p_cpu, p_frame->pixels);
+    triple_buffer_publish(&p_ctx->frames);
+}
+
+/*
+ * Run the frame's cycles. When the debugger stops the cpu part way the
+ * frame, and so the timers, wait here for debugger keys until it carries
+ * on or steps to the end of the frame.
+ */
+static void run_cycles(emu_context_t *p_ctx)
+{
+    chip8_t *p_cpu = p_ctx->p_cpu;
+    bool changed = true;
+
+    timeline_begin(&p_ctx->emu_timeline, "emulate");
+    cpu_run(p_cpu, p_ctx->cycles_per_frame);
+    while(DEBUG_RUNNING != p_ctx->debug.stop && SDL_AtomicGet(&p_ctx->running))
+    {
+        if(changed)
+        {
+            publish_debug_frame(p_ctx);
+        }
+        SDL_Delay(DEBUG_POLL_MS);
+        changed = apply_debug_command(p_ctx);
+        dump_timeline(p_ctx);
+
+        if(cpu_frame_cycle(p_cpu) >= p_ctx->cycles_per_frame)
+        {
+            break;
+        }
+        cpu_run(p_cpu, p_ctx->cycles_per_frame - cpu_frame_cycle(p_cpu));
+    }
+    timeline_end(&p_ctx->emu_timeline);
+}
+
+/*
+ * The HUD is coming on. Without a metrics file nothing was counted while
+ * it was hidden, so its first second starts now rather than back when it
+ * was turned off.
+ */
+static void restart_hud_rates(emu_context_t *p_ctx)
+{
+    uint64_t now = 0;
+
+    if(NULL != p_ctx->p_metrics_file)
+    {
+        return;
+    }
+    now = timeline_clock();
+    p_ctx->second_start = now;
+    p_ctx->second_frames = p_ctx->metrics.frames;
+    p_ctx->paced_frames = 0;
+    p_ctx->undrawn_frames = 0;
+    // Without a rate to work out, metrics_rate() only takes the starting point
+    p_ctx->metrics.rate_ns = 0;
+    metrics_rate(&p_ctx->metrics, now);
+}
+
+/*
+ * Latch the keypad for the coming frame. A movie being played back
+ * overrides live input, one being recorded captures it.
+ */
+static void begin_frame(emu_context_t *p_ctx, uint64_t current_time)
+{
+    chip8_t *p_cpu = p_ctx->p_cpu;
+    uint16_t keypad = 0;
+
+    // Outside the frame, writing the file isn't one of its phases
+    dump_timeline(p_ctx);
+    if(!p_ctx->hud_on && SDL_AtomicGet(&p_ctx->show_hud))
+    {
+        restart_hud_rates(p_ctx);
+    }
+    p_ctx->hud_on = SDL_AtomicGet(&p_ctx->show_hud);
+    if(NULL != p_ctx->p_metrics_file || p_ctx->hud_on)
+    {
+        p_ctx->frame_start = timeline_clock();
+    }
+    timeline_begin(&p_ctx->emu_timeline, "frame");
+    timeline_begin(&p_ctx->emu_timeline, "input");
+    apply_input(p_ctx, current_time);
+    apply_debug_command(p_ctx);
+
+#ifdef EMUEIGHT_PROFILE
+    if(SDL_AtomicSet(&p_ctx->dump_profile, 0))
+    {
+        if(profile_save(&p_ctx->profile, PROFILE_FILE))
+        {
+            printf("Profile of %llu instructions written to %s.\n",
+                   (unsigned long long)p_ctx->profile.total, PROFILE_FILE);
+        }
+        else
+        {
+            fprintf(stderr, "Failed to write profile %s.\n", PROFILE_FILE);
+        }
+    }
+#endif
+
+    if(MOVIE_PLAY == p_ctx->movie_mode)
+    {
+        if(movie_play_frame(&p_ctx->movie, &keypad))
+        {
+            cpu_set_keypad(p_cpu, keypad);
+        }
+        else
+        {
+            printf("Movie finished, display hash %s.\n",
+                   movie_play_verify(&p_ctx->movie, p_cpu) ? "matches" : "MISMATCH");
+            p_ctx->movie_mode = MOVIE_OFF;
+        }
+    }
+    else if(MOVIE_RECORD == p_ctx->movie_mode)
+    {
+        if(!movie_record_frame(&p_ctx->movie, cpu_keypad(p_cpu)))
+        {
+            fprintf(stderr, "Out of memory, movie recording stopped.\n");
+            p_ctx->movie_mode = MOVIE_OFF;
+        }
+    }
+
+    if(NULL != p_ctx->p_history && !history_frame(p_ctx->p_history, p_cpu))
+    {
+        fprintf(stderr, "Out of memory, going backwards is off.\n");
+        history_free(p_ctx->p_history);
+        p_ctx->p_history = NULL;
+    }
+    timeline_end(&p_ctx->emu_timeline);
+}
+
+// Once a second, work out the HUD's rates from what the metrics counted
+static void update_hud_rates(emu_context_t *p_ctx, uint64_t now)
+{
+    hud_stats_t *p_stats = &p_ctx->hud_stats;
+    uint64_t elapsed = now - p_ctx->second_start;
+
+    p_stats->instructions_per_second = (uint32_t)p_ctx->metrics.instructions_per_second;
+    // Every frame counted is followed by a timer tick, turbo frames too
+    p_stats->timer_hz = (uint32_t)((p_ctx->metrics.frames - p_ctx->second_frames) * 1000000000u / elapsed);
+    p_stats->undrawn_percent = (0 != p_ctx->paced_frames) ?
+                               (uint32_t)(p_ctx->undrawn_frames * 100 / p_ctx->paced_frames) : 0;
+    p_ctx->second_frames = p_ctx->metrics.frames;
+    p_ctx->paced_frames = 0;
+    p_ctx->undrawn_frames = 0;
+}
+
+/*
+ * Count the frame, after its cycles and before its timer tick, and once a
+ * second rewrite the metrics file. Only this thread touches the metrics,
+ * the audio callback's underrun count is read through its atomic. With
+ * the HUD shown a copy of its stats goes to the render thread each frame.
+ */
+static void update_metrics(emu_context_t *p_ctx)
+{
+    hud_stats_t *p_stats = &p_ctx->hud_stats;
+    uint64_t now = 0;
+
+    if(NULL == p_ctx->p_metrics_file && !p_ctx->hud_on)
+    {
+        return;
+    }
+    now = timeline_clock();
+    metrics_frame(&p_ctx->metrics, p_ctx->p_cpu, now - p_ctx->frame_start);
+    if(now - p_ctx->second_start >= METRICS_SAVE_NS)
+    {
+        p_ctx->metrics.audio_underruns = (uint64_t)SDL_AtomicGet(&p_ctx->audio.underruns);
+        metrics_rate(&p_ctx->metrics, now);
+        if(NULL != p_ctx->p_metrics_file && !metrics_save(&p_ctx->metrics, p_ctx->p_metrics_file))
+        {
+            fprintf(stderr, "Failed to save metrics %s.\n", p_ctx->p_metrics_file);
+        }
+        update_hud_rates(p_ctx, now);
+        p_ctx->second_start = now;
+    }
+
+    if(p_ctx->hud_on)
+    {
+        p_stats->frame_us[p_stats->head] = (uint32_t)((now - p_ctx->frame_start) / 1000);
+        p_stats->head = (p_stats->head + 1) % HUD_GRAPH_FRAMES;
+        *(hud_stats_t *)triple_buffer_write_slot(&p_ctx->hud) = *p_stats;
+        triple_buffer_publish(&p_ctx->hud);
+    }
+}
+
+// Finish the current frame: synthesize its audio, advance the timers and
+// hand the picture to the render thread without ever waiting on it.
+static void end_frame(emu_context_t *p_ctx, int16_t *p_samples, size_t sample_count)
+{
+    chip8_t *p_cpu = p_ctx->p_cpu;
+    timeline_t *p_timeline = &p_ctx->emu_timeline;
+    video_frame_t *p_frame = NULL;
+
+    timeline_begin(p_timeline, "audio");
+    beeper_render_frame(&p_ctx->beeper, p_cpu, p_samples, sample_count);
+    audio_output_queue(&p_ctx->audio, p_samples, sample_count);
+    timeline_end(p_timeline);
+    p_ctx->paced_frames++;
+    p_ctx->undrawn_frames += !cpu_display_dirty(p_cpu);
+    update_metrics(p_ctx);
+    cpu_timer_tick(p_cpu);
+
+    // With nothing drawn the render thread keeps showing the last frame
+    if(cpu_display_dirty(p_cpu))
+    {
+        timeline_begin(p_timeline, "video");
+        p_frame = triple_buffer_write_slot(&p_ctx->frames);
+        p_frame->width = (int)cpu_display_width(p_cpu);
+        p_frame->height = (int)cpu_display_height(p_cpu);
+        cpu_display_render(p_cpu, p_frame->pixels, DISPLAY_W, cpu_default_palette);
+        triple_buffer_publish(&p_ctx->frames);
+        timeline_end(p_timeline);
+    }
+    timeline_end(p_timeline); // frame
+}
+
+// Run a frame that is neither heard nor seen, for turbo and unlimited mode.
+static void skip_frame(emu_context_t *p_ctx, uint64_t current_time)
+{
+    begin_frame(p_ctx, current_time);
+    run_cycles(p_ctx);
+    update_metrics(p_ctx);
+    cpu_timer_tick(p_ctx->p_cpu);
+    timeline_end(&p_ctx->emu_timeline); // frame
+}
+
+// While the turbo key is held each paced frame is preceded by extra silent ones.
+static void run_turbo_frames(emu_context_t *p_ctx, uint64_t current_time)
+{
+    if(SDL_AtomicGet(&p_ctx->turbo))
+    {
+        for(int i = 1; i < TURBO_FRAMES; i++)
+        {
+            skip_frame(p_ctx, current_time);
+        }
+    }
+}
+
+/*
+ * Run whole frames of cycles_per_frame cycles at 60Hz measured by
+ * SDL_GetTicks64. Every frame runs the same number of cycles, so the clock
+ * speed is exactly cycles_per_frame * 60 and movies replay as recorded.
+ */
+static void run_ticks_paced(emu_context_t *p_ctx)
+{
+    int16_t samples[AUDIO_MAX_FRAME_SAMPLES];
+    uint64_t start_time = SDL_GetTicks64();
+    uint64_t last_frame_time = start_time;
+    uint64_t frames = 0;
+
+    while(SDL_AtomicGet(&p_ctx->running))
+    {
+        uint64_t current_time = SDL_GetTicks64();
+        uint64_t frames_due = (current_time - start_time) * 60 / 1000;
+
+        if(frames >= frames_due)
+        {
+            SDL_Delay(1);
+            continue;
+        }
+        if(frames_due - frames > MAX_LAG_FRAMES)
+        {
+            p_ctx->metrics.skipped_frames += frames_due - 1 - frames;
+            frames = frames_due - 1;
+        }
+
+        run_turbo_frames(p_ctx, current_time);
+        begin_frame(p_ctx, current_time);
+        run_cycles(p_ctx);
+        end_frame(p_ctx, samples, audio_output_frame_samples(&p_ctx->audio, current_time - last_frame_time));
+        last_frame_time = current_time;
+        frames++;
+    }
+}
+
+// Run frames back to back, only presenting one every PRESENT_INTERVAL_MS.
+static void run_unlimited(emu_context_t *p_ctx)
+{
+    int16_t samples[1];
+    uint64_t last_present_time = 0;
+
+    while(SDL_AtomicGet(&p_ctx->running))
+    {
+        uint64_t current_time = SDL_GetTicks64();
+
+        if(current_time - last_present_time < PRESENT_INTERVAL_MS)
+        {
+            skip_frame(p_ctx, current_time);
+            continue;
+        }
+
+        begin_frame(p_ctx, current_time);
+        run_cycles(p_ctx);
+        end_frame(p_ctx, samples, 0);
+        last_present_time = current_time;
+    }
+}
+
+/*
+ * Run a frame whenever the audio device has drained the ring down to its
+ * own buffer size. Every frame produces exactly sample_rate / 60 samples,
+ * carrying the integer remainder, so emulation is slaved to the sound card
+ * clock with no resampling and no drift however long it runs.
+ */
+static void run_audio_paced(emu_context_t *p_ctx)
+{
+    audio_output_t *p_audio = &p_ctx->audio;
+    int16_t samples[AUDIO_MAX_FRAME_SAMPLES];
+    uint32_t remainder = 0;
+
+    while(SDL_AtomicGet(&p_ctx->running))
+    {
+        if(audio_ring_fill(&p_audio->ring) > p_audio->device_samples)
+        {
+            // Sleep until the callback has consumed another block
+            SDL_SemWaitTimeout(p_audio->p_drained, 10);
+            continue;
+        }
+
+        uint32_t sample_count = (p_audio->sample_rate + remainder) / 60;
+        remainder = (p_audio->sample_rate + remainder) % 60;
+
+        uint64_t current_time = SDL_GetTicks64();
+        run_turbo_frames(p_ctx, current_time);
+        begin_frame(p_ctx, current_time);
+        run_cycles(p_ctx);
+        end_frame(p_ctx, samples, sample_count);
+    }
+}
+
+static int emulation_thread(void *p_data)
+{
+    emu_context_t *p_ctx = p_data;
+
+    switch(p_ctx->sync_mode)
+    {
+        case SYNC_AUDIO:
+            run_audio_paced(p_ctx);
+            break;
+        case SYNC_UNLIMITED:
+            run_unlimited(p_ctx);
+            break;
+        default:
+            run_ticks_paced(p_ctx);
+            break;
+    }
+
+    return 0;
+}
+
+static void queue_key(emu_context_t *p_ctx, int8_t index, bool pressed)
+{
+    if(INPUT_MAP_NONE != index)
+    {
+        input_event_t event;
+        event.timestamp = SDL_GetTicks64();
+        event.key = (uint8_t)index;
+        event.pressed = pressed;
+        if(!input_queue_push(&p_ctx->input, &event))
+        {
+            fprintf(stderr, "Input queue full, dropped key event.\n");
+        }
+    }
+}
+
+// Start a timeline file with the render thread's part, see dump_timeline()
+static void start_timeline_dump(emu_context_t *p_ctx)
+{
+    FILE *p_fp = NULL;
+
+    // The last one is still being finished
+    if(SDL_AtomicGet(&p_ctx->dump_timeline))
+    {
+        return;
+    }
+    p_fp = fopen(TIMELINE_FILE, "w");
+    if(NULL == p_fp || !timeline_write_begin(p_fp) || !timeline_write(&p_ctx->render_timeline, p_fp))
+    {
+        fprintf(stderr, "Failed to write frame timeline %s.\n", TIMELINE_FILE);
+        if(NULL != p_fp)
+        {
+            fclose(p_fp);
+        }
+        return;
+    }
+    p_ctx->p_timeline_fp = p_fp;
+    SDL_AtomicSet(&p_ctx->dump_timeline, 1);
+}
+
+static void usage(const char *p_name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <rom>\n"
+            "  --sync=ticks|audio   pace frames from the system timer or the sound card\n"
+            "  --unlimited          run as fast as possible, without sound\n"
+            "  --cycles=N           instructions per frame, 1 to %d\n"
+            "                       (default from the ROM database, else %d)\n"
+            "  --keymap=FILE        load key bindings\n"
+            "  --record=FILE        record an input movie\n"
+            "  --play=FILE          play an input movie back\n"
+            "  --xochip             64KB memory and XO-CHIP quirks, whatever the ROM looks like\n"
+            "  --debug              stop before the first instruction\n"
+            "  --break=ADDR         stop at ADDR, up to %d of them\n"
+            "  --metrics=FILE       keep Prometheus metrics in FILE, rewritten every second\n"
+            "Hold Tab for turbo.\n"
+            "F5 stops or continues, F8 toggles a breakpoint at pc, F10 steps over and F11 steps.\n"
+            "With --debug or --break, F7 steps back and F6 continues back.\n"
+            "F12 writes the last minute or so of frame timings to " TIMELINE_FILE ",\n"
+            "for chrome://tracing or Perfetto.\n"
+            "F1 shows instructions per second in white, timer Hz in cyan, the percentage\n"
+            "of frames that drew nothing in yellow and a graph of frame times.\n",
+            p_name, CYCLES_PER_FRAME_MAX, CYCLES_PER_FRAME, MAX_BREAKPOINTS);
 }
 
 int main(int argc, char *argv[]){
 
-    (void)argc;
+    static emu_context_t ctx;
+    static uint32_t hud_pixels[HUD_W * HUD_H]; // render thread only
+    bool hud_toggled = false;
+    char *p_rom = NULL;
+    const char *p_keymap = NULL;
+    const char *p_movie = NULL;
+    bool xochip = false;
+    bool debug = false;
+    uint16_t breakpoints[MAX_BREAKPOINTS];
+    int breakpoint_count = 0;
+    rom_cache_t roms;
+    const rom_image_t *p_image = NULL;
+    char *p_end = NULL;
+
+    ctx.sync_mode = SYNC_TICKS;
+    for(int i = 1; i < argc; i++)
+    {
+        if(0 == strcmp(argv[i], "--sync=audio"))
+        {
+            ctx.sync_mode = SYNC_AUDIO;
+        }
+        else if(0 == strcmp(argv[i], "--sync=ticks"))
+        {
+            ctx.sync_mode = SYNC_TICKS;
+        }
+        else if(0 == strcmp(argv[i], "--unlimited"))
+        {
+            ctx.sync_mode = SYNC_UNLIMITED;
+        }
+        else if(0 == strncmp(argv[i], "--cycles=", strlen("--cycles=")))
+        {
+            unsigned long cycles = strtoul(argv[i] + strlen("--cycles="), &p_end, 10);
+            if('\0' != *p_end || cycles < 1 || cycles > CYCLES_PER_FRAME_MAX)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            ctx.cycles_per_frame = (uint32_t)cycles;
+        }
+        else if(0 == strcmp(argv[i], "--xochip"))
+        {
+            xochip = true;
+        }
+        else if(0 == strcmp(argv[i], "--debug"))
+        {
+            debug = true;
+        }
+        else if(0 == strncmp(argv[i], "--break=", strlen("--break=")))
+        {
+            unsigned long address = strtoul(argv[i] + strlen("--break="), &p_end, 0);
+            if('\0' != *p_end || address > 0xFFFF || breakpoint_count >= MAX_BREAKPOINTS)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            breakpoints[breakpoint_count++] = (uint16_t)address;
+        }
+        else if(0 == strncmp(argv[i], "--keymap=", strlen("--keymap=")))
+        {
+            p_keymap = argv[i] + strlen("--keymap=");
+        }
+        else if(0 == strncmp(argv[i], "--record=", strlen("--record=")))
+        {
+            ctx.movie_mode = MOVIE_RECORD;
+            p_movie = argv[i] + strlen("--record=");
+        }
+        else if(0 == strncmp(argv[i], "--metrics=", strlen("--metrics=")))
+        {
+            ctx.p_metrics_file = argv[i] + strlen("--metrics=");
+        }
+        else if(0 == strncmp(argv[i], "--play=", strlen("--play=")))
+        {
+            ctx.movie_mode = MOVIE_PLAY;
+            p_movie = argv[i] + strlen("--play=");
+        }
+        else if('-' == argv[i][0])
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            p_rom = argv[i];
+        }
+    }
 
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         fprintf(stderr, "SDL_Init Error: %s\n", SDL_GetError());
@@ -71,79 +801,288 @@ int main(int argc, char *argv[]){
         return EXIT_FAILURE;
     }
 
-    SDL_Texture *tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_W, DISPLAY_H);
+    SDL_Texture *tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_W, DISPLAY_H);
+    // Drawn over the picture, see through where the HUD leaves its background
+    SDL_Texture *hud_tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, HUD_W, HUD_H);
+    SDL_SetTextureBlendMode(hud_tex, SDL_BLENDMODE_BLEND);
 
     SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
 
-	int videoPitch = sizeof(uint32_t) * DISPLAY_W;
 
-	chip8_t *p_cpu = cpu_init();
+    // The ROM database, or a look at the program, picks the platform and speed
+    rom_cache_init(&roms);
+    p_image = rom_cache_acquire_file(&roms, p_rom);
+    if(NULL == p_image)
+    {
+        printf("Failed to load program.");
+        ctx.p_cpu = xochip ? cpu_init_memory(XOCHIP_MEMORY_SIZE) : cpu_init();
+    }
+    else if(xochip)
+    {
+        ctx.p_cpu = cpu_init_memory(XOCHIP_MEMORY_SIZE);
+        if(NULL != ctx.p_cpu)
+        {
+            cpu_load_program_mem(ctx.p_cpu, p_image->data, p_image->size);
+        }
+    }
+    else
+    {
+        ctx.p_cpu = rom_image_new_cpu(p_image);
+    }
+    if(0 == ctx.cycles_per_frame)
+    {
+        ctx.cycles_per_frame = (NULL != p_image && 0 != p_image->tickrate) ? p_image->tickrate : CYCLES_PER_FRAME;
+    }
+    if(NULL == ctx.p_cpu || !triple_buffer_init(&ctx.frames, sizeof(video_frame_t)) ||
+       !triple_buffer_init(&ctx.hud, sizeof(hud_stats_t)))
+    {
+        fprintf(stderr, "Failed to allocate emulator state.\n");
+        cpu_free(ctx.p_cpu);
+        rom_cache_free(&roms);
+        triple_buffer_destroy(&ctx.frames);
+        SDL_DestroyTexture(hud_tex);
+        SDL_DestroyTexture(tex);
+        SDL_DestroyRenderer(ren);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+    input_queue_init(&ctx.input);
+    input_map_init_default(&ctx.input_map);
+    if(NULL != p_keymap && !input_map_load(&ctx.input_map, p_keymap))
+    {
+        fprintf(stderr, "Failed to read keymap %s, using the default layout.\n", p_keymap);
+    }
+    else if(NULL == p_keymap && NULL != p_image)
+    {
+        input_map_bind_keys(&ctx.input_map, p_image->keys);
+    }
+    rom_cache_free(&roms);
+    if(!audio_output_open(&ctx.audio))
+    {
+        fprintf(stderr, "Continuing without sound.\n");
+        if(SYNC_AUDIO == ctx.sync_mode)
+        {
+            fprintf(stderr, "No audio clock to sync to, falling back to --sync=ticks.\n");
+            ctx.sync_mode = SYNC_TICKS;
+        }
+    }
+    beeper_init(&ctx.beeper, ctx.audio.sample_rate);
+
+    if(xochip)
+    {
+        cpu_set_quirks(ctx.p_cpu, QUIRKS_XOCHIP);
+    }
+    // Always attached, it costs nothing until a breakpoint is set or F5 pressed
+    debug_init(&ctx.debug);
+    for(int i = 0; i < breakpoint_count; i++)
+    {
+        debug_set_breakpoint(&ctx.debug, breakpoints[i], true);
+    }
+    if(debug)
+    {
+        debug_pause(&ctx.debug);
+    }
+    cpu_attach_debug(ctx.p_cpu, &ctx.debug);
+
+#ifdef EMUEIGHT_PROFILE
+    profile_init(&ctx.profile, cpu_memory_size(ctx.p_cpu));
+    cpu_attach_profile(ctx.p_cpu, &ctx.profile);
+#endif
+
+    if(MOVIE_RECORD == ctx.movie_mode)
+    {
+        movie_record_begin(&ctx.movie, ctx.p_cpu, ctx.cycles_per_frame);
+    }
+    else if(MOVIE_PLAY == ctx.movie_mode)
+    {
+        if(movie_load(&ctx.movie, p_movie))
+        {
+            movie_play_begin(&ctx.movie, ctx.p_cpu);
+            ctx.cycles_per_frame = ctx.movie.cycles_per_frame;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to load movie %s.\n", p_movie);
+            ctx.movie_mode = MOVIE_OFF;
+        }
+    }
 
-	
+    // Debugging from the start keeps a history to go back through
+    if((debug || 0 != breakpoint_count) && history_begin(&ctx.history, ctx.p_cpu, ctx.cycles_per_frame, 0))
+    {
+        ctx.p_history = &ctx.history;
+    }
 
-	if(!cpu_load_program(p_cpu, argv[1])) 
-	{
-		printf("Failed to load program.");
-	}
+    metrics_init(&ctx.metrics);
+    // Always recording, F12 writes the timelines out
+    if(!timeline_init(&ctx.render_timeline, 0, timeline_clock, "render", 1) ||
+       !timeline_init(&ctx.emu_timeline, 0, timeline_clock, "emulation", 2))
+    {
+        fprintf(stderr, "Continuing without a frame timeline.\n");
+    }
 
-	uint64_t last_cycle_time = SDL_GetTicks64();
-	uint64_t last_display_time = SDL_GetTicks64();
+    SDL_AtomicSet(&ctx.running, 1);
+    SDL_Thread *p_emu_thread = SDL_CreateThread(emulation_thread, "emulation", &ctx);
+    if(NULL == p_emu_thread)
+    {
+        fprintf(stderr, "SDL_CreateThread Error: %s\n", SDL_GetError());
+        SDL_AtomicSet(&ctx.running, 0);
+    }
 
-    // Keep the main loop until the window is closed (SDL_QUIT event)
-    bool exit = false;
+    // The main thread only polls events and presents; presentation stalls
+    // can no longer hold up the emulation thread.
     SDL_Event eventData;
-    while (!exit)
-    {
-		uint64_t current_time = SDL_GetTicks64();
-		int8_t index = 0;
-		if(current_time - last_cycle_time >= 2)
-		{
-			cpu_cycle(p_cpu);
-			cpu_cycle(p_cpu);
-			last_cycle_time = SDL_GetTicks();
-		}
-		if(current_time - last_display_time > 17)
-		{
-			if(p_cpu->delayTimer > 0)
-			{
-				p_cpu->delayTimer--;
-			}
-			if(p_cpu->soundTimer > 0)
-			{
-				p_cpu->soundTimer--;
-			}
-			update_display(tex, ren, p_cpu->vram, videoPitch);
-			p_cpu->display_wait = false;
-			last_display_time = SDL_GetTicks64();
-		}
+    while (SDL_AtomicGet(&ctx.running))
+    {
+        const void *p_frame = NULL;
+        const void *p_hud_stats = NULL;
+        bool fresh_frame = false;
+        bool fresh_hud = false;
+
+        timeline_begin(&ctx.render_timeline, "events");
         while (SDL_PollEvent(&eventData))
         {
             switch (eventData.type)
             {
 				case SDL_QUIT:
-					exit = true;
+					SDL_AtomicSet(&ctx.running, 0);
 					break;
 				case SDL_KEYDOWN:
-            		index = get_index_from_scancode(eventData.key.keysym.scancode);
-            		if (index != -1) 
+					if(!eventData.key.repeat)
+					{
+						queue_key(&ctx, input_map_scancode(&ctx.input_map, eventData.key.keysym.scancode), true);
+					}
+					if(TURBO_SCANCODE == eventData.key.keysym.scancode)
 					{
-                		p_cpu->keypad_register |= 1 << index;
+						SDL_AtomicSet(&ctx.turbo, 1);
 					}
+					if(!eventData.key.repeat)
+					{
+						switch(eventData.key.keysym.scancode)
+						{
+							case PAUSE_SCANCODE:
+								SDL_AtomicSet(&ctx.debug_command, DEBUG_COMMAND_PAUSE);
+								break;
+							case BREAKPOINT_SCANCODE:
+								SDL_AtomicSet(&ctx.debug_command, DEBUG_COMMAND_BREAKPOINT);
+								break;
+							case STEP_OVER_SCANCODE:
+								SDL_AtomicSet(&ctx.debug_command, DEBUG_COMMAND_STEP_OVER);
+								break;
+							case STEP_SCANCODE:
+								SDL_AtomicSet(&ctx.debug_command, DEBUG_COMMAND_STEP);
+								break;
+							case STEP_BACK_SCANCODE:
+								SDL_AtomicSet(&ctx.debug_command, DEBUG_COMMAND_STEP_BACK);
+								break;
+							case CONTINUE_BACK_SCANCODE:
+								SDL_AtomicSet(&ctx.debug_command, DEBUG_COMMAND_CONTINUE_BACK);
+								break;
+							case TIMELINE_SCANCODE:
+								start_timeline_dump(&ctx);
+								break;
+							case HUD_SCANCODE:
+								SDL_AtomicSet(&ctx.show_hud, !SDL_AtomicGet(&ctx.show_hud));
+								hud_toggled = true;
+								break;
+							default:
+								break;
+						}
+					}
+#ifdef EMUEIGHT_PROFILE
+					if(PROFILE_SCANCODE == eventData.key.keysym.scancode && !eventData.key.repeat)
+					{
+						SDL_AtomicSet(&ctx.dump_profile, 1);
+					}
+#endif
 					break;
 				case SDL_KEYUP:
-					index = get_index_from_scancode(eventData.key.keysym.scancode);
-            		if (index != -1) 
+					queue_key(&ctx, input_map_scancode(&ctx.input_map, eventData.key.keysym.scancode), false);
+					if(TURBO_SCANCODE == eventData.key.keysym.scancode)
 					{
-                		p_cpu->keypad_register &= ~(1 << index);
+						SDL_AtomicSet(&ctx.turbo, 0);
 					}
 					break;
+				case SDL_CONTROLLERBUTTONDOWN:
+					queue_key(&ctx, input_map_button(&ctx.input_map, eventData.cbutton.button), true);
+					break;
+				case SDL_CONTROLLERBUTTONUP:
+					queue_key(&ctx, input_map_button(&ctx.input_map, eventData.cbutton.button), false);
+					break;
+				case SDL_CONTROLLERDEVICEADDED:
+					input_map_add_controller(&ctx.input_map, eventData.cdevice.which);
+					break;
+				case SDL_CONTROLLERDEVICEREMOVED:
+					input_map_remove_controller(&ctx.input_map, eventData.cdevice.which);
+					break;
             }
         }
+        timeline_end(&ctx.render_timeline);
+
+        fresh_frame = triple_buffer_acquire(&ctx.frames, &p_frame);
+        // Hidden, the HUD costs the render thread nothing but the flag
+        if(SDL_AtomicGet(&ctx.show_hud) && triple_buffer_acquire(&ctx.hud, &p_hud_stats))
+        {
+            timeline_begin(&ctx.render_timeline, "hud");
+            hud_render(p_hud_stats, hud_pixels);
+            SDL_UpdateTexture(hud_tex, NULL, hud_pixels, sizeof(uint32_t) * HUD_W);
+            timeline_end(&ctx.render_timeline);
+            fresh_hud = true;
+        }
+
+        if(fresh_frame || fresh_hud || hud_toggled)
+        {
+            update_display(tex, ren, p_frame, fresh_frame, SDL_AtomicGet(&ctx.show_hud) ? hud_tex : NULL,
+                           &ctx.render_timeline);
+            hud_toggled = false;
+        }
+        else
+        {
+            SDL_Delay(1);
+        }
+    }
+
+    if(NULL != p_emu_thread)
+    {
+        SDL_WaitThread(p_emu_thread, NULL);
+    }
+    // Finish a timeline the emulation thread stopped before getting to
+    dump_timeline(&ctx);
+    if(NULL != ctx.p_metrics_file)
+    {
+        ctx.metrics.audio_underruns = (uint64_t)SDL_AtomicGet(&ctx.audio.underruns);
+        metrics_rate(&ctx.metrics, timeline_clock());
+        if(!metrics_save(&ctx.metrics, ctx.p_metrics_file))
+        {
+            fprintf(stderr, "Failed to save metrics %s.\n", ctx.p_metrics_file);
+        }
+    }
+    timeline_free(&ctx.render_timeline);
+    timeline_free(&ctx.emu_timeline);
+
+    if(MOVIE_RECORD == ctx.movie_mode)
+    {
+        movie_record_end(&ctx.movie, ctx.p_cpu);
+        if(!movie_save(&ctx.movie, p_movie))
+        {
+            fprintf(stderr, "Failed to save movie %s.\n", p_movie);
+        }
+    }
+    movie_free(&ctx.movie);
+    if(NULL != ctx.p_history)
+    {
+        history_free(ctx.p_history);
     }
 
-	free(p_cpu);
-	p_cpu = NULL;
-    // Free the texture
+    input_map_close_controllers(&ctx.input_map);
+    audio_output_close(&ctx.audio);
+	cpu_free(ctx.p_cpu);
+	ctx.p_cpu = NULL;
+    triple_buffer_destroy(&ctx.frames);
+    triple_buffer_destroy(&ctx.hud);
+    // Free the textures
+    SDL_DestroyTexture(hud_tex);
     SDL_DestroyTexture(tex);
 
     // Destroy the render, window and finalise SDL
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "triple_buffer.h"
+
+#define TRIPLE_BUFFER_FRESH 0x4
+#define TRIPLE_BUFFER_INDEX_MASK 0x3
+
+bool triple_buffer_init(triple_buffer_t *p_tb, size_t slot_size)
+{
+    if(NULL == p_tb || 0 == slot_size)
+    {
+        return false;
+    }
+
+    memset(p_tb, 0, sizeof(*p_tb));
+
+    for(int i = 0; i < TRIPLE_BUFFER_SLOTS; i++)
+    {
+        p_tb->p_slots[i] = calloc(1, slot_size);
+        if(NULL == p_tb->p_slots[i])
+        {
+            triple_buffer_destroy(p_tb);
+            return false;
+        }
+    }
+
+    p_tb->slot_size = slot_size;
+    p_tb->write_index = 0;
+    p_tb->read_index = 1;
+    SDL_AtomicSet(&p_tb->middle, 2);
+
+    return true;
+}
+
+void triple_buffer_destroy(triple_buffer_t *p_tb)
+{
+    if(NULL == p_tb)
+    {
+        return;
+    }
+
+    for(int i = 0; i < TRIPLE_BUFFER_SLOTS; i++)
+    {
+        free(p_tb->p_slots[i]);
+        p_tb->p_slots[i] = NULL;
+    }
+}
+
+void *triple_buffer_write_slot(triple_buffer_t *p_tb)
+{
+    return p_tb->p_slots[p_tb->write_index];
+}
+
+void triple_buffer_publish(triple_buffer_t *p_tb)
+{
+    // SDL_AtomicSet is a full barrier, so the slot contents are visible
+    // before the consumer can pick up the new index.
+    int previous = SDL_AtomicSet(&p_tb->middle, p_tb->write_index | TRIPLE_BUFFER_FRESH);
+    p_tb->write_index = previous & TRIPLE_BUFFER_INDEX_MASK;
+}
+
+bool triple_buffer_acquire(triple_buffer_t *p_tb, const void **pp_slot)
+{
+    bool fresh = false;
+
+    if(SDL_AtomicGet(&p_tb->middle) & TRIPLE_BUFFER_FRESH)
+    {
+        int previous = SDL_AtomicSet(&p_tb->middle, p_tb->read_index);
+        p_tb->read_index = previous & TRIPLE_BUFFER_INDEX_MASK;
+        fresh = true;
+    }
+
+    *pp_slot = p_tb->p_slots[p_tb->read_index];
+    return fresh;
+}
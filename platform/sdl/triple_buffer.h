@@ -0,0 +1,39 @@
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <SDL2/SDL.h>
+
+#define TRIPLE_BUFFER_SLOTS 3
+
+/*
+ * Lock-free single-producer/single-consumer triple buffer.
+ *
+ * The producer always owns one slot to write into, the consumer always owns
+ * one slot to read from, and the third slot sits in the middle. Publishing
+ * and acquiring are a single atomic exchange with the middle slot, so
+ * neither side ever waits for the other.
+ */
+typedef struct triple_buffer
+{
+    void *p_slots[TRIPLE_BUFFER_SLOTS];
+    size_t slot_size;
+    SDL_atomic_t middle; // index of the middle slot, TRIPLE_BUFFER_FRESH set when unread
+    int write_index; // owned by the producer
+    int read_index; // owned by the consumer
+} triple_buffer_t;
+
+bool triple_buffer_init(triple_buffer_t *p_tb, size_t slot_size);
+void triple_buffer_destroy(triple_buffer_t *p_tb);
+
+// Producer side
+void *triple_buffer_write_slot(triple_buffer_t *p_tb);
+void triple_buffer_publish(triple_buffer_t *p_tb);
+
+// Consumer side. Returns true and the newest slot when a frame was published
+// since the last acquire, false (and the previous slot) otherwise.
+bool triple_buffer_acquire(triple_buffer_t *p_tb, const void **pp_slot);
+
+#endif // TRIPLE_BUFFER_H_
@@ -0,0 +1,283 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+#include "trace.h"
+
+#define LINE_SIZE 160
+
+typedef struct options
+{
+    const char *p_trace;
+    const char *p_other; // --diff against this
+    const char *p_match;
+    uint32_t pc_low;
+    uint32_t pc_high;
+    uint32_t limit;
+} options_t;
+
+static void usage(const char *p_name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <trace>\n"
+            "       %s --diff <trace> <trace>\n"
+            "  --pc=ADDR[-ADDR]  only instructions at ADDR, or between the two\n"
+            "  --match=TEXT      only instructions whose line contains TEXT\n"
+            "  --limit=N         stop after N lines\n"
+            "  --diff            show where two traces of the same ROM first differ\n",
+            p_name, p_name);
+}
+
+static bool parse_pc(const char *p_value, options_t *p_opts)
+{
+    char *p_end = NULL;
+    unsigned long low = strtoul(p_value, &p_end, 0);
+    unsigned long high = low;
+
+    if(p_end == p_value)
+    {
+        return false;
+    }
+    if('-' == *p_end)
+    {
+        p_value = p_end + 1;
+        high = strtoul(p_value, &p_end, 0);
+        if(p_end == p_value)
+        {
+            return false;
+        }
+    }
+    if('\0' != *p_end || low > high || high > UINT16_MAX)
+    {
+        return false;
+    }
+    p_opts->pc_low = (uint32_t)low;
+    p_opts->pc_high = (uint32_t)high;
+
+    return true;
+}
+
+static bool parse_options(int argc, char *argv[], options_t *p_opts)
+{
+    bool diff = false;
+
+    memset(p_opts, 0, sizeof(*p_opts));
+    p_opts->pc_high = UINT16_MAX;
+
+    for(int i = 1; i < argc; i++)
+    {
+        const char *p_arg = argv[i];
+
+        if(0 == strcmp(p_arg, "--diff"))
+        {
+            diff = true;
+        }
+        else if(0 == strncmp(p_arg, "--pc=", 5))
+        {
+            if(!parse_pc(p_arg + 5, p_opts))
+            {
+                return false;
+            }
+        }
+        else if(0 == strncmp(p_arg, "--match=", 8))
+        {
+            p_opts->p_match = p_arg + 8;
+        }
+        else if(0 == strncmp(p_arg, "--limit=", 8))
+        {
+            p_opts->limit = (uint32_t)strtoul(p_arg + 8, NULL, 0);
+        }
+        else if('-' == p_arg[0])
+        {
+            return false;
+        }
+        else if(NULL == p_opts->p_trace)
+        {
+            p_opts->p_trace = p_arg;
+        }
+        else if(diff && NULL == p_opts->p_other)
+        {
+            p_opts->p_other = p_arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return NULL != p_opts->p_trace && diff == (NULL != p_opts->p_other);
+}
+
+// "seq pc opcode mnemonic" then whatever the instruction changed
+static void format_record(char *p_line, size_t size, const trace_record_t *p_record)
+{
+    char mnemonic[32];
+    size_t length = 0;
+
+    // The long load's operand isn't in the record, but it ends up in I
+    disasm_format(mnemonic, sizeof(mnemonic), p_record->opcode, p_record->index);
+    length = (size_t)snprintf(p_line, size, "%10" PRIu32 "  %04X  %04X  %-20s", p_record->sequence,
+                              p_record->pc, p_record->opcode, mnemonic);
+
+    for(unsigned i = 0; i < NUM_REGISTERS && length < size; i++)
+    {
+        if(0 != (p_record->changed & (1u << i)))
+        {
+            length += (size_t)snprintf(p_line + length, size - length, " V%X=%02X", i, p_record->V[i]);
+        }
+    }
+    if(0 != (p_record->flags & TRACE_CHANGED_INDEX) && length < size)
+    {
+        length += (size_t)snprintf(p_line + length, size - length, " I=%04X", p_record->index);
+    }
+    if(0 != (p_record->flags & TRACE_CHANGED_SP) && length < size)
+    {
+        length += (size_t)snprintf(p_line + length, size - length, " SP=%u", p_record->sp);
+    }
+    if(0 != (p_record->flags & TRACE_CHANGED_DT) && length < size)
+    {
+        length += (size_t)snprintf(p_line + length, size - length, " DT=%02X", p_record->delay_timer);
+    }
+    if(0 != (p_record->flags & TRACE_CHANGED_ST) && length < size)
+    {
+        snprintf(p_line + length, size - length, " ST=%02X", p_record->sound_timer);
+    }
+
+    // No padding after a mnemonic when nothing changed
+    length = strlen(p_line);
+    while(0 != length && ' ' == p_line[length - 1])
+    {
+        p_line[--length] = '\0';
+    }
+}
+
+static int decode(const options_t *p_opts)
+{
+    trace_reader_t reader;
+    trace_record_t record;
+    char line[LINE_SIZE];
+    uint32_t expected = 0;
+    uint32_t lines = 0;
+
+    if(!trace_reader_open(&reader, p_opts->p_trace))
+    {
+        fprintf(stderr, "Failed to open trace %s.\n", p_opts->p_trace);
+        return EXIT_FAILURE;
+    }
+
+    while(trace_reader_next(&reader, &record))
+    {
+        // The ring buffer filled up before it was written out
+        if(record.sequence != expected)
+        {
+            printf("-- %" PRIu32 " instructions lost --\n", record.sequence - expected);
+        }
+        expected = record.sequence + 1;
+
+        if(record.pc < p_opts->pc_low || record.pc > p_opts->pc_high)
+        {
+            continue;
+        }
+        format_record(line, sizeof(line), &record);
+        if(NULL != p_opts->p_match && NULL == strstr(line, p_opts->p_match))
+        {
+            continue;
+        }
+        puts(line);
+        if(++lines == p_opts->limit)
+        {
+            break;
+        }
+    }
+    trace_reader_close(&reader);
+
+    return EXIT_SUCCESS;
+}
+
+static bool same(const trace_record_t *p_a, const trace_record_t *p_b)
+{
+    return p_a->pc == p_b->pc && p_a->opcode == p_b->opcode && p_a->index == p_b->index &&
+           p_a->sp == p_b->sp && p_a->delay_timer == p_b->delay_timer &&
+           p_a->sound_timer == p_b->sound_timer && 0 == memcmp(p_a->V, p_b->V, NUM_REGISTERS);
+}
+
+// Compare instruction by instruction, sequence numbers aside, and stop at the first difference
+static int diff(const options_t *p_opts)
+{
+    trace_reader_t a;
+    trace_reader_t b;
+    trace_record_t record_a;
+    trace_record_t record_b;
+    char line[LINE_SIZE];
+    uint64_t count = 0;
+    int status = EXIT_SUCCESS;
+
+    if(!trace_reader_open(&a, p_opts->p_trace))
+    {
+        fprintf(stderr, "Failed to open trace %s.\n", p_opts->p_trace);
+        return EXIT_FAILURE;
+    }
+    if(!trace_reader_open(&b, p_opts->p_other))
+    {
+        fprintf(stderr, "Failed to open trace %s.\n", p_opts->p_other);
+        trace_reader_close(&a);
+        return EXIT_FAILURE;
+    }
+
+    for(;; count++)
+    {
+        bool more_a = trace_reader_next(&a, &record_a);
+        bool more_b = trace_reader_next(&b, &record_b);
+
+        if(!more_a && !more_b)
+        {
+            printf("same: %" PRIu64 " instructions\n", count);
+            break;
+        }
+        if(more_a && more_b && same(&record_a, &record_b))
+        {
+            continue;
+        }
+
+        printf("differ at instruction %" PRIu64 "\n", count);
+        if(more_a)
+        {
+            format_record(line, sizeof(line), &record_a);
+            printf("< %s\n", line);
+        }
+        else
+        {
+            printf("< end of trace\n");
+        }
+        if(more_b)
+        {
+            format_record(line, sizeof(line), &record_b);
+            printf("> %s\n", line);
+        }
+        else
+        {
+            printf("> end of trace\n");
+        }
+        status = EXIT_FAILURE;
+        break;
+    }
+    trace_reader_close(&a);
+    trace_reader_close(&b);
+
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    options_t opts;
+
+    if(!parse_options(argc, argv, &opts))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return (NULL != opts.p_other) ? diff(&opts) : decode(&opts);
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+
+#include "beeper.h"
+
+// Polynomial band-limited step, smooths the square wave's discontinuities
+// so the beeper doesn't alias at common sample rates.
+static float poly_blep(float t, float dt)
+{
+    if(t < dt)
+    {
+        t /= dt;
+        return t + t - t * t - 1.0f;
+    }
+    if(t > 1.0f - dt)
+    {
+        t = (t - 1.0f) / dt;
+        return t * t + t + t + 1.0f;
+    }
+    return 0.0f;
+}
+
+#define PATTERN_BITS (AUDIO_PATTERN_SIZE * 8)
+
+// 2^(i/48), one octave of XO-CHIP pitch steps
+static const float pitch_steps[48] =
+{
+    1.000000000f, 1.014545335f, 1.029302237f, 1.044273782f, 1.059463094f, 1.074873340f,
+    1.090507733f, 1.106369533f, 1.122462048f, 1.138788635f, 1.155352697f, 1.172157689f,
+    1.189207115f, 1.206504531f, 1.224053543f, 1.241857812f, 1.259921050f, 1.278247024f,
+    1.296839555f, 1.315702520f, 1.334839854f, 1.354255547f, 1.373953647f, 1.393938263f,
+    1.414213562f, 1.434783772f, 1.455653183f, 1.476826146f, 1.498307077f, 1.520100455f,
+    1.542210825f, 1.564642798f, 1.587401052f, 1.610490332f, 1.633915453f, 1.657681301f,
+    1.681792831f, 1.706255071f, 1.731073122f, 1.756252160f, 1.781797436f, 1.807714277f,
+    1.834008086f, 1.860684348f, 1.887748625f, 1.915206561f, 1.943063882f, 1.971326397f
+};
+
+// Pattern bits per second, 4000 * 2^((pitch - 64) / 48) without needing libm
+static float pattern_rate(uint8_t pitch)
+{
+    // Offset by two octaves so the exponent is never negative
+    unsigned steps = (unsigned)pitch + 32;
+    return 1000.0f * (float)(1u << (steps / 48)) * pitch_steps[steps % 48];
+}
+
+void beeper_init(beeper_t *p_beeper, uint32_t sample_rate)
+{
+    memset(p_beeper, 0, sizeof(*p_beeper));
+    p_beeper->sample_rate = sample_rate;
+    p_beeper->phase_step = BEEPER_FREQUENCY / (float)sample_rate;
+}
+
+void beeper_render_frame(beeper_t *p_beeper, const chip8_t *p_cpu, int16_t *p_out, size_t samples)
+{
+    size_t edge_samples[SOUND_EDGES_MAX];
+    uint8_t edge_count = p_cpu->sound_edge_count;
+    uint8_t edge = 0;
+    bool gate = p_cpu->sound_gate;
+    const float dt = p_beeper->phase_step;
+    const float ramp_step = 1.0f / BEEPER_RAMP_SAMPLES;
+    const bool pattern = p_cpu->audio_pattern_active;
+    const float pattern_step = pattern_rate(p_cpu->pitch) / (float)p_beeper->sample_rate;
+
+    if(!gate && 0 == edge_count && p_beeper->level <= 0.0f)
+    {
+        // Silent frame, nothing to synthesize
+        memset(p_out, 0, samples * sizeof(*p_out));
+        p_beeper->phase = 0.0f;
+        p_beeper->pattern_position = 0.0f;
+        return;
+    }
+
+    // Map the cycle of each gate toggle onto the frame's samples
+    for(uint8_t i = 0; i < edge_count; i++)
+    {
+        edge_samples[i] = 0;
+        if(0 != p_cpu->frame_cycle)
+        {
+            edge_samples[i] = (size_t)((uint64_t)p_cpu->sound_edges[i] * samples / p_cpu->frame_cycle);
+        }
+    }
+
+    for(size_t i = 0; i < samples; i++)
+    {
+        while(edge < edge_count && edge_samples[edge] <= i)
+        {
+            gate = !gate;
+            edge++;
+        }
+
+        if(gate && p_beeper->level < 1.0f)
+        {
+            p_beeper->level += ramp_step;
+            if(p_beeper->level > 1.0f)
+            {
+                p_beeper->level = 1.0f;
+            }
+        }
+        else if(!gate && p_beeper->level > 0.0f)
+        {
+            p_beeper->level -= ramp_step;
+        }
+
+        if(p_beeper->level <= 0.0f)
+        {
+            // Restart the oscillator so every beep begins on the same phase
+            p_beeper->level = 0.0f;
+            p_beeper->phase = 0.0f;
+            p_beeper->pattern_position = 0.0f;
+            p_out[i] = 0;
+            continue;
+        }
+
+        if(pattern)
+        {
+            unsigned bit = (unsigned)p_beeper->pattern_position;
+            float value = (p_cpu->audio_pattern[bit >> 3] & (0x80 >> (bit & 7))) ? 1.0f : -1.0f;
+
+            p_out[i] = (int16_t)(value * p_beeper->level * BEEPER_AMPLITUDE);
+
+            p_beeper->pattern_position += pattern_step;
+            while(p_beeper->pattern_position >= (float)PATTERN_BITS)
+            {
+                p_beeper->pattern_position -= (float)PATTERN_BITS;
+            }
+            continue;
+        }
+
+        float t = p_beeper->phase;
+        float value = t < 0.5f ? 1.0f : -1.0f;
+        float half = t + 0.5f;
+        if(half >= 1.0f)
+        {
+            half -= 1.0f;
+        }
+        value += poly_blep(t, dt);
+        value -= poly_blep(half, dt);
+
+        p_out[i] = (int16_t)(value * p_beeper->level * BEEPER_AMPLITUDE);
+
+        p_beeper->phase += dt;
+        if(p_beeper->phase >= 1.0f)
+        {
+            p_beeper->phase -= 1.0f;
+        }
+    }
+}
@@ -1,12 +1,22 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdio.h>
 #include <string.h>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
 #include "cpu.h"
+#include "debug.h"
+#include "trace.h"
+#include "file_map.h"
 
-static uint8_t font_sprites[FONT_SPRITES_SIZE] =
+const uint8_t cpu_font_sprites[FONT_SPRITES_SIZE] =
 {
 	0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
 	0x20, 0x60, 0x20, 0x20, 0x70, // 1
@@ -26,6 +36,35 @@ static uint8_t font_sprites[FONT_SPRITES_SIZE] =
 	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+// SUPER-CHIP 8x10 digits, A-F as extended by Octo
+static uint8_t big_font_sprites[BIG_FONT_SPRITES_SIZE] =
+{
+	0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+	0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+	0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+	0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+	0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+	0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+	0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+	0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+const uint32_t cpu_default_palette[DISPLAY_COLORS] =
+{
+    0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555,
+    0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFF00,
+    0xFF880000, 0xFF008800, 0xFF000088, 0xFF888800,
+    0xFFFF00FF, 0xFF00FFFF, 0xFF880088, 0xFF008888
+};
+
 opcode_t cpu_decode_opcode(uint16_t opcode)
 {
     opcode_t decoded_opcode;
@@ -44,10 +83,34 @@ opcode_t cpu_decode_opcode(uint16_t opcode)
  * @return chip8_t*
  */
 chip8_t *cpu_init(void)
+{
+    return cpu_init_memory(MEMORY_SIZE);
+}
+
+chip8_t *cpu_init_memory(uint32_t memory_size)
 {
     chip8_t *p_cpu = NULL;
+#if !defined(_WIN32)
+    void *p_block = NULL;
+#endif
 
-    p_cpu = malloc(sizeof(*p_cpu));
+    // Power of two sizes only, so addresses can be masked later on
+    if(memory_size < MEMORY_SIZE || memory_size > XOCHIP_MEMORY_SIZE ||
+       0 != (memory_size & (memory_size - 1)))
+    {
+        return NULL;
+    }
+
+    // Line aligned, so the hot registers at the start share one cache line
+#if defined(_WIN32)
+    p_cpu = _aligned_malloc(cpu_state_size(memory_size), CPU_CACHE_LINE);
+#else
+    if(0 != posix_memalign(&p_block, CPU_CACHE_LINE, cpu_state_size(memory_size)))
+    {
+        p_block = NULL;
+    }
+    p_cpu = p_block;
+#endif
 
     if(NULL == p_cpu) 
     {
@@ -55,72 +118,107 @@ chip8_t *cpu_init(void)
         return NULL;
     }
 
-    srand((uint16_t)time(NULL));
-
-    if(!cpu_reset(p_cpu)) 
+    // cpu_reset() keeps these, a new cpu starts without them
+    p_cpu->memory_size = memory_size;
+    p_cpu->p_debug = NULL;
+    p_cpu->p_trace = NULL;
+#ifdef EMUEIGHT_PROFILE
+    p_cpu->p_profile = NULL;
+#endif
+    if(!cpu_reset(p_cpu))
     {
         // failed to reset cpu
-        free(p_cpu);
+        cpu_free(p_cpu);
         return NULL;
     }
 
-    // Caller is responsible for freeing.
+    cpu_seed_rng(p_cpu, (uint32_t)time(NULL));
+
+    // Caller is responsible for freeing, with cpu_free().
     return p_cpu;
 }
 
-bool cpu_load_program(chip8_t *p_cpu, char *p_filename)
+void cpu_free(chip8_t *p_cpu)
 {
-    FILE *pg_fp;
-    size_t pg_size = 0;
-    long ret_size = 0;
-
-    if(NULL == p_filename) 
-    {
-        return false;
-    }
+#if defined(_WIN32)
+    _aligned_free(p_cpu);
+#else
+    free(p_cpu);
+#endif
+}
 
-    pg_fp = fopen(p_filename, "rb");
+bool cpu_load_program(chip8_t *p_cpu, const char *p_filename)
+{
+    file_map_t rom;
+    bool loaded = false;
 
-    if(NULL == pg_fp) 
+    if(NULL == p_filename || !file_map_open(&rom, p_filename))
     {
         // failed to open file
         return false;
     }
 
-    // Get file size
-    fseek(pg_fp, 0, SEEK_END);
-    ret_size = ftell(pg_fp);
-    fseek(pg_fp, 0, SEEK_SET);
+    loaded = cpu_load_program_mem(p_cpu, rom.p_data, rom.size);
+    file_map_close(&rom);
+
+    return loaded;
+}
 
-    if(-1 != ret_size && ret_size >= PROGRAM_MEMORY_SIZE) 
+bool cpu_load_program_mem(chip8_t *p_cpu, const uint8_t *p_program, size_t size)
+{
+    if(NULL == p_cpu || (NULL == p_program && 0 != size))
     {
         return false;
     }
 
-    // Read file into memory
-    pg_size = fread(p_cpu->memory + START_ADDRESS, sizeof(p_cpu->memory[0]), (size_t)ret_size, pg_fp);
-    if(pg_size != (size_t)ret_size) 
+    // A program may fill every byte from START_ADDRESS to the end of memory
+    if(size > p_cpu->memory_size - START_ADDRESS)
     {
         return false;
     }
 
-    fclose(pg_fp);
+    if(0 != size)
+    {
+        memcpy(p_cpu->memory + START_ADDRESS, p_program, size);
+    }
 
     return true;
 }
 
 bool cpu_reset(chip8_t *p_cpu)
 {
+    uint32_t memory_size = 0;
+    debug_t *p_debug = NULL;
+    trace_t *p_trace = NULL;
+#ifdef EMUEIGHT_PROFILE
+    profile_t *p_profile = NULL;
+#endif
+
     if(NULL == p_cpu) 
     {
         return false;
     }
 
-    // clear the memory
+    // clear the memory, keeping hold of how much there is
+    memory_size = p_cpu->memory_size;
+    p_debug = p_cpu->p_debug;
+    p_trace = p_cpu->p_trace;
+#ifdef EMUEIGHT_PROFILE
+    // an attached profile keeps counting across resets
+    p_profile = p_cpu->p_profile;
+#endif
     memset(p_cpu, 0, sizeof(*p_cpu));
+    p_cpu->memory_size = memory_size;
+    p_cpu->p_debug = p_debug;
+    p_cpu->p_trace = p_trace;
+#ifdef EMUEIGHT_PROFILE
+    p_cpu->p_profile = p_profile;
+#endif
+    memset(p_cpu->memory, 0, memory_size);
 
     // load font sprites into memory at address 0x00
-    memcpy(p_cpu->memory, &font_sprites, FONT_SPRITES_SIZE);
+    memcpy(p_cpu->memory, cpu_font_sprites, FONT_SPRITES_SIZE);
+    memcpy(p_cpu->memory + BIG_FONT_ADDRESS, &big_font_sprites, BIG_FONT_SPRITES_SIZE);
     
     // set the program counter
     p_cpu->pc = START_ADDRESS;
@@ -128,35 +226,428 @@ bool cpu_reset(chip8_t *p_cpu)
     // set current key held to none
     p_cpu->key_held = 255;
 
+    p_cpu->planes = 0x1;
+    p_cpu->pitch = AUDIO_DEFAULT_PITCH;
+    p_cpu->display_dirty = true;
+
+    p_cpu->quirks = QUIRKS_CHIP8;
+    cpu_seed_rng(p_cpu, CPU_DEFAULT_SEED);
+
 
     return true;
 }
 
-void cpu_cycle(chip8_t *p_cpu)
+void cpu_seed_rng(chip8_t *p_cpu, uint32_t seed)
+{
+    // xorshift gets stuck on zero
+    p_cpu->rng_seed = (0 == seed) ? CPU_DEFAULT_SEED : seed;
+    p_cpu->rng_state = p_cpu->rng_seed;
+}
+
+// xorshift32, kept per instance so runs can be replayed exactly
+static uint8_t cpu_random_byte(chip8_t *p_cpu)
+{
+    uint32_t x = p_cpu->rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p_cpu->rng_state = x;
+    return (uint8_t)(x >> 24);
+}
+
+uint64_t cpu_display_hash(const chip8_t *p_cpu)
+{
+    // FNV-1a, fed most significant byte first so the hash doesn't depend on endianness
+    uint64_t hash = 0xCBF29CE484222325u;
+
+    for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        for(unsigned y = 0; y < DISPLAY_H; y++)
+        {
+            for(unsigned w = 0; w < DISPLAY_WORDS; w++)
+            {
+                for(int shift = 56; shift >= 0; shift -= 8)
+                {
+                    hash ^= (p_cpu->vram[plane][y][w] >> shift) & 0xFF;
+                    hash *= 0x100000001B3u;
+                }
+            }
+        }
+    }
+
+    return hash;
+}
+
+void cpu_display_render(chip8_t *p_cpu, uint32_t *p_pixels, size_t pitch, const uint32_t *p_palette)
+{
+    unsigned width = cpu_display_width(p_cpu);
+    unsigned height = cpu_display_height(p_cpu);
+
+    // Planes are only combined here, once per presented frame, never per draw
+    for(unsigned y = 0; y < height; y++)
+    {
+        uint32_t *p_row = p_pixels + y * pitch;
+        for(unsigned w = 0; w < width / 64; w++)
+        {
+            uint64_t bits[DISPLAY_PLANES];
+            for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+            {
+                bits[plane] = p_cpu->vram[plane][y][w];
+            }
+            for(unsigned x = 0; x < 64; x++)
+            {
+                unsigned shift = 63 - x;
+                unsigned color = (unsigned)(((bits[0] >> shift) & 1) |
+                                            (((bits[1] >> shift) & 1) << 1) |
+                                            (((bits[2] >> shift) & 1) << 2) |
+                                            (((bits[3] >> shift) & 1) << 3));
+                p_row[w * 64 + x] = p_palette[color];
+            }
+        }
+    }
+
+    p_cpu->display_dirty = false;
+}
+
+/**
+ * XOR one sprite row into the display. bits holds width pixels, leftmost in
+ * the most significant bit. The row is lined up with the packed words using
+ * two shifts, so drawing costs the same however wide the display is.
+ * Returns true if any pixel was turned off.
+ */
+static bool cpu_draw_row(chip8_t *p_cpu, unsigned plane, uint8_t y, uint8_t col, uint16_t bits, uint8_t width)
+{
+    unsigned words = cpu_display_width(p_cpu) / 64;
+    unsigned w = col >> 6;
+    unsigned offset = col & 63;
+    uint64_t sprite = (uint64_t)bits << (64 - width);
+    uint64_t parts[2];
+    bool collision = false;
+
+    parts[0] = sprite >> offset;
+    // Anything shifted out spills into the next word
+    parts[1] = (0 == offset) ? 0 : sprite << (64 - offset);
+
+    for(unsigned i = 0; i < 2; i++, w++)
+    {
+        if(w >= words)
+        {
+            if(p_cpu->quirks & QUIRK_CLIPPING)
+            {
+                break;
+            }
+            w -= words;
+        }
+        uint64_t *p_word = &p_cpu->vram[plane][y][w];
+        collision |= (*p_word & parts[i]) != 0;
+        *p_word ^= parts[i];
+    }
+
+    return collision;
+}
+
+static void cpu_set_hires(chip8_t *p_cpu, bool hires)
+{
+    // Switching resolution clears the screen, as in modern SUPER-CHIP
+    p_cpu->hires = hires;
+    memset(p_cpu->vram, 0, sizeof(p_cpu->vram));
+    p_cpu->display_dirty = true;
+}
+
+// 00E0 and the scrolls only touch the planes selected with Fn01
+static void cpu_clear_planes(chip8_t *p_cpu)
+{
+    for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if(p_cpu->planes & (1u << plane))
+        {
+            memset(p_cpu->vram[plane], 0, sizeof(p_cpu->vram[plane]));
+        }
+    }
+    p_cpu->display_dirty = true;
+}
+
+// 00Cn, scrolling a whole row is a single memmove
+static void cpu_scroll_down(chip8_t *p_cpu, uint8_t rows)
+{
+    unsigned height = cpu_display_height(p_cpu);
+
+    if(rows > height)
+    {
+        rows = (uint8_t)height;
+    }
+    for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if(p_cpu->planes & (1u << plane))
+        {
+            uint64_t (*p_rows)[DISPLAY_WORDS] = p_cpu->vram[plane];
+            memmove(p_rows[rows], p_rows[0], (height - rows) * sizeof(p_rows[0]));
+            memset(p_rows[0], 0, rows * sizeof(p_rows[0]));
+        }
+    }
+    p_cpu->display_dirty = true;
+}
+
+// 00FB and 00FC, shift each row by 4 pixels carrying across word boundaries
+static void cpu_scroll_right(chip8_t *p_cpu)
+{
+    unsigned height = cpu_display_height(p_cpu);
+    unsigned words = cpu_display_width(p_cpu) / 64;
+
+    for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if(!(p_cpu->planes & (1u << plane)))
+        {
+            continue;
+        }
+        for(unsigned y = 0; y < height; y++)
+        {
+            uint64_t *p_row = p_cpu->vram[plane][y];
+            for(unsigned w = words - 1; w > 0; w--)
+            {
+                p_row[w] = (p_row[w] >> 4) | (p_row[w - 1] << 60);
+            }
+            p_row[0] >>= 4;
+        }
+    }
+    p_cpu->display_dirty = true;
+}
+
+static void cpu_scroll_left(chip8_t *p_cpu)
+{
+    unsigned height = cpu_display_height(p_cpu);
+    unsigned words = cpu_display_width(p_cpu) / 64;
+
+    for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if(!(p_cpu->planes & (1u << plane)))
+        {
+            continue;
+        }
+        for(unsigned y = 0; y < height; y++)
+        {
+            uint64_t *p_row = p_cpu->vram[plane][y];
+            for(unsigned w = 0; w < words - 1; w++)
+            {
+                p_row[w] = (p_row[w] << 4) | (p_row[w + 1] >> 60);
+            }
+            p_row[words - 1] <<= 4;
+        }
+    }
+    p_cpu->display_dirty = true;
+}
+
+/*
+ * Guest addresses wrap at the end of memory, 12 bits or 16 for XO-CHIP.
+ * Every byte of an access is masked on its own, so I + n past the end
+ * carries on from address 0.
+ */
+static inline uint32_t cpu_address(const chip8_t *p_cpu, uint32_t address)
+{
+    return address & (p_cpu->memory_size - 1);
+}
+
+// XO-CHIP skips hop over the whole four byte F000 nnnn
+static void cpu_skip(chip8_t *p_cpu)
+{
+    if(0xF0 == p_cpu->memory[cpu_address(p_cpu, p_cpu->pc)] &&
+       0x00 == p_cpu->memory[cpu_address(p_cpu, p_cpu->pc + 1u)])
+    {
+        p_cpu->pc += 4;
+    }
+    else
+    {
+        p_cpu->pc += 2;
+    }
+}
+
+// 5xy2 and 5xy3 walk from Vx to Vy, backwards if x > y
+static void cpu_register_range(chip8_t *p_cpu, uint8_t x, uint8_t y, bool store)
+{
+    int step = (x <= y) ? 1 : -1;
+    unsigned count = (unsigned)((x <= y) ? y - x : x - y) + 1;
+
+    for(unsigned i = 0; i < count; i++)
+    {
+        uint8_t reg = (uint8_t)(x + step * (int)i);
+        uint8_t *p_mem = &p_cpu->memory[cpu_address(p_cpu, p_cpu->index + i)];
+        if(store)
+        {
+            *p_mem = p_cpu->V[reg];
+        }
+        else
+        {
+            p_cpu->V[reg] = *p_mem;
+        }
+    }
+}
+
+// Count an executed instruction, compiled out unless EMUEIGHT_PROFILE
+static inline void cpu_profile(chip8_t *p_cpu, uint16_t pc, uint16_t code)
+{
+#ifdef EMUEIGHT_PROFILE
+    if(NULL != p_cpu->p_profile)
+    {
+        profile_count(p_cpu->p_profile, pc, code);
+    }
+#else
+    (void)p_cpu;
+    (void)pc;
+    (void)code;
+#endif
+}
+
+// 0xDxyn (DRW) Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
+static void cpu_draw(chip8_t *p_cpu, opcode_t opcode)
 {
-    opcode_t opcode;
     uint8_t col = 0;
     uint8_t row = 0;
+    uint8_t width = 0;
+    uint8_t height = 0;
+    uint32_t src_address = 0;
+
+    if(p_cpu->display_wait)
+    {
+        p_cpu->pc -= 2;
+        return;
+    }
+    // Dxy0 draws a 16x16 sprite, two bytes per row
+    width = (0 == opcode.n) ? 16 : 8;
+    height = (0 == opcode.n) ? 16 : opcode.n;
+    // wrap around screen
+    col = (uint8_t)(p_cpu->V[opcode.x] & (cpu_display_width(p_cpu) - 1));
+    row = (uint8_t)(p_cpu->V[opcode.y] & (cpu_display_height(p_cpu) - 1));
+    p_cpu->V[0xF] = 0;
+    // Each selected plane takes the next sprite's worth of bytes from I
+    src_address = p_cpu->index;
+    for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if(!(p_cpu->planes & (1u << plane)))
+        {
+            continue;
+        }
+        for(uint8_t i = 0; i < height; i++)
+        {
+            uint8_t y = (uint8_t)(row + i);
+            if(y >= cpu_display_height(p_cpu)) {
+                if(p_cpu->quirks & QUIRK_CLIPPING)
+                {
+                    break;
+                }
+                y = (uint8_t)(y & (cpu_display_height(p_cpu) - 1));
+            }
+            uint16_t bits = p_cpu->memory[cpu_address(p_cpu, src_address + i)];
+            if(16 == width)
+            {
+                bits = (uint16_t)(p_cpu->memory[cpu_address(p_cpu, src_address + 2u * i)] << 8 |
+                                  p_cpu->memory[cpu_address(p_cpu, src_address + 2u * i + 1u)]);
+            }
+            if(cpu_draw_row(p_cpu, plane, y, col, bits, width))
+            {
+                // Set collision flag
+                p_cpu->V[0xF] = 1;
+            }
+        }
+        src_address += (uint32_t)height * (width / 8u);
+    }
+    p_cpu->display_dirty = true;
+    p_cpu->display_wait = (p_cpu->quirks & QUIRK_DISPLAY_WAIT) != 0;
+}
+
+// Read the instruction at pc to see if it fuses with the one just executed
+static bool cpu_peek(const chip8_t *p_cpu, uint16_t *p_next)
+{
+    if((uint32_t)p_cpu->pc + 2u > p_cpu->memory_size)
+    {
+        return false;
+    }
+    *p_next = (uint16_t)(p_cpu->memory[p_cpu->pc] << 8u | p_cpu->memory[p_cpu->pc + 1u]);
+    return true;
+}
+
+// Fused 3xnn or 4xnn tail, comparing the Vx the previous instruction wrote
+static bool cpu_fuse_skip(chip8_t *p_cpu, uint8_t x, uint16_t next)
+{
+    uint8_t op = (uint8_t)(next >> 12);
+
+    if((0x3 != op && 0x4 != op) || x != ((next >> 8) & 0xF))
+    {
+        return false;
+    }
+    cpu_profile(p_cpu, p_cpu->pc, next);
+    p_cpu->pc += 2;
+    if(((next & 0xFF) == p_cpu->V[x]) == (0x3 == op))
+    {
+        cpu_skip(p_cpu);
+    }
+    return true;
+}
+
+/**
+ * Execute the instruction at pc. With a budget of more than one, a few
+ * common sequences run as superinstructions, the instructions that follow
+ * being executed straight from the first one's handler instead of going
+ * back through fetch and dispatch:
+ *
+ *   Annn Dxyn         point I at a sprite and draw it
+ *   7xnn 3xnn/4xnn    loop counter
+ *   Fx07 3xnn/4xnn    delay timer poll
+ *   6xnn 6xnn ...     register loads
+ *
+ * The result is exactly what executing them one at a time gives, skips
+ * included. Returns the number of instructions executed.
+ */
+static uint32_t cpu_execute(chip8_t *p_cpu, uint32_t budget)
+{
+    opcode_t opcode;
     uint8_t carry = false;
+    uint8_t src = 0;
+    uint16_t next = 0;
+    uint32_t executed = 1;
+    uint16_t pc = 0;
+
+    // Fetch, pc wraps at the end of memory like any other address
+    pc = (uint16_t)cpu_address(p_cpu, p_cpu->pc);
+    opcode = cpu_decode_opcode((uint16_t)(p_cpu->memory[pc] << 8u | p_cpu->memory[cpu_address(p_cpu, pc + 1u)]));
 
-    // Fetch 
-    opcode = cpu_decode_opcode((uint16_t)(p_cpu->memory[p_cpu->pc] << 8u | p_cpu->memory[p_cpu->pc + 1u]));
+    cpu_profile(p_cpu, pc, opcode.code);
     
-    p_cpu->pc+=2;
+    p_cpu->pc = (uint16_t)(pc + 2);
 
     // Decode and execute
     switch (opcode.op)
     {
         case 0x0:
-            switch (opcode.nn)
+            if(0x00C0 == (opcode.code & 0xFFF0)) // 0x00Cn (SCD) Scroll the display down n rows.
             {
-                case 0xE0: // 0x00E0 (CLS) Clear the display
-                    memset(p_cpu->vram, 0, sizeof(p_cpu->vram));
+                cpu_scroll_down(p_cpu, opcode.n);
+                break;
+            }
+            // 0x0nnn with anything else is a machine code call, ignored
+            switch (opcode.code)
+            {
+                case 0x00E0: // 0x00E0 (CLS) Clear the display
+                    cpu_clear_planes(p_cpu);
                     break;
-                case 0xEE: // 0x00EE (RET) Return from a subroutine.
-                    p_cpu->sp--;                    
+                case 0x00EE: // 0x00EE (RET) Return from a subroutine.
+                    p_cpu->sp = (uint8_t)((p_cpu->sp - 1u) & (STACK_SIZE - 1));
                     p_cpu->pc = p_cpu->stack[p_cpu->sp];
                     break;
+                case 0x00FB: // 0x00FB (SCR) Scroll the display right 4 pixels.
+                    cpu_scroll_right(p_cpu);
+                    break;
+                case 0x00FC: // 0x00FC (SCL) Scroll the display left 4 pixels.
+                    cpu_scroll_left(p_cpu);
+                    break;
+                case 0x00FD: // 0x00FD (EXIT) Exit the interpreter, spin here.
+                    p_cpu->pc -= 2;
+                    break;
+                case 0x00FE: // 0x00FE (LOW) Switch to 64x32 lo-res.
+                    cpu_set_hires(p_cpu, false);
+                    break;
+                case 0x00FF: // 0x00FF (HIGH) Switch to 128x64 hi-res.
+                    cpu_set_hires(p_cpu, true);
+                    break;
                 default:
                     break;
             }
@@ -165,33 +656,57 @@ void cpu_cycle(chip8_t *p_cpu)
             p_cpu->pc = opcode.nnn;
             break;
         case 0x2: // 0x2nnn (CALL) Call subroutine at location nnn.
-            p_cpu->stack[p_cpu->sp] = p_cpu->pc;
-            p_cpu->sp++;
+            p_cpu->stack[p_cpu->sp & (STACK_SIZE - 1)] = p_cpu->pc;
+            p_cpu->sp = (uint8_t)((p_cpu->sp + 1u) & (STACK_SIZE - 1));
             p_cpu->pc = opcode.nnn;
             break;
         case 0x3: // 0x3xnn (SE) Skip next instruction if Vx = nn;
             if(opcode.nn == p_cpu->V[opcode.x])
             {
-                p_cpu->pc += 2;
+                cpu_skip(p_cpu);
             }
             break;
         case 0x4: // 0x4xnn (SNE) Skip next instruction if Vx != nn;
             if(opcode.nn != p_cpu->V[opcode.x])
             {
-                p_cpu->pc += 2;
+                cpu_skip(p_cpu);
             }
             break;
-        case 0x5: // 0x5xy0 (SE) Skip next instruction if Vx = Vy;
-            if(p_cpu->V[opcode.x] == p_cpu->V[opcode.y])
+        case 0x5:
+            switch (opcode.n)
             {
-                p_cpu->pc += 2;
+                case 0x0: // 0x5xy0 (SE) Skip next instruction if Vx = Vy;
+                    if(p_cpu->V[opcode.x] == p_cpu->V[opcode.y])
+                    {
+                        cpu_skip(p_cpu);
+                    }
+                    break;
+                case 0x2: // 0x5xy2 (LD) Store Vx through Vy in memory starting at location I.
+                    cpu_register_range(p_cpu, opcode.x, opcode.y, true);
+                    break;
+                case 0x3: // 0x5xy3 (LD) Read Vx through Vy from memory starting at location I.
+                    cpu_register_range(p_cpu, opcode.x, opcode.y, false);
+                    break;
+                default:
+                    break;
             }
             break;
         case 0x6: // 0x6xnn (LD) Set Vx = nn.
             p_cpu->V[opcode.x] = opcode.nn;
+            while(executed < budget && cpu_peek(p_cpu, &next) && 0x6 == (next >> 12))
+            {
+                cpu_profile(p_cpu, p_cpu->pc, next);
+                p_cpu->V[(next >> 8) & 0xF] = (uint8_t)next;
+                p_cpu->pc += 2;
+                executed++;
+            }
             break;
         case 0x7: // 0x7xnn (ADD) Set Vx = Vx + nn.
             p_cpu->V[opcode.x] += opcode.nn;
+            if(budget > 1 && cpu_peek(p_cpu, &next) && cpu_fuse_skip(p_cpu, opcode.x, next))
+            {
+                executed = 2;
+            }
             break;
         case 0x8:
             switch (opcode.n)
@@ -201,18 +716,24 @@ void cpu_cycle(chip8_t *p_cpu)
                     break;
                 case 0x1: // 0x8xy1 (OR) Set Vx = Vx OR Vy.
                     p_cpu->V[opcode.x] = p_cpu->V[opcode.x] | p_cpu->V[opcode.y];
-                    // TODO: Make quirk configurable
-                    p_cpu->V[0xF] = 0;
+                    if(p_cpu->quirks & QUIRK_VF_RESET)
+                    {
+                        p_cpu->V[0xF] = 0;
+                    }
                     break;
                 case 0x2: // 0x8xy2 (AND) Set Vx = Vx AND Vy.
                     p_cpu->V[opcode.x] = p_cpu->V[opcode.x] & p_cpu->V[opcode.y];
-                    // TODO: Make quirk configurable
-                    p_cpu->V[0xF] = 0;
+                    if(p_cpu->quirks & QUIRK_VF_RESET)
+                    {
+                        p_cpu->V[0xF] = 0;
+                    }
                     break;
                 case 0x3: // 0x8xy3 (XOR) Set Vx = Vx XOR Vy.
                     p_cpu->V[opcode.x] = p_cpu->V[opcode.x] ^ p_cpu->V[opcode.y];
-                    // TODO: Make quirk configurable
-                    p_cpu->V[0xF] = 0;
+                    if(p_cpu->quirks & QUIRK_VF_RESET)
+                    {
+                        p_cpu->V[0xF] = 0;
+                    }
                     break;
                 case 0x4: // 0x8xy4 (ADD) Set Vx = Vx + Vy. Set VF = carry.
                     carry = (p_cpu->V[opcode.y] > UCHAR_MAX - p_cpu->V[opcode.x]);
@@ -225,9 +746,9 @@ void cpu_cycle(chip8_t *p_cpu)
                     p_cpu->V[0xF] = carry;
                     break;
                 case 0x6: // 0x8xy6 (SHR) Set Vx = Vy SHR 1.
-                    // TODO: Make quirk configurable
-                    carry = p_cpu->V[opcode.y] & 0x1;
-                    p_cpu->V[opcode.x] = p_cpu->V[opcode.y] >> 1;
+                    src = (p_cpu->quirks & QUIRK_SHIFT_VX) ? opcode.x : opcode.y;
+                    carry = p_cpu->V[src] & 0x1;
+                    p_cpu->V[opcode.x] = p_cpu->V[src] >> 1;
                     p_cpu->V[0xF] = carry;
                     break;
                 case 0x7: // 0x8xy7 (SUBN) Set Vx = Vy - Vx, set VF = NOT borrow.
@@ -235,10 +756,10 @@ void cpu_cycle(chip8_t *p_cpu)
                     p_cpu->V[opcode.x] = p_cpu->V[opcode.y] - p_cpu->V[opcode.x];
                     p_cpu->V[0xF] = carry;
                     break;
-                case 0xE: // 0x8xyE (SHL) Set Vx = Vx SHL 1.
-                    // TODO: Make quirk configurable
-                    carry = (p_cpu->V[opcode.y]) >> 7;
-                    p_cpu->V[opcode.x] = (uint8_t)(p_cpu->V[opcode.y] << 1);
+                case 0xE: // 0x8xyE (SHL) Set Vx = Vy SHL 1.
+                    src = (p_cpu->quirks & QUIRK_SHIFT_VX) ? opcode.x : opcode.y;
+                    carry = (p_cpu->V[src]) >> 7;
+                    p_cpu->V[opcode.x] = (uint8_t)(p_cpu->V[src] << 1);
                     p_cpu->V[0xF] = carry;
                     break;
                 default:
@@ -248,68 +769,43 @@ void cpu_cycle(chip8_t *p_cpu)
         case 0x9: // 0x9xy0 (SNE) Skip next instruction if Vx != Vy.
             if(p_cpu->V[opcode.x] != p_cpu->V[opcode.y]) 
             {
-                p_cpu->pc += 2;
+                cpu_skip(p_cpu);
             }
             break;
         case 0xA: // 0xAnnn (LD I) The value of index register I is set to nnn.
             p_cpu->index = opcode.nnn;
+            if(budget > 1 && cpu_peek(p_cpu, &next) && 0xD == (next >> 12))
+            {
+                cpu_profile(p_cpu, p_cpu->pc, next);
+                p_cpu->pc += 2;
+                cpu_draw(p_cpu, cpu_decode_opcode(next));
+                executed = 2;
+            }
             break;
         case 0xB: // 0xBnnn (JP) Jump to location nnn + V0.
-            p_cpu->pc = opcode.nnn + p_cpu->V[0x0];
+            // SUPER-CHIP reads it as Bxnn, jump to xnn + Vx
+            src = (p_cpu->quirks & QUIRK_JUMP_VX) ? opcode.x : 0x0;
+            p_cpu->pc = (uint16_t)(opcode.nnn + p_cpu->V[src]);
             break;
         case 0xC: // 0xCxnn (RND) Set Vx = random byte AND nn
-            p_cpu->V[opcode.x] = ((uint8_t)(rand() % 255)) & opcode.nn;
+            p_cpu->V[opcode.x] = cpu_random_byte(p_cpu) & opcode.nn;
             break;
         case 0xD: // 0xDxyn (DRW) Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
-            // TODO: Make quirk configurable
-            if(p_cpu->display_wait)
-            {
-                p_cpu->pc -= 2;
-                break;
-            }
-            // wrap around screen
-            col = p_cpu->V[opcode.x] & (DISPLAY_W - 1);
-            row = p_cpu->V[opcode.y] & (DISPLAY_H - 1);
-            p_cpu->V[0xF] = 0;
-            for(uint8_t i = 0; i < opcode.n; i++)
-            {
-                if(row + i == DISPLAY_H) {
-                    break;
-                }
-                uint8_t sprite_byte = p_cpu->memory[p_cpu->index + i];
-                for(uint8_t j = 0; j < 8; j++)
-                {
-                    if(col + j == DISPLAY_W)
-                    {
-                        break;
-                    }
-                    if(sprite_byte & (0x80 >> j))
-                    {
-                        uint32_t *p_pixel = &p_cpu->vram[(((row + i) * DISPLAY_W) + (col + j))];
-                        if(*p_pixel) 
-                        {
-                            // Set collision flag
-                            p_cpu->V[0xF] = 1;
-                        }
-                        *p_pixel ^= 0xFFFFFFFF;
-                    }
-                }
-            }
-            p_cpu->display_wait = true;
+            cpu_draw(p_cpu, opcode);
             break;
         case 0xE:
             switch (opcode.nn)
             {
                 case 0x9E: // 0xEx9E (SNP) Skip next instruction if key with the value of Vx is pressed.
-                    if(p_cpu->keypad_register & (1 << p_cpu->V[opcode.x]))
+                    if(p_cpu->keypad_register & (1u << (p_cpu->V[opcode.x] & 0xF)))
                     {
-                        p_cpu->pc += 2;
+                        cpu_skip(p_cpu);
                     }
                     break;
                 case 0xA1: // 0xExA1 (SKNP) Skip next instruction if key with the value of Vx is not pressed.
-                    if(!(p_cpu->keypad_register & (1 << p_cpu->V[opcode.x])))
+                    if(!(p_cpu->keypad_register & (1u << (p_cpu->V[opcode.x] & 0xF))))
                     {
-                        p_cpu->pc += 2;
+                        cpu_skip(p_cpu);
                     }
                     break;
                 default:
@@ -319,8 +815,33 @@ void cpu_cycle(chip8_t *p_cpu)
         case 0xF:
             switch(opcode.nn) 
             {
+                case 0x00: // 0xF000 nnnn (LD) Set I = nnnn, the 16 bit address that follows.
+                    if(0xF000 == opcode.code)
+                    {
+                        p_cpu->index = (uint16_t)(p_cpu->memory[cpu_address(p_cpu, p_cpu->pc)] << 8 |
+                                                  p_cpu->memory[cpu_address(p_cpu, p_cpu->pc + 1u)]);
+                        p_cpu->pc += 2;
+                    }
+                    break;
+                case 0x01: // 0xFn01 (PLANE) Select the planes n to draw to.
+                    p_cpu->planes = opcode.x;
+                    break;
+                case 0x02: // 0xF002 (AUDIO) Load the 16 byte audio pattern at I.
+                    if(0xF002 == opcode.code)
+                    {
+                        for(uint32_t i = 0; i < AUDIO_PATTERN_SIZE; i++)
+                        {
+                            p_cpu->audio_pattern[i] = p_cpu->memory[cpu_address(p_cpu, p_cpu->index + i)];
+                        }
+                        p_cpu->audio_pattern_active = true;
+                    }
+                    break;
                 case 0x07: // 0xFx07 (LD) Set Vx = delay timer value.
                     p_cpu->V[opcode.x] = p_cpu->delayTimer;
+                    if(budget > 1 && cpu_peek(p_cpu, &next) && cpu_fuse_skip(p_cpu, opcode.x, next))
+                    {
+                        executed = 2;
+                    }
                     break;
                 case 0x0A: // 0xFx0A (LD) Wait for a key press, store the value of the key in Vx.
                     if(255 != p_cpu->key_held)
@@ -352,6 +873,12 @@ void cpu_cycle(chip8_t *p_cpu)
                     p_cpu->delayTimer = p_cpu->V[opcode.x];
                     break;
                 case 0x18: // 0xFx18 (LD) Set sound timer = Vx.
+                    // Log where in the frame the beeper starts or stops
+                    if((0 != p_cpu->soundTimer) != (0 != p_cpu->V[opcode.x]) &&
+                       p_cpu->sound_edge_count < SOUND_EDGES_MAX)
+                    {
+                        p_cpu->sound_edges[p_cpu->sound_edge_count++] = p_cpu->frame_cycle;
+                    }
                     p_cpu->soundTimer = p_cpu->V[opcode.x];
                     break;
                 case 0x1E: // 0xFx1E (ADD) Set I = I + Vx.
@@ -360,26 +887,42 @@ void cpu_cycle(chip8_t *p_cpu)
                 case 0x29: // 0xFx29 (LD) Set I = location of sprite for digit Vx.
                     p_cpu->index = (FONT_ADDRESS + (FONT_BYTES * p_cpu->V[opcode.x]));
                     break;
+                case 0x30: // 0xFx30 (LD) Set I = location of the big sprite for digit Vx.
+                    p_cpu->index = (uint16_t)(BIG_FONT_ADDRESS + (BIG_FONT_BYTES * (p_cpu->V[opcode.x] & 0xF)));
+                    break;
                 case 0x33: // 0xFx33 (LD) Store BCD representation of Vx in memory locations I, I+1, and I+2.
-                    p_cpu->memory[p_cpu->index] = (uint8_t)(p_cpu->V[opcode.x]/100) % 10;
-                    p_cpu->memory[p_cpu->index + 1] = (uint8_t)(p_cpu->V[opcode.x]/10) % 10;
-                    p_cpu->memory[p_cpu->index + 2] = (p_cpu->V[opcode.x]) % 10;
+                    p_cpu->memory[cpu_address(p_cpu, p_cpu->index)] = (uint8_t)(p_cpu->V[opcode.x]/100) % 10;
+                    p_cpu->memory[cpu_address(p_cpu, p_cpu->index + 1u)] = (uint8_t)(p_cpu->V[opcode.x]/10) % 10;
+                    p_cpu->memory[cpu_address(p_cpu, p_cpu->index + 2u)] = (p_cpu->V[opcode.x]) % 10;
+                    break;
+                case 0x3A: // 0xFx3A (PITCH) Set the audio pattern playback rate from Vx.
+                    p_cpu->pitch = p_cpu->V[opcode.x];
                     break;
                 case 0x55: // 0xFx55 (LD) Store registers V0 through Vx in memory starting at location I.
                     for(uint8_t i = 0; i <= opcode.x; i++)
                     {
-                        p_cpu->memory[p_cpu->index + i] = p_cpu->V[i];
+                        p_cpu->memory[cpu_address(p_cpu, p_cpu->index + i)] = p_cpu->V[i];
+                    }
+                    if(p_cpu->quirks & QUIRK_MEMORY_INCREMENT)
+                    {
+                        p_cpu->index = (uint16_t)(p_cpu->index + opcode.x + 1);
                     }
-                    // TODO: Make quirk configurable
-                    p_cpu->index += opcode.x+1;
                     break;
                 case 0x65: // 0xFx65 (LD) Read registers V0 through Vx from memory starting at location I.
                     for(uint8_t i = 0; i <= opcode.x; i++)
                     {
-                        p_cpu->V[i] = p_cpu->memory[p_cpu->index + i];
+                        p_cpu->V[i] = p_cpu->memory[cpu_address(p_cpu, p_cpu->index + i)];
+                    }
+                    if(p_cpu->quirks & QUIRK_MEMORY_INCREMENT)
+                    {
+                        p_cpu->index = (uint16_t)(p_cpu->index + opcode.x + 1);
                     }
-                    // TODO: Make quirk configurable
-                    p_cpu->index += opcode.x+1;
+                    break;
+                case 0x75: // 0xFx75 (LD) Store V0 through Vx in the RPL flags.
+                    memcpy(p_cpu->rpl, p_cpu->V, (size_t)opcode.x + 1);
+                    break;
+                case 0x85: // 0xFx85 (LD) Read V0 through Vx from the RPL flags.
+                    memcpy(p_cpu->V, p_cpu->rpl, (size_t)opcode.x + 1);
                     break;
                 default:
                     break;
@@ -388,4 +931,178 @@ void cpu_cycle(chip8_t *p_cpu)
         default:
             break;
     }
+
+    return executed;
+}
+
+/*
+ * Execute one instruction and append a record of the registers it left
+ * behind. Unless full is set only the V registers the opcode can write are
+ * stored, marked in changed, and trace_flush() takes the rest from the
+ * record before. Inlined into the batch loop, a record costs about as much
+ * as the instruction.
+ */
+static inline void cpu_execute_traced(chip8_t *p_cpu, bool full)
+{
+    trace_record_t *p_record = trace_append(p_cpu->p_trace);
+    uint16_t pc = (uint16_t)cpu_address(p_cpu, p_cpu->pc);
+    // Fetched first, the instruction may overwrite itself
+    uint16_t code = (uint16_t)(p_cpu->memory[pc] << 8u | p_cpu->memory[cpu_address(p_cpu, pc + 1u)]);
+    uint8_t x = (uint8_t)((code >> 8) & 0xF);
+
+    p_record->pc = pc;
+    p_record->opcode = code;
+    cpu_execute(p_cpu, 1);
+
+    p_record->index = p_cpu->index;
+    p_record->sp = p_cpu->sp;
+    p_record->delay_timer = p_cpu->delayTimer;
+    p_record->sound_timer = p_cpu->soundTimer;
+
+    // Vx and VF are all most instructions can write, storing them whatever
+    // the instruction was is cheaper than working out which it was
+    p_record->changed = (uint16_t)(1u << x | 1u << 0xF);
+    p_record->V[x] = p_cpu->V[x];
+    p_record->V[0xF] = p_cpu->V[0xF];
+    // 5xy3, Fx65 and Fx85 load a range
+    if(full || 0x5 == (code >> 12) || 0xF065 == (code & 0xF0FF) || 0xF085 == (code & 0xF0FF))
+    {
+        p_record->changed = 0xFFFF;
+        memcpy(p_record->V, p_cpu->V, NUM_REGISTERS);
+    }
+}
+
+// A single instruction, traced when a trace is attached
+static void cpu_step(chip8_t *p_cpu)
+{
+    if(NULL != p_cpu->p_trace)
+    {
+        cpu_execute_traced(p_cpu, true);
+    }
+    else
+    {
+        cpu_execute(p_cpu, 1);
+    }
+}
+
+void cpu_cycle(chip8_t *p_cpu)
+{
+    cpu_step(p_cpu);
+}
+
+/*
+ * cpu_run() with a debugger attached and something for it to do. Every
+ * instruction runs on its own, checked against the breakpoints before and
+ * the watchpoints after, so none are hidden inside a superinstruction and
+ * nothing is skipped as idle.
+ */
+static void cpu_run_debug(chip8_t *p_cpu, uint32_t cycles)
+{
+    debug_t *p_debug = p_cpu->p_debug;
+
+    for(uint32_t i = 0; i < cycles && DEBUG_RUNNING == p_debug->stop; i++)
+    {
+        debug_stop_t watch = DEBUG_RUNNING;
+
+        if(debug_break_before(p_debug, p_cpu))
+        {
+            break;
+        }
+        watch = debug_watch(p_debug, p_cpu);
+        cpu_step(p_cpu);
+        p_cpu->frame_cycle++;
+        p_debug->stop = watch;
+    }
+}
+
+/*
+ * cpu_run() with a trace attached, one instruction and one record at a
+ * time. Idling is skipped the same way, so a wait loop leaves one record
+ * per batch rather than thousands.
+ */
+static void cpu_run_trace(chip8_t *p_cpu, uint32_t cycles)
+{
+    for(uint32_t i = 0; i < cycles; i++)
+    {
+        uint16_t pc = p_cpu->pc;
+        uint8_t sp = p_cpu->sp;
+
+        // Registers can change between batches, the first record has them all
+        cpu_execute_traced(p_cpu, 0 == i);
+        p_cpu->frame_cycle++;
+        if(pc == p_cpu->pc && sp == p_cpu->sp)
+        {
+            p_cpu->frame_cycle += cycles - i - 1;
+            p_cpu->idle_cycles += cycles - i - 1;
+            break;
+        }
+    }
+}
+
+/**
+ * Execute a batch of cycles, keeping count of where we are in the current
+ * frame so sound timer writes can be placed accurately by the beeper.
+ * Common instruction sequences run as superinstructions where the batch
+ * has room for all of them, see cpu_execute().
+ *
+ * An instruction that leaves pc and sp where they were (a jump to itself,
+ * Fx0A waiting on a keypad that can't change until the next frame, a draw
+ * waiting for the timer tick) would just repeat itself for the rest of the
+ * batch, so the remaining cycles are counted without being executed. This
+ * keeps very high cycles per frame cheap for programs that idle.
+ */
+void cpu_run(chip8_t *p_cpu, uint32_t cycles)
+{
+    uint32_t i = 0;
+
+    // Decided once per batch, the loop below never looks at the debugger
+    if(NULL != p_cpu->p_debug && debug_active(p_cpu->p_debug))
+    {
+        cpu_run_debug(p_cpu, cycles);
+        return;
+    }
+    if(NULL != p_cpu->p_trace)
+    {
+        cpu_run_trace(p_cpu, cycles);
+        return;
+    }
+
+    while(i < cycles)
+    {
+        uint16_t pc = p_cpu->pc;
+        uint8_t sp = p_cpu->sp;
+        uint32_t executed = cpu_execute(p_cpu, cycles - i);
+
+        p_cpu->frame_cycle += executed;
+        i += executed;
+
+        // 2nnn calling itself or 00EE returning to itself still moves the stack, so it is not idle
+        if(pc == p_cpu->pc && sp == p_cpu->sp)
+        {
+            p_cpu->frame_cycle += cycles - i;
+            p_cpu->idle_cycles += cycles - i;
+            break;
+        }
+    }
+}
+
+/**
+ * Advance the 60Hz timers and start a new frame. Anything consuming the
+ * frame's sound edges (the beeper) must run before this.
+ */
+void cpu_timer_tick(chip8_t *p_cpu)
+{
+    if(p_cpu->delayTimer > 0)
+    {
+        p_cpu->delayTimer--;
+    }
+    if(p_cpu->soundTimer > 0)
+    {
+        p_cpu->soundTimer--;
+    }
+
+    p_cpu->display_wait = false;
+    p_cpu->frame_cycle = 0;
+    p_cpu->sound_edge_count = 0;
+    p_cpu->sound_gate = p_cpu->soundTimer > 0;
 }
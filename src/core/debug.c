@@ -0,0 +1,215 @@
+#include <string.h>
+
+#include "debug.h"
+
+static void debug_set_bit(uint8_t *p_bitmap, uint16_t address, bool enabled, uint32_t *p_count)
+{
+    uint8_t mask = (uint8_t)(1u << (address & 7));
+    bool set = 0 != (p_bitmap[address >> 3] & mask);
+
+    if(enabled && !set)
+    {
+        p_bitmap[address >> 3] |= mask;
+        (*p_count)++;
+    }
+    else if(!enabled && set)
+    {
+        p_bitmap[address >> 3] &= (uint8_t)~mask;
+        (*p_count)--;
+    }
+}
+
+static bool debug_test_bit(const uint8_t *p_bitmap, uint32_t address)
+{
+    return 0 != (p_bitmap[address >> 3] & (1u << (address & 7)));
+}
+
+void debug_init(debug_t *p_debug)
+{
+    memset(p_debug, 0, sizeof(*p_debug));
+}
+
+void debug_set_breakpoint(debug_t *p_debug, uint16_t address, bool enabled)
+{
+    debug_set_bit(p_debug->breakpoints, address, enabled, &p_debug->breakpoint_count);
+}
+
+void debug_set_watch(debug_t *p_debug, uint16_t address, uint16_t length, uint8_t kinds, bool enabled)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        uint16_t watched = (uint16_t)(address + i);
+
+        // watch_count counts watched bytes of either kind
+        if(kinds & DEBUG_WATCH_READ)
+        {
+            debug_set_bit(p_debug->read_watch, watched, enabled, &p_debug->watch_count);
+        }
+        if(kinds & DEBUG_WATCH_WRITE)
+        {
+            debug_set_bit(p_debug->write_watch, watched, enabled, &p_debug->watch_count);
+        }
+    }
+}
+
+void debug_pause(debug_t *p_debug)
+{
+    p_debug->stop = DEBUG_PAUSED;
+    p_debug->stepping_over = false;
+}
+
+void debug_continue(chip8_t *p_cpu)
+{
+    debug_t *p_debug = p_cpu->p_debug;
+
+    p_debug->resuming = true;
+    p_debug->resume_pc = p_cpu->pc;
+    p_debug->stop = DEBUG_RUNNING;
+}
+
+void debug_step(chip8_t *p_cpu)
+{
+    debug_t *p_debug = p_cpu->p_debug;
+
+    cpu_cycle(p_cpu);
+    p_cpu->frame_cycle++;
+    p_debug->stop = DEBUG_STEPPED;
+    p_debug->stop_address = p_cpu->pc;
+}
+
+void debug_step_over(chip8_t *p_cpu)
+{
+    debug_t *p_debug = p_cpu->p_debug;
+
+    if(0x20 != (p_cpu->memory[p_cpu->pc & (p_cpu->memory_size - 1)] & 0xF0))
+    {
+        debug_step(p_cpu);
+        return;
+    }
+
+    // Let it run, cpu_run() stops when the call comes back
+    p_debug->stepping_over = true;
+    p_debug->return_pc = (uint16_t)(p_cpu->pc + 2);
+    p_debug->return_sp = p_cpu->sp;
+    debug_continue(p_cpu);
+}
+
+bool debug_break_before(debug_t *p_debug, const chip8_t *p_cpu)
+{
+    // Instructions waiting on the display or keypad run again at the same
+    // address, the breakpoint just continued from stays quiet until pc moves on
+    bool resuming = p_debug->resuming && p_cpu->pc == p_debug->resume_pc;
+
+    p_debug->resuming = resuming;
+    if(p_debug->stepping_over && p_cpu->pc == p_debug->return_pc && p_cpu->sp == p_debug->return_sp)
+    {
+        p_debug->stepping_over = false;
+        p_debug->stop = DEBUG_STEPPED;
+        p_debug->stop_address = p_cpu->pc;
+        return true;
+    }
+    if(!resuming && debug_has_breakpoint(p_debug, p_cpu->pc))
+    {
+        // A breakpoint inside the subroutine ends the step over
+        p_debug->stepping_over = false;
+        p_debug->stop = DEBUG_BREAKPOINT;
+        p_debug->stop_address = p_cpu->pc;
+        return true;
+    }
+
+    return false;
+}
+
+static bool debug_watch_range(debug_t *p_debug, const chip8_t *p_cpu, const uint8_t *p_bitmap, uint32_t length)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        // Addresses wrap at the end of memory
+        uint32_t address = (p_cpu->index + i) & (p_cpu->memory_size - 1);
+
+        if(debug_test_bit(p_bitmap, address))
+        {
+            p_debug->stop_address = (uint16_t)address;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Every instruction that touches memory other than to fetch does it from I
+ * onwards, so the opcode and a few registers are enough to know what it
+ * will read or write before it runs.
+ */
+debug_stop_t debug_watch(debug_t *p_debug, const chip8_t *p_cpu)
+{
+    uint16_t pc = (uint16_t)(p_cpu->pc & (p_cpu->memory_size - 1));
+    uint16_t opcode = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t read = 0;
+    uint32_t written = 0;
+
+    if(0 == p_debug->watch_count)
+    {
+        return DEBUG_RUNNING;
+    }
+    opcode = (uint16_t)(p_cpu->memory[pc] << 8 | p_cpu->memory[(pc + 1u) & (p_cpu->memory_size - 1)]);
+    x = (opcode >> 8) & 0xFu;
+    y = (opcode >> 4) & 0xFu;
+
+    switch(opcode & 0xF00F)
+    {
+        case 0x5002:
+            written = ((x > y) ? x - y : y - x) + 1;
+            break;
+        case 0x5003:
+            read = ((x > y) ? x - y : y - x) + 1;
+            break;
+        default:
+            break;
+    }
+    if(0xD000 == (opcode & 0xF000))
+    {
+        uint32_t planes = 0;
+
+        // A draw waiting for the display reads nothing until the timer tick
+        if(p_cpu->display_wait)
+        {
+            return DEBUG_RUNNING;
+        }
+        for(unsigned plane = 0; plane < DISPLAY_PLANES; plane++)
+        {
+            planes += (p_cpu->planes >> plane) & 1u;
+        }
+        read = planes * ((0 == (opcode & 0xF)) ? 32u : (opcode & 0xFu));
+    }
+    else if(0xF002 == opcode)
+    {
+        read = AUDIO_PATTERN_SIZE;
+    }
+    else if(0xF033 == (opcode & 0xF0FF))
+    {
+        written = 3;
+    }
+    else if(0xF055 == (opcode & 0xF0FF))
+    {
+        written = x + 1;
+    }
+    else if(0xF065 == (opcode & 0xF0FF))
+    {
+        read = x + 1;
+    }
+
+    if(0 != written && debug_watch_range(p_debug, p_cpu, p_debug->write_watch, written))
+    {
+        return DEBUG_WATCH_WRITE_HIT;
+    }
+    if(0 != read && debug_watch_range(p_debug, p_cpu, p_debug->read_watch, read))
+    {
+        return DEBUG_WATCH_READ_HIT;
+    }
+
+    return DEBUG_RUNNING;
+}
@@ -0,0 +1,576 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "disasm.h"
+#include "profile.h"
+
+static const char *edge_names[] = { "next", "jump", "call", "skip" };
+
+// Big endian word at offset, zero past the end of the ROM
+static uint16_t disasm_word(const uint8_t *p_rom, size_t size, size_t offset)
+{
+    uint16_t high = (offset < size) ? p_rom[offset] : 0;
+    uint16_t low = (offset + 1 < size) ? p_rom[offset + 1] : 0;
+
+    return (uint16_t)(high << 8 | low);
+}
+
+size_t disasm_length(const uint8_t *p_rom, size_t size, size_t offset)
+{
+    return (offset + 1 < size && 0xF000 == disasm_word(p_rom, size, offset)) ? 4 : 2;
+}
+
+static bool disasm_is_skip(uint16_t opcode)
+{
+    switch(opcode >> 12)
+    {
+        case 0x3:
+        case 0x4:
+        case 0x9:
+        case 0xE:
+            return true;
+        case 0x5:
+            return 0x0 == (opcode & 0xF);
+        default:
+            return false;
+    }
+}
+
+// Nothing after it runs unless something else jumps there
+static bool disasm_is_terminal(uint16_t opcode)
+{
+    return 0x00EE == opcode || 0x00FD == opcode || 0x1 == (opcode >> 12) || 0xB == (opcode >> 12);
+}
+
+// Offset of a jump or call target, or SIZE_MAX when it's below the ROM
+static size_t disasm_target(uint16_t opcode)
+{
+    return ((opcode & 0x0FFF) >= START_ADDRESS) ? (size_t)(opcode & 0x0FFF) - START_ADDRESS : SIZE_MAX;
+}
+
+// Queue the instruction at offset unless it is outside the ROM or already found
+static void disasm_visit(disasm_t *p_disasm, uint32_t *p_work, size_t *p_count, size_t offset)
+{
+    if(offset >= p_disasm->size || offset + 1 >= p_disasm->size || (p_disasm->p_flags[offset] & DISASM_CODE))
+    {
+        return;
+    }
+    p_disasm->p_flags[offset] |= DISASM_CODE;
+    p_work[(*p_count)++] = (uint32_t)offset;
+}
+
+static void disasm_lead(disasm_t *p_disasm, size_t offset)
+{
+    if(offset < p_disasm->size && (p_disasm->p_flags[offset] & DISASM_CODE))
+    {
+        p_disasm->p_flags[offset] |= DISASM_LEADER;
+    }
+}
+
+// Mark every reachable instruction, the same paths the cpu can take
+static void disasm_walk(disasm_t *p_disasm, uint32_t *p_work)
+{
+    const uint8_t *p_rom = p_disasm->p_rom;
+    size_t size = p_disasm->size;
+    size_t count = 0;
+
+    disasm_visit(p_disasm, p_work, &count, 0);
+    while(count > 0)
+    {
+        size_t offset = p_work[--count];
+        uint16_t opcode = disasm_word(p_rom, size, offset);
+        size_t next = offset + disasm_length(p_rom, size, offset);
+
+        if(4 == next - offset && offset + 2 < size)
+        {
+            p_disasm->p_flags[offset + 2] |= DISASM_OPERAND;
+        }
+
+        if(0x1 == (opcode >> 12) || 0x2 == (opcode >> 12))
+        {
+            disasm_visit(p_disasm, p_work, &count, disasm_target(opcode));
+        }
+        if(disasm_is_skip(opcode))
+        {
+            disasm_visit(p_disasm, p_work, &count, next + disasm_length(p_rom, size, next));
+        }
+        if(!disasm_is_terminal(opcode))
+        {
+            disasm_visit(p_disasm, p_work, &count, next);
+        }
+    }
+}
+
+// Blocks start at the entry point, branch targets and whatever follows a branch
+static size_t disasm_find_leaders(disasm_t *p_disasm)
+{
+    const uint8_t *p_rom = p_disasm->p_rom;
+    size_t size = p_disasm->size;
+    size_t leaders = 0;
+
+    disasm_lead(p_disasm, 0);
+    for(size_t offset = 0; offset < size; offset++)
+    {
+        if(p_disasm->p_flags[offset] & DISASM_CODE)
+        {
+            uint16_t opcode = disasm_word(p_rom, size, offset);
+            size_t next = offset + disasm_length(p_rom, size, offset);
+
+            if(0x1 == (opcode >> 12) || 0x2 == (opcode >> 12))
+            {
+                disasm_lead(p_disasm, disasm_target(opcode));
+            }
+            if(disasm_is_skip(opcode))
+            {
+                disasm_lead(p_disasm, next + disasm_length(p_rom, size, next));
+            }
+            if(disasm_is_skip(opcode) || disasm_is_terminal(opcode) || 0x2 == (opcode >> 12))
+            {
+                disasm_lead(p_disasm, next);
+            }
+        }
+    }
+
+    for(size_t offset = 0; offset < size; offset++)
+    {
+        if(p_disasm->p_flags[offset] & DISASM_LEADER)
+        {
+            leaders++;
+        }
+    }
+
+    return leaders;
+}
+
+static void disasm_edge(disasm_block_t *p_block, disasm_edge_t edge, uint32_t address)
+{
+    p_block->targets[p_block->edge_count] = address;
+    p_block->edges[p_block->edge_count] = (uint8_t)edge;
+    p_block->edge_count++;
+}
+
+// Runs from a leader until a branch or the next leader
+static void disasm_build_block(disasm_t *p_disasm, disasm_block_t *p_block, size_t offset)
+{
+    const uint8_t *p_rom = p_disasm->p_rom;
+    size_t size = p_disasm->size;
+    uint16_t opcode = 0;
+    size_t next = 0;
+
+    memset(p_block, 0, sizeof(*p_block));
+    p_block->start = (uint32_t)(START_ADDRESS + offset);
+
+    for(;;)
+    {
+        opcode = disasm_word(p_rom, size, offset);
+        next = offset + disasm_length(p_rom, size, offset);
+        p_disasm->instruction_count++;
+
+        if(disasm_is_skip(opcode) || disasm_is_terminal(opcode) || 0x2 == (opcode >> 12) ||
+           next >= size || !(p_disasm->p_flags[next] & DISASM_CODE) || (p_disasm->p_flags[next] & DISASM_LEADER))
+        {
+            break;
+        }
+        offset = next;
+    }
+    p_block->end = (uint32_t)(START_ADDRESS + next);
+
+    switch(opcode >> 12)
+    {
+        case 0x1:
+            disasm_edge(p_block, DISASM_EDGE_JUMP, opcode & 0x0FFFu);
+            break;
+        case 0x2:
+            disasm_edge(p_block, DISASM_EDGE_CALL, opcode & 0x0FFFu);
+            disasm_edge(p_block, DISASM_EDGE_NEXT, p_block->end);
+            break;
+        case 0xB:
+            p_block->indirect = true;
+            break;
+        default:
+            if(0x00EE == opcode || 0x00FD == opcode)
+            {
+                break;
+            }
+            disasm_edge(p_block, DISASM_EDGE_NEXT, p_block->end);
+            if(disasm_is_skip(opcode))
+            {
+                disasm_edge(p_block, DISASM_EDGE_SKIP, (uint32_t)(p_block->end + disasm_length(p_rom, size, next)));
+            }
+            break;
+    }
+}
+
+static void disasm_store(disasm_t *p_disasm, size_t offset, bool known, uint32_t address, uint32_t length)
+{
+    if(!known)
+    {
+        p_disasm->p_flags[offset] |= DISASM_UNRESOLVED;
+        p_disasm->unresolved_count++;
+        return;
+    }
+
+    for(uint32_t i = 0; i < length; i++)
+    {
+        uint32_t written = (address + i) & 0xFFFF;
+        if(written >= START_ADDRESS && written - START_ADDRESS < p_disasm->size)
+        {
+            p_disasm->p_flags[written - START_ADDRESS] |= DISASM_WRITTEN;
+        }
+    }
+}
+
+/*
+ * Follow I through each block from the constant loads that set it to the
+ * stores that use it. I is unknown again at the start of every block and
+ * after anything that moves it by a register or, depending on quirks, by
+ * the length of a load or store.
+ */
+static void disasm_find_stores(disasm_t *p_disasm, const disasm_block_t *p_block)
+{
+    const uint8_t *p_rom = p_disasm->p_rom;
+    size_t size = p_disasm->size;
+    uint32_t i = 0;
+    bool known = false;
+
+    for(size_t offset = p_block->start - START_ADDRESS; offset < p_block->end - START_ADDRESS;
+        offset += disasm_length(p_rom, size, offset))
+    {
+        uint16_t opcode = disasm_word(p_rom, size, offset);
+        uint32_t x = (opcode >> 8) & 0xF;
+        uint32_t y = (opcode >> 4) & 0xF;
+
+        if(0xA == (opcode >> 12))
+        {
+            i = opcode & 0x0FFFu;
+            known = true;
+        }
+        else if(0xF000 == opcode)
+        {
+            i = disasm_word(p_rom, size, offset + 2);
+            known = true;
+        }
+        else if(0x5002 == (opcode & 0xF00F))
+        {
+            disasm_store(p_disasm, offset, known, i, ((x > y) ? x - y : y - x) + 1);
+        }
+        else if(0xF033 == (opcode & 0xF0FF))
+        {
+            disasm_store(p_disasm, offset, known, i, 3);
+        }
+        else if(0xF055 == (opcode & 0xF0FF))
+        {
+            disasm_store(p_disasm, offset, known, i, x + 1);
+            known = false;
+        }
+        else if(0xF065 == (opcode & 0xF0FF) || 0xF01E == (opcode & 0xF0FF) ||
+                0xF029 == (opcode & 0xF0FF) || 0xF030 == (opcode & 0xF0FF))
+        {
+            known = false;
+        }
+    }
+}
+
+// Blocks holding an instruction that one of the stores writes over
+static void disasm_find_modified(disasm_t *p_disasm, disasm_block_t *p_block)
+{
+    const uint8_t *p_rom = p_disasm->p_rom;
+    size_t size = p_disasm->size;
+
+    for(size_t offset = p_block->start - START_ADDRESS; offset < p_block->end - START_ADDRESS;
+        offset += disasm_length(p_rom, size, offset))
+    {
+        size_t length = disasm_length(p_rom, size, offset);
+
+        for(size_t i = 0; i < length && offset + i < size; i++)
+        {
+            if(p_disasm->p_flags[offset + i] & DISASM_WRITTEN)
+            {
+                p_block->modified = true;
+                p_disasm->modified_count++;
+                break;
+            }
+        }
+    }
+}
+
+bool disasm_analyse(disasm_t *p_disasm, const uint8_t *p_rom, size_t size)
+{
+    uint32_t *p_work = NULL;
+    size_t leaders = 0;
+    size_t block = 0;
+
+    memset(p_disasm, 0, sizeof(*p_disasm));
+    if((NULL == p_rom && 0 != size) || size > XOCHIP_MEMORY_SIZE - START_ADDRESS)
+    {
+        return false;
+    }
+    p_disasm->p_rom = p_rom;
+    p_disasm->size = size;
+
+    // One more so an empty ROM still gets an allocation
+    p_disasm->p_flags = calloc(size + 1, 1);
+    // Every offset is queued at most once
+    p_work = malloc((size + 1) * sizeof(*p_work));
+    if(NULL == p_disasm->p_flags || NULL == p_work)
+    {
+        free(p_work);
+        disasm_free(p_disasm);
+        return false;
+    }
+    disasm_walk(p_disasm, p_work);
+    free(p_work);
+
+    leaders = disasm_find_leaders(p_disasm);
+    p_disasm->p_blocks = calloc(leaders + 1, sizeof(*p_disasm->p_blocks));
+    if(NULL == p_disasm->p_blocks)
+    {
+        disasm_free(p_disasm);
+        return false;
+    }
+
+    for(size_t offset = 0; offset < size; offset++)
+    {
+        if(p_disasm->p_flags[offset] & DISASM_LEADER)
+        {
+            disasm_build_block(p_disasm, &p_disasm->p_blocks[block++], offset);
+        }
+        if((p_disasm->p_flags[offset] & DISASM_CODE) && 0xB == (p_rom[offset] >> 4))
+        {
+            p_disasm->p_flags[offset] |= DISASM_INDIRECT;
+            p_disasm->indirect_count++;
+        }
+    }
+    p_disasm->block_count = block;
+
+    // Every store has to be seen before any block can be called unmodified
+    for(block = 0; block < p_disasm->block_count; block++)
+    {
+        disasm_find_stores(p_disasm, &p_disasm->p_blocks[block]);
+    }
+    for(block = 0; block < p_disasm->block_count; block++)
+    {
+        disasm_find_modified(p_disasm, &p_disasm->p_blocks[block]);
+    }
+
+    return true;
+}
+
+void disasm_free(disasm_t *p_disasm)
+{
+    free(p_disasm->p_flags);
+    free(p_disasm->p_blocks);
+    memset(p_disasm, 0, sizeof(*p_disasm));
+}
+
+int disasm_format(char *p_buffer, size_t size, uint16_t opcode, uint16_t operand)
+{
+    profile_op_t op = profile_classify(opcode);
+    const char *p_name = profile_op_name(op);
+    char text[32];
+    size_t length = 0;
+
+    if(PROFILE_OP_UNKNOWN == op)
+    {
+        return snprintf(p_buffer, size, ".word 0x%04X", opcode);
+    }
+
+    // Fill in the operands of the profiler's mnemonic, "DRW Vx, Vy, n"
+    for(const char *p_char = p_name; '\0' != *p_char && length < sizeof(text) - 8; p_char++)
+    {
+        size_t digits = strspn(p_char, "n");
+        int written = 0;
+
+        if('x' == *p_char)
+        {
+            written = snprintf(&text[length], sizeof(text) - length, "%X", (unsigned)(opcode >> 8) & 0xFu);
+        }
+        else if('y' == *p_char)
+        {
+            written = snprintf(&text[length], sizeof(text) - length, "%X", (unsigned)(opcode >> 4) & 0xFu);
+        }
+        else if(1 == digits)
+        {
+            // PLANE takes its mask in the x nibble
+            unsigned n = (PROFILE_OP_PLANE == op) ? (unsigned)(opcode >> 8) & 0xFu : opcode & 0xFu;
+            written = snprintf(&text[length], sizeof(text) - length, "%u", n);
+        }
+        else if(2 == digits)
+        {
+            written = snprintf(&text[length], sizeof(text) - length, "0x%02X", opcode & 0xFFu);
+        }
+        else if(3 == digits)
+        {
+            written = snprintf(&text[length], sizeof(text) - length, "0x%03X", opcode & 0xFFFu);
+        }
+        else if(4 == digits)
+        {
+            written = snprintf(&text[length], sizeof(text) - length, "0x%04X", operand);
+        }
+        else
+        {
+            text[length++] = *p_char;
+        }
+
+        if(written > 0)
+        {
+            length += (size_t)written;
+        }
+        if(digits > 1)
+        {
+            p_char += digits - 1;
+        }
+    }
+    text[length] = '\0';
+
+    return snprintf(p_buffer, size, "%s", text);
+}
+
+static void disasm_write_edges(const disasm_block_t *p_block, FILE *p_fp)
+{
+    const char *p_sep = "  ; ->";
+
+    for(uint8_t i = 0; i < p_block->edge_count; i++)
+    {
+        fprintf(p_fp, "%s %s 0x%04X", p_sep, edge_names[p_block->edges[i]], p_block->targets[i]);
+        p_sep = ",";
+    }
+    if(p_block->indirect)
+    {
+        fprintf(p_fp, "%s V0 + nnn", p_sep);
+    }
+}
+
+bool disasm_write_text(const disasm_t *p_disasm, FILE *p_fp)
+{
+    const uint8_t *p_rom = p_disasm->p_rom;
+    size_t size = p_disasm->size;
+    size_t block = 0;
+    size_t data = 0;
+
+    // Counted the way the listing below steps through the ROM
+    for(size_t offset = 0; offset < size;)
+    {
+        if(p_disasm->p_flags[offset] & DISASM_CODE)
+        {
+            offset += disasm_length(p_rom, size, offset);
+        }
+        else
+        {
+            data++;
+            offset++;
+        }
+    }
+    fprintf(p_fp, "; %zu bytes, %zu instructions in %zu blocks, %zu data bytes\n",
+            size, p_disasm->instruction_count, p_disasm->block_count, data);
+    fprintf(p_fp, "; %zu indirect jumps, %zu modified instructions, %zu stores through an unknown I\n",
+            p_disasm->indirect_count, p_disasm->modified_count, p_disasm->unresolved_count);
+
+    for(size_t offset = 0; offset < size;)
+    {
+        uint32_t address = (uint32_t)(START_ADDRESS + offset);
+        uint8_t flags = p_disasm->p_flags[offset];
+
+        if(flags & DISASM_CODE)
+        {
+            size_t length = disasm_length(p_rom, size, offset);
+            uint16_t opcode = disasm_word(p_rom, size, offset);
+            uint16_t operand = disasm_word(p_rom, size, offset + 2);
+            char text[32];
+            char bytes[16];
+
+            if(flags & DISASM_LEADER)
+            {
+                while(block < p_disasm->block_count && p_disasm->p_blocks[block].start < address)
+                {
+                    block++;
+                }
+                fprintf(p_fp, "\nblock_%04X:", address);
+                if(block < p_disasm->block_count)
+                {
+                    disasm_write_edges(&p_disasm->p_blocks[block], p_fp);
+                }
+                fprintf(p_fp, "\n");
+            }
+
+            disasm_format(text, sizeof(text), opcode, operand);
+            if(4 == length)
+            {
+                snprintf(bytes, sizeof(bytes), "%04X %04X", opcode, operand);
+            }
+            else
+            {
+                snprintf(bytes, sizeof(bytes), "%04X", opcode);
+            }
+            fprintf(p_fp, "    0x%04X  %-9s  %s", address, bytes, text);
+            if(flags & DISASM_INDIRECT)
+            {
+                fprintf(p_fp, "  ; indirect jump");
+            }
+            if(flags & DISASM_UNRESOLVED)
+            {
+                fprintf(p_fp, "  ; store through unknown I");
+            }
+            if((flags | p_disasm->p_flags[offset + 1]) & DISASM_WRITTEN)
+            {
+                fprintf(p_fp, "  ; modified by a store");
+            }
+            fprintf(p_fp, "\n");
+            offset += length;
+        }
+        else
+        {
+            // Up to eight bytes of data a line, stopping at the next instruction
+            fprintf(p_fp, "    0x%04X  .byte", address);
+            for(size_t i = 0; i < 8 && offset < size && !(p_disasm->p_flags[offset] & DISASM_CODE); i++)
+            {
+                fprintf(p_fp, "%s0x%02X", (0 == i) ? " " : ", ", p_rom[offset]);
+                offset++;
+            }
+            fprintf(p_fp, "\n");
+        }
+    }
+
+    return 0 == ferror(p_fp);
+}
+
+bool disasm_write_dot(const disasm_t *p_disasm, FILE *p_fp)
+{
+    const uint8_t *p_rom = p_disasm->p_rom;
+    size_t size = p_disasm->size;
+
+    fprintf(p_fp, "digraph rom {\n    node [shape=box, fontname=\"monospace\"];\n");
+    for(size_t block = 0; block < p_disasm->block_count; block++)
+    {
+        const disasm_block_t *p_block = &p_disasm->p_blocks[block];
+
+        fprintf(p_fp, "    b%04X [label=\"", p_block->start);
+        for(size_t offset = p_block->start - START_ADDRESS; offset < p_block->end - START_ADDRESS;
+            offset += disasm_length(p_rom, size, offset))
+        {
+            char text[32];
+
+            disasm_format(text, sizeof(text), disasm_word(p_rom, size, offset), disasm_word(p_rom, size, offset + 2));
+            fprintf(p_fp, "0x%04X  %s\\l", (uint32_t)(START_ADDRESS + offset), text);
+        }
+        fprintf(p_fp, "\"%s%s];\n", p_block->indirect ? ", style=dashed" : "",
+                p_block->modified ? ", color=red" : "");
+
+        for(uint8_t i = 0; i < p_block->edge_count; i++)
+        {
+            uint32_t target = p_block->targets[i];
+
+            // Somewhere outside the ROM, or the middle of an instruction
+            if(target < START_ADDRESS || target - START_ADDRESS >= size ||
+               !(p_disasm->p_flags[target - START_ADDRESS] & DISASM_LEADER))
+            {
+                fprintf(p_fp, "    b%04X [label=\"0x%04X\", shape=plaintext];\n", target, target);
+            }
+            fprintf(p_fp, "    b%04X -> b%04X [label=\"%s\"];\n", p_block->start, target, edge_names[p_block->edges[i]]);
+        }
+    }
+    fprintf(p_fp, "}\n");
+
+    return 0 == ferror(p_fp);
+}
@@ -0,0 +1,178 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FILE_MAP_MMAP
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#include "file_map.h"
+
+#if defined(_WIN32)
+
+bool file_map_open(file_map_t *p_map, const char *p_filename)
+{
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    LARGE_INTEGER size;
+    bool ok = false;
+
+    memset(p_map, 0, sizeof(*p_map));
+
+    file = CreateFileA(p_filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(INVALID_HANDLE_VALUE == file)
+    {
+        return false;
+    }
+
+    if(GetFileSizeEx(file, &size) && (uint64_t)size.QuadPart <= SIZE_MAX)
+    {
+        p_map->size = (size_t)size.QuadPart;
+        if(0 == p_map->size)
+        {
+            // Empty files can't be mapped, there's nothing to read anyway
+            ok = true;
+        }
+        else
+        {
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(NULL != mapping)
+            {
+                p_map->p_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                ok = NULL != p_map->p_data;
+                // The view keeps the mapping alive
+                CloseHandle(mapping);
+            }
+        }
+    }
+    CloseHandle(file);
+
+    if(!ok)
+    {
+        memset(p_map, 0, sizeof(*p_map));
+    }
+    return ok;
+}
+
+void file_map_close(file_map_t *p_map)
+{
+    if(NULL != p_map->p_data)
+    {
+        UnmapViewOfFile(p_map->p_data);
+    }
+    memset(p_map, 0, sizeof(*p_map));
+}
+
+#elif defined(FILE_MAP_MMAP)
+
+bool file_map_open(file_map_t *p_map, const char *p_filename)
+{
+    struct stat st;
+    void *p_data = NULL;
+    int fd = -1;
+
+    memset(p_map, 0, sizeof(*p_map));
+
+    fd = open(p_filename, O_RDONLY | O_CLOEXEC);
+    if(-1 == fd)
+    {
+        return false;
+    }
+
+    if(0 != fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size < 0 ||
+       (uintmax_t)st.st_size > SIZE_MAX)
+    {
+        close(fd);
+        return false;
+    }
+
+    p_map->size = (size_t)st.st_size;
+    if(0 != p_map->size)
+    {
+        p_data = mmap(NULL, p_map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping outlives the descriptor
+    close(fd);
+
+    if(MAP_FAILED == p_data)
+    {
+        memset(p_map, 0, sizeof(*p_map));
+        return false;
+    }
+    p_map->p_data = p_data;
+
+    return true;
+}
+
+void file_map_close(file_map_t *p_map)
+{
+    if(NULL != p_map->p_data)
+    {
+        munmap((void *)(uintptr_t)p_map->p_data, p_map->size);
+    }
+    memset(p_map, 0, sizeof(*p_map));
+}
+
+#else
+
+bool file_map_open(file_map_t *p_map, const char *p_filename)
+{
+    FILE *p_fp = NULL;
+    uint8_t *p_data = NULL;
+    long size = 0;
+    bool ok = false;
+
+    memset(p_map, 0, sizeof(*p_map));
+
+    p_fp = fopen(p_filename, "rb");
+    if(NULL == p_fp)
+    {
+        return false;
+    }
+
+    if(0 == fseek(p_fp, 0, SEEK_END) && (size = ftell(p_fp)) >= 0 && 0 == fseek(p_fp, 0, SEEK_SET))
+    {
+        p_map->size = (size_t)size;
+        if(0 == p_map->size)
+        {
+            ok = true;
+        }
+        else if(NULL != (p_data = malloc(p_map->size)))
+        {
+            ok = p_map->size == fread(p_data, 1, p_map->size, p_fp);
+        }
+    }
+    fclose(p_fp);
+
+    if(!ok)
+    {
+        free(p_data);
+        memset(p_map, 0, sizeof(*p_map));
+        return false;
+    }
+    p_map->p_data = p_data;
+
+    return true;
+}
+
+void file_map_close(file_map_t *p_map)
+{
+    free((void *)(uintptr_t)p_map->p_data);
+    memset(p_map, 0, sizeof(*p_map));
+}
+
+#endif
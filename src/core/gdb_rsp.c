@@ -0,0 +1,532 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gdb_rsp.h"
+
+// Where in a packet the next byte goes
+#define RSP_IDLE 0
+#define RSP_DATA 1
+#define RSP_CHECKSUM_HIGH 2
+#define RSP_CHECKSUM_LOW 3
+
+#define RSP_INTERRUPT 0x03
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int rsp_hex_value(char c)
+{
+    if(c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// A hex number of up to eight digits, advancing past it
+static bool rsp_parse_hex(const char **pp_text, uint32_t *p_value)
+{
+    const char *p_text = *pp_text;
+    uint32_t value = 0;
+    int digit = 0;
+    int count = 0;
+
+    while(count < 8 && (digit = rsp_hex_value(*p_text)) >= 0)
+    {
+        value = value << 4 | (uint32_t)digit;
+        p_text++;
+        count++;
+    }
+    *pp_text = p_text;
+    *p_value = value;
+
+    return count > 0;
+}
+
+// Little endian bytes of a register or memory, two hex digits each
+static bool rsp_parse_bytes(const char **pp_text, uint8_t *p_bytes, size_t count)
+{
+    const char *p_text = *pp_text;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        int high = rsp_hex_value(p_text[0]);
+        int low = (high < 0) ? -1 : rsp_hex_value(p_text[1]);
+
+        if(low < 0)
+        {
+            return false;
+        }
+        p_bytes[i] = (uint8_t)(high << 4 | low);
+        p_text += 2;
+    }
+    *pp_text = p_text;
+
+    return true;
+}
+
+static void rsp_put(gdb_rsp_t *p_rsp, const char *p_data, size_t size)
+{
+    // Nothing sent here is bigger than a packet, a stuck client loses replies
+    if(size > GDB_RSP_OUTPUT_SIZE - p_rsp->output_length)
+    {
+        return;
+    }
+    memcpy(&p_rsp->output[p_rsp->output_length], p_data, size);
+    p_rsp->output_length += size;
+}
+
+static void rsp_reply(gdb_rsp_t *p_rsp, const char *p_payload)
+{
+    size_t size = strlen(p_payload);
+    uint8_t checksum = 0;
+    char trailer[3];
+
+    for(size_t i = 0; i < size; i++)
+    {
+        checksum = (uint8_t)(checksum + (uint8_t)p_payload[i]);
+    }
+    trailer[0] = '#';
+    trailer[1] = hex_digits[checksum >> 4];
+    trailer[2] = hex_digits[checksum & 0xF];
+
+    rsp_put(p_rsp, "$", 1);
+    rsp_put(p_rsp, p_payload, size);
+    rsp_put(p_rsp, trailer, sizeof(trailer));
+}
+
+// Append count bytes as hex to p_text
+static char *rsp_format_bytes(char *p_text, const uint8_t *p_bytes, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        *p_text++ = hex_digits[p_bytes[i] >> 4];
+        *p_text++ = hex_digits[p_bytes[i] & 0xF];
+    }
+    *p_text = '\0';
+
+    return p_text;
+}
+
+static size_t rsp_register_size(uint32_t reg)
+{
+    return (GDB_RSP_REG_I == reg || GDB_RSP_REG_PC == reg) ? 2 : 1;
+}
+
+static void rsp_read_register(const chip8_t *p_cpu, uint32_t reg, uint8_t *p_bytes)
+{
+    uint16_t value = 0;
+
+    switch(reg)
+    {
+        case GDB_RSP_REG_I: value = p_cpu->index; break;
+        case GDB_RSP_REG_PC: value = p_cpu->pc; break;
+        case GDB_RSP_REG_SP: value = p_cpu->sp; break;
+        case GDB_RSP_REG_DT: value = p_cpu->delayTimer; break;
+        case GDB_RSP_REG_ST: value = p_cpu->soundTimer; break;
+        default: value = p_cpu->V[reg & 0xF]; break;
+    }
+    p_bytes[0] = (uint8_t)value;
+    p_bytes[1] = (uint8_t)(value >> 8);
+}
+
+static bool rsp_write_register(chip8_t *p_cpu, uint32_t reg, const uint8_t *p_bytes)
+{
+    uint16_t value = (uint16_t)(p_bytes[0] | ((2 == rsp_register_size(reg)) ? p_bytes[1] << 8 : 0));
+
+    switch(reg)
+    {
+        case GDB_RSP_REG_I: p_cpu->index = value; break;
+        case GDB_RSP_REG_PC: p_cpu->pc = value; break;
+        case GDB_RSP_REG_SP:
+            if(value >= STACK_SIZE)
+            {
+                return false;
+            }
+            p_cpu->sp = (uint8_t)value;
+            break;
+        case GDB_RSP_REG_DT: p_cpu->delayTimer = (uint8_t)value; break;
+        case GDB_RSP_REG_ST: p_cpu->soundTimer = (uint8_t)value; break;
+        default: p_cpu->V[reg & 0xF] = (uint8_t)value; break;
+    }
+
+    return true;
+}
+
+static void rsp_stop_reply(gdb_rsp_t *p_rsp)
+{
+    const debug_t *p_debug = p_rsp->p_cpu->p_debug;
+    char reply[32];
+
+    switch(p_debug->stop)
+    {
+        case DEBUG_WATCH_WRITE_HIT:
+            snprintf(reply, sizeof(reply), "T05watch:%x;", p_debug->stop_address);
+            break;
+        case DEBUG_WATCH_READ_HIT:
+            snprintf(reply, sizeof(reply), "T05rwatch:%x;", p_debug->stop_address);
+            break;
+        case DEBUG_PAUSED:
+            snprintf(reply, sizeof(reply), "T02");
+            break;
+        default:
+            snprintf(reply, sizeof(reply), "T05");
+            break;
+    }
+    rsp_reply(p_rsp, reply);
+}
+
+static void rsp_registers(gdb_rsp_t *p_rsp, bool write, const char *p_args)
+{
+    char reply[2 * 2 * GDB_RSP_REGS + 1];
+    char *p_text = reply;
+    uint8_t bytes[2];
+
+    for(uint32_t reg = 0; reg < GDB_RSP_REGS; reg++)
+    {
+        if(!write)
+        {
+            rsp_read_register(p_rsp->p_cpu, reg, bytes);
+            p_text = rsp_format_bytes(p_text, bytes, rsp_register_size(reg));
+        }
+        else if(!rsp_parse_bytes(&p_args, bytes, rsp_register_size(reg)) ||
+                !rsp_write_register(p_rsp->p_cpu, reg, bytes))
+        {
+            rsp_reply(p_rsp, "E01");
+            return;
+        }
+    }
+    rsp_reply(p_rsp, write ? "OK" : reply);
+}
+
+// p n, or P n=value
+static void rsp_register(gdb_rsp_t *p_rsp, bool write, const char *p_args)
+{
+    uint32_t reg = 0;
+    uint8_t bytes[2];
+    char reply[5];
+
+    if(!rsp_parse_hex(&p_args, &reg) || reg >= GDB_RSP_REGS)
+    {
+        rsp_reply(p_rsp, "E01");
+        return;
+    }
+    if(!write)
+    {
+        rsp_read_register(p_rsp->p_cpu, reg, bytes);
+        rsp_format_bytes(reply, bytes, rsp_register_size(reg));
+        rsp_reply(p_rsp, reply);
+        return;
+    }
+    if('=' != *p_args++ || !rsp_parse_bytes(&p_args, bytes, rsp_register_size(reg)) ||
+       !rsp_write_register(p_rsp->p_cpu, reg, bytes))
+    {
+        rsp_reply(p_rsp, "E01");
+        return;
+    }
+    rsp_reply(p_rsp, "OK");
+}
+
+// m addr,length or M addr,length:bytes
+static void rsp_memory(gdb_rsp_t *p_rsp, bool write, const char *p_args)
+{
+    chip8_t *p_cpu = p_rsp->p_cpu;
+    char reply[GDB_RSP_PACKET_SIZE + 1];
+    uint8_t bytes[GDB_RSP_PACKET_SIZE / 2]; // as many as fit in a packet
+    uint32_t address = 0;
+    uint32_t length = 0;
+
+    if(!rsp_parse_hex(&p_args, &address) || ',' != *p_args++ || !rsp_parse_hex(&p_args, &length) ||
+       address > p_cpu->memory_size || length > p_cpu->memory_size - address)
+    {
+        rsp_reply(p_rsp, "E01");
+        return;
+    }
+
+    if(!write)
+    {
+        // The client asks again for whatever doesn't fit
+        if(length > GDB_RSP_PACKET_SIZE / 2)
+        {
+            length = GDB_RSP_PACKET_SIZE / 2;
+        }
+        rsp_format_bytes(reply, &p_cpu->memory[address], length);
+        rsp_reply(p_rsp, reply);
+        return;
+    }
+    // Parse it all before touching memory, a bad packet mustn't leave half a write
+    if(length > sizeof(bytes) || ':' != *p_args++ || !rsp_parse_bytes(&p_args, bytes, length))
+    {
+        rsp_reply(p_rsp, "E01");
+        return;
+    }
+    memcpy(&p_cpu->memory[address], bytes, length);
+    rsp_reply(p_rsp, "OK");
+}
+
+// Z type,addr,kind and z type,addr,kind
+static void rsp_breakpoint(gdb_rsp_t *p_rsp, bool insert, const char *p_args)
+{
+    debug_t *p_debug = p_rsp->p_cpu->p_debug;
+    uint32_t type = 0;
+    uint32_t address = 0;
+    uint32_t kind = 0;
+
+    if(!rsp_parse_hex(&p_args, &type) || ',' != *p_args++ || !rsp_parse_hex(&p_args, &address) ||
+       ',' != *p_args++ || !rsp_parse_hex(&p_args, &kind) || address > 0xFFFF || kind > 0x10000)
+    {
+        rsp_reply(p_rsp, "E01");
+        return;
+    }
+
+    switch(type)
+    {
+        case 0: // software and hardware breakpoints are the same thing here
+        case 1:
+            debug_set_breakpoint(p_debug, (uint16_t)address, insert);
+            break;
+        case 2:
+            debug_set_watch(p_debug, (uint16_t)address, (uint16_t)kind, DEBUG_WATCH_WRITE, insert);
+            break;
+        case 3:
+            debug_set_watch(p_debug, (uint16_t)address, (uint16_t)kind, DEBUG_WATCH_READ, insert);
+            break;
+        case 4:
+            debug_set_watch(p_debug, (uint16_t)address, (uint16_t)kind, DEBUG_WATCH_READ | DEBUG_WATCH_WRITE, insert);
+            break;
+        default:
+            rsp_reply(p_rsp, "");
+            return;
+    }
+    rsp_reply(p_rsp, "OK");
+}
+
+// c [addr] and s [addr] resume from addr when given
+static void rsp_resume(gdb_rsp_t *p_rsp, bool step, const char *p_args)
+{
+    chip8_t *p_cpu = p_rsp->p_cpu;
+    uint32_t address = 0;
+
+    if(rsp_parse_hex(&p_args, &address))
+    {
+        p_cpu->pc = (uint16_t)address;
+    }
+
+    if(step)
+    {
+        debug_step(p_cpu);
+        rsp_stop_reply(p_rsp);
+        return;
+    }
+    debug_continue(p_cpu);
+    p_rsp->running = true;
+}
+
+// bs and bc, the stop reply says when there is no more history
+static void rsp_reverse(gdb_rsp_t *p_rsp, const char *p_args)
+{
+    bool moved = false;
+
+    if(NULL == p_rsp->p_history || ('s' != p_args[0] && 'c' != p_args[0]))
+    {
+        rsp_reply(p_rsp, "");
+        return;
+    }
+
+    if('s' == p_args[0])
+    {
+        moved = history_step_back(p_rsp->p_history, p_rsp->p_cpu);
+    }
+    else
+    {
+        moved = history_continue_back(p_rsp->p_history, p_rsp->p_cpu);
+    }
+    if(!moved)
+    {
+        rsp_reply(p_rsp, "T05replaylog:begin;");
+        return;
+    }
+    rsp_stop_reply(p_rsp);
+}
+
+static void rsp_handle(gdb_rsp_t *p_rsp)
+{
+    const char *p_packet = p_rsp->packet;
+
+    switch(p_packet[0])
+    {
+        case '?':
+            rsp_stop_reply(p_rsp);
+            break;
+        case 'g':
+        case 'G':
+            rsp_registers(p_rsp, 'G' == p_packet[0], p_packet + 1);
+            break;
+        case 'p':
+        case 'P':
+            rsp_register(p_rsp, 'P' == p_packet[0], p_packet + 1);
+            break;
+        case 'm':
+        case 'M':
+            rsp_memory(p_rsp, 'M' == p_packet[0], p_packet + 1);
+            break;
+        case 'Z':
+        case 'z':
+            rsp_breakpoint(p_rsp, 'Z' == p_packet[0], p_packet + 1);
+            break;
+        case 'c':
+        case 's':
+            rsp_resume(p_rsp, 's' == p_packet[0], p_packet + 1);
+            break;
+        case 'b':
+            rsp_reverse(p_rsp, p_packet + 1);
+            break;
+        case 'H':
+            rsp_reply(p_rsp, "OK");
+            break;
+        case 'D':
+            rsp_reply(p_rsp, "OK");
+            gdb_rsp_detach(p_rsp);
+            break;
+        case 'k':
+            gdb_rsp_detach(p_rsp);
+            p_rsp->killed = true;
+            break;
+        case 'q':
+            if(0 == strncmp(p_packet, "qSupported", strlen("qSupported")))
+            {
+                char reply[64];
+                snprintf(reply, sizeof(reply), "PacketSize=%x;QStartNoAckMode+%s", GDB_RSP_PACKET_SIZE,
+                         (NULL != p_rsp->p_history) ? ";ReverseStep+;ReverseContinue+" : "");
+                rsp_reply(p_rsp, reply);
+            }
+            else if(0 == strcmp(p_packet, "qAttached"))
+            {
+                rsp_reply(p_rsp, "1");
+            }
+            else
+            {
+                rsp_reply(p_rsp, "");
+            }
+            break;
+        case 'Q':
+            if(0 == strcmp(p_packet, "QStartNoAckMode"))
+            {
+                // This packet is still acknowledged, the ones after it aren't
+                rsp_reply(p_rsp, "OK");
+                p_rsp->no_ack = true;
+            }
+            else
+            {
+                rsp_reply(p_rsp, "");
+            }
+            break;
+        default:
+            // Unsupported, an empty reply says so
+            rsp_reply(p_rsp, "");
+            break;
+    }
+}
+
+void gdb_rsp_init(gdb_rsp_t *p_rsp, chip8_t *p_cpu)
+{
+    memset(p_rsp, 0, sizeof(*p_rsp));
+    p_rsp->p_cpu = p_cpu;
+    p_rsp->state = RSP_IDLE;
+    debug_pause(p_cpu->p_debug);
+}
+
+void gdb_rsp_receive(gdb_rsp_t *p_rsp, const uint8_t *p_data, size_t size)
+{
+    for(size_t i = 0; i < size && !p_rsp->detached; i++)
+    {
+        char c = (char)p_data[i];
+        int digit = rsp_hex_value(c);
+
+        switch(p_rsp->state)
+        {
+            case RSP_DATA:
+                if('#' == c)
+                {
+                    p_rsp->state = RSP_CHECKSUM_HIGH;
+                    break;
+                }
+                // Too long is kept counting so it can be refused whole
+                if(p_rsp->length < GDB_RSP_PACKET_SIZE)
+                {
+                    p_rsp->packet[p_rsp->length] = c;
+                }
+                p_rsp->length++;
+                p_rsp->checksum = (uint8_t)(p_rsp->checksum + (uint8_t)c);
+                break;
+            case RSP_CHECKSUM_HIGH:
+                p_rsp->received_checksum = (uint8_t)((digit < 0) ? 0 : digit << 4);
+                p_rsp->state = (digit < 0) ? RSP_IDLE : RSP_CHECKSUM_LOW;
+                break;
+            case RSP_CHECKSUM_LOW:
+                p_rsp->state = RSP_IDLE;
+                p_rsp->received_checksum = (uint8_t)(p_rsp->received_checksum | ((digit < 0) ? 0 : digit));
+                if(p_rsp->length > GDB_RSP_PACKET_SIZE || digit < 0 ||
+                   (!p_rsp->no_ack && p_rsp->received_checksum != p_rsp->checksum))
+                {
+                    rsp_put(p_rsp, "-", 1);
+                    break;
+                }
+                if(!p_rsp->no_ack)
+                {
+                    rsp_put(p_rsp, "+", 1);
+                }
+                p_rsp->packet[p_rsp->length] = '\0';
+                rsp_handle(p_rsp);
+                break;
+            default:
+                if('$' == c)
+                {
+                    p_rsp->state = RSP_DATA;
+                    p_rsp->length = 0;
+                    p_rsp->checksum = 0;
+                }
+                else if(RSP_INTERRUPT == c && p_rsp->running)
+                {
+                    // The stop reply follows from gdb_rsp_check_stop()
+                    debug_pause(p_rsp->p_cpu->p_debug);
+                }
+                // Acks for our replies, nothing is ever resent
+                break;
+        }
+    }
+}
+
+void gdb_rsp_check_stop(gdb_rsp_t *p_rsp)
+{
+    if(p_rsp->running && DEBUG_RUNNING != p_rsp->p_cpu->p_debug->stop)
+    {
+        p_rsp->running = false;
+        rsp_stop_reply(p_rsp);
+    }
+}
+
+void gdb_rsp_sent(gdb_rsp_t *p_rsp, size_t size)
+{
+    if(size >= p_rsp->output_length)
+    {
+        p_rsp->output_length = 0;
+        return;
+    }
+    memmove(p_rsp->output, &p_rsp->output[size], p_rsp->output_length - size);
+    p_rsp->output_length -= size;
+}
+
+void gdb_rsp_detach(gdb_rsp_t *p_rsp)
+{
+    debug_init(p_rsp->p_cpu->p_debug);
+    p_rsp->running = false;
+    p_rsp->detached = true;
+}
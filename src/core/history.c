@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "history.h"
+
+#define HISTORY_INITIAL_KEYFRAMES 64
+
+// Where the debugger stopped the cpu during a replay
+typedef struct history_hit
+{
+    bool found;
+    uint32_t frame;
+    uint32_t cycle;
+    debug_stop_t stop;
+    uint16_t address;
+} history_hit_t;
+
+static bool history_page_differs(const history_keyframe_t *p_keyframe, uint32_t page)
+{
+    return 0 != (p_keyframe->pages[page >> 3] & (1u << (page & 7)));
+}
+
+bool history_begin(history_t *p_history, const chip8_t *p_cpu, uint32_t cycles_per_frame, uint32_t interval)
+{
+    memset(p_history, 0, sizeof(*p_history));
+    p_history->p_base = malloc(p_cpu->memory_size);
+    if(NULL == p_history->p_base)
+    {
+        return false;
+    }
+    memcpy(p_history->p_base, p_cpu->memory, p_cpu->memory_size);
+    p_history->memory_size = p_cpu->memory_size;
+    p_history->interval = (0 == interval) ? HISTORY_DEFAULT_INTERVAL : interval;
+    movie_record_begin(&p_history->input, p_cpu, cycles_per_frame);
+
+    return true;
+}
+
+static bool history_capture(history_t *p_history, const chip8_t *p_cpu)
+{
+    history_keyframe_t keyframe;
+    uint32_t page_count = p_history->memory_size / HISTORY_PAGE_SIZE;
+    size_t changed = 0;
+    uint8_t *p_page = NULL;
+
+    memset(&keyframe, 0, sizeof(keyframe));
+    keyframe.frame = p_history->frame_count;
+
+    // Most of memory is the program and font, which rarely change
+    for(uint32_t page = 0; page < page_count; page++)
+    {
+        size_t offset = (size_t)page * HISTORY_PAGE_SIZE;
+
+        if(0 != memcmp(&p_cpu->memory[offset], &p_history->p_base[offset], HISTORY_PAGE_SIZE))
+        {
+            keyframe.pages[page >> 3] |= (uint8_t)(1u << (page & 7));
+            changed++;
+        }
+    }
+
+    if(p_history->keyframe_count == p_history->keyframe_capacity)
+    {
+        size_t capacity = (0 == p_history->keyframe_capacity) ? HISTORY_INITIAL_KEYFRAMES : p_history->keyframe_capacity * 2;
+        history_keyframe_t *p_keyframes = realloc(p_history->p_keyframes, capacity * sizeof(*p_keyframes));
+        if(NULL == p_keyframes)
+        {
+            return false;
+        }
+        p_history->p_keyframes = p_keyframes;
+        p_history->keyframe_capacity = capacity;
+    }
+
+    keyframe.p_state = malloc(sizeof(chip8_t) + changed * HISTORY_PAGE_SIZE);
+    if(NULL == keyframe.p_state)
+    {
+        return false;
+    }
+    memcpy(keyframe.p_state, p_cpu, sizeof(chip8_t));
+    p_page = keyframe.p_state + sizeof(chip8_t);
+    for(uint32_t page = 0; page < page_count; page++)
+    {
+        if(history_page_differs(&keyframe, page))
+        {
+            memcpy(p_page, &p_cpu->memory[(size_t)page * HISTORY_PAGE_SIZE], HISTORY_PAGE_SIZE);
+            p_page += HISTORY_PAGE_SIZE;
+        }
+    }
+
+    p_history->p_keyframes[p_history->keyframe_count++] = keyframe;
+
+    return true;
+}
+
+bool history_frame(history_t *p_history, const chip8_t *p_cpu)
+{
+    if(!movie_record_frame(&p_history->input, p_cpu->keypad_register))
+    {
+        return false;
+    }
+    if(0 == p_history->frame_count % p_history->interval && !history_capture(p_history, p_cpu))
+    {
+        movie_truncate(&p_history->input, p_history->frame_count);
+        return false;
+    }
+    p_history->frame_count++;
+
+    return true;
+}
+
+void history_free(history_t *p_history)
+{
+    for(size_t i = 0; i < p_history->keyframe_count; i++)
+    {
+        free(p_history->p_keyframes[i].p_state);
+    }
+    free(p_history->p_keyframes);
+    free(p_history->p_base);
+    movie_free(&p_history->input);
+    memset(p_history, 0, sizeof(*p_history));
+}
+
+// The last keyframe at or before frame
+static size_t history_keyframe_before(const history_t *p_history, uint32_t frame)
+{
+    size_t low = 0;
+    size_t high = p_history->keyframe_count;
+
+    while(high - low > 1)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if(p_history->p_keyframes[middle].frame <= frame)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static void history_restore(const history_t *p_history, const history_keyframe_t *p_keyframe, chip8_t *p_cpu)
+{
+    struct debug *p_debug = p_cpu->p_debug;
+    struct trace *p_trace = p_cpu->p_trace;
+#ifdef EMUEIGHT_PROFILE
+    profile_t *p_profile = p_cpu->p_profile;
+#endif
+    const uint8_t *p_page = p_keyframe->p_state + sizeof(chip8_t);
+    uint32_t page_count = p_history->memory_size / HISTORY_PAGE_SIZE;
+
+    memcpy(p_cpu, p_keyframe->p_state, sizeof(chip8_t));
+    p_cpu->p_debug = p_debug;
+    p_cpu->p_trace = p_trace;
+#ifdef EMUEIGHT_PROFILE
+    p_cpu->p_profile = p_profile;
+#endif
+
+    for(uint32_t page = 0; page < page_count; page++)
+    {
+        size_t offset = (size_t)page * HISTORY_PAGE_SIZE;
+
+        if(history_page_differs(p_keyframe, page))
+        {
+            memcpy(&p_cpu->memory[offset], p_page, HISTORY_PAGE_SIZE);
+            p_page += HISTORY_PAGE_SIZE;
+        }
+        else
+        {
+            memcpy(&p_cpu->memory[offset], &p_history->p_base[offset], HISTORY_PAGE_SIZE);
+        }
+    }
+}
+
+static bool history_before(uint32_t frame, uint32_t cycle, uint32_t end_frame, uint32_t end_cycle)
+{
+    return frame < end_frame || (frame == end_frame && cycle < end_cycle);
+}
+
+/*
+ * Replay from the start of frame, just restored from its keyframe, to
+ * end_cycle of end_frame with the keypad from the input log. Given p_hit,
+ * the debugger is left attached and every stop before the end is noted and
+ * run on from, so p_hit ends up with the last of them.
+ */
+static void history_run(history_t *p_history, chip8_t *p_cpu, uint32_t frame, uint32_t end_frame, uint32_t end_cycle,
+                        history_hit_t *p_hit)
+{
+    debug_t *p_debug = p_cpu->p_debug;
+    uint32_t cycles = p_history->input.cycles_per_frame;
+
+    movie_play_seek(&p_history->input, frame + 1);
+    for(;;)
+    {
+        uint32_t limit = (frame == end_frame) ? end_cycle : cycles;
+
+        while(p_cpu->frame_cycle < limit)
+        {
+            cpu_run(p_cpu, limit - p_cpu->frame_cycle);
+            if(NULL != p_hit && DEBUG_RUNNING != p_debug->stop)
+            {
+                if(history_before(frame, p_cpu->frame_cycle, end_frame, end_cycle))
+                {
+                    p_hit->found = true;
+                    p_hit->frame = frame;
+                    p_hit->cycle = p_cpu->frame_cycle;
+                    p_hit->stop = p_debug->stop;
+                    p_hit->address = p_debug->stop_address;
+                }
+                debug_continue(p_cpu);
+            }
+        }
+        if(frame == end_frame)
+        {
+            break;
+        }
+
+        cpu_timer_tick(p_cpu);
+        frame++;
+        movie_play_frame(&p_history->input, &p_cpu->keypad_register);
+    }
+}
+
+bool history_seek(history_t *p_history, chip8_t *p_cpu, uint32_t frame, uint32_t cycle)
+{
+    struct debug *p_debug = p_cpu->p_debug;
+    struct trace *p_trace = p_cpu->p_trace;
+#ifdef EMUEIGHT_PROFILE
+    profile_t *p_profile = p_cpu->p_profile;
+#endif
+    size_t keyframe = 0;
+
+    if(0 == p_history->keyframe_count || frame >= p_history->frame_count ||
+       (frame == p_history->frame_count - 1 && cycle > p_cpu->frame_cycle))
+    {
+        return false;
+    }
+
+    keyframe = history_keyframe_before(p_history, frame);
+    history_restore(p_history, &p_history->p_keyframes[keyframe], p_cpu);
+
+    // Nothing stops, counts or traces a replay
+    p_cpu->p_debug = NULL;
+    p_cpu->p_trace = NULL;
+#ifdef EMUEIGHT_PROFILE
+    p_cpu->p_profile = NULL;
+#endif
+    history_run(p_history, p_cpu, p_history->p_keyframes[keyframe].frame, frame, cycle, NULL);
+    p_cpu->p_debug = p_debug;
+    p_cpu->p_trace = p_trace;
+#ifdef EMUEIGHT_PROFILE
+    p_cpu->p_profile = p_profile;
+#endif
+
+    // What came after is forgotten, running on from here records it again
+    for(size_t i = keyframe + 1; i < p_history->keyframe_count; i++)
+    {
+        free(p_history->p_keyframes[i].p_state);
+    }
+    p_history->keyframe_count = keyframe + 1;
+    p_history->frame_count = frame + 1;
+    movie_truncate(&p_history->input, frame + 1);
+
+    return true;
+}
+
+bool history_step_back(history_t *p_history, chip8_t *p_cpu)
+{
+    debug_t *p_debug = p_cpu->p_debug;
+    uint32_t frame = p_history->frame_count - 1;
+    uint32_t cycle = p_cpu->frame_cycle;
+
+    if(0 == p_history->frame_count || (0 == frame && 0 == cycle))
+    {
+        return false;
+    }
+    if(0 != cycle)
+    {
+        cycle--;
+    }
+    else
+    {
+        frame--;
+        cycle = p_history->input.cycles_per_frame - 1;
+    }
+
+    if(!history_seek(p_history, p_cpu, frame, cycle))
+    {
+        return false;
+    }
+    p_debug->stop = DEBUG_STEPPED;
+    p_debug->stop_address = p_cpu->pc;
+    p_debug->stepping_over = false;
+
+    return true;
+}
+
+bool history_continue_back(history_t *p_history, chip8_t *p_cpu)
+{
+    debug_t *p_debug = p_cpu->p_debug;
+    struct trace *p_trace = p_cpu->p_trace;
+#ifdef EMUEIGHT_PROFILE
+    profile_t *p_profile = p_cpu->p_profile;
+#endif
+    history_hit_t hit;
+    uint32_t end_frame = p_history->frame_count - 1;
+    uint32_t end_cycle = p_cpu->frame_cycle;
+    size_t keyframe = 0;
+
+    if(0 == p_history->keyframe_count)
+    {
+        return false;
+    }
+    memset(&hit, 0, sizeof(hit));
+
+    // Search a keyframe's worth at a time, latest first
+    p_cpu->p_trace = NULL;
+#ifdef EMUEIGHT_PROFILE
+    p_cpu->p_profile = NULL;
+#endif
+    keyframe = history_keyframe_before(p_history, end_frame);
+    for(;;)
+    {
+        const history_keyframe_t *p_keyframe = &p_history->p_keyframes[keyframe];
+
+        history_restore(p_history, p_keyframe, p_cpu);
+        p_debug->stop = DEBUG_RUNNING;
+        p_debug->resuming = false;
+        p_debug->stepping_over = false;
+        history_run(p_history, p_cpu, p_keyframe->frame, end_frame, end_cycle, &hit);
+        if(hit.found || 0 == keyframe)
+        {
+            break;
+        }
+        end_frame = p_keyframe->frame;
+        end_cycle = 0;
+        keyframe--;
+    }
+    p_cpu->p_trace = p_trace;
+#ifdef EMUEIGHT_PROFILE
+    p_cpu->p_profile = p_profile;
+#endif
+
+    if(!hit.found)
+    {
+        history_seek(p_history, p_cpu, p_history->p_keyframes[0].frame, 0);
+        p_debug->stop = DEBUG_STEPPED;
+        p_debug->stop_address = p_cpu->pc;
+        return false;
+    }
+
+    history_seek(p_history, p_cpu, hit.frame, hit.cycle);
+    p_debug->stop = hit.stop;
+    p_debug->stop_address = hit.address;
+
+    return true;
+}
@@ -0,0 +1,191 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metrics.h"
+
+#define METRICS_TMP_SUFFIX ".tmp"
+
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+void metrics_init(metrics_t *p_metrics)
+{
+    memset(p_metrics, 0, sizeof(*p_metrics));
+}
+
+// Log-linear, each doubling split into METRICS_SUB_BUCKETS
+static uint32_t metrics_bucket(uint64_t us)
+{
+    uint32_t shift = 0;
+
+    while((us >> shift) >= 2 * METRICS_SUB_BUCKETS)
+    {
+        shift++;
+    }
+    if(shift > METRICS_MAX_SHIFT)
+    {
+        return METRICS_BUCKETS - 1;
+    }
+
+    return shift * METRICS_SUB_BUCKETS + (uint32_t)(us >> shift);
+}
+
+// Largest microsecond count that lands in bucket
+static uint64_t metrics_bucket_top(uint32_t bucket)
+{
+    uint32_t shift = 0;
+
+    if(bucket >= 2 * METRICS_SUB_BUCKETS)
+    {
+        shift = bucket / METRICS_SUB_BUCKETS - 1;
+    }
+
+    return ((uint64_t)(bucket - shift * METRICS_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+void metrics_frame(metrics_t *p_metrics, const chip8_t *p_cpu, uint64_t frame_ns)
+{
+    // A reset cpu counts from zero again
+    if(p_cpu->idle_cycles < p_metrics->cpu_idle_cycles)
+    {
+        p_metrics->cpu_idle_cycles = 0;
+    }
+
+    p_metrics->frames++;
+    p_metrics->cycles += p_cpu->frame_cycle;
+    p_metrics->idle_cycles += p_cpu->idle_cycles - p_metrics->cpu_idle_cycles;
+    p_metrics->cpu_idle_cycles = p_cpu->idle_cycles;
+    p_metrics->cycles_per_frame = p_cpu->frame_cycle;
+
+    if(frame_ns > METRICS_FRAME_BUDGET_NS)
+    {
+        p_metrics->late_frames++;
+    }
+    p_metrics->frame_ns_sum += frame_ns;
+    if(frame_ns > p_metrics->frame_ns_max)
+    {
+        p_metrics->frame_ns_max = frame_ns;
+    }
+    p_metrics->histogram[metrics_bucket(frame_ns / 1000)]++;
+}
+
+void metrics_rate(metrics_t *p_metrics, uint64_t now_ns)
+{
+    uint64_t instructions = p_metrics->cycles - p_metrics->idle_cycles;
+
+    if(0 != p_metrics->rate_ns && now_ns > p_metrics->rate_ns)
+    {
+        p_metrics->instructions_per_second = (double)(instructions - p_metrics->rate_instructions) * 1e9 /
+                                             (double)(now_ns - p_metrics->rate_ns);
+    }
+    p_metrics->rate_ns = now_ns;
+    p_metrics->rate_instructions = instructions;
+}
+
+double metrics_quantile(const metrics_t *p_metrics, double q)
+{
+    uint64_t rank = (uint64_t)(q * (double)p_metrics->frames);
+    uint64_t seen = 0;
+
+    if(0 == p_metrics->frames)
+    {
+        return 0.0;
+    }
+    if(rank >= p_metrics->frames)
+    {
+        rank = p_metrics->frames - 1;
+    }
+    for(uint32_t bucket = 0; bucket < METRICS_BUCKETS; bucket++)
+    {
+        seen += p_metrics->histogram[bucket];
+        if(seen > rank)
+        {
+            // A bucket's top can be past the longest frame actually in it
+            uint64_t top_ns = metrics_bucket_top(bucket) * 1000;
+
+            return (double)((top_ns < p_metrics->frame_ns_max) ? top_ns : p_metrics->frame_ns_max) / 1e9;
+        }
+    }
+
+    return (double)p_metrics->frame_ns_max / 1e9;
+}
+
+static void metrics_write_counter(FILE *p_fp, const char *p_name, const char *p_help, uint64_t value)
+{
+    fprintf(p_fp, "# HELP %s %s\n# TYPE %s counter\n%s %" PRIu64 "\n", p_name, p_help, p_name, p_name, value);
+}
+
+bool metrics_write(const metrics_t *p_metrics, FILE *p_fp)
+{
+    metrics_write_counter(p_fp, "emueight_frames_total", "Frames emulated.", p_metrics->frames);
+    metrics_write_counter(p_fp, "emueight_late_frames_total", "Frames that took longer than a 60Hz frame.",
+                          p_metrics->late_frames);
+    metrics_write_counter(p_fp, "emueight_skipped_frames_total", "Frames dropped to catch up after a stall.",
+                          p_metrics->skipped_frames);
+    metrics_write_counter(p_fp, "emueight_cycles_total", "Cycles run, executed or skipped as idle.",
+                          p_metrics->cycles);
+    metrics_write_counter(p_fp, "emueight_idle_cycles_total", "Cycles skipped as idle instead of executed.",
+                          p_metrics->idle_cycles);
+    metrics_write_counter(p_fp, "emueight_audio_underruns_total", "Times the sound card ran out of samples.",
+                          p_metrics->audio_underruns);
+
+    fprintf(p_fp, "# HELP emueight_cycles_per_frame Cycles in the last frame.\n"
+                  "# TYPE emueight_cycles_per_frame gauge\n"
+                  "emueight_cycles_per_frame %" PRIu32 "\n", p_metrics->cycles_per_frame);
+    fprintf(p_fp, "# HELP emueight_instructions_per_second Instructions executed per second, idle cycles aside.\n"
+                  "# TYPE emueight_instructions_per_second gauge\n"
+                  "emueight_instructions_per_second %.0f\n", p_metrics->instructions_per_second);
+
+    fprintf(p_fp, "# HELP emueight_frame_seconds Time taken by each frame.\n"
+                  "# TYPE emueight_frame_seconds summary\n");
+    for(size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++)
+    {
+        fprintf(p_fp, "emueight_frame_seconds{quantile=\"%g\"} %.6f\n", quantiles[i],
+                metrics_quantile(p_metrics, quantiles[i]));
+    }
+    fprintf(p_fp, "emueight_frame_seconds_sum %.6f\n"
+                  "emueight_frame_seconds_count %" PRIu64 "\n",
+            (double)p_metrics->frame_ns_sum / 1e9, p_metrics->frames);
+    fprintf(p_fp, "# HELP emueight_frame_seconds_max Longest frame.\n"
+                  "# TYPE emueight_frame_seconds_max gauge\n"
+                  "emueight_frame_seconds_max %.6f\n", (double)p_metrics->frame_ns_max / 1e9);
+
+    return !ferror(p_fp);
+}
+
+bool metrics_save(const metrics_t *p_metrics, const char *p_filename)
+{
+    size_t length = strlen(p_filename);
+    char *p_tmp = malloc(length + sizeof(METRICS_TMP_SUFFIX));
+    FILE *p_fp = NULL;
+    bool ok = false;
+
+    if(NULL == p_tmp)
+    {
+        return false;
+    }
+    memcpy(p_tmp, p_filename, length);
+    memcpy(p_tmp + length, METRICS_TMP_SUFFIX, sizeof(METRICS_TMP_SUFFIX));
+
+    p_fp = fopen(p_tmp, "w");
+    if(NULL != p_fp)
+    {
+        ok = metrics_write(p_metrics, p_fp);
+        ok = (0 == fclose(p_fp)) && ok;
+    }
+#if defined(_WIN32)
+    // rename() won't replace a file here
+    if(ok)
+    {
+        remove(p_filename);
+    }
+#endif
+    ok = ok && 0 == rename(p_tmp, p_filename);
+    if(!ok)
+    {
+        remove(p_tmp);
+    }
+    free(p_tmp);
+
+    return ok;
+}
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "movie.h"
+
+#define MOVIE_HEADER_SIZE 36
+#define MOVIE_RUN_SIZE 6
+#define MOVIE_INITIAL_RUNS 256
+
+static void put_u16(uint8_t *p_buf, uint16_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t *p_buf, uint32_t value)
+{
+    put_u16(p_buf, (uint16_t)value);
+    put_u16(p_buf + 2, (uint16_t)(value >> 16));
+}
+
+static void put_u64(uint8_t *p_buf, uint64_t value)
+{
+    put_u32(p_buf, (uint32_t)value);
+    put_u32(p_buf + 4, (uint32_t)(value >> 32));
+}
+
+static uint16_t get_u16(const uint8_t *p_buf)
+{
+    return (uint16_t)(p_buf[0] | (p_buf[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p_buf)
+{
+    return (uint32_t)get_u16(p_buf) | ((uint32_t)get_u16(p_buf + 2) << 16);
+}
+
+static uint64_t get_u64(const uint8_t *p_buf)
+{
+    return (uint64_t)get_u32(p_buf) | ((uint64_t)get_u32(p_buf + 4) << 32);
+}
+
+void movie_record_begin(movie_t *p_movie, const chip8_t *p_cpu, uint32_t cycles_per_frame)
+{
+    memset(p_movie, 0, sizeof(*p_movie));
+    p_movie->rng_seed = p_cpu->rng_seed;
+    p_movie->quirks = p_cpu->quirks;
+    p_movie->cycles_per_frame = cycles_per_frame;
+}
+
+static bool append_run(movie_t *p_movie, uint16_t keypad, uint32_t frames)
+{
+    movie_run_t *p_last = NULL;
+
+    if(0 == frames)
+    {
+        return true;
+    }
+
+    if(0 != p_movie->run_count)
+    {
+        p_last = &p_movie->p_runs[p_movie->run_count - 1];
+    }
+
+    if(NULL != p_last && p_last->keypad == keypad && frames <= UINT32_MAX - p_last->frames)
+    {
+        p_last->frames += frames;
+        p_movie->frame_count += frames;
+        return true;
+    }
+
+    if(p_movie->run_count == p_movie->run_capacity)
+    {
+        size_t capacity = (0 == p_movie->run_capacity) ? MOVIE_INITIAL_RUNS : p_movie->run_capacity * 2;
+        movie_run_t *p_runs = realloc(p_movie->p_runs, capacity * sizeof(*p_runs));
+        if(NULL == p_runs)
+        {
+            return false;
+        }
+        p_movie->p_runs = p_runs;
+        p_movie->run_capacity = capacity;
+    }
+
+    p_movie->p_runs[p_movie->run_count].keypad = keypad;
+    p_movie->p_runs[p_movie->run_count].frames = frames;
+    p_movie->run_count++;
+    p_movie->frame_count += frames;
+
+    return true;
+}
+
+bool movie_record_frame(movie_t *p_movie, uint16_t keypad)
+{
+    return append_run(p_movie, keypad, 1);
+}
+
+void movie_record_end(movie_t *p_movie, const chip8_t *p_cpu)
+{
+    p_movie->display_hash = cpu_display_hash(p_cpu);
+}
+
+void movie_play_begin(movie_t *p_movie, chip8_t *p_cpu)
+{
+    p_movie->play_run = 0;
+    p_movie->play_frame = 0;
+    p_cpu->quirks = p_movie->quirks;
+    cpu_seed_rng(p_cpu, p_movie->rng_seed);
+}
+
+bool movie_play_frame(movie_t *p_movie, uint16_t *p_keypad)
+{
+    if(p_movie->play_run >= p_movie->run_count)
+    {
+        return false;
+    }
+
+    const movie_run_t *p_run = &p_movie->p_runs[p_movie->play_run];
+    *p_keypad = p_run->keypad;
+
+    p_movie->play_frame++;
+    if(p_movie->play_frame == p_run->frames)
+    {
+        p_movie->play_run++;
+        p_movie->play_frame = 0;
+    }
+
+    return true;
+}
+
+bool movie_play_seek(movie_t *p_movie, uint32_t frame)
+{
+    if(frame > p_movie->frame_count)
+    {
+        return false;
+    }
+
+    p_movie->play_run = 0;
+    while(p_movie->play_run < p_movie->run_count && frame >= p_movie->p_runs[p_movie->play_run].frames)
+    {
+        frame -= p_movie->p_runs[p_movie->play_run].frames;
+        p_movie->play_run++;
+    }
+    p_movie->play_frame = frame;
+
+    return true;
+}
+
+void movie_truncate(movie_t *p_movie, uint32_t frame_count)
+{
+    uint32_t frames = 0;
+    size_t run = 0;
+
+    if(frame_count >= p_movie->frame_count)
+    {
+        return;
+    }
+
+    // Keep whole runs while they fit, then shorten the one that doesn't
+    while(run < p_movie->run_count && frames + p_movie->p_runs[run].frames <= frame_count)
+    {
+        frames += p_movie->p_runs[run].frames;
+        run++;
+    }
+    if(frames < frame_count)
+    {
+        p_movie->p_runs[run].frames = frame_count - frames;
+        run++;
+    }
+    p_movie->run_count = run;
+    p_movie->frame_count = frame_count;
+}
+
+bool movie_play_verify(const movie_t *p_movie, const chip8_t *p_cpu)
+{
+    return p_movie->display_hash == cpu_display_hash(p_cpu);
+}
+
+uint32_t movie_play_all(movie_t *p_movie, chip8_t *p_cpu)
+{
+    uint32_t frames = 0;
+
+    movie_play_begin(p_movie, p_cpu);
+    // Walk the runs directly, the hot loop never touches the cursor
+    for(size_t r = 0; r < p_movie->run_count; r++)
+    {
+        p_cpu->keypad_register = p_movie->p_runs[r].keypad;
+        for(uint32_t f = 0; f < p_movie->p_runs[r].frames; f++)
+        {
+            cpu_run(p_cpu, p_movie->cycles_per_frame);
+            cpu_timer_tick(p_cpu);
+        }
+        frames += p_movie->p_runs[r].frames;
+    }
+    p_movie->play_run = p_movie->run_count;
+
+    return frames;
+}
+
+bool movie_save(const movie_t *p_movie, const char *p_filename)
+{
+    uint8_t header[MOVIE_HEADER_SIZE];
+    FILE *p_fp = NULL;
+    bool ok = true;
+
+    if(NULL == p_filename || p_movie->run_count > UINT32_MAX)
+    {
+        return false;
+    }
+
+    p_fp = fopen(p_filename, "wb");
+    if(NULL == p_fp)
+    {
+        return false;
+    }
+
+    memcpy(header, MOVIE_MAGIC, 4);
+    put_u16(header + 4, MOVIE_VERSION);
+    put_u16(header + 6, 0);
+    put_u32(header + 8, p_movie->rng_seed);
+    put_u32(header + 12, p_movie->quirks);
+    put_u32(header + 16, p_movie->cycles_per_frame);
+    put_u32(header + 20, p_movie->frame_count);
+    put_u64(header + 24, p_movie->display_hash);
+    put_u32(header + 32, (uint32_t)p_movie->run_count);
+    ok = (1 == fwrite(header, sizeof(header), 1, p_fp));
+
+    for(size_t i = 0; ok && i < p_movie->run_count; i++)
+    {
+        uint8_t run[MOVIE_RUN_SIZE];
+        put_u16(run, p_movie->p_runs[i].keypad);
+        put_u32(run + 2, p_movie->p_runs[i].frames);
+        ok = (1 == fwrite(run, sizeof(run), 1, p_fp));
+    }
+
+    if(0 != fclose(p_fp))
+    {
+        ok = false;
+    }
+
+    return ok;
+}
+
+bool movie_load(movie_t *p_movie, const char *p_filename)
+{
+    uint8_t header[MOVIE_HEADER_SIZE];
+    FILE *p_fp = NULL;
+    uint32_t run_count = 0;
+
+    memset(p_movie, 0, sizeof(*p_movie));
+
+    if(NULL == p_filename)
+    {
+        return false;
+    }
+
+    p_fp = fopen(p_filename, "rb");
+    if(NULL == p_fp)
+    {
+        return false;
+    }
+
+    if(1 != fread(header, sizeof(header), 1, p_fp) ||
+       0 != memcmp(header, MOVIE_MAGIC, 4) ||
+       MOVIE_VERSION != get_u16(header + 4))
+    {
+        fclose(p_fp);
+        return false;
+    }
+
+    p_movie->rng_seed = get_u32(header + 8);
+    p_movie->quirks = get_u32(header + 12);
+    p_movie->cycles_per_frame = get_u32(header + 16);
+    p_movie->display_hash = get_u64(header + 24);
+    // frame_count is rebuilt from the runs as they are read
+    run_count = get_u32(header + 32);
+
+    for(uint32_t i = 0; i < run_count; i++)
+    {
+        uint8_t run[MOVIE_RUN_SIZE];
+        if(1 != fread(run, sizeof(run), 1, p_fp))
+        {
+            fclose(p_fp);
+            movie_free(p_movie);
+            return false;
+        }
+        // Merges adjacent runs and keeps frame_count honest
+        if(!append_run(p_movie, get_u16(run), get_u32(run + 2)))
+        {
+            fclose(p_fp);
+            movie_free(p_movie);
+            return false;
+        }
+    }
+
+    fclose(p_fp);
+
+    return true;
+}
+
+void movie_free(movie_t *p_movie)
+{
+    free(p_movie->p_runs);
+    p_movie->p_runs = NULL;
+    p_movie->run_count = 0;
+    p_movie->run_capacity = 0;
+}
@@ -0,0 +1,219 @@
+#include <inttypes.h>
+#include <string.h>
+
+#include "profile.h"
+
+static const char *op_names[PROFILE_OP_COUNT] =
+{
+    "CLS", "RET", "SCD n", "SCR", "SCL", "EXIT", "LOW", "HIGH",
+    "JP nnn", "CALL nnn", "SE Vx, nn", "SNE Vx, nn", "SE Vx, Vy",
+    "SAVE Vx-Vy", "LOAD Vx-Vy", "LD Vx, nn", "ADD Vx, nn", "LD Vx, Vy",
+    "OR Vx, Vy", "AND Vx, Vy", "XOR Vx, Vy", "ADD Vx, Vy", "SUB Vx, Vy",
+    "SHR Vx, Vy", "SUBN Vx, Vy", "SHL Vx, Vy", "SNE Vx, Vy", "LD I, nnn",
+    "JP V0, nnn", "RND Vx, nn", "DRW Vx, Vy, n", "SKP Vx", "SKNP Vx",
+    "LD I, nnnn", "PLANE n", "AUDIO", "LD Vx, DT", "LD Vx, K", "LD DT, Vx",
+    "LD ST, Vx", "ADD I, Vx", "LD F, Vx", "LD HF, Vx", "LD B, Vx",
+    "PITCH Vx", "LD [I], Vx", "LD Vx, [I]", "LD R, Vx", "LD Vx, R",
+    "UNKNOWN"
+};
+
+void profile_init(profile_t *p_profile, uint32_t memory_size)
+{
+    memset(p_profile, 0, sizeof(*p_profile));
+
+    // 4KB gets one bucket per instruction, 64KB one per 32 bytes
+    while(((uint32_t)PROFILE_PC_BUCKETS << p_profile->pc_shift) < memory_size)
+    {
+        p_profile->pc_shift++;
+    }
+}
+
+void profile_reset(profile_t *p_profile)
+{
+    uint8_t pc_shift = p_profile->pc_shift;
+
+    memset(p_profile, 0, sizeof(*p_profile));
+    p_profile->pc_shift = pc_shift;
+}
+
+profile_op_t profile_classify(uint16_t opcode)
+{
+    uint8_t n = (uint8_t)(opcode & 0xF);
+    uint8_t nn = (uint8_t)(opcode & 0xFF);
+
+    switch(opcode >> 12)
+    {
+        case 0x0:
+            if(0xC0 == (nn & 0xF0))
+            {
+                return PROFILE_OP_SCD;
+            }
+            switch(nn)
+            {
+                case 0xE0: return PROFILE_OP_CLS;
+                case 0xEE: return PROFILE_OP_RET;
+                case 0xFB: return PROFILE_OP_SCR;
+                case 0xFC: return PROFILE_OP_SCL;
+                case 0xFD: return PROFILE_OP_EXIT;
+                case 0xFE: return PROFILE_OP_LOW;
+                case 0xFF: return PROFILE_OP_HIGH;
+                default: return PROFILE_OP_UNKNOWN;
+            }
+        case 0x1: return PROFILE_OP_JP;
+        case 0x2: return PROFILE_OP_CALL;
+        case 0x3: return PROFILE_OP_SE_IMM;
+        case 0x4: return PROFILE_OP_SNE_IMM;
+        case 0x5:
+            switch(n)
+            {
+                case 0x0: return PROFILE_OP_SE_REG;
+                case 0x2: return PROFILE_OP_SAVE_RANGE;
+                case 0x3: return PROFILE_OP_LOAD_RANGE;
+                default: return PROFILE_OP_UNKNOWN;
+            }
+        case 0x6: return PROFILE_OP_LD_IMM;
+        case 0x7: return PROFILE_OP_ADD_IMM;
+        case 0x8:
+            switch(n)
+            {
+                case 0x0: return PROFILE_OP_LD_REG;
+                case 0x1: return PROFILE_OP_OR;
+                case 0x2: return PROFILE_OP_AND;
+                case 0x3: return PROFILE_OP_XOR;
+                case 0x4: return PROFILE_OP_ADD_REG;
+                case 0x5: return PROFILE_OP_SUB;
+                case 0x6: return PROFILE_OP_SHR;
+                case 0x7: return PROFILE_OP_SUBN;
+                case 0xE: return PROFILE_OP_SHL;
+                default: return PROFILE_OP_UNKNOWN;
+            }
+        case 0x9: return PROFILE_OP_SNE_REG;
+        case 0xA: return PROFILE_OP_LD_I;
+        case 0xB: return PROFILE_OP_JP_V0;
+        case 0xC: return PROFILE_OP_RND;
+        case 0xD: return PROFILE_OP_DRW;
+        case 0xE:
+            switch(nn)
+            {
+                case 0x9E: return PROFILE_OP_SKP;
+                case 0xA1: return PROFILE_OP_SKNP;
+                default: return PROFILE_OP_UNKNOWN;
+            }
+        default:
+            switch(nn)
+            {
+                case 0x00: return (0xF000 == opcode) ? PROFILE_OP_LD_I_LONG : PROFILE_OP_UNKNOWN;
+                case 0x01: return PROFILE_OP_PLANE;
+                case 0x02: return (0xF002 == opcode) ? PROFILE_OP_AUDIO : PROFILE_OP_UNKNOWN;
+                case 0x07: return PROFILE_OP_LD_VX_DT;
+                case 0x0A: return PROFILE_OP_LD_KEY;
+                case 0x15: return PROFILE_OP_LD_DT;
+                case 0x18: return PROFILE_OP_LD_ST;
+                case 0x1E: return PROFILE_OP_ADD_I;
+                case 0x29: return PROFILE_OP_LD_FONT;
+                case 0x30: return PROFILE_OP_LD_BIG_FONT;
+                case 0x33: return PROFILE_OP_BCD;
+                case 0x3A: return PROFILE_OP_PITCH;
+                case 0x55: return PROFILE_OP_STORE;
+                case 0x65: return PROFILE_OP_LOAD;
+                case 0x75: return PROFILE_OP_SAVE_FLAGS;
+                case 0x85: return PROFILE_OP_LOAD_FLAGS;
+                default: return PROFILE_OP_UNKNOWN;
+            }
+    }
+}
+
+const char *profile_op_name(profile_op_t op)
+{
+    return ((unsigned)op < PROFILE_OP_COUNT) ? op_names[op] : "UNKNOWN";
+}
+
+bool profile_write_json(const profile_t *p_profile, FILE *p_fp)
+{
+    const char *p_sep = "";
+
+    fprintf(p_fp, "{\n  \"total\": %" PRIu64 ",\n  \"pc_bucket_bytes\": %u,\n  \"opcodes\": [",
+            p_profile->total, 1u << p_profile->pc_shift);
+    for(unsigned op = 0; op < PROFILE_OP_COUNT; op++)
+    {
+        if(0 != p_profile->op_counts[op])
+        {
+            fprintf(p_fp, "%s\n    { \"op\": \"%s\", \"count\": %" PRIu64 " }",
+                    p_sep, op_names[op], p_profile->op_counts[op]);
+            p_sep = ",";
+        }
+    }
+
+    p_sep = "";
+    fprintf(p_fp, "\n  ],\n  \"pcs\": [");
+    for(unsigned bucket = 0; bucket < PROFILE_PC_BUCKETS; bucket++)
+    {
+        if(0 != p_profile->pc_counts[bucket])
+        {
+            fprintf(p_fp, "%s\n    { \"pc\": \"0x%04X\", \"count\": %" PRIu64 " }",
+                    p_sep, bucket << p_profile->pc_shift, p_profile->pc_counts[bucket]);
+            p_sep = ",";
+        }
+    }
+    fprintf(p_fp, "\n  ]\n}\n");
+
+    return 0 == ferror(p_fp);
+}
+
+bool profile_write_csv(const profile_t *p_profile, FILE *p_fp)
+{
+    // Mnemonics contain commas, so the key column is always quoted
+    fprintf(p_fp, "kind,key,count\n");
+    fprintf(p_fp, "total,\"\",%" PRIu64 "\n", p_profile->total);
+    for(unsigned op = 0; op < PROFILE_OP_COUNT; op++)
+    {
+        if(0 != p_profile->op_counts[op])
+        {
+            fprintf(p_fp, "opcode,\"%s\",%" PRIu64 "\n", op_names[op], p_profile->op_counts[op]);
+        }
+    }
+    for(unsigned bucket = 0; bucket < PROFILE_PC_BUCKETS; bucket++)
+    {
+        if(0 != p_profile->pc_counts[bucket])
+        {
+            fprintf(p_fp, "pc,\"0x%04X\",%" PRIu64 "\n", bucket << p_profile->pc_shift, p_profile->pc_counts[bucket]);
+        }
+    }
+
+    return 0 == ferror(p_fp);
+}
+
+bool profile_save(const profile_t *p_profile, const char *p_filename)
+{
+    const char *p_ext = NULL;
+    FILE *p_fp = NULL;
+    bool ok = false;
+
+    if(NULL == p_filename)
+    {
+        return false;
+    }
+
+    p_fp = fopen(p_filename, "w");
+    if(NULL == p_fp)
+    {
+        return false;
+    }
+
+    p_ext = strrchr(p_filename, '.');
+    if(NULL != p_ext && 0 == strcmp(p_ext, ".csv"))
+    {
+        ok = profile_write_csv(p_profile, p_fp);
+    }
+    else
+    {
+        ok = profile_write_json(p_profile, p_fp);
+    }
+
+    if(0 != fclose(p_fp))
+    {
+        ok = false;
+    }
+
+    return ok;
+}
@@ -0,0 +1,282 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+#include "file_map.h"
+#include "rom_cache.h"
+
+uint64_t rom_hash(const uint8_t *p_data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325u;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= p_data[i];
+        hash *= 0x100000001B3u;
+    }
+
+    return hash;
+}
+
+static uint16_t rom_opcode(const rom_image_t *p_image, size_t offset)
+{
+    return (uint16_t)(p_image->data[offset] << 8 | p_image->data[offset + 1]);
+}
+
+// The oldest platform an instruction exists on
+static rom_platform_t rom_opcode_platform(uint16_t opcode)
+{
+    if(0xF000 == opcode || 0xF002 == opcode || 0xF001 == (opcode & 0xF0FF) ||
+       0xF03A == (opcode & 0xF0FF) || 0x5002 == (opcode & 0xF00F) ||
+       0x5003 == (opcode & 0xF00F) || 0x00D0 == (opcode & 0xFFF0))
+    {
+        return ROM_PLATFORM_XOCHIP;
+    }
+    if(0x00C0 == (opcode & 0xFFF0) || (opcode >= 0x00FB && opcode <= 0x00FF) ||
+       0xF030 == (opcode & 0xF0FF) || 0xF075 == (opcode & 0xF0FF) ||
+       0xF085 == (opcode & 0xF0FF) || 0xD000 == (opcode & 0xF00F))
+    {
+        return ROM_PLATFORM_SCHIP;
+    }
+    return ROM_PLATFORM_CHIP8;
+}
+
+// Settings for the platform, overridden by the ROM database if it knows the ROM
+static bool rom_configure(const rom_cache_t *p_cache, rom_image_t *p_image, rom_platform_t platform)
+{
+    const rom_db_entry_t *p_entry = rom_db_search(p_cache->p_db, p_cache->db_count, p_image->hash);
+
+    memset(p_image->keys, ROM_DB_KEY_NONE, sizeof(p_image->keys));
+    if(NULL != p_entry)
+    {
+        platform = (rom_platform_t)p_entry->platform;
+    }
+
+    p_image->platform = platform;
+    switch(platform)
+    {
+        case ROM_PLATFORM_XOCHIP:
+            p_image->quirks = QUIRKS_XOCHIP;
+            p_image->memory_size = XOCHIP_MEMORY_SIZE;
+            break;
+        case ROM_PLATFORM_SCHIP:
+            p_image->quirks = QUIRKS_SCHIP;
+            p_image->memory_size = MEMORY_SIZE;
+            break;
+        default:
+            p_image->quirks = QUIRKS_CHIP8;
+            p_image->memory_size = MEMORY_SIZE;
+            break;
+    }
+
+    if(NULL != p_entry)
+    {
+        p_image->known = true;
+        p_image->quirks = p_entry->quirks;
+        p_image->tickrate = p_entry->tickrate;
+        memcpy(p_image->keys, p_entry->keys, sizeof(p_image->keys));
+    }
+
+    // Programs bigger than 4KB only fit XO-CHIP's memory
+    return p_image->size <= p_image->memory_size - START_ADDRESS;
+}
+
+/*
+ * Mark every instruction start the disassembler can reach from the entry
+ * point and guess the platform from what it finds there. Returns false when
+ * out of memory or the ROM doesn't fit its platform.
+ */
+static bool rom_analyse(const rom_cache_t *p_cache, rom_image_t *p_image, uint8_t *p_code_map)
+{
+    disasm_t disasm;
+    rom_platform_t platform = ROM_PLATFORM_CHIP8;
+
+    if(p_image->size > PROGRAM_MEMORY_SIZE)
+    {
+        platform = ROM_PLATFORM_XOCHIP;
+    }
+
+    if(!disasm_analyse(&disasm, p_image->data, p_image->size))
+    {
+        return false;
+    }
+
+    for(size_t offset = 0; offset < p_image->size; offset++)
+    {
+        if(disasm.p_flags[offset] & DISASM_CODE)
+        {
+            rom_platform_t opcode_platform = rom_opcode_platform(rom_opcode(p_image, offset));
+
+            p_code_map[offset >> 3] |= (uint8_t)(1u << (offset & 7));
+            if(opcode_platform > platform)
+            {
+                platform = opcode_platform;
+            }
+        }
+    }
+    disasm_free(&disasm);
+
+    return rom_configure(p_cache, p_image, platform);
+}
+
+void rom_cache_init(rom_cache_t *p_cache)
+{
+    memset(p_cache, 0, sizeof(*p_cache));
+    rom_cache_use_db(p_cache, rom_db_entries, rom_db_entry_count);
+}
+
+void rom_cache_use_db(rom_cache_t *p_cache, const rom_db_entry_t *p_db, size_t count)
+{
+    p_cache->p_db = p_db;
+    p_cache->db_count = count;
+}
+
+void rom_cache_free(rom_cache_t *p_cache)
+{
+    for(size_t i = 0; i < ROM_CACHE_BUCKETS; i++)
+    {
+        rom_image_t *p_image = p_cache->p_buckets[i];
+        while(NULL != p_image)
+        {
+            rom_image_t *p_next = p_image->p_next;
+            free(p_image);
+            p_image = p_next;
+        }
+    }
+    rom_cache_init(p_cache);
+}
+
+const rom_image_t *rom_cache_acquire(rom_cache_t *p_cache, const uint8_t *p_data, size_t size)
+{
+    uint64_t hash = 0;
+    rom_image_t **pp_bucket = NULL;
+    rom_image_t *p_image = NULL;
+    uint8_t *p_code_map = NULL;
+    size_t map_size = (size + 7) / 8;
+
+    if(NULL == p_data && 0 != size)
+    {
+        return NULL;
+    }
+    if(size > XOCHIP_MEMORY_SIZE - START_ADDRESS)
+    {
+        return NULL;
+    }
+
+    hash = rom_hash(p_data, size);
+    pp_bucket = &p_cache->p_buckets[hash & (ROM_CACHE_BUCKETS - 1)];
+
+    for(p_image = *pp_bucket; NULL != p_image; p_image = p_image->p_next)
+    {
+        // Compare the bytes too, a hash collision mustn't hand out the wrong program
+        if(hash == p_image->hash && size == p_image->size &&
+           (0 == size || 0 == memcmp(p_image->data, p_data, size)))
+        {
+            p_image->refs++;
+            return p_image;
+        }
+    }
+
+    p_image = calloc(1, sizeof(*p_image) + size + map_size);
+    if(NULL == p_image)
+    {
+        return NULL;
+    }
+    p_image->hash = hash;
+    p_image->size = size;
+    if(0 != size)
+    {
+        memcpy(p_image->data, p_data, size);
+    }
+    p_code_map = p_image->data + size;
+    p_image->p_code_map = p_code_map;
+
+    if(!rom_analyse(p_cache, p_image, p_code_map))
+    {
+        free(p_image);
+        return NULL;
+    }
+
+    p_image->refs = 1;
+    p_image->p_next = *pp_bucket;
+    *pp_bucket = p_image;
+    p_cache->count++;
+
+    return p_image;
+}
+
+const rom_image_t *rom_cache_acquire_file(rom_cache_t *p_cache, const char *p_filename)
+{
+    file_map_t rom;
+    const rom_image_t *p_image = NULL;
+
+    if(NULL == p_filename || !file_map_open(&rom, p_filename))
+    {
+        return NULL;
+    }
+
+    p_image = rom_cache_acquire(p_cache, rom.p_data, rom.size);
+    file_map_close(&rom);
+
+    return p_image;
+}
+
+void rom_cache_release(rom_cache_t *p_cache, const rom_image_t *p_image)
+{
+    rom_image_t **pp_link = NULL;
+
+    if(NULL == p_image)
+    {
+        return;
+    }
+
+    pp_link = &p_cache->p_buckets[p_image->hash & (ROM_CACHE_BUCKETS - 1)];
+    while(NULL != *pp_link && p_image != *pp_link)
+    {
+        pp_link = &(*pp_link)->p_next;
+    }
+    if(NULL == *pp_link)
+    {
+        // Not one of ours
+        return;
+    }
+
+    if(0 == --(*pp_link)->refs)
+    {
+        rom_image_t *p_dead = *pp_link;
+        *pp_link = p_dead->p_next;
+        free(p_dead);
+        p_cache->count--;
+    }
+}
+
+bool rom_image_is_code(const rom_image_t *p_image, uint32_t address)
+{
+    uint32_t offset = address - START_ADDRESS;
+
+    if(address < START_ADDRESS || offset >= p_image->size)
+    {
+        return false;
+    }
+
+    return 0 != (p_image->p_code_map[offset >> 3] & (1u << (offset & 7)));
+}
+
+chip8_t *rom_image_new_cpu(const rom_image_t *p_image)
+{
+    chip8_t *p_cpu = cpu_init_memory(p_image->memory_size);
+
+    if(NULL == p_cpu)
+    {
+        return NULL;
+    }
+
+    if(!cpu_load_program_mem(p_cpu, p_image->data, p_image->size))
+    {
+        cpu_free(p_cpu);
+        return NULL;
+    }
+    p_cpu->quirks = p_image->quirks;
+
+    return p_cpu;
+}
@@ -0,0 +1,43 @@
+#include "cpu.h"
+#include "rom_db.h"
+
+#define ROM_DB_NO_KEYS { ROM_DB_KEY_NONE, ROM_DB_KEY_NONE, ROM_DB_KEY_NONE, \
+                         ROM_DB_KEY_NONE, ROM_DB_KEY_NONE, ROM_DB_KEY_NONE }
+
+/*
+ * Known ROMs, sorted by hash. `emueight-headless` prints the hash of the ROM
+ * it runs; insert new entries in order, test_rom_db checks it. The last
+ * entry is a terminator that is never matched.
+ */
+const rom_db_entry_t rom_db_entries[] =
+{
+    { UINT64_MAX, QUIRKS_CHIP8, 0, ROM_PLATFORM_CHIP8, ROM_DB_NO_KEYS }
+};
+
+const size_t rom_db_entry_count = sizeof(rom_db_entries) / sizeof(rom_db_entries[0]) - 1;
+
+const rom_db_entry_t *rom_db_search(const rom_db_entry_t *p_table, size_t count, uint64_t hash)
+{
+    size_t low = 0;
+    size_t high = count;
+
+    while(low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if(p_table[mid].hash < hash)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return (low < count && hash == p_table[low].hash) ? &p_table[low] : NULL;
+}
+
+const rom_db_entry_t *rom_db_find(uint64_t hash)
+{
+    return rom_db_search(rom_db_entries, rom_db_entry_count, hash);
+}
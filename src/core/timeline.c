@@ -0,0 +1,92 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timeline.h"
+
+#define TIMELINE_PID 1
+
+bool timeline_init(timeline_t *p_timeline, uint32_t capacity, timeline_clock_t clock,
+                   const char *p_thread_name, uint32_t thread_id)
+{
+    uint32_t size = 1;
+
+    memset(p_timeline, 0, sizeof(*p_timeline));
+    if(0 == capacity)
+    {
+        capacity = TIMELINE_DEFAULT_EVENTS;
+    }
+    while(size < capacity && size <= UINT32_MAX / 2)
+    {
+        size *= 2;
+    }
+
+    p_timeline->p_events = malloc((size_t)size * sizeof(timeline_event_t));
+    if(NULL == p_timeline->p_events)
+    {
+        return false;
+    }
+    p_timeline->mask = size - 1;
+    p_timeline->clock = clock;
+    p_timeline->p_thread_name = p_thread_name;
+    p_timeline->thread_id = thread_id;
+
+    return true;
+}
+
+void timeline_free(timeline_t *p_timeline)
+{
+    free(p_timeline->p_events);
+    p_timeline->p_events = NULL;
+}
+
+// Trace event times are microseconds, kept to the nanosecond
+static void timeline_write_us(FILE *p_fp, uint64_t ns)
+{
+    fprintf(p_fp, "%" PRIu64 ".%03u", ns / 1000, (unsigned)(ns % 1000));
+}
+
+bool timeline_write_begin(FILE *p_fp)
+{
+    fprintf(p_fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                  "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"EmuEight\"}}",
+            TIMELINE_PID);
+
+    return !ferror(p_fp);
+}
+
+bool timeline_write(const timeline_t *p_timeline, FILE *p_fp)
+{
+    uint64_t capacity = (uint64_t)p_timeline->mask + 1;
+    uint64_t first = (p_timeline->head > capacity) ? p_timeline->head - capacity : 0;
+
+    if(NULL == p_timeline->p_events)
+    {
+        return true;
+    }
+
+    fprintf(p_fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%" PRIu32 ",\"args\":{\"name\":\"%s\"}}",
+            TIMELINE_PID, p_timeline->thread_id, p_timeline->p_thread_name);
+
+    // Oldest first, the names are literals with nothing to escape
+    for(uint64_t i = first; i < p_timeline->head; i++)
+    {
+        const timeline_event_t *p_event = &p_timeline->p_events[i & p_timeline->mask];
+
+        fprintf(p_fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%" PRIu32 ",\"ts\":",
+                p_event->p_name, TIMELINE_PID, p_timeline->thread_id);
+        timeline_write_us(p_fp, p_event->start);
+        fputs(",\"dur\":", p_fp);
+        timeline_write_us(p_fp, p_event->duration);
+        fputc('}', p_fp);
+    }
+
+    return !ferror(p_fp);
+}
+
+bool timeline_write_end(FILE *p_fp)
+{
+    fputs("\n]}\n", p_fp);
+
+    return !ferror(p_fp);
+}
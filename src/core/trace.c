@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define TRACE_HEADER_SIZE 8
+#define TRACE_BATCH_RECORDS 256 // serialised on the stack at a time
+
+static void put_u16(uint8_t *p_buf, uint16_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t *p_buf, uint32_t value)
+{
+    put_u16(p_buf, (uint16_t)value);
+    put_u16(p_buf + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p_buf)
+{
+    return (uint16_t)(p_buf[0] | (p_buf[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p_buf)
+{
+    return (uint32_t)get_u16(p_buf) | ((uint32_t)get_u16(p_buf + 2) << 16);
+}
+
+bool trace_init(trace_t *p_trace, uint32_t capacity)
+{
+    uint32_t size = TRACE_CHUNK_RECORDS;
+
+    memset(p_trace, 0, sizeof(*p_trace));
+    if(0 == capacity)
+    {
+        capacity = TRACE_DEFAULT_RECORDS;
+    }
+    while(size < capacity && size <= UINT32_MAX / 2)
+    {
+        size *= 2;
+    }
+
+    // Zeroed, a record lost before it was ever written still says what it stored
+    p_trace->p_records = calloc(size, sizeof(trace_record_t));
+    if(NULL == p_trace->p_records)
+    {
+        return false;
+    }
+    p_trace->mask = size - 1;
+
+    return true;
+}
+
+void trace_free(trace_t *p_trace)
+{
+    free(p_trace->p_records);
+    p_trace->p_records = NULL;
+}
+
+bool trace_write_header(FILE *p_fp)
+{
+    uint8_t header[TRACE_HEADER_SIZE];
+
+    memcpy(header, TRACE_MAGIC, 4);
+    put_u16(header + 4, TRACE_VERSION);
+    put_u16(header + 6, TRACE_RECORD_SIZE);
+
+    return 1 == fwrite(header, sizeof(header), 1, p_fp);
+}
+
+// Take the registers the record didn't store from the one before it
+static void trace_fill(trace_record_t *p_record, const trace_record_t *p_before)
+{
+    for(unsigned i = 0; i < NUM_REGISTERS; i++)
+    {
+        if(0 == (p_record->changed & (1u << i)))
+        {
+            p_record->V[i] = p_before->V[i];
+        }
+    }
+}
+
+void trace_overrun(trace_t *p_trace)
+{
+    const trace_record_t *p_lost = &p_trace->p_records[p_trace->head & p_trace->mask];
+    trace_record_t *p_next = &p_trace->p_records[(p_trace->head + 1) & p_trace->mask];
+
+    // The next one becomes the oldest, it needs what the lost one stored
+    // to still add up against the last record written out
+    trace_fill(p_next, p_lost);
+    p_next->changed |= p_lost->changed;
+}
+
+// Fill in what the record changed since the last one written out
+static void trace_delta(trace_t *p_trace, trace_record_t *p_record)
+{
+    const trace_record_t *p_last = &p_trace->last;
+    uint16_t changed = 0;
+
+    trace_fill(p_record, p_last);
+    for(unsigned i = 0; i < NUM_REGISTERS; i++)
+    {
+        changed |= (uint16_t)((p_last->V[i] != p_record->V[i]) << i);
+    }
+    p_record->changed = changed;
+    p_record->flags = (uint8_t)(((p_last->index != p_record->index) ? TRACE_CHANGED_INDEX : 0) |
+                                ((p_last->sp != p_record->sp) ? TRACE_CHANGED_SP : 0) |
+                                ((p_last->delay_timer != p_record->delay_timer) ? TRACE_CHANGED_DT : 0) |
+                                ((p_last->sound_timer != p_record->sound_timer) ? TRACE_CHANGED_ST : 0));
+    p_trace->last = *p_record;
+}
+
+static void trace_encode(const trace_record_t *p_record, uint8_t *p_buf)
+{
+    put_u32(p_buf, p_record->sequence);
+    put_u16(p_buf + 4, p_record->pc);
+    put_u16(p_buf + 6, p_record->opcode);
+    put_u16(p_buf + 8, p_record->changed);
+    put_u16(p_buf + 10, p_record->index);
+    p_buf[12] = p_record->flags;
+    p_buf[13] = p_record->sp;
+    p_buf[14] = p_record->delay_timer;
+    p_buf[15] = p_record->sound_timer;
+    memcpy(p_buf + 16, p_record->V, NUM_REGISTERS);
+}
+
+static void trace_decode(const uint8_t *p_buf, trace_record_t *p_record)
+{
+    p_record->sequence = get_u32(p_buf);
+    p_record->pc = get_u16(p_buf + 4);
+    p_record->opcode = get_u16(p_buf + 6);
+    p_record->changed = get_u16(p_buf + 8);
+    p_record->index = get_u16(p_buf + 10);
+    p_record->flags = p_buf[12];
+    p_record->sp = p_buf[13];
+    p_record->delay_timer = p_buf[14];
+    p_record->sound_timer = p_buf[15];
+    memcpy(p_record->V, p_buf + 16, NUM_REGISTERS);
+}
+
+bool trace_flush(trace_t *p_trace, FILE *p_fp, bool all)
+{
+    uint64_t capacity = (uint64_t)p_trace->mask + 1;
+    uint8_t batch[TRACE_BATCH_RECORDS * TRACE_RECORD_SIZE];
+
+    // Overwritten before they could be written out
+    if(p_trace->head - p_trace->tail > capacity)
+    {
+        p_trace->dropped += p_trace->head - capacity - p_trace->tail;
+        p_trace->tail = p_trace->head - capacity;
+    }
+
+    while(p_trace->head - p_trace->tail >= TRACE_CHUNK_RECORDS || (all && p_trace->head != p_trace->tail))
+    {
+        uint64_t pending = p_trace->head - p_trace->tail;
+        size_t count = (pending < TRACE_BATCH_RECORDS) ? (size_t)pending : TRACE_BATCH_RECORDS;
+
+        for(size_t i = 0; i < count; i++)
+        {
+            trace_record_t *p_record = &p_trace->p_records[(p_trace->tail + i) & p_trace->mask];
+
+            trace_delta(p_trace, p_record);
+            trace_encode(p_record, &batch[i * TRACE_RECORD_SIZE]);
+        }
+        if(count != fwrite(batch, TRACE_RECORD_SIZE, count, p_fp))
+        {
+            return false;
+        }
+        p_trace->tail += count;
+    }
+
+    return true;
+}
+
+bool trace_reader_open(trace_reader_t *p_reader, const char *p_filename)
+{
+    uint8_t header[TRACE_HEADER_SIZE];
+
+    p_reader->p_fp = fopen(p_filename, "rb");
+    if(NULL == p_reader->p_fp)
+    {
+        return false;
+    }
+
+    if(1 != fread(header, sizeof(header), 1, p_reader->p_fp) || 0 != memcmp(header, TRACE_MAGIC, 4) ||
+       TRACE_VERSION != get_u16(header + 4) || TRACE_RECORD_SIZE != get_u16(header + 6))
+    {
+        trace_reader_close(p_reader);
+        return false;
+    }
+
+    return true;
+}
+
+bool trace_reader_next(trace_reader_t *p_reader, trace_record_t *p_record)
+{
+    uint8_t buf[TRACE_RECORD_SIZE];
+
+    if(1 != fread(buf, sizeof(buf), 1, p_reader->p_fp))
+    {
+        return false;
+    }
+    trace_decode(buf, p_record);
+
+    return true;
+}
+
+void trace_reader_close(trace_reader_t *p_reader)
+{
+    if(NULL != p_reader->p_fp)
+    {
+        fclose(p_reader->p_fp);
+        p_reader->p_fp = NULL;
+    }
+}
@@ -0,0 +1,174 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu.h"
+
+#define BENCH_FRAMES 20000
+#define BENCH_CYCLES_PER_FRAME 1000
+#define BENCH_RUNS 5 // best of, to ride out a noisy host
+#define BENCH_INSTANCES 64 // cpus run side by side a frame at a time, as a multi-game host would
+
+typedef struct workload
+{
+    const char *p_name;
+    const uint8_t *p_program;
+    size_t size;
+    uint32_t quirks;
+} workload_t;
+
+// Annn Dxyn with the sprite moving right each time round
+static const uint8_t sprites[] = { 0xA0, 0x00, 0xD0, 0x15, 0x70, 0x01, 0x12, 0x00 };
+// 7xnn 3xnn loop counter
+static const uint8_t counter[] = { 0x70, 0x01, 0x30, 0x00, 0x12, 0x00, 0x12, 0x00 };
+// Fx07 3x00 delay timer poll
+static const uint8_t delay[] = { 0xF0, 0x07, 0x30, 0x00, 0x12, 0x00, 0x12, 0x00 };
+// 6xnn run
+static const uint8_t loads[] =
+{
+    0x60, 0x01, 0x61, 0x02, 0x62, 0x03, 0x63, 0x04,
+    0x64, 0x05, 0x65, 0x06, 0x66, 0x07, 0x67, 0x08, 0x12, 0x00
+};
+// Nothing to fuse, the cost of looking
+static const uint8_t arithmetic[] = { 0x80, 0x14, 0x81, 0x25, 0x82, 0x03, 0x12, 0x00 };
+
+static const workload_t workloads[] =
+{
+    { "sprites", sprites, sizeof(sprites), QUIRKS_SCHIP },
+    { "counter", counter, sizeof(counter), QUIRKS_CHIP8 },
+    { "delay", delay, sizeof(delay), QUIRKS_CHIP8 },
+    { "loads", loads, sizeof(loads), QUIRKS_CHIP8 },
+    { "arithmetic", arithmetic, sizeof(arithmetic), QUIRKS_CHIP8 },
+};
+
+static chip8_t *new_cpu(const workload_t *p_workload)
+{
+    chip8_t *p_cpu = cpu_init();
+
+    if(NULL != p_cpu)
+    {
+        p_cpu->quirks = p_workload->quirks;
+        cpu_seed_rng(p_cpu, CPU_DEFAULT_SEED);
+        memcpy(&p_cpu->memory[START_ADDRESS], p_workload->p_program, p_workload->size);
+    }
+
+    return p_cpu;
+}
+
+// Instructions per second running the workload, through cpu_run() or one cpu_cycle() at a time
+static double bench(const workload_t *p_workload, bool plain, uint64_t *p_hash)
+{
+    chip8_t *p_cpu = new_cpu(p_workload);
+    clock_t start = 0;
+    double seconds = 0.0;
+
+    if(NULL == p_cpu)
+    {
+        return 0.0;
+    }
+
+    start = clock();
+    for(uint32_t frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+        if(plain)
+        {
+            for(uint32_t i = 0; i < BENCH_CYCLES_PER_FRAME; i++)
+            {
+                cpu_cycle(p_cpu);
+                p_cpu->frame_cycle++;
+            }
+        }
+        else
+        {
+            cpu_run(p_cpu, BENCH_CYCLES_PER_FRAME);
+        }
+        cpu_timer_tick(p_cpu);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    *p_hash = cpu_display_hash(p_cpu);
+    cpu_free(p_cpu);
+
+    return (seconds > 0.0) ? (double)BENCH_FRAMES * BENCH_CYCLES_PER_FRAME / seconds : 0.0;
+}
+
+/*
+ * As bench() through cpu_run(), the same number of instructions spread
+ * over BENCH_INSTANCES cpus taking turns a frame at a time, so each one's
+ * state has to come back into the cache every frame.
+ */
+static double bench_instances(const workload_t *p_workload)
+{
+    chip8_t *p_cpus[BENCH_INSTANCES];
+    uint32_t created = 0;
+    clock_t start = 0;
+    double seconds = 0.0;
+
+    for(created = 0; created < BENCH_INSTANCES; created++)
+    {
+        p_cpus[created] = new_cpu(p_workload);
+        if(NULL == p_cpus[created])
+        {
+            break;
+        }
+    }
+
+    if(BENCH_INSTANCES == created)
+    {
+        start = clock();
+        for(uint32_t frame = 0; frame < BENCH_FRAMES / BENCH_INSTANCES; frame++)
+        {
+            for(uint32_t i = 0; i < BENCH_INSTANCES; i++)
+            {
+                cpu_run(p_cpus[i], BENCH_CYCLES_PER_FRAME);
+                cpu_timer_tick(p_cpus[i]);
+            }
+        }
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+
+    while(created > 0)
+    {
+        cpu_free(p_cpus[--created]);
+    }
+
+    return (seconds > 0.0) ? (double)(BENCH_FRAMES / BENCH_INSTANCES) * BENCH_INSTANCES * BENCH_CYCLES_PER_FRAME / seconds : 0.0;
+}
+
+int main(void)
+{
+    int status = EXIT_SUCCESS;
+
+    printf("%-12s %12s %12s %8s %7u cpus\n", "workload", "plain MIPS", "run MIPS", "speedup", BENCH_INSTANCES);
+    for(size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        uint64_t plain_hash = 0;
+        uint64_t run_hash = 0;
+        double plain = 0.0;
+        double run = 0.0;
+        double instances = 0.0;
+
+        for(unsigned r = 0; r < BENCH_RUNS; r++)
+        {
+            double rate = bench(&workloads[i], true, &plain_hash);
+            plain = (rate > plain) ? rate : plain;
+            rate = bench(&workloads[i], false, &run_hash);
+            run = (rate > run) ? rate : run;
+            rate = bench_instances(&workloads[i]);
+            instances = (rate > instances) ? rate : instances;
+        }
+
+        printf("%-12s %12.1f %12.1f %7.2fx %12.1f\n", workloads[i].p_name,
+               plain / 1e6, run / 1e6, (plain > 0.0) ? run / plain : 0.0, instances / 1e6);
+        if(plain_hash != run_hash)
+        {
+            printf("%-12s display hash MISMATCH %016" PRIx64 " != %016" PRIx64 "\n",
+                   workloads[i].p_name, run_hash, plain_hash);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,130 @@
+#include "unity.h"
+#include "beeper.h"
+#include "cpu.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_SAMPLE_RATE 48000
+#define TEST_FRAME_SAMPLES 800
+
+chip8_t *p_cpu;
+beeper_t beeper;
+int16_t samples[TEST_FRAME_SAMPLES];
+
+void setUp(void)
+{
+    p_cpu = cpu_init();
+    beeper_init(&beeper, TEST_SAMPLE_RATE);
+    memset(samples, 0x55, sizeof(samples));
+}
+
+void tearDown(void)
+{
+    cpu_free(p_cpu);
+}
+
+static size_t count_nonzero(size_t from, size_t to)
+{
+    size_t count = 0;
+    for(size_t i = from; i < to; i++)
+    {
+        if(0 != samples[i])
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void test_silent_frame(void)
+{
+    cpu_run(p_cpu, 10);
+    beeper_render_frame(&beeper, p_cpu, samples, TEST_FRAME_SAMPLES);
+    TEST_ASSERT_EQUAL(0, count_nonzero(0, TEST_FRAME_SAMPLES));
+}
+
+void test_tone_while_sound_timer_runs(void)
+{
+    p_cpu->soundTimer = 2;
+    cpu_timer_tick(p_cpu);
+    TEST_ASSERT_TRUE(p_cpu->sound_gate);
+    cpu_run(p_cpu, 10);
+    beeper_render_frame(&beeper, p_cpu, samples, TEST_FRAME_SAMPLES);
+    // The band-limited edges pass through zero, everything else is tone
+    TEST_ASSERT_GREATER_THAN(TEST_FRAME_SAMPLES * 9 / 10, count_nonzero(0, TEST_FRAME_SAMPLES));
+    for(size_t i = 0; i < TEST_FRAME_SAMPLES; i++)
+    {
+        TEST_ASSERT_TRUE(samples[i] <= BEEPER_AMPLITUDE * 2);
+        TEST_ASSERT_TRUE(samples[i] >= -BEEPER_AMPLITUDE * 2);
+    }
+}
+
+void test_start_mid_frame(void)
+{
+    // 0x600A, 10 cycles of padding, then 0xF018 (LD ST, V0) at cycle 10
+    p_cpu->memory[0x200] = 0x60;
+    p_cpu->memory[0x201] = 0x0A;
+    for(int i = 0; i < 9; i++)
+    {
+        p_cpu->memory[0x202 + i * 2] = 0x61;
+        p_cpu->memory[0x203 + i * 2] = 0x00;
+    }
+    p_cpu->memory[0x214] = 0xF0;
+    p_cpu->memory[0x215] = 0x18;
+    cpu_run(p_cpu, 20);
+    TEST_ASSERT_EQUAL(1, p_cpu->sound_edge_count);
+    TEST_ASSERT_EQUAL(10, p_cpu->sound_edges[0]);
+
+    beeper_render_frame(&beeper, p_cpu, samples, TEST_FRAME_SAMPLES);
+    // Silent for the first half of the frame, sounding for the second
+    TEST_ASSERT_EQUAL(0, count_nonzero(0, TEST_FRAME_SAMPLES / 2));
+    TEST_ASSERT_GREATER_THAN(TEST_FRAME_SAMPLES * 9 / 20, count_nonzero(TEST_FRAME_SAMPLES / 2, TEST_FRAME_SAMPLES));
+}
+
+void test_stop_ramps_to_silence(void)
+{
+    p_cpu->soundTimer = 2;
+    cpu_timer_tick(p_cpu);
+    cpu_run(p_cpu, 1);
+    beeper_render_frame(&beeper, p_cpu, samples, TEST_FRAME_SAMPLES);
+    cpu_timer_tick(p_cpu);
+    TEST_ASSERT_FALSE(p_cpu->sound_gate);
+    cpu_run(p_cpu, 1);
+    beeper_render_frame(&beeper, p_cpu, samples, TEST_FRAME_SAMPLES);
+    TEST_ASSERT_TRUE(count_nonzero(0, BEEPER_RAMP_SAMPLES) > 0);
+    TEST_ASSERT_EQUAL(0, count_nonzero(BEEPER_RAMP_SAMPLES, TEST_FRAME_SAMPLES));
+}
+
+void test_audio_pattern(void)
+{
+    // 0xF0 repeated is a square wave of 8 pattern bits, 500Hz at the default pitch
+    memset(p_cpu->audio_pattern, 0xF0, sizeof(p_cpu->audio_pattern));
+    p_cpu->audio_pattern_active = true;
+    p_cpu->soundTimer = 2;
+    cpu_timer_tick(p_cpu);
+    cpu_run(p_cpu, 10);
+    beeper_render_frame(&beeper, p_cpu, samples, TEST_FRAME_SAMPLES);
+    size_t sign_changes = 0;
+    for(size_t i = BEEPER_RAMP_SAMPLES + 1; i < TEST_FRAME_SAMPLES; i++)
+    {
+        if((samples[i] > 0) != (samples[i - 1] > 0))
+        {
+            sign_changes++;
+        }
+    }
+    // 500Hz over 1/60s is ~16.7 half periods
+    TEST_ASSERT_TRUE(sign_changes >= 15 && sign_changes <= 18);
+    TEST_ASSERT_EQUAL(0, TEST_FRAME_SAMPLES - BEEPER_RAMP_SAMPLES - count_nonzero(BEEPER_RAMP_SAMPLES, TEST_FRAME_SAMPLES));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_silent_frame);
+    RUN_TEST(test_tone_while_sound_timer_runs);
+    RUN_TEST(test_start_mid_frame);
+    RUN_TEST(test_stop_ramps_to_silence);
+    RUN_TEST(test_audio_pattern);
+    return UNITY_END();
+}
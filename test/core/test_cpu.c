@@ -1,6 +1,7 @@
 #include "unity.h"
 #include "cpu.h"
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -16,18 +17,20 @@ void setUp(void)
 void tearDown(void) 
 {
     // Clean up code after each test
-    free(p_cpu);
+    cpu_free(p_cpu);
 }
 
 void test_00e0(void) 
 {
     // 0x00E0 (CLS) Clear the display
-    memset(p_cpu->vram, 1, sizeof(p_cpu->vram));
+    memset(p_cpu->vram[0], 0xFF, sizeof(p_cpu->vram[0]));
     p_cpu->memory[p_cpu->pc] = 0x00;
     p_cpu->memory[p_cpu->pc + 1] = 0xE0;
     cpu_cycle(p_cpu);
-    for(int i = 0; i < DISPLAY_H * DISPLAY_W; i++) {
-        TEST_ASSERT_EQUAL(0, p_cpu->vram[i]);
+    for(unsigned y = 0; y < DISPLAY_H; y++) {
+        for(unsigned x = 0; x < DISPLAY_W; x++) {
+            TEST_ASSERT_FALSE(cpu_pixel(p_cpu, x, y));
+        }
     }
 }
 
@@ -336,11 +339,14 @@ void test_dxyn(void)
     p_cpu->memory[3] = 0xFF;
     p_cpu->memory[4] = 0xFF;
     cpu_cycle(p_cpu);
-    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_cpu->vram[0]);
-    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_cpu->vram[1]);
-    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_cpu->vram[2]);
-    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_cpu->vram[3]);
-    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_cpu->vram[4]);
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 0, 0));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 1, 0));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 2, 0));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 3, 0));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 4, 0));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 7, 4));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 8, 0));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 0, 5));
     TEST_ASSERT_EQUAL(0, p_cpu->V[0xF]);
     // Test when there is a collision
     p_cpu->memory[p_cpu->pc] = 0xD0;
@@ -348,11 +354,11 @@ void test_dxyn(void)
     p_cpu->index = 0;
     p_cpu->display_wait = false;
     cpu_cycle(p_cpu);
-    TEST_ASSERT_EQUAL(0x0, p_cpu->vram[0]);
-    TEST_ASSERT_EQUAL(0x0, p_cpu->vram[1]);
-    TEST_ASSERT_EQUAL(0x0, p_cpu->vram[2]);
-    TEST_ASSERT_EQUAL(0x0, p_cpu->vram[3]);
-    TEST_ASSERT_EQUAL(0x0, p_cpu->vram[4]);
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 0, 0));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 1, 0));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 2, 0));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 3, 0));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 4, 0));
     TEST_ASSERT_EQUAL(1, p_cpu->V[0xF]);
 }
 
@@ -463,6 +469,10 @@ void test_fx29(void)
     p_cpu->V[0] = 0x0;
     cpu_cycle(p_cpu);
     TEST_ASSERT_EQUAL(0, p_cpu->index);
+    for(unsigned i = 0; i < FONT_SPRITES_SIZE; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX8(cpu_font_sprites[i], p_cpu->memory[FONT_ADDRESS + i]);
+    }
 }
 
 void test_fx33(void) 
@@ -518,6 +528,719 @@ void test_fx65(void)
     //TEST_ASSERT_EQUAL(0, p_cpu->index);
 }
 
+void test_fx18_sound_edges(void) 
+{
+    // Starting and stopping the sound timer is logged at the frame cycle
+    p_cpu->memory[p_cpu->pc] = 0xF0;
+    p_cpu->memory[p_cpu->pc + 1] = 0x18;
+    p_cpu->memory[p_cpu->pc + 2] = 0xF1;
+    p_cpu->memory[p_cpu->pc + 3] = 0x18;
+    p_cpu->memory[p_cpu->pc + 4] = 0xF2;
+    p_cpu->memory[p_cpu->pc + 5] = 0x18;
+    p_cpu->V[0] = 0x10;
+    p_cpu->V[1] = 0x20;
+    p_cpu->V[2] = 0x00;
+    cpu_run(p_cpu, 3);
+    TEST_ASSERT_EQUAL(2, p_cpu->sound_edge_count);
+    TEST_ASSERT_EQUAL(0, p_cpu->sound_edges[0]);
+    TEST_ASSERT_EQUAL(2, p_cpu->sound_edges[1]);
+}
+
+void test_cpu_run(void) 
+{
+    p_cpu->memory[p_cpu->pc] = 0x70;
+    p_cpu->memory[p_cpu->pc + 1] = 0x01;
+    p_cpu->memory[p_cpu->pc + 2] = 0x12;
+    p_cpu->memory[p_cpu->pc + 3] = 0x00;
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(5, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(10, p_cpu->frame_cycle);
+}
+
+void test_cpu_run_idle(void) 
+{
+    // A jump to itself stops executing but still counts the whole batch
+    p_cpu->memory[p_cpu->pc] = 0x12;
+    p_cpu->memory[p_cpu->pc + 1] = 0x00;
+    cpu_run(p_cpu, 5000000);
+    TEST_ASSERT_EQUAL(0x200, p_cpu->pc);
+    TEST_ASSERT_EQUAL(5000000, p_cpu->frame_cycle);
+    TEST_ASSERT_EQUAL(4999999, p_cpu->idle_cycles);
+}
+
+void test_cpu_timer_tick(void) 
+{
+    p_cpu->delayTimer = 2;
+    p_cpu->soundTimer = 1;
+    p_cpu->display_wait = true;
+    p_cpu->frame_cycle = 100;
+    p_cpu->sound_edge_count = 1;
+    cpu_timer_tick(p_cpu);
+    TEST_ASSERT_EQUAL(1, p_cpu->delayTimer);
+    TEST_ASSERT_EQUAL(0, p_cpu->soundTimer);
+    TEST_ASSERT_FALSE(p_cpu->display_wait);
+    TEST_ASSERT_EQUAL(0, p_cpu->frame_cycle);
+    TEST_ASSERT_EQUAL(0, p_cpu->sound_edge_count);
+    TEST_ASSERT_FALSE(p_cpu->sound_gate);
+    cpu_timer_tick(p_cpu);
+    TEST_ASSERT_EQUAL(0, p_cpu->delayTimer);
+    TEST_ASSERT_EQUAL(0, p_cpu->soundTimer);
+}
+
+void test_quirk_shift_vx(void) 
+{
+    // SUPER-CHIP shifts Vx in place
+    p_cpu->quirks |= QUIRK_SHIFT_VX;
+    p_cpu->memory[p_cpu->pc] = 0x80;
+    p_cpu->memory[p_cpu->pc + 1] = 0x16;
+    p_cpu->V[0] = 0x11;
+    p_cpu->V[1] = 0x40;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x08, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(1, p_cpu->V[0xF]);
+}
+
+void test_quirk_jump_vx(void) 
+{
+    p_cpu->quirks |= QUIRK_JUMP_VX;
+    p_cpu->memory[p_cpu->pc] = 0xB2;
+    p_cpu->memory[p_cpu->pc + 1] = 0x20;
+    p_cpu->V[0] = 0x01;
+    p_cpu->V[2] = 0x10;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x230, p_cpu->pc);
+}
+
+void test_quirk_no_vf_reset(void) 
+{
+    p_cpu->quirks &= ~QUIRK_VF_RESET;
+    p_cpu->memory[p_cpu->pc] = 0x80;
+    p_cpu->memory[p_cpu->pc + 1] = 0x11;
+    p_cpu->V[0xF] = 0x5;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x5, p_cpu->V[0xF]);
+}
+
+void test_quirk_no_memory_increment(void) 
+{
+    p_cpu->quirks &= ~QUIRK_MEMORY_INCREMENT;
+    p_cpu->memory[p_cpu->pc] = 0xF4;
+    p_cpu->memory[p_cpu->pc + 1] = 0x55;
+    p_cpu->index = 0x300;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x300, p_cpu->index);
+}
+
+void test_quirk_sprite_wrap(void) 
+{
+    // Without clipping, sprites wrap around to the other side
+    p_cpu->quirks &= ~QUIRK_CLIPPING;
+    p_cpu->memory[p_cpu->pc] = 0xD0;
+    p_cpu->memory[p_cpu->pc + 1] = 0x12;
+    p_cpu->V[0] = DISPLAY_LORES_W - 4;
+    p_cpu->V[1] = DISPLAY_LORES_H - 1;
+    p_cpu->index = 0x300;
+    p_cpu->memory[0x300] = 0xFF;
+    p_cpu->memory[0x301] = 0xFF;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, DISPLAY_LORES_W - 1, DISPLAY_LORES_H - 1));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 3, DISPLAY_LORES_H - 1));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 3, 0));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, DISPLAY_LORES_W, DISPLAY_LORES_H - 1));
+}
+
+void test_rng_seed(void) 
+{
+    // The same seed gives the same sequence
+    uint8_t first[8];
+    p_cpu->memory[p_cpu->pc] = 0xC0;
+    p_cpu->memory[p_cpu->pc + 1] = 0xFF;
+    p_cpu->memory[p_cpu->pc + 2] = 0x12;
+    p_cpu->memory[p_cpu->pc + 3] = 0x00;
+    cpu_seed_rng(p_cpu, 1234);
+    for(int i = 0; i < 8; i++)
+    {
+        cpu_run(p_cpu, 2);
+        first[i] = p_cpu->V[0];
+    }
+    cpu_seed_rng(p_cpu, 1234);
+    for(int i = 0; i < 8; i++)
+    {
+        cpu_run(p_cpu, 2);
+        TEST_ASSERT_EQUAL(first[i], p_cpu->V[0]);
+    }
+    cpu_seed_rng(p_cpu, 0);
+    TEST_ASSERT_NOT_EQUAL(0, p_cpu->rng_state);
+}
+
+void test_00ff_00fe(void) 
+{
+    // 0x00FF (HIGH) and 0x00FE (LOW) switch resolution and clear the screen
+    p_cpu->memory[p_cpu->pc] = 0x00;
+    p_cpu->memory[p_cpu->pc + 1] = 0xFF;
+    p_cpu->memory[p_cpu->pc + 2] = 0x00;
+    p_cpu->memory[p_cpu->pc + 3] = 0xFE;
+    p_cpu->vram[0][0][0] = 1;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_TRUE(p_cpu->hires);
+    TEST_ASSERT_EQUAL(DISPLAY_W, cpu_display_width(p_cpu));
+    TEST_ASSERT_EQUAL(DISPLAY_H, cpu_display_height(p_cpu));
+    TEST_ASSERT_EQUAL(0, p_cpu->vram[0][0][0]);
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_FALSE(p_cpu->hires);
+    TEST_ASSERT_EQUAL(DISPLAY_LORES_W, cpu_display_width(p_cpu));
+}
+
+void test_dxy0_hires(void) 
+{
+    // 0xDxy0 draws a 16x16 sprite, here straddling the two words of a row
+    p_cpu->hires = true;
+    p_cpu->memory[p_cpu->pc] = 0xD0;
+    p_cpu->memory[p_cpu->pc + 1] = 0x10;
+    p_cpu->V[0] = 60;
+    p_cpu->V[1] = 50;
+    p_cpu->index = 0x300;
+    for(int i = 0; i < 32; i += 2)
+    {
+        p_cpu->memory[0x300 + i] = 0x80;
+        p_cpu->memory[0x301 + i] = 0x01;
+    }
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 60, 50));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 75, 50));
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 75, 63));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 64, 50));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 60, 0));
+    TEST_ASSERT_EQUAL(0, p_cpu->V[0xF]);
+}
+
+void test_00cn(void) 
+{
+    // 0x00Cn (SCD) Scroll the display down n rows
+    p_cpu->hires = true;
+    p_cpu->memory[p_cpu->pc] = 0x00;
+    p_cpu->memory[p_cpu->pc + 1] = 0xC4;
+    p_cpu->vram[0][0][1] = 1;
+    p_cpu->vram[0][DISPLAY_H - 1][0] = 1;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0, p_cpu->vram[0][0][1]);
+    TEST_ASSERT_EQUAL(1, p_cpu->vram[0][4][1]);
+    TEST_ASSERT_EQUAL(0, p_cpu->vram[0][DISPLAY_H - 1][0]);
+}
+
+void test_0nnn_not_00cn(void)
+{
+    // 0x01C3 is a machine code call, not a scroll
+    p_cpu->hires = true;
+    p_cpu->memory[p_cpu->pc] = 0x01;
+    p_cpu->memory[p_cpu->pc + 1] = 0xC3;
+    p_cpu->vram[0][0][1] = 1;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(1, p_cpu->vram[0][0][1]);
+    TEST_ASSERT_EQUAL(0, p_cpu->vram[0][3][1]);
+    TEST_ASSERT_EQUAL(0x202, p_cpu->pc);
+}
+
+void test_00fb(void) 
+{
+    // 0x00FB (SCR) Scroll right 4 pixels, carrying into the next word
+    p_cpu->hires = true;
+    p_cpu->memory[p_cpu->pc] = 0x00;
+    p_cpu->memory[p_cpu->pc + 1] = 0xFB;
+    p_cpu->vram[0][3][0] = 0x1;
+    p_cpu->vram[0][3][1] = 0x1;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_TRUE(0 == p_cpu->vram[0][3][0]);
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 67, 3));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, DISPLAY_W - 1, 3));
+}
+
+void test_00fc(void) 
+{
+    // 0x00FC (SCL) Scroll left 4 pixels, carrying into the previous word
+    p_cpu->hires = true;
+    p_cpu->memory[p_cpu->pc] = 0x00;
+    p_cpu->memory[p_cpu->pc + 1] = 0xFC;
+    p_cpu->vram[0][3][0] = 0x8000000000000000u;
+    p_cpu->vram[0][3][1] = 0x8000000000000000u;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_TRUE(cpu_pixel(p_cpu, 60, 3));
+    TEST_ASSERT_FALSE(cpu_pixel(p_cpu, 0, 3));
+    TEST_ASSERT_TRUE(0 == p_cpu->vram[0][3][1]);
+}
+
+void test_fx30(void) 
+{
+    // 0xFx30 (LD) Set I = location of the big sprite for digit Vx
+    p_cpu->memory[p_cpu->pc] = 0xF0;
+    p_cpu->memory[p_cpu->pc + 1] = 0x30;
+    p_cpu->V[0] = 0x9;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(BIG_FONT_ADDRESS + 9 * BIG_FONT_BYTES, p_cpu->index);
+    TEST_ASSERT_EQUAL(0xFF, p_cpu->memory[p_cpu->index]);
+}
+
+void test_fx75_fx85(void) 
+{
+    // 0xFx75 and 0xFx85 save and restore V0 through Vx in the RPL flags
+    p_cpu->memory[p_cpu->pc] = 0xF2;
+    p_cpu->memory[p_cpu->pc + 1] = 0x75;
+    p_cpu->memory[p_cpu->pc + 2] = 0xF1;
+    p_cpu->memory[p_cpu->pc + 3] = 0x85;
+    p_cpu->V[0] = 0x11;
+    p_cpu->V[1] = 0x22;
+    p_cpu->V[2] = 0x33;
+    cpu_cycle(p_cpu);
+    memset(p_cpu->V, 0, sizeof(p_cpu->V));
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x11, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(0x22, p_cpu->V[1]);
+    TEST_ASSERT_EQUAL(0x00, p_cpu->V[2]);
+    TEST_ASSERT_EQUAL(0x33, p_cpu->rpl[2]);
+}
+
+void test_display_render(void) 
+{
+    uint32_t pixels[DISPLAY_LORES_H * DISPLAY_LORES_W];
+    p_cpu->vram[0][1][0] = 0x8000000000000001u;
+    p_cpu->vram[1][1][0] = 0x0000000000000001u;
+    cpu_display_render(p_cpu, pixels, DISPLAY_LORES_W, cpu_default_palette);
+    TEST_ASSERT_EQUAL_HEX32(cpu_default_palette[1], pixels[DISPLAY_LORES_W]);
+    TEST_ASSERT_EQUAL_HEX32(cpu_default_palette[3], pixels[2 * DISPLAY_LORES_W - 1]);
+    TEST_ASSERT_EQUAL_HEX32(cpu_default_palette[0], pixels[DISPLAY_LORES_W + 1]);
+    TEST_ASSERT_EQUAL_HEX32(cpu_default_palette[0], pixels[0]);
+    TEST_ASSERT_FALSE(p_cpu->display_dirty);
+}
+
+void test_init_memory(void) 
+{
+    chip8_t *p_xo = cpu_init_memory(XOCHIP_MEMORY_SIZE);
+    TEST_ASSERT_NOT_NULL(p_xo);
+    TEST_ASSERT_EQUAL(XOCHIP_MEMORY_SIZE, p_xo->memory_size);
+    TEST_ASSERT_EQUAL(0, p_xo->memory[XOCHIP_MEMORY_SIZE - 1]);
+    cpu_free(p_xo);
+    TEST_ASSERT_NULL(cpu_init_memory(5000));
+    TEST_ASSERT_EQUAL(MEMORY_SIZE, p_cpu->memory_size);
+}
+
+void test_f000(void) 
+{
+    // 0xF000 nnnn (LD) Set I to the 16 bit address that follows
+    p_cpu->memory[p_cpu->pc] = 0xF0;
+    p_cpu->memory[p_cpu->pc + 1] = 0x00;
+    p_cpu->memory[p_cpu->pc + 2] = 0xAB;
+    p_cpu->memory[p_cpu->pc + 3] = 0xCD;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0xABCD, p_cpu->index);
+    TEST_ASSERT_EQUAL(0x204, p_cpu->pc);
+}
+
+void test_f000_memory_sizes(void)
+{
+    // I = 0xABCD is past the end of 4KB, accesses through it wrap
+    const uint8_t program[] = { 0xF0, 0x00, 0xAB, 0xCD, 0xF1, 0x55 };
+    chip8_t *p_xo = cpu_init_memory(XOCHIP_MEMORY_SIZE);
+
+    TEST_ASSERT_NOT_NULL(p_xo);
+    memcpy(&p_cpu->memory[START_ADDRESS], program, sizeof(program));
+    memcpy(&p_xo->memory[START_ADDRESS], program, sizeof(program));
+    p_cpu->V[0] = p_xo->V[0] = 0x11;
+    p_cpu->V[1] = p_xo->V[1] = 0x22;
+    cpu_run(p_cpu, 2);
+    cpu_run(p_xo, 2);
+    TEST_ASSERT_EQUAL_HEX8(0x11, p_cpu->memory[0xBCD]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, p_cpu->memory[0xBCE]);
+    TEST_ASSERT_EQUAL_HEX8(0x11, p_xo->memory[0xABCD]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, p_xo->memory[0xABCE]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, p_xo->memory[0xBCD]);
+    cpu_free(p_xo);
+}
+
+void test_fx00_fx02_not_xochip(void)
+{
+    // Only F000 and F002 are XO-CHIP instructions, F100 and F102 do nothing
+    p_cpu->memory[p_cpu->pc] = 0xF1;
+    p_cpu->memory[p_cpu->pc + 1] = 0x00;
+    p_cpu->memory[p_cpu->pc + 2] = 0xF1;
+    p_cpu->memory[p_cpu->pc + 3] = 0x02;
+    p_cpu->index = 0x300;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x300, p_cpu->index);
+    TEST_ASSERT_EQUAL(0x202, p_cpu->pc);
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_FALSE(p_cpu->audio_pattern_active);
+    TEST_ASSERT_EQUAL(0x204, p_cpu->pc);
+}
+
+void test_skip_f000(void) 
+{
+    // Skips step over all four bytes of F000 nnnn
+    p_cpu->memory[p_cpu->pc] = 0x30;
+    p_cpu->memory[p_cpu->pc + 1] = 0x00;
+    p_cpu->memory[p_cpu->pc + 2] = 0xF0;
+    p_cpu->memory[p_cpu->pc + 3] = 0x00;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x206, p_cpu->pc);
+}
+
+void test_fn01_planes(void) 
+{
+    // 0xFn01 selects planes, each one draws the next n bytes from I
+    p_cpu->memory[p_cpu->pc] = 0xF3;
+    p_cpu->memory[p_cpu->pc + 1] = 0x01;
+    p_cpu->memory[p_cpu->pc + 2] = 0xD0;
+    p_cpu->memory[p_cpu->pc + 3] = 0x01;
+    p_cpu->quirks = QUIRKS_XOCHIP;
+    p_cpu->index = 0x300;
+    p_cpu->memory[0x300] = 0xC0;
+    p_cpu->memory[0x301] = 0x80;
+    cpu_run(p_cpu, 2);
+    TEST_ASSERT_EQUAL(0x3, p_cpu->planes);
+    TEST_ASSERT_EQUAL(3, cpu_pixel(p_cpu, 0, 0));
+    TEST_ASSERT_EQUAL(1, cpu_pixel(p_cpu, 1, 0));
+    TEST_ASSERT_TRUE(p_cpu->display_dirty);
+    // Clearing only touches the selected planes
+    p_cpu->memory[p_cpu->pc] = 0xF2;
+    p_cpu->memory[p_cpu->pc + 1] = 0x01;
+    p_cpu->memory[p_cpu->pc + 2] = 0x00;
+    p_cpu->memory[p_cpu->pc + 3] = 0xE0;
+    cpu_run(p_cpu, 2);
+    TEST_ASSERT_EQUAL(1, cpu_pixel(p_cpu, 0, 0));
+}
+
+void test_f002_fx3a(void) 
+{
+    // 0xF002 loads the audio pattern, 0xFx3A sets its pitch
+    p_cpu->memory[p_cpu->pc] = 0xF0;
+    p_cpu->memory[p_cpu->pc + 1] = 0x02;
+    p_cpu->memory[p_cpu->pc + 2] = 0xF1;
+    p_cpu->memory[p_cpu->pc + 3] = 0x3A;
+    p_cpu->index = 0x300;
+    for(int i = 0; i < AUDIO_PATTERN_SIZE; i++)
+    {
+        p_cpu->memory[0x300 + i] = (uint8_t)i;
+    }
+    p_cpu->V[1] = 112;
+    TEST_ASSERT_EQUAL(AUDIO_DEFAULT_PITCH, p_cpu->pitch);
+    cpu_run(p_cpu, 2);
+    TEST_ASSERT_TRUE(p_cpu->audio_pattern_active);
+    TEST_ASSERT_EQUAL(15, p_cpu->audio_pattern[15]);
+    TEST_ASSERT_EQUAL(112, p_cpu->pitch);
+}
+
+void test_5xy2_5xy3(void) 
+{
+    // 0x5xy2 stores Vx..Vy, 0x5xy3 loads them, backwards when x > y
+    p_cpu->memory[p_cpu->pc] = 0x51;
+    p_cpu->memory[p_cpu->pc + 1] = 0x32;
+    p_cpu->memory[p_cpu->pc + 2] = 0x5A;
+    p_cpu->memory[p_cpu->pc + 3] = 0x83;
+    p_cpu->index = 0x300;
+    p_cpu->V[1] = 0x11;
+    p_cpu->V[2] = 0x22;
+    p_cpu->V[3] = 0x33;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x11, p_cpu->memory[0x300]);
+    TEST_ASSERT_EQUAL(0x33, p_cpu->memory[0x302]);
+    TEST_ASSERT_EQUAL(0x300, p_cpu->index);
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x11, p_cpu->V[0xA]);
+    TEST_ASSERT_EQUAL(0x22, p_cpu->V[0x9]);
+    TEST_ASSERT_EQUAL(0x33, p_cpu->V[0x8]);
+}
+
+// Run a program through cpu_run() and through plain cpu_cycle() calls side
+// by side, the superinstructions must leave both machines identical.
+static void assert_fused_matches(const uint8_t *p_program, size_t size, uint32_t quirks,
+                                 uint32_t frames, uint32_t cycles)
+{
+    chip8_t *p_plain = cpu_init();
+    TEST_ASSERT_NOT_NULL(p_plain);
+
+    p_cpu->quirks = quirks;
+    p_plain->quirks = quirks;
+    cpu_seed_rng(p_cpu, 1);
+    cpu_seed_rng(p_plain, 1);
+    memcpy(&p_cpu->memory[START_ADDRESS], p_program, size);
+    memcpy(&p_plain->memory[START_ADDRESS], p_program, size);
+
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        cpu_run(p_cpu, cycles);
+        for(uint32_t i = 0; i < cycles; i++)
+        {
+            cpu_cycle(p_plain);
+            p_plain->frame_cycle++;
+        }
+
+        TEST_ASSERT_EQUAL_MEMORY(p_plain->V, p_cpu->V, sizeof(p_cpu->V));
+        TEST_ASSERT_EQUAL_HEX16(p_plain->pc, p_cpu->pc);
+        TEST_ASSERT_EQUAL_HEX16(p_plain->index, p_cpu->index);
+        TEST_ASSERT_EQUAL(p_plain->sp, p_cpu->sp);
+        TEST_ASSERT_EQUAL_MEMORY(p_plain->stack, p_cpu->stack, sizeof(p_cpu->stack));
+        TEST_ASSERT_EQUAL(p_plain->delayTimer, p_cpu->delayTimer);
+        TEST_ASSERT_EQUAL(p_plain->soundTimer, p_cpu->soundTimer);
+        TEST_ASSERT_EQUAL(p_plain->display_wait, p_cpu->display_wait);
+        TEST_ASSERT_EQUAL(p_plain->frame_cycle, p_cpu->frame_cycle);
+        TEST_ASSERT_EQUAL_UINT32(p_plain->rng_state, p_cpu->rng_state);
+        TEST_ASSERT_EQUAL_MEMORY(p_plain->vram, p_cpu->vram, sizeof(p_cpu->vram));
+        TEST_ASSERT_EQUAL_MEMORY(p_plain->memory, p_cpu->memory, p_cpu->memory_size);
+
+        cpu_timer_tick(p_cpu);
+        cpu_timer_tick(p_plain);
+    }
+
+    cpu_free(p_plain);
+}
+
+void test_fused_annn_dxyn(void)
+{
+    // Draw, erase, then wait on the tick between draws
+    const uint8_t program[] = { 0xA0, 0x0A, 0xD0, 0x15, 0xA0, 0x0A, 0xD0, 0x15, 0x12, 0x00 };
+
+    assert_fused_matches(program, sizeof(program), QUIRKS_CHIP8, 3, 7);
+    TEST_ASSERT_EQUAL_HEX16(0x206, p_cpu->pc);
+}
+
+void test_fused_loop_counter(void)
+{
+    // Count V0 up to 0x10 and spin, with 7xnn 3xnn and 7xnn 4xnn loops
+    const uint8_t program[] =
+    {
+        0x60, 0x00, 0x70, 0x01, 0x30, 0x10, 0x12, 0x02,
+        0x61, 0x00, 0x71, 0x01, 0x41, 0x08, 0x12, 0x12, 0x12, 0x0A,
+        0x12, 0x12
+    };
+
+    assert_fused_matches(program, sizeof(program), QUIRKS_CHIP8, 8, 13);
+    TEST_ASSERT_EQUAL(0x10, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(0x08, p_cpu->V[1]);
+}
+
+void test_fused_delay_poll(void)
+{
+    // Wait for the delay timer to run out with Fx07 3x00 and Fx07 4x00
+    const uint8_t program[] =
+    {
+        0x62, 0x03, 0xF2, 0x15, 0xF3, 0x07, 0x33, 0x00, 0x12, 0x04,
+        0xF2, 0x15, 0xF4, 0x07, 0x44, 0x00, 0x12, 0x14, 0x12, 0x0C,
+        0x12, 0x14
+    };
+
+    assert_fused_matches(program, sizeof(program), QUIRKS_CHIP8, 10, 5);
+    TEST_ASSERT_EQUAL_HEX16(0x214, p_cpu->pc);
+}
+
+void test_fused_skip_f000(void)
+{
+    // A fused skip still hops the whole F000 nnnn
+    const uint8_t program[] = { 0x70, 0x01, 0x30, 0x01, 0xF0, 0x00, 0x12, 0x34, 0x12, 0x08 };
+
+    assert_fused_matches(program, sizeof(program), QUIRKS_XOCHIP, 1, 3);
+    TEST_ASSERT_EQUAL_HEX16(0x208, p_cpu->pc);
+    TEST_ASSERT_EQUAL_HEX16(0x0000, p_cpu->index);
+}
+
+void test_fused_6xnn_run(void)
+{
+    // A run of loads split across batches of two
+    const uint8_t program[] = { 0x60, 0x01, 0x61, 0x02, 0x62, 0x03, 0x63, 0x04, 0x64, 0x05, 0x12, 0x0A };
+
+    assert_fused_matches(program, sizeof(program), QUIRKS_CHIP8, 3, 2);
+    TEST_ASSERT_EQUAL(0x05, p_cpu->V[4]);
+}
+
+void test_fused_random_programs(void)
+{
+    // Random programs built mostly from the fused opcodes on a few registers
+    uint32_t state = 0x2468ACE1;
+    uint8_t program[128];
+
+    for(unsigned round = 0; round < 64; round++)
+    {
+        for(size_t i = 0; i < sizeof(program); i += 2)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            uint16_t x = (uint16_t)((state >> 8) & 0x3) << 8;
+            uint16_t nn = (uint16_t)((state >> 16) & 0x0F);
+            uint16_t code = 0;
+            switch(state % 10)
+            {
+                case 0: code = (uint16_t)(0x6000 | x | nn); break;
+                case 1: code = (uint16_t)(0x7000 | x | nn); break;
+                case 2: code = (uint16_t)(0x3000 | x | nn); break;
+                case 3: code = (uint16_t)(0x4000 | x | nn); break;
+                case 4: code = (uint16_t)(0xA000 | ((state >> 12) & 0x4F)); break;
+                case 5: code = (uint16_t)(0xD010 | x | ((state >> 20) & 0xF)); break;
+                case 6: code = (uint16_t)(0xF007 | x); break;
+                case 7: code = (uint16_t)(0xF015 | x); break;
+                case 8: code = (uint16_t)(0xC000 | x | 0xFF); break;
+                default: code = (uint16_t)(0x1200 | ((state >> 4) & 0x7E)); break;
+            }
+            program[i] = (uint8_t)(code >> 8);
+            program[i + 1] = (uint8_t)code;
+        }
+
+        assert_fused_matches(program, sizeof(program), (round & 1) ? QUIRKS_CHIP8 : QUIRKS_SCHIP,
+                             8, 3 + round % 11);
+        tearDown();
+        setUp();
+    }
+}
+
+void test_load_program_mem(void)
+{
+    static uint8_t program[XOCHIP_MEMORY_SIZE - START_ADDRESS + 1];
+
+    // A ROM exactly filling program memory fits, one byte more doesn't
+    memset(program, 0xAB, sizeof(program));
+    TEST_ASSERT_TRUE(cpu_load_program_mem(p_cpu, program, PROGRAM_MEMORY_SIZE));
+    TEST_ASSERT_EQUAL_HEX8(0xAB, p_cpu->memory[START_ADDRESS]);
+    TEST_ASSERT_EQUAL_HEX8(0xAB, p_cpu->memory[MEMORY_SIZE - 1]);
+    TEST_ASSERT_FALSE(cpu_load_program_mem(p_cpu, program, PROGRAM_MEMORY_SIZE + 1));
+    TEST_ASSERT_TRUE(cpu_load_program_mem(p_cpu, NULL, 0));
+    TEST_ASSERT_FALSE(cpu_load_program_mem(p_cpu, NULL, 2));
+
+    cpu_free(p_cpu);
+    p_cpu = cpu_init_memory(XOCHIP_MEMORY_SIZE);
+    TEST_ASSERT_TRUE(cpu_load_program_mem(p_cpu, program, sizeof(program) - 1));
+    TEST_ASSERT_FALSE(cpu_load_program_mem(p_cpu, program, sizeof(program)));
+}
+
+void test_load_program(void)
+{
+    static uint8_t program[PROGRAM_MEMORY_SIZE];
+    const char *p_filename = "test_cpu_rom.ch8";
+    FILE *p_fp = fopen(p_filename, "wb");
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    memset(program, 0x5A, sizeof(program));
+    program[0] = 0x12;
+    TEST_ASSERT_EQUAL(sizeof(program), fwrite(program, 1, sizeof(program), p_fp));
+    fclose(p_fp);
+
+    TEST_ASSERT_TRUE(cpu_load_program(p_cpu, p_filename));
+    TEST_ASSERT_EQUAL_HEX8(0x12, p_cpu->memory[START_ADDRESS]);
+    TEST_ASSERT_EQUAL_HEX8(0x5A, p_cpu->memory[MEMORY_SIZE - 1]);
+    TEST_ASSERT_FALSE(cpu_load_program(p_cpu, "no_such_rom.ch8"));
+    TEST_ASSERT_FALSE(cpu_load_program(p_cpu, NULL));
+    remove(p_filename);
+}
+
+void test_address_wrap(void)
+{
+    // pc and I wrap at the end of memory, so does every byte from I on
+    p_cpu->pc = MEMORY_SIZE + 0x200;
+    p_cpu->memory[0x200] = 0xF1;
+    p_cpu->memory[0x201] = 0x55;
+    p_cpu->index = 0xFFFF;
+    p_cpu->V[0] = 0x11;
+    p_cpu->V[1] = 0x22;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x202, p_cpu->pc);
+    TEST_ASSERT_EQUAL_HEX8(0x11, p_cpu->memory[MEMORY_SIZE - 1]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, p_cpu->memory[0]);
+
+    // and reads back from there
+    p_cpu->memory[0x202] = 0xF2;
+    p_cpu->memory[0x203] = 0x65;
+    p_cpu->index = MEMORY_SIZE - 1;
+    p_cpu->memory[1] = 0x33;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL_HEX8(0x11, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, p_cpu->V[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x33, p_cpu->V[2]);
+
+    // the last instruction in memory runs into address 0
+    p_cpu->pc = MEMORY_SIZE - 2;
+    p_cpu->memory[MEMORY_SIZE - 2] = 0x60;
+    p_cpu->memory[MEMORY_SIZE - 1] = 0x42;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL_HEX8(0x42, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(0x000, p_cpu->pc & (MEMORY_SIZE - 1));
+
+    // one that starts on the last byte takes its second from address 0
+    p_cpu->pc = MEMORY_SIZE - 1;
+    p_cpu->memory[MEMORY_SIZE - 1] = 0x61;
+    p_cpu->memory[0] = 0x24;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL_HEX8(0x24, p_cpu->V[1]);
+}
+
+void test_sprite_wrap(void)
+{
+    // A sprite at the end of memory carries on from address 0, the font's 0
+    p_cpu->memory[START_ADDRESS] = 0xD0;
+    p_cpu->memory[START_ADDRESS + 1] = 0x02;
+    p_cpu->memory[MEMORY_SIZE - 1] = 0x80;
+    p_cpu->index = MEMORY_SIZE - 1;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_TRUE(0x8000000000000000u == p_cpu->vram[0][0][0]);
+    TEST_ASSERT_TRUE(0xF000000000000000u == p_cpu->vram[0][1][0]);
+}
+
+void test_stack_wrap(void)
+{
+    // Calling past the top of the stack wraps, as does returning past the bottom
+    for(uint16_t i = 0; i <= STACK_SIZE; i++)
+    {
+        p_cpu->memory[0x200 + 2 * i] = 0x22;
+        p_cpu->memory[0x200 + 2 * i + 1] = (uint8_t)(2 * i + 2);
+    }
+    cpu_run(p_cpu, STACK_SIZE + 1);
+    TEST_ASSERT_EQUAL(1, p_cpu->sp);
+    TEST_ASSERT_EQUAL(0x222, p_cpu->stack[0]);
+
+    p_cpu->sp = 0;
+    p_cpu->memory[p_cpu->pc] = 0x00;
+    p_cpu->memory[p_cpu->pc + 1] = 0xEE;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(STACK_SIZE - 1, p_cpu->sp);
+    TEST_ASSERT_EQUAL(p_cpu->stack[STACK_SIZE - 1], p_cpu->pc);
+}
+
+void test_ex9e_high_key(void)
+{
+    // Only the low nibble of Vx picks the key
+    p_cpu->memory[p_cpu->pc] = 0xE0;
+    p_cpu->memory[p_cpu->pc + 1] = 0x9E;
+    p_cpu->V[0] = 0x83;
+    p_cpu->keypad_register = 0x08;
+    cpu_cycle(p_cpu);
+    TEST_ASSERT_EQUAL(0x204, p_cpu->pc);
+}
+
+void test_hot_line(void)
+{
+    // Everything but the stack, memory and display in one line
+    TEST_ASSERT_EQUAL(0, (uintptr_t)p_cpu % CPU_CACHE_LINE);
+    TEST_ASSERT_TRUE(offsetof(chip8_t, p_trace) + sizeof(p_cpu->p_trace) <= CPU_CACHE_LINE);
+}
+
+void test_accessors(void)
+{
+    p_cpu->memory[MEMORY_SIZE - 1] = 0x12;
+    p_cpu->memory[0] = 0x34;
+    TEST_ASSERT_EQUAL(0x1234, cpu_read_word(p_cpu, MEMORY_SIZE - 1));
+    TEST_ASSERT_EQUAL_HEX8(0x12, cpu_read(p_cpu, 2 * MEMORY_SIZE - 1));
+    TEST_ASSERT_EQUAL(MEMORY_SIZE, cpu_memory_size(p_cpu));
+
+    cpu_set_keypad(p_cpu, 0x8001);
+    TEST_ASSERT_EQUAL(0x8001, cpu_keypad(p_cpu));
+    cpu_set_quirks(p_cpu, QUIRKS_SCHIP);
+    TEST_ASSERT_EQUAL(QUIRKS_SCHIP, cpu_quirks(p_cpu));
+
+    p_cpu->V[0xA] = 0x5A;
+    TEST_ASSERT_EQUAL_HEX8(0x5A, cpu_register(p_cpu, 0x1A));
+    TEST_ASSERT_EQUAL(START_ADDRESS, cpu_pc(p_cpu));
+    p_cpu->display_dirty = false;
+    TEST_ASSERT_FALSE(cpu_display_dirty(p_cpu));
+    cpu_display_invalidate(p_cpu);
+    TEST_ASSERT_TRUE(cpu_display_dirty(p_cpu));
+}
+
 int main(void) 
 {
     UNITY_BEGIN();
@@ -555,5 +1278,46 @@ int main(void)
     RUN_TEST(test_fx33);
     RUN_TEST(test_fx55);
     RUN_TEST(test_fx65);
+    RUN_TEST(test_fx18_sound_edges);
+    RUN_TEST(test_cpu_run);
+    RUN_TEST(test_cpu_run_idle);
+    RUN_TEST(test_cpu_timer_tick);
+    RUN_TEST(test_quirk_shift_vx);
+    RUN_TEST(test_quirk_jump_vx);
+    RUN_TEST(test_quirk_no_vf_reset);
+    RUN_TEST(test_quirk_no_memory_increment);
+    RUN_TEST(test_quirk_sprite_wrap);
+    RUN_TEST(test_rng_seed);
+    RUN_TEST(test_00ff_00fe);
+    RUN_TEST(test_dxy0_hires);
+    RUN_TEST(test_00cn);
+    RUN_TEST(test_0nnn_not_00cn);
+    RUN_TEST(test_00fb);
+    RUN_TEST(test_00fc);
+    RUN_TEST(test_fx30);
+    RUN_TEST(test_fx75_fx85);
+    RUN_TEST(test_display_render);
+    RUN_TEST(test_init_memory);
+    RUN_TEST(test_f000);
+    RUN_TEST(test_f000_memory_sizes);
+    RUN_TEST(test_fx00_fx02_not_xochip);
+    RUN_TEST(test_skip_f000);
+    RUN_TEST(test_fn01_planes);
+    RUN_TEST(test_f002_fx3a);
+    RUN_TEST(test_5xy2_5xy3);
+    RUN_TEST(test_fused_annn_dxyn);
+    RUN_TEST(test_fused_loop_counter);
+    RUN_TEST(test_fused_delay_poll);
+    RUN_TEST(test_fused_skip_f000);
+    RUN_TEST(test_fused_6xnn_run);
+    RUN_TEST(test_fused_random_programs);
+    RUN_TEST(test_load_program_mem);
+    RUN_TEST(test_load_program);
+    RUN_TEST(test_address_wrap);
+    RUN_TEST(test_sprite_wrap);
+    RUN_TEST(test_stack_wrap);
+    RUN_TEST(test_ex9e_high_key);
+    RUN_TEST(test_hot_line);
+    RUN_TEST(test_accessors);
     return UNITY_END();
 }
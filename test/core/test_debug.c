@@ -0,0 +1,230 @@
+#include "unity.h"
+#include "cpu.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+chip8_t *p_cpu;
+debug_t debug;
+
+void setUp(void)
+{
+    p_cpu = cpu_init();
+    debug_init(&debug);
+    p_cpu->p_debug = &debug;
+    cpu_seed_rng(p_cpu, 1);
+}
+
+void tearDown(void)
+{
+    cpu_free(p_cpu);
+}
+
+static void load(const uint8_t *p_program, size_t size)
+{
+    memcpy(&p_cpu->memory[START_ADDRESS], p_program, size);
+}
+
+void test_inactive(void)
+{
+    // Count V0 up forever
+    const uint8_t program[] = { 0x70, 0x01, 0x12, 0x00 };
+
+    load(program, sizeof(program));
+    TEST_ASSERT_FALSE(debug_active(&debug));
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(5, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(10, p_cpu->frame_cycle);
+    TEST_ASSERT_EQUAL(DEBUG_RUNNING, debug.stop);
+
+    // Cleared breakpoints go back to the fast path
+    debug_set_breakpoint(&debug, 0x202, true);
+    debug_set_breakpoint(&debug, 0x202, true);
+    TEST_ASSERT_EQUAL(1, debug.breakpoint_count);
+    TEST_ASSERT_TRUE(debug_active(&debug));
+    debug_set_breakpoint(&debug, 0x202, false);
+    TEST_ASSERT_FALSE(debug_active(&debug));
+}
+
+void test_breakpoint(void)
+{
+    const uint8_t program[] = { 0x70, 0x01, 0x70, 0x10, 0x12, 0x00 };
+
+    load(program, sizeof(program));
+    debug_set_breakpoint(&debug, 0x202, true);
+
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(DEBUG_BREAKPOINT, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x202, debug.stop_address);
+    TEST_ASSERT_EQUAL_HEX16(0x202, p_cpu->pc);
+    TEST_ASSERT_EQUAL(1, p_cpu->frame_cycle);
+
+    // Stopped, nothing runs
+    cpu_run(p_cpu, 9);
+    TEST_ASSERT_EQUAL(1, p_cpu->frame_cycle);
+
+    // Continuing runs off the breakpoint and round to it again
+    debug_continue(p_cpu);
+    cpu_run(p_cpu, 9);
+    TEST_ASSERT_EQUAL(DEBUG_BREAKPOINT, debug.stop);
+    TEST_ASSERT_EQUAL(4, p_cpu->frame_cycle);
+    TEST_ASSERT_EQUAL(0x12, p_cpu->V[0]);
+}
+
+void test_breakpoint_waiting(void)
+{
+    // Fx0A waits at the same address, continuing doesn't stop on it every cycle
+    const uint8_t program[] = { 0xF0, 0x0A, 0x12, 0x00 };
+
+    load(program, sizeof(program));
+    debug_set_breakpoint(&debug, 0x200, true);
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(DEBUG_BREAKPOINT, debug.stop);
+    TEST_ASSERT_EQUAL(0, p_cpu->frame_cycle);
+
+    debug_continue(p_cpu);
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(DEBUG_RUNNING, debug.stop);
+    TEST_ASSERT_EQUAL(10, p_cpu->frame_cycle);
+}
+
+void test_step(void)
+{
+    // 0x200 CALL 0x206 / 0x202 ADD V1, 1 / 0x204 JP 0x204 / 0x206 ADD V0, 1 / 0x208 ADD V0, 1 / 0x20A RET
+    const uint8_t program[] =
+    {
+        0x22, 0x06, 0x71, 0x01, 0x12, 0x04, 0x70, 0x01, 0x70, 0x01, 0x00, 0xEE
+    };
+
+    load(program, sizeof(program));
+    debug_pause(&debug);
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(0, p_cpu->frame_cycle);
+
+    debug_step(p_cpu);
+    TEST_ASSERT_EQUAL(DEBUG_STEPPED, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x206, p_cpu->pc);
+    TEST_ASSERT_EQUAL(1, p_cpu->frame_cycle);
+
+    // Back to the caller in one go
+    p_cpu->pc = 0x200;
+    p_cpu->sp = 0;
+    debug_step_over(p_cpu);
+    TEST_ASSERT_EQUAL(DEBUG_RUNNING, debug.stop);
+    cpu_run(p_cpu, 20);
+    TEST_ASSERT_EQUAL(DEBUG_STEPPED, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x202, p_cpu->pc);
+    TEST_ASSERT_EQUAL(0, p_cpu->sp);
+    TEST_ASSERT_EQUAL(2, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(5, p_cpu->frame_cycle);
+
+    // Anything else steps one instruction
+    debug_step_over(p_cpu);
+    TEST_ASSERT_EQUAL(DEBUG_STEPPED, debug.stop);
+    TEST_ASSERT_EQUAL(1, p_cpu->V[1]);
+    TEST_ASSERT_FALSE(debug.stepping_over);
+}
+
+void test_watch_write(void)
+{
+    // 0x200 LD I, 0x300 / 0x202 LD [I], V1 / 0x204 JP 0x204
+    const uint8_t program[] = { 0xA3, 0x00, 0xF1, 0x55, 0x12, 0x04 };
+
+    load(program, sizeof(program));
+    p_cpu->V[1] = 0x42;
+    debug_set_watch(&debug, 0x301, 1, DEBUG_WATCH_WRITE, true);
+    TEST_ASSERT_EQUAL(1, debug.watch_count);
+
+    // Stops after the store has happened
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(DEBUG_WATCH_WRITE_HIT, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x301, debug.stop_address);
+    TEST_ASSERT_EQUAL_HEX16(0x204, p_cpu->pc);
+    TEST_ASSERT_EQUAL_HEX8(0x42, p_cpu->memory[0x301]);
+
+    // Reads of it don't count
+    debug_set_watch(&debug, 0x301, 1, DEBUG_WATCH_WRITE, false);
+    debug_set_watch(&debug, 0x300, 2, DEBUG_WATCH_READ, true);
+    p_cpu->pc = 0x200;
+    debug_continue(p_cpu);
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(DEBUG_RUNNING, debug.stop);
+}
+
+void test_watch_read(void)
+{
+    // 0x200 LD I, 0x300 / 0x202 DRW V0, V0, 2 / 0x204 JP 0x204
+    const uint8_t program[] = { 0xA3, 0x00, 0xD0, 0x02, 0x12, 0x04 };
+
+    load(program, sizeof(program));
+    debug_set_watch(&debug, 0x301, 1, DEBUG_WATCH_READ, true);
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(DEBUG_WATCH_READ_HIT, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x301, debug.stop_address);
+}
+
+void test_watch_read_display_wait(void)
+{
+    // 0x200 LD I, 0x300 / 0x202 DRW V0, V0, 5 / 0x204 DRW V0, V0, 5 / 0x206 JP 0x206
+    const uint8_t program[] = { 0xA3, 0x00, 0xD0, 0x05, 0xD0, 0x05, 0x12, 0x06 };
+
+    load(program, sizeof(program));
+    p_cpu->quirks = QUIRKS_CHIP8;
+    debug_set_watch(&debug, 0x300, 1, DEBUG_WATCH_READ, true);
+    cpu_run(p_cpu, 20);
+    TEST_ASSERT_EQUAL(DEBUG_WATCH_READ_HIT, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x204, p_cpu->pc);
+    TEST_ASSERT_TRUE(p_cpu->display_wait);
+
+    // The second draw waits out the frame without reading the sprite
+    debug_continue(p_cpu);
+    cpu_run(p_cpu, 18);
+    TEST_ASSERT_EQUAL(DEBUG_RUNNING, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x204, p_cpu->pc);
+    TEST_ASSERT_EQUAL(20, p_cpu->frame_cycle);
+
+    // and reads it once it gets to draw
+    cpu_timer_tick(p_cpu);
+    cpu_run(p_cpu, 20);
+    TEST_ASSERT_EQUAL(DEBUG_WATCH_READ_HIT, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x206, p_cpu->pc);
+}
+
+void test_reset_keeps_debugger(void)
+{
+    debug_set_breakpoint(&debug, 0x200, true);
+    cpu_reset(p_cpu);
+    TEST_ASSERT_TRUE(&debug == p_cpu->p_debug);
+}
+
+void test_new_cpu_undebugged(void)
+{
+    // A new cpu starts without a debugger, even in a block that held garbage
+    chip8_t *p_new = cpu_init();
+
+    TEST_ASSERT_NOT_NULL(p_new);
+    memset(p_new, 0xA5, cpu_state_size(MEMORY_SIZE));
+    cpu_free(p_new);
+    p_new = cpu_init();
+    TEST_ASSERT_NOT_NULL(p_new);
+    TEST_ASSERT_NULL(p_new->p_debug);
+    TEST_ASSERT_NULL(p_new->p_trace);
+    cpu_run(p_new, 10);
+    TEST_ASSERT_EQUAL(10, p_new->frame_cycle);
+    cpu_free(p_new);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_inactive);
+    RUN_TEST(test_breakpoint);
+    RUN_TEST(test_breakpoint_waiting);
+    RUN_TEST(test_step);
+    RUN_TEST(test_watch_write);
+    RUN_TEST(test_watch_read);
+    RUN_TEST(test_watch_read_display_wait);
+    RUN_TEST(test_reset_keeps_debugger);
+    RUN_TEST(test_new_cpu_undebugged);
+    return UNITY_END();
+}
@@ -0,0 +1,180 @@
+#include "unity.h"
+#include "disasm.h"
+#include <string.h>
+
+disasm_t disasm;
+
+void setUp(void)
+{
+    memset(&disasm, 0, sizeof(disasm));
+}
+
+void tearDown(void)
+{
+    disasm_free(&disasm);
+}
+
+void test_format(void)
+{
+    char text[32];
+
+    disasm_format(text, sizeof(text), 0x00E0, 0);
+    TEST_ASSERT_EQUAL_STRING("CLS", text);
+    disasm_format(text, sizeof(text), 0xD125, 0);
+    TEST_ASSERT_EQUAL_STRING("DRW V1, V2, 5", text);
+    disasm_format(text, sizeof(text), 0x6A2B, 0);
+    TEST_ASSERT_EQUAL_STRING("LD VA, 0x2B", text);
+    disasm_format(text, sizeof(text), 0x1234, 0);
+    TEST_ASSERT_EQUAL_STRING("JP 0x234", text);
+    disasm_format(text, sizeof(text), 0xF000, 0xBEEF);
+    TEST_ASSERT_EQUAL_STRING("LD I, 0xBEEF", text);
+    disasm_format(text, sizeof(text), 0xF301, 0);
+    TEST_ASSERT_EQUAL_STRING("PLANE 3", text);
+    disasm_format(text, sizeof(text), 0x5132, 0);
+    TEST_ASSERT_EQUAL_STRING("SAVE V1-V3", text);
+    disasm_format(text, sizeof(text), 0x8008, 0);
+    TEST_ASSERT_EQUAL_STRING(".word 0x8008", text);
+}
+
+void test_blocks(void)
+{
+    // 0x200 SE V0, 1 / 0x202 F000 nnnn / 0x206 CALL 0x20C / 0x208 JP 0x208 / 0x20A data / 0x20C RET
+    const uint8_t rom[] =
+    {
+        0x30, 0x01, 0xF0, 0x00, 0x12, 0x34, 0x22, 0x0C,
+        0x12, 0x08, 0xFF, 0xFF, 0x00, 0xEE
+    };
+    const disasm_block_t *p_block = NULL;
+
+    TEST_ASSERT_TRUE(disasm_analyse(&disasm, rom, sizeof(rom)));
+    TEST_ASSERT_EQUAL(5, disasm.block_count);
+    TEST_ASSERT_EQUAL(5, disasm.instruction_count);
+    TEST_ASSERT_TRUE(disasm.p_flags[4] & DISASM_OPERAND);
+    TEST_ASSERT_FALSE(disasm.p_flags[10] & (DISASM_CODE | DISASM_OPERAND));
+
+    p_block = &disasm.p_blocks[0];
+    TEST_ASSERT_EQUAL_HEX(0x200, p_block->start);
+    TEST_ASSERT_EQUAL_HEX(0x202, p_block->end);
+    TEST_ASSERT_EQUAL(2, p_block->edge_count);
+    TEST_ASSERT_EQUAL(DISASM_EDGE_NEXT, p_block->edges[0]);
+    TEST_ASSERT_EQUAL_HEX(0x202, p_block->targets[0]);
+    // Skipping the long load lands after its operand
+    TEST_ASSERT_EQUAL(DISASM_EDGE_SKIP, p_block->edges[1]);
+    TEST_ASSERT_EQUAL_HEX(0x206, p_block->targets[1]);
+
+    p_block = &disasm.p_blocks[2];
+    TEST_ASSERT_EQUAL_HEX(0x206, p_block->start);
+    TEST_ASSERT_EQUAL(DISASM_EDGE_CALL, p_block->edges[0]);
+    TEST_ASSERT_EQUAL_HEX(0x20C, p_block->targets[0]);
+    TEST_ASSERT_EQUAL(DISASM_EDGE_NEXT, p_block->edges[1]);
+    TEST_ASSERT_EQUAL_HEX(0x208, p_block->targets[1]);
+
+    p_block = &disasm.p_blocks[3];
+    TEST_ASSERT_EQUAL(1, p_block->edge_count);
+    TEST_ASSERT_EQUAL(DISASM_EDGE_JUMP, p_block->edges[0]);
+    TEST_ASSERT_EQUAL_HEX(0x208, p_block->targets[0]);
+
+    // RET goes wherever the caller was
+    p_block = &disasm.p_blocks[4];
+    TEST_ASSERT_EQUAL_HEX(0x20C, p_block->start);
+    TEST_ASSERT_EQUAL(0, p_block->edge_count);
+}
+
+void test_straight_line(void)
+{
+    // A jump back into the middle splits the run in two
+    const uint8_t rom[] = { 0x60, 0x01, 0x61, 0x02, 0x62, 0x03, 0x12, 0x02 };
+
+    TEST_ASSERT_TRUE(disasm_analyse(&disasm, rom, sizeof(rom)));
+    TEST_ASSERT_EQUAL(2, disasm.block_count);
+    TEST_ASSERT_EQUAL_HEX(0x202, disasm.p_blocks[0].end);
+    TEST_ASSERT_EQUAL(DISASM_EDGE_NEXT, disasm.p_blocks[0].edges[0]);
+    TEST_ASSERT_EQUAL_HEX(0x202, disasm.p_blocks[1].start);
+    TEST_ASSERT_EQUAL_HEX(0x208, disasm.p_blocks[1].end);
+}
+
+void test_indirect(void)
+{
+    // JP V0, 0x204 never reaches the code after it as far as anyone can tell
+    const uint8_t rom[] = { 0x60, 0x02, 0xB2, 0x04, 0x00, 0xE0, 0x12, 0x04 };
+
+    TEST_ASSERT_TRUE(disasm_analyse(&disasm, rom, sizeof(rom)));
+    TEST_ASSERT_EQUAL(1, disasm.indirect_count);
+    TEST_ASSERT_TRUE(disasm.p_flags[2] & DISASM_INDIRECT);
+    TEST_ASSERT_TRUE(disasm.p_blocks[0].indirect);
+    TEST_ASSERT_EQUAL(0, disasm.p_blocks[0].edge_count);
+    TEST_ASSERT_FALSE(disasm.p_flags[4] & DISASM_CODE);
+}
+
+void test_self_modifying(void)
+{
+    // 0x200 LD I, 0x206 / 0x202 LD B, V0 over the jump / 0x204 LD V0, [I] / 0x206 LD [I], V1 / 0x208 JP 0x200
+    const uint8_t rom[] =
+    {
+        0xA2, 0x06, 0xF0, 0x33, 0xF0, 0x65, 0xF1, 0x55, 0x12, 0x00
+    };
+
+    TEST_ASSERT_TRUE(disasm_analyse(&disasm, rom, sizeof(rom)));
+    TEST_ASSERT_TRUE(disasm.p_flags[6] & DISASM_WRITTEN);
+    TEST_ASSERT_TRUE(disasm.p_flags[8] & DISASM_WRITTEN);
+    TEST_ASSERT_FALSE(disasm.p_flags[9] & DISASM_WRITTEN);
+    TEST_ASSERT_EQUAL(2, disasm.modified_count);
+    TEST_ASSERT_TRUE(disasm.p_blocks[0].modified);
+    // Fx65 can move I, so the Fx55 after it can't be pinned down
+    TEST_ASSERT_EQUAL(1, disasm.unresolved_count);
+    TEST_ASSERT_TRUE(disasm.p_flags[6] & DISASM_UNRESOLVED);
+}
+
+void test_write(void)
+{
+    const uint8_t rom[] = { 0x30, 0x01, 0x00, 0xE0, 0x12, 0x00, 0xAB, 0xCD };
+    char text[1024];
+    FILE *p_fp = NULL;
+    size_t length = 0;
+
+    TEST_ASSERT_TRUE(disasm_analyse(&disasm, rom, sizeof(rom)));
+
+    p_fp = tmpfile();
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_TRUE(disasm_write_text(&disasm, p_fp));
+    rewind(p_fp);
+    length = fread(text, 1, sizeof(text) - 1, p_fp);
+    text[length] = '\0';
+    fclose(p_fp);
+    TEST_ASSERT_NOT_NULL(strstr(text, "block_0200:  ; -> next 0x0202, skip 0x0204"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "0x0200  3001       SE V0, 0x01"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "0x0206  .byte 0xAB, 0xCD"));
+
+    p_fp = tmpfile();
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_TRUE(disasm_write_dot(&disasm, p_fp));
+    rewind(p_fp);
+    length = fread(text, 1, sizeof(text) - 1, p_fp);
+    text[length] = '\0';
+    fclose(p_fp);
+    TEST_ASSERT_NOT_NULL(strstr(text, "digraph rom {"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "b0200 -> b0204 [label=\"skip\"];"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "b0204 -> b0200 [label=\"jump\"];"));
+}
+
+void test_too_big(void)
+{
+    static uint8_t rom[0x10000];
+
+    TEST_ASSERT_FALSE(disasm_analyse(&disasm, rom, sizeof(rom)));
+    TEST_ASSERT_TRUE(disasm_analyse(&disasm, rom, 0));
+    TEST_ASSERT_EQUAL(0, disasm.block_count);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_format);
+    RUN_TEST(test_blocks);
+    RUN_TEST(test_straight_line);
+    RUN_TEST(test_indirect);
+    RUN_TEST(test_self_modifying);
+    RUN_TEST(test_write);
+    RUN_TEST(test_too_big);
+    return UNITY_END();
+}
@@ -0,0 +1,68 @@
+#include "unity.h"
+#include "file_map.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_MAP_FILE "test_file_map.bin"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    remove(TEST_MAP_FILE);
+}
+
+static void write_file(const uint8_t *p_data, size_t size)
+{
+    FILE *p_fp = fopen(TEST_MAP_FILE, "wb");
+    TEST_ASSERT_NOT_NULL(p_fp);
+    if(0 != size)
+    {
+        TEST_ASSERT_EQUAL(size, fwrite(p_data, 1, size, p_fp));
+    }
+    fclose(p_fp);
+}
+
+void test_map(void)
+{
+    const uint8_t data[] = { 0x00, 0xE0, 0xA2, 0x2A, 0x12, 0x00 };
+    file_map_t map;
+
+    write_file(data, sizeof(data));
+    TEST_ASSERT_TRUE(file_map_open(&map, TEST_MAP_FILE));
+    TEST_ASSERT_EQUAL(sizeof(data), map.size);
+    TEST_ASSERT_EQUAL_MEMORY(data, map.p_data, sizeof(data));
+    file_map_close(&map);
+    TEST_ASSERT_NULL(map.p_data);
+    TEST_ASSERT_EQUAL(0, map.size);
+}
+
+void test_map_empty(void)
+{
+    file_map_t map;
+
+    write_file(NULL, 0);
+    TEST_ASSERT_TRUE(file_map_open(&map, TEST_MAP_FILE));
+    TEST_ASSERT_EQUAL(0, map.size);
+    TEST_ASSERT_NULL(map.p_data);
+    file_map_close(&map);
+}
+
+void test_map_missing(void)
+{
+    file_map_t map;
+
+    TEST_ASSERT_FALSE(file_map_open(&map, "no_such_file.bin"));
+    TEST_ASSERT_NULL(map.p_data);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_map);
+    RUN_TEST(test_map_empty);
+    RUN_TEST(test_map_missing);
+    return UNITY_END();
+}
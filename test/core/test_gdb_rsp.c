@@ -0,0 +1,288 @@
+#include "unity.h"
+#include "cpu.h"
+#include "debug.h"
+#include "gdb_rsp.h"
+#include "history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+chip8_t *p_cpu;
+debug_t debug;
+gdb_rsp_t rsp;
+
+void setUp(void)
+{
+    p_cpu = cpu_init();
+    debug_init(&debug);
+    p_cpu->p_debug = &debug;
+    cpu_seed_rng(p_cpu, 1);
+    gdb_rsp_init(&rsp, p_cpu);
+}
+
+void tearDown(void)
+{
+    cpu_free(p_cpu);
+}
+
+static void load(const uint8_t *p_program, size_t size)
+{
+    memcpy(&p_cpu->memory[START_ADDRESS], p_program, size);
+}
+
+static void send_raw(const char *p_text)
+{
+    gdb_rsp_receive(&rsp, (const uint8_t *)p_text, strlen(p_text));
+}
+
+// Frame a packet the way a client would and feed it in
+static void send(const char *p_payload)
+{
+    char packet[GDB_RSP_PACKET_SIZE + 8];
+    unsigned checksum = 0;
+
+    for(const char *p = p_payload; '\0' != *p; p++)
+    {
+        checksum = (checksum + (unsigned char)*p) & 0xFF;
+    }
+    snprintf(packet, sizeof(packet), "$%s#%02x", p_payload, checksum);
+    send_raw(packet);
+}
+
+// Take everything replied so far, as a string
+static const char *take(void)
+{
+    static char text[GDB_RSP_OUTPUT_SIZE + 1];
+
+    memcpy(text, rsp.output, rsp.output_length);
+    text[rsp.output_length] = '\0';
+    gdb_rsp_sent(&rsp, rsp.output_length);
+
+    return text;
+}
+
+void test_init_pauses(void)
+{
+    TEST_ASSERT_EQUAL(DEBUG_PAUSED, debug.stop);
+    send("?");
+    TEST_ASSERT_EQUAL_STRING("+$T02#b6", take());
+}
+
+void test_registers(void)
+{
+    p_cpu->V[0] = 0x12;
+    p_cpu->V[0xF] = 0x01;
+    p_cpu->index = 0x0345;
+    p_cpu->delayTimer = 0x3C;
+
+    send("g");
+    TEST_ASSERT_EQUAL_STRING("+$12000000000000000000000000000001"
+                             "4503" "0002" "00" "3c" "00" "#e8",
+                             take());
+
+    // One register, then all of them back
+    send("P11=0403");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+    TEST_ASSERT_EQUAL_HEX16(0x0304, p_cpu->pc);
+    send("p11");
+    TEST_ASSERT_EQUAL_STRING("+$0403#c7", take());
+
+    send("Gff0000000000000000000000000000000002000201000");
+    TEST_ASSERT_EQUAL_STRING("+$E01#a6", take());
+    send("Gff00000000000000000000000000000000020002010000");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+    TEST_ASSERT_EQUAL(0xFF, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL(0, p_cpu->V[0xF]);
+    TEST_ASSERT_EQUAL_HEX16(0x0200, p_cpu->index);
+    TEST_ASSERT_EQUAL_HEX16(0x0200, p_cpu->pc);
+    TEST_ASSERT_EQUAL(1, p_cpu->sp);
+
+    send("p15");
+    TEST_ASSERT_EQUAL_STRING("+$E01#a6", take());
+}
+
+void test_memory(void)
+{
+    send("M300,3:a1b2c3");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+    TEST_ASSERT_EQUAL_HEX8(0xB2, p_cpu->memory[0x301]);
+    send("m2ff,5");
+    TEST_ASSERT_EQUAL_STRING("+$00a1b2c300#7c", take());
+
+    // Nothing past the end of memory
+    send("mfff,2");
+    TEST_ASSERT_EQUAL_STRING("+$E01#a6", take());
+    send("Mfff,1:zz");
+    TEST_ASSERT_EQUAL_STRING("+$E01#a6", take());
+
+    // A write that goes bad part way leaves memory as it was
+    send("M300,3:d4e5zz");
+    TEST_ASSERT_EQUAL_STRING("+$E01#a6", take());
+    TEST_ASSERT_EQUAL_HEX8(0xA1, p_cpu->memory[0x300]);
+    TEST_ASSERT_EQUAL_HEX8(0xB2, p_cpu->memory[0x301]);
+}
+
+void test_continue_to_breakpoint(void)
+{
+    const uint8_t program[] = { 0x70, 0x01, 0x70, 0x10, 0x12, 0x00 };
+
+    load(program, sizeof(program));
+    send("Z0,202,2");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+
+    // A continue answers once the cpu stops
+    send("c");
+    TEST_ASSERT_EQUAL_STRING("+", take());
+    TEST_ASSERT_TRUE(rsp.running);
+    gdb_rsp_check_stop(&rsp);
+    TEST_ASSERT_EQUAL_STRING("", take());
+    cpu_run(p_cpu, 10);
+    gdb_rsp_check_stop(&rsp);
+    TEST_ASSERT_EQUAL_STRING("$T05#b9", take());
+    TEST_ASSERT_EQUAL_HEX16(0x202, p_cpu->pc);
+    TEST_ASSERT_FALSE(rsp.running);
+
+    // And round again
+    send("c");
+    cpu_run(p_cpu, 9);
+    gdb_rsp_check_stop(&rsp);
+    TEST_ASSERT_EQUAL_STRING("+$T05#b9", take());
+    TEST_ASSERT_EQUAL(0x12, p_cpu->V[0]);
+
+    send("z0,202,2");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+    TEST_ASSERT_EQUAL(0, debug.breakpoint_count);
+}
+
+void test_interrupt_and_watch(void)
+{
+    // Store V0 at 0x300 after a while
+    const uint8_t program[] = { 0xA3, 0x00, 0x70, 0x01, 0x30, 0x05, 0x12, 0x02, 0xF0, 0x55, 0x12, 0x08 };
+
+    load(program, sizeof(program));
+    send("c");
+    take();
+    cpu_run(p_cpu, 3);
+    send_raw("\x03");
+    cpu_run(p_cpu, 3);
+    gdb_rsp_check_stop(&rsp);
+    TEST_ASSERT_EQUAL_STRING("$T02#b6", take());
+    TEST_ASSERT_EQUAL(3, p_cpu->frame_cycle);
+
+    send("Z2,300,1");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+    send("c");
+    cpu_run(p_cpu, 100);
+    gdb_rsp_check_stop(&rsp);
+    TEST_ASSERT_EQUAL_STRING("+$T05watch:300;#d8", take());
+    TEST_ASSERT_EQUAL(5, p_cpu->memory[0x300]);
+}
+
+void test_step(void)
+{
+    const uint8_t program[] = { 0x70, 0x01, 0x70, 0x01 };
+
+    load(program, sizeof(program));
+    send("s");
+    TEST_ASSERT_EQUAL_STRING("+$T05#b9", take());
+    TEST_ASSERT_EQUAL_HEX16(0x202, p_cpu->pc);
+    TEST_ASSERT_EQUAL(1, p_cpu->V[0]);
+    TEST_ASSERT_FALSE(rsp.running);
+}
+
+void test_framing(void)
+{
+    // A bad checksum is refused and the packet ignored
+    send_raw("$g#00");
+    TEST_ASSERT_EQUAL_STRING("-", take());
+
+    // Acks and noise between packets don't matter
+    send_raw("+++");
+    TEST_ASSERT_EQUAL_STRING("", take());
+
+    send("vMustReplyEmpty");
+    TEST_ASSERT_EQUAL_STRING("+$#00", take());
+    send("qSupported:multiprocess+");
+    TEST_ASSERT_EQUAL_STRING("+$PacketSize=1000;QStartNoAckMode+#07", take());
+
+    // No-ack mode is acknowledged itself, nothing after it is
+    send("QStartNoAckMode");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+    send("qAttached");
+    TEST_ASSERT_EQUAL_STRING("$1#31", take());
+}
+
+void test_reverse(void)
+{
+    const uint8_t program[] = { 0x70, 0x01, 0x12, 0x00 };
+    history_t history;
+
+    load(program, sizeof(program));
+    send("bs");
+    TEST_ASSERT_EQUAL_STRING("+$#00", take());
+
+    TEST_ASSERT_TRUE(history_begin(&history, p_cpu, 10, 2));
+    rsp.p_history = &history;
+    send("qSupported");
+    TEST_ASSERT_EQUAL_STRING("+$PacketSize=1000;QStartNoAckMode+;ReverseStep+;ReverseContinue+#6c", take());
+
+    debug_continue(p_cpu);
+    for(int frame = 0; frame < 5; frame++)
+    {
+        TEST_ASSERT_TRUE(history_frame(&history, p_cpu));
+        cpu_run(p_cpu, 10);
+        cpu_timer_tick(p_cpu);
+    }
+    TEST_ASSERT_TRUE(history_frame(&history, p_cpu));
+    TEST_ASSERT_EQUAL(25, p_cpu->V[0]);
+
+    send("bs");
+    TEST_ASSERT_EQUAL_STRING("+$T05#b9", take());
+    TEST_ASSERT_EQUAL(25, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x202, p_cpu->pc);
+
+    send("Z0,200,2");
+    send("bc");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a+$T05#b9", take());
+    TEST_ASSERT_EQUAL(24, p_cpu->V[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x200, p_cpu->pc);
+
+    send("z0,200,2");
+    send("bc");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a+$T05replaylog:begin;#02", take());
+    TEST_ASSERT_EQUAL(0, p_cpu->V[0]);
+
+    history_free(&history);
+}
+
+void test_detach(void)
+{
+    send("Z0,204,2");
+    send("Z4,300,2");
+    take();
+
+    send("D");
+    TEST_ASSERT_EQUAL_STRING("+$OK#9a", take());
+    TEST_ASSERT_TRUE(rsp.detached);
+    TEST_ASSERT_FALSE(rsp.killed);
+    TEST_ASSERT_FALSE(debug_active(&debug));
+
+    // Nothing more is read
+    send("g");
+    TEST_ASSERT_EQUAL_STRING("", take());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_pauses);
+    RUN_TEST(test_registers);
+    RUN_TEST(test_memory);
+    RUN_TEST(test_continue_to_breakpoint);
+    RUN_TEST(test_interrupt_and_watch);
+    RUN_TEST(test_step);
+    RUN_TEST(test_framing);
+    RUN_TEST(test_reverse);
+    RUN_TEST(test_detach);
+    return UNITY_END();
+}
@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "unity.h"
+#include "cpu.h"
+#include "debug.h"
+#include "gdb_server.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+chip8_t *p_cpu;
+debug_t debug;
+
+void setUp(void)
+{
+    p_cpu = cpu_init();
+    debug_init(&debug);
+    p_cpu->p_debug = &debug;
+}
+
+void tearDown(void)
+{
+    cpu_free(p_cpu);
+}
+
+// The client's side, in a process of its own: connect once the server is listening
+static int client_connect(uint16_t port)
+{
+    struct sockaddr_in address;
+    struct timespec pause = { 0, 10 * 1000 * 1000 };
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for(int attempt = 0; attempt < 500; attempt++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        if(fd < 0)
+        {
+            return -1;
+        }
+        if(0 == connect(fd, (const struct sockaddr *)&address, sizeof(address)))
+        {
+            return fd;
+        }
+        close(fd);
+        nanosleep(&pause, NULL);
+    }
+
+    return -1;
+}
+
+// Send a packet and check the server's ack and reply come back whole
+static bool client_exchange(int fd, const char *p_packet, const char *p_expected)
+{
+    char reply[64];
+    size_t expected = strlen(p_expected);
+    size_t got = 0;
+
+    if(send(fd, p_packet, strlen(p_packet), 0) < 0)
+    {
+        return false;
+    }
+    while(got < expected)
+    {
+        ssize_t received = recv(fd, reply + got, expected - got, 0);
+
+        if(received <= 0)
+        {
+            return false;
+        }
+        got += (size_t)received;
+    }
+
+    return 0 == memcmp(reply, p_expected, expected);
+}
+
+static int client_run(uint16_t port)
+{
+    int fd = client_connect(port);
+    bool ok = fd >= 0;
+
+    ok = ok && client_exchange(fd, "$?#3f", "+$T02#b6");
+    ok = ok && client_exchange(fd, "$M300,3:a1b2c3#35", "+$OK#9a");
+    ok = ok && client_exchange(fd, "$m2ff,5#cc", "+$00a1b2c300#7c");
+    ok = ok && client_exchange(fd, "$M300,2:d4zz#04", "+$E01#a6");
+    ok = ok && client_exchange(fd, "$k#6b", "+");
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+
+    return ok ? 0 : 1;
+}
+
+void test_round_trip(void)
+{
+    gdb_server_t server;
+    char address[8];
+    // Somewhere other test runs on the machine are unlikely to be
+    uint16_t port = (uint16_t)(20000 + getpid() % 20000);
+    int status = 0;
+    pid_t client = 0;
+
+    snprintf(address, sizeof(address), "%u", (unsigned)port);
+    fflush(stdout);
+    client = fork();
+    TEST_ASSERT_TRUE(client >= 0);
+    if(0 == client)
+    {
+        _exit(client_run(port));
+    }
+
+    TEST_ASSERT_TRUE(gdb_server_open(&server, address, p_cpu));
+    while(gdb_server_poll(&server, true) && server.fd >= 0)
+    {
+    }
+    gdb_server_close(&server);
+
+    TEST_ASSERT_EQUAL(client, waitpid(client, &status, 0));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL(0, WEXITSTATUS(status));
+    TEST_ASSERT_TRUE(server.rsp.killed);
+    TEST_ASSERT_EQUAL_HEX8(0xA1, p_cpu->memory[0x300]);
+    TEST_ASSERT_EQUAL_HEX8(0xB2, p_cpu->memory[0x301]);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    return UNITY_END();
+}
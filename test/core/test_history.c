@@ -0,0 +1,212 @@
+#include "unity.h"
+#include "cpu.h"
+#include "debug.h"
+#include "history.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_CYCLES_PER_FRAME 16
+#define TEST_INTERVAL 8
+
+chip8_t *p_cpu;
+debug_t debug;
+history_t history;
+
+// Draws a random digit wherever the pressed key says, forever
+static const uint8_t test_rom[] = {
+    0xC0, 0x0F, // 0x200 RND V0, 0x0F
+    0xF0, 0x29, // 0x202 LD F, V0
+    0xF1, 0x0A, // 0x204 LD V1, K
+    0x62, 0x07, // 0x206 LD V2, 7
+    0x81, 0x22, // 0x208 AND V1, V2
+    0x81, 0x1E, // 0x20A SHL V1
+    0xA3, 0x00, // 0x20C LD I, 0x300
+    0xF2, 0x55, // 0x20E LD [I], V0-V2
+    0xF0, 0x29, // 0x210 LD F, V0
+    0xD1, 0x15, // 0x212 DRW V1, V1, 5
+    0x12, 0x00  // 0x214 JP 0x200
+};
+
+static chip8_t *new_cpu(void)
+{
+    chip8_t *p_new = cpu_init();
+
+    memcpy(&p_new->memory[START_ADDRESS], test_rom, sizeof(test_rom));
+    cpu_seed_rng(p_new, 7);
+
+    return p_new;
+}
+
+static uint16_t keypad_for(uint32_t frame)
+{
+    return (uint16_t)(((frame / 7) % 3) ? (1u << ((frame / 21) % 16)) : 0);
+}
+
+// Carry on from the start of frame to cycle of end_frame, recording it when asked
+static void play(chip8_t *p_target, history_t *p_record, uint32_t frame, uint32_t end_frame, uint32_t end_cycle)
+{
+    for(;; frame++)
+    {
+        p_target->keypad_register = keypad_for(frame);
+        if(NULL != p_record)
+        {
+            TEST_ASSERT_TRUE(history_frame(p_record, p_target));
+        }
+        if(frame == end_frame)
+        {
+            break;
+        }
+        cpu_run(p_target, TEST_CYCLES_PER_FRAME - p_target->frame_cycle);
+        cpu_timer_tick(p_target);
+    }
+    cpu_run(p_target, end_cycle - p_target->frame_cycle);
+}
+
+static void assert_same(const chip8_t *p_expected, const chip8_t *p_actual)
+{
+    TEST_ASSERT_EQUAL_MEMORY(p_expected->V, p_actual->V, sizeof(p_expected->V));
+    TEST_ASSERT_EQUAL_HEX16(p_expected->pc, p_actual->pc);
+    TEST_ASSERT_EQUAL_HEX16(p_expected->index, p_actual->index);
+    TEST_ASSERT_EQUAL(p_expected->sp, p_actual->sp);
+    TEST_ASSERT_EQUAL(p_expected->delayTimer, p_actual->delayTimer);
+    TEST_ASSERT_EQUAL(p_expected->frame_cycle, p_actual->frame_cycle);
+    TEST_ASSERT_EQUAL_HEX16(p_expected->keypad_register, p_actual->keypad_register);
+    TEST_ASSERT_EQUAL(p_expected->key_held, p_actual->key_held);
+    TEST_ASSERT_EQUAL(p_expected->rng_state, p_actual->rng_state);
+    TEST_ASSERT_EQUAL_MEMORY(p_expected->vram, p_actual->vram, sizeof(p_expected->vram));
+    TEST_ASSERT_EQUAL_MEMORY(p_expected->memory, p_actual->memory, p_expected->memory_size);
+}
+
+// Where a straight run from the start is at cycle of frame
+static void assert_at(uint32_t frame, uint32_t cycle)
+{
+    chip8_t *p_expected = new_cpu();
+
+    play(p_expected, NULL, 0, frame, cycle);
+    assert_same(p_expected, p_cpu);
+    cpu_free(p_expected);
+}
+
+void setUp(void)
+{
+    p_cpu = new_cpu();
+    debug_init(&debug);
+    p_cpu->p_debug = &debug;
+    TEST_ASSERT_TRUE(history_begin(&history, p_cpu, TEST_CYCLES_PER_FRAME, TEST_INTERVAL));
+}
+
+void tearDown(void)
+{
+    history_free(&history);
+    cpu_free(p_cpu);
+}
+
+void test_keyframes(void)
+{
+    play(p_cpu, &history, 0, 100, 3);
+    TEST_ASSERT_EQUAL(101, history.frame_count);
+    TEST_ASSERT_EQUAL(13, history.keyframe_count);
+    TEST_ASSERT_EQUAL(96, history.p_keyframes[12].frame);
+    TEST_ASSERT_EQUAL(101, history.input.frame_count);
+
+    // Going back forgets what came after
+    TEST_ASSERT_TRUE(history_seek(&history, p_cpu, 50, 9));
+    assert_at(50, 9);
+    TEST_ASSERT_EQUAL(51, history.frame_count);
+    TEST_ASSERT_EQUAL(7, history.keyframe_count);
+    TEST_ASSERT_EQUAL(51, history.input.frame_count);
+    TEST_ASSERT_FALSE(history_seek(&history, p_cpu, 50, 10));
+    TEST_ASSERT_FALSE(history_seek(&history, p_cpu, 51, 0));
+
+    // and running on records it again
+    cpu_run(p_cpu, TEST_CYCLES_PER_FRAME - p_cpu->frame_cycle);
+    cpu_timer_tick(p_cpu);
+    play(p_cpu, &history, 51, 80, 0);
+    assert_at(80, 0);
+    TEST_ASSERT_EQUAL(11, history.keyframe_count);
+    TEST_ASSERT_TRUE(history_seek(&history, p_cpu, 70, 15));
+    assert_at(70, 15);
+}
+
+void test_step_back(void)
+{
+    play(p_cpu, &history, 0, 41, 2);
+
+    TEST_ASSERT_TRUE(history_step_back(&history, p_cpu));
+    assert_at(41, 1);
+    TEST_ASSERT_EQUAL(DEBUG_STEPPED, debug.stop);
+    TEST_ASSERT_TRUE(history_step_back(&history, p_cpu));
+    TEST_ASSERT_TRUE(history_step_back(&history, p_cpu));
+    assert_at(40, TEST_CYCLES_PER_FRAME - 1);
+
+    // Back to the start, and no further
+    TEST_ASSERT_TRUE(history_seek(&history, p_cpu, 0, 1));
+    TEST_ASSERT_TRUE(history_step_back(&history, p_cpu));
+    assert_at(0, 0);
+    TEST_ASSERT_FALSE(history_step_back(&history, p_cpu));
+}
+
+void test_continue_back_to_breakpoint(void)
+{
+    play(p_cpu, &history, 0, 60, 5);
+    debug_set_breakpoint(&debug, 0x212, true);
+
+    // Every draw is a few cycles apart, the last one before now is the one
+    TEST_ASSERT_TRUE(history_continue_back(&history, p_cpu));
+    TEST_ASSERT_EQUAL(DEBUG_BREAKPOINT, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x212, debug.stop_address);
+    TEST_ASSERT_EQUAL_HEX16(0x212, p_cpu->pc);
+    uint32_t frame = history.frame_count - 1;
+    uint32_t cycle = p_cpu->frame_cycle;
+    assert_at(frame, cycle);
+
+    // Going forward again runs from here to the same draw
+    debug_continue(p_cpu);
+    TEST_ASSERT_TRUE(history_continue_back(&history, p_cpu));
+    TEST_ASSERT_TRUE(history.frame_count - 1 < frame ||
+                     (history.frame_count - 1 == frame && p_cpu->frame_cycle < cycle));
+    debug_continue(p_cpu);
+    cpu_run(p_cpu, TEST_CYCLES_PER_FRAME - p_cpu->frame_cycle);
+    while(DEBUG_RUNNING == debug.stop)
+    {
+        cpu_timer_tick(p_cpu);
+        play(p_cpu, &history, history.frame_count, history.frame_count, TEST_CYCLES_PER_FRAME);
+    }
+    TEST_ASSERT_EQUAL(frame, history.frame_count - 1);
+    TEST_ASSERT_EQUAL(cycle, p_cpu->frame_cycle);
+}
+
+void test_continue_back_to_watch(void)
+{
+    play(p_cpu, &history, 0, 30, 0);
+    debug_set_watch(&debug, 0x302, 1, DEBUG_WATCH_WRITE, true);
+
+    TEST_ASSERT_TRUE(history_continue_back(&history, p_cpu));
+    TEST_ASSERT_EQUAL(DEBUG_WATCH_WRITE_HIT, debug.stop);
+    TEST_ASSERT_EQUAL_HEX16(0x302, debug.stop_address);
+    // Stopped just after the store
+    TEST_ASSERT_EQUAL_HEX16(0x210, p_cpu->pc);
+    assert_at(history.frame_count - 1, p_cpu->frame_cycle);
+}
+
+void test_continue_back_without_stops(void)
+{
+    play(p_cpu, &history, 0, 20, 7);
+
+    TEST_ASSERT_FALSE(history_continue_back(&history, p_cpu));
+    assert_at(0, 0);
+    TEST_ASSERT_EQUAL(DEBUG_STEPPED, debug.stop);
+    TEST_ASSERT_EQUAL(1, history.frame_count);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_keyframes);
+    RUN_TEST(test_step_back);
+    RUN_TEST(test_continue_back_to_breakpoint);
+    RUN_TEST(test_continue_back_to_watch);
+    RUN_TEST(test_continue_back_without_stops);
+    return UNITY_END();
+}
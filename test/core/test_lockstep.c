@@ -0,0 +1,615 @@
+#include "unity.h"
+#include "cpu.h"
+#include "debug.h"
+#include "disasm.h"
+#include "rom_cache.h"
+#include "trace.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Every engine has to leave the machine exactly as cpu_cycle() one
+ * instruction at a time does. Each candidate runs in lockstep with that
+ * reference, on random instruction streams, on small hand written
+ * programs and on any ROMs named on the command line, and the two
+ * machines are compared after every instruction or block of them. A new
+ * engine only needs an entry in engines[].
+ */
+
+#define STREAM_START START_ADDRESS
+#define STREAM_BYTES 0x100
+#define SUBROUTINES (STREAM_START + STREAM_BYTES) // after the stream's closing jump
+#define SUBROUTINE_SLOTS 8
+#define SUBROUTINE_BYTES 6
+#define INDEX_LIMIT 0x400 // Annn stays below, so nothing reads or writes past 0x400 + 64
+#define STREAM_FRAMES 24
+#define ROM_FRAMES 600
+#define RECENT_INSTRUCTIONS 8
+
+typedef struct engine
+{
+    const char *p_name;
+    void (*attach)(chip8_t *p_cpu); // NULL for a bare cpu
+    void (*run)(chip8_t *p_cpu, uint32_t cycles);
+} engine_t;
+
+// One field the machines don't agree on
+typedef struct divergence
+{
+    const char *p_field;
+    uint32_t offset; // into the field, for arrays
+    uint64_t reference;
+    uint64_t candidate;
+} divergence_t;
+
+// An instruction the reference executed, for the report
+typedef struct recent
+{
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t operand;
+} recent_t;
+
+static chip8_t *p_reference;
+static chip8_t *p_candidate;
+static debug_t debug;
+static trace_t trace;
+static recent_t recent[RECENT_INSTRUCTIONS];
+static uint32_t recent_head;
+static char message[2048];
+static char **pp_roms;
+static int rom_count;
+
+static void attach_trace(chip8_t *p_cpu)
+{
+    // Never flushed, the smallest ring will do
+    TEST_ASSERT_TRUE(trace_init(&trace, 1));
+    p_cpu->p_trace = &trace;
+}
+
+// Never stops, a breakpoint at an odd address is only there to take cpu_run() down its debugger path
+static void attach_debug(chip8_t *p_cpu)
+{
+    debug_init(&debug);
+    debug_set_breakpoint(&debug, 0x001, true);
+    p_cpu->p_debug = &debug;
+}
+
+static const engine_t engines[] =
+{
+    { "cpu_run", NULL, cpu_run },
+    { "cpu_run traced", attach_trace, cpu_run },
+    { "cpu_run debugged", attach_debug, cpu_run },
+};
+
+static uint32_t next_random(uint32_t *p_state)
+{
+    *p_state ^= *p_state << 13;
+    *p_state ^= *p_state >> 17;
+    *p_state ^= *p_state << 5;
+    return *p_state;
+}
+
+static uint16_t fetch(const chip8_t *p_cpu, uint32_t address)
+{
+    return (uint16_t)(p_cpu->memory[address & (p_cpu->memory_size - 1)] << 8 |
+                      p_cpu->memory[(address + 1) & (p_cpu->memory_size - 1)]);
+}
+
+static void reference_run(chip8_t *p_cpu, uint32_t cycles)
+{
+    for(uint32_t i = 0; i < cycles; i++)
+    {
+        recent_t *p_recent = &recent[recent_head++ % RECENT_INSTRUCTIONS];
+
+        p_recent->pc = p_cpu->pc;
+        p_recent->opcode = fetch(p_cpu, p_cpu->pc);
+        p_recent->operand = fetch(p_cpu, p_cpu->pc + 2u);
+        cpu_cycle(p_cpu);
+        p_cpu->frame_cycle++;
+    }
+}
+
+static bool differ(divergence_t *p_div, const char *p_field, uint32_t offset, uint64_t reference, uint64_t candidate)
+{
+    if(reference == candidate)
+    {
+        return false;
+    }
+    p_div->p_field = p_field;
+    p_div->offset = offset;
+    p_div->reference = reference;
+    p_div->candidate = candidate;
+
+    return true;
+}
+
+static bool differ_bytes(divergence_t *p_div, const char *p_field, const uint8_t *p_ref, const uint8_t *p_cand,
+                         size_t size)
+{
+    for(size_t i = 0; i < size; i++)
+    {
+        if(differ(p_div, p_field, (uint32_t)i, p_ref[i], p_cand[i]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Everything an instruction can change, idle_cycles aside since only cpu_run() skips
+static bool find_divergence(const chip8_t *p_ref, const chip8_t *p_cand, divergence_t *p_div)
+{
+    if(differ(p_div, "pc", 0, p_ref->pc, p_cand->pc) ||
+       differ(p_div, "I", 0, p_ref->index, p_cand->index) ||
+       differ_bytes(p_div, "V", p_ref->V, p_cand->V, sizeof(p_ref->V)) ||
+       differ(p_div, "sp", 0, p_ref->sp, p_cand->sp) ||
+       differ(p_div, "delay timer", 0, p_ref->delayTimer, p_cand->delayTimer) ||
+       differ(p_div, "sound timer", 0, p_ref->soundTimer, p_cand->soundTimer) ||
+       differ(p_div, "frame_cycle", 0, p_ref->frame_cycle, p_cand->frame_cycle) ||
+       differ(p_div, "display_wait", 0, p_ref->display_wait, p_cand->display_wait) ||
+       differ(p_div, "display_dirty", 0, p_ref->display_dirty, p_cand->display_dirty) ||
+       differ(p_div, "hires", 0, p_ref->hires, p_cand->hires) ||
+       differ(p_div, "planes", 0, p_ref->planes, p_cand->planes) ||
+       differ(p_div, "key_held", 0, p_ref->key_held, p_cand->key_held) ||
+       differ(p_div, "rng_state", 0, p_ref->rng_state, p_cand->rng_state) ||
+       differ(p_div, "sound_gate", 0, p_ref->sound_gate, p_cand->sound_gate) ||
+       differ(p_div, "sound_edge_count", 0, p_ref->sound_edge_count, p_cand->sound_edge_count) ||
+       differ(p_div, "pitch", 0, p_ref->pitch, p_cand->pitch) ||
+       differ(p_div, "audio_pattern_active", 0, p_ref->audio_pattern_active, p_cand->audio_pattern_active) ||
+       differ_bytes(p_div, "audio_pattern", p_ref->audio_pattern, p_cand->audio_pattern,
+                    sizeof(p_ref->audio_pattern)) ||
+       differ_bytes(p_div, "rpl", p_ref->rpl, p_cand->rpl, sizeof(p_ref->rpl)))
+    {
+        return true;
+    }
+    for(uint32_t i = 0; i < STACK_SIZE; i++)
+    {
+        if(differ(p_div, "stack", i, p_ref->stack[i], p_cand->stack[i]))
+        {
+            return true;
+        }
+    }
+    for(uint32_t i = 0; i < p_ref->sound_edge_count && i < SOUND_EDGES_MAX; i++)
+    {
+        if(differ(p_div, "sound_edges", i, p_ref->sound_edges[i], p_cand->sound_edges[i]))
+        {
+            return true;
+        }
+    }
+    // Word by word, reported as plane * DISPLAY_H * DISPLAY_WORDS + row * DISPLAY_WORDS + word
+    if(0 != memcmp(p_ref->vram, p_cand->vram, sizeof(p_ref->vram)))
+    {
+        const uint64_t *p_ref_words = &p_ref->vram[0][0][0];
+        const uint64_t *p_cand_words = &p_cand->vram[0][0][0];
+
+        for(uint32_t i = 0; i < sizeof(p_ref->vram) / sizeof(uint64_t); i++)
+        {
+            if(differ(p_div, "vram", i, p_ref_words[i], p_cand_words[i]))
+            {
+                return true;
+            }
+        }
+    }
+
+    return 0 != memcmp(p_ref->memory, p_cand->memory, p_ref->memory_size) &&
+           differ_bytes(p_div, "memory", p_ref->memory, p_cand->memory, p_ref->memory_size);
+}
+
+// Say where the machines parted and what the reference ran just before
+static void report(const engine_t *p_engine, const char *p_corpus, uint32_t frame, uint32_t block_start,
+                   uint32_t block, const divergence_t *p_div)
+{
+    size_t length = 0;
+    uint32_t first = (recent_head > RECENT_INSTRUCTIONS) ? recent_head - RECENT_INSTRUCTIONS : 0;
+
+    length += (size_t)snprintf(message, sizeof(message),
+                               "%s diverged from cpu_cycle on %s, frame %" PRIu32 " cycles %" PRIu32 "-%" PRIu32
+                               ": %s[%" PRIu32 "] is %#" PRIx64 ", should be %#" PRIx64 "\n"
+                               "  the reference ran, most recent last:\n",
+                               p_engine->p_name, p_corpus, frame, block_start, block_start + block - 1,
+                               p_div->p_field, p_div->offset, p_div->candidate, p_div->reference);
+    for(uint32_t i = first; i < recent_head && length < sizeof(message); i++)
+    {
+        const recent_t *p_recent = &recent[i % RECENT_INSTRUCTIONS];
+        char text[64];
+
+        disasm_format(text, sizeof(text), p_recent->opcode, p_recent->operand);
+        length += (size_t)snprintf(message + length, sizeof(message) - length, "    %04X  %04X  %s\n",
+                                   p_recent->pc, p_recent->opcode, text);
+    }
+    if(length < sizeof(message))
+    {
+        snprintf(message + length, sizeof(message) - length,
+                 "  pc %04X I %04X, should be pc %04X I %04X",
+                 p_candidate->pc, p_candidate->index, p_reference->pc, p_reference->index);
+    }
+}
+
+/*
+ * Run frames of cycles cycles on both machines, which must start out the
+ * same, with the keypad changing every frame. With single set each
+ * instruction is compared, otherwise blocks of random length, which give
+ * the superinstructions and idle skipping room.
+ */
+static bool lockstep(const engine_t *p_engine, const char *p_corpus, uint32_t frames, uint32_t cycles,
+                     bool single, uint32_t seed)
+{
+    divergence_t div;
+
+    recent_head = 0;
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        uint32_t done = 0;
+        // Random keys, about half of them held
+        uint16_t keypad = (uint16_t)next_random(&seed);
+
+        p_reference->keypad_register = keypad;
+        p_candidate->keypad_register = keypad;
+        while(done < cycles)
+        {
+            uint32_t block = single ? 1 : 1 + next_random(&seed) % (cycles - done);
+
+            p_engine->run(p_candidate, block);
+            reference_run(p_reference, block);
+            if(find_divergence(p_reference, p_candidate, &div))
+            {
+                report(p_engine, p_corpus, frame, done, block, &div);
+                return false;
+            }
+            done += block;
+        }
+
+        cpu_timer_tick(p_reference);
+        cpu_timer_tick(p_candidate);
+    }
+
+    return true;
+}
+
+// Two cpus with the same program and seed, the candidate with the engine attached
+static void make_pair(const engine_t *p_engine, uint32_t memory_size, uint32_t quirks,
+                      const uint8_t *p_program, size_t size)
+{
+    p_reference = cpu_init_memory(memory_size);
+    p_candidate = cpu_init_memory(memory_size);
+    TEST_ASSERT_NOT_NULL(p_reference);
+    TEST_ASSERT_NOT_NULL(p_candidate);
+    TEST_ASSERT_TRUE(cpu_load_program_mem(p_reference, p_program, size));
+    TEST_ASSERT_TRUE(cpu_load_program_mem(p_candidate, p_program, size));
+    p_reference->quirks = quirks;
+    p_candidate->quirks = quirks;
+    cpu_seed_rng(p_reference, CPU_DEFAULT_SEED);
+    cpu_seed_rng(p_candidate, CPU_DEFAULT_SEED);
+    if(NULL != p_engine->attach)
+    {
+        p_engine->attach(p_candidate);
+    }
+}
+
+static void free_pair(void)
+{
+    cpu_free(p_reference);
+    cpu_free(p_candidate);
+    p_reference = NULL;
+    p_candidate = NULL;
+    trace_free(&trace);
+}
+
+static size_t put(uint8_t *p_stream, size_t at, uint16_t opcode)
+{
+    p_stream[at] = (uint8_t)(opcode >> 8);
+    p_stream[at + 1] = (uint8_t)opcode;
+    return at + 2;
+}
+
+// Touches neither memory, I nor control flow
+static uint16_t random_plain(uint32_t *p_state, bool xochip)
+{
+    uint32_t r = next_random(p_state);
+    uint16_t x = (uint16_t)((r >> 8) & 0xF) << 8;
+    uint16_t y = (uint16_t)((r >> 12) & 0xF) << 4;
+    uint16_t nn = (uint16_t)((r >> 16) & 0xFF);
+    static const uint16_t alu[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+    static const uint16_t misc[] =
+    {
+        0x00E0, 0x00C3, 0x00FB, 0x00FC, 0x00FE, 0x00FF, 0xF007, 0xF015, 0xF018, 0xF029, 0xF030, 0xF075, 0xF085,
+        0xF00A, 0xF03A, 0xF001
+    };
+
+    switch(r % 8)
+    {
+        case 0:
+        case 1: return (uint16_t)(0x6000 | x | nn);
+        case 2:
+        case 3: return (uint16_t)(0x7000 | x | nn);
+        case 4:
+        case 5: return (uint16_t)(0x8000 | x | y | alu[(r >> 24) % (sizeof(alu) / sizeof(alu[0]))]);
+        case 6: return (uint16_t)(0xC000 | x | nn);
+        default:
+        {
+            uint16_t code = misc[(r >> 24) % (sizeof(misc) / sizeof(misc[0]))];
+
+            // Fn01 picks planes, only XO-CHIP has more than one
+            if(0xF001 == code && !xochip)
+            {
+                return (uint16_t)(0x6000 | x | nn);
+            }
+            // 00Cn scrolls n rows, the others use x
+            return (0x00C3 == code) ? (uint16_t)(0x00C0 | ((r >> 20) & 0xF)) :
+                   (0xF000 == (code & 0xF000)) ? (uint16_t)(code | x) : code;
+        }
+    }
+}
+
+/*
+ * A random program from slots of a couple of instructions. Everything
+ * that goes through I has an Annn in front of it in the same slot, and
+ * skips only skip the rest of their slot, with jumps only to the start of
+ * one, so I can never run off the end of memory and the stack never
+ * overflows whatever path is taken. Loads, adds, skips, draws, timer
+ * polls and jumps to themselves all turn up, which are what the
+ * superinstructions and idle skipping look for.
+ */
+static size_t random_stream(uint8_t *p_stream, uint32_t seed, bool xochip)
+{
+    uint16_t slots[STREAM_BYTES / 2];
+    uint32_t slot_count = 0;
+    size_t at = 0;
+    uint32_t state = seed;
+
+    memset(p_stream, 0, STREAM_BYTES + SUBROUTINE_SLOTS * SUBROUTINE_BYTES);
+    while(at + 6 <= STREAM_BYTES - 4)
+    {
+        uint32_t r = next_random(&state);
+        uint16_t x = (uint16_t)((r >> 8) & 0xF) << 8;
+        uint16_t y = (uint16_t)((r >> 12) & 0xF) << 4;
+        uint16_t nn = (uint16_t)((r >> 16) & 0xFF);
+        uint16_t address = (uint16_t)(STREAM_START + at);
+        uint16_t index = (uint16_t)(next_random(&state) % INDEX_LIMIT);
+
+        slots[slot_count++] = address;
+        switch(r % 12)
+        {
+            case 0:
+            case 1:
+            {
+                static const uint16_t through_i[] =
+                {
+                    0xD000, 0xD000, 0xD000, 0xF033, 0xF055, 0xF065, 0xF01E, 0xF002, 0x5002, 0x5003
+                };
+                uint16_t code = through_i[(r >> 24) % (sizeof(through_i) / sizeof(through_i[0]))];
+
+                if(0xD000 == code)
+                {
+                    code = (uint16_t)(code | x | y | ((r >> 4) & 0xF));
+                }
+                else if(0x5000 == (code & 0xF000))
+                {
+                    code = xochip ? (uint16_t)(code | x | y) : 0xF01E;
+                }
+                else if(0xF002 == code)
+                {
+                    code = xochip ? code : 0xF033;
+                }
+                at = put(p_stream, at, (uint16_t)(0xA000 | index));
+                if(0xF000 == (code & 0xF000) && 0xF002 != code)
+                {
+                    code = (uint16_t)(code | x);
+                }
+                at = put(p_stream, at, code);
+                break;
+            }
+            case 2:
+            case 3:
+            {
+                static const uint16_t skips[] = { 0x3000, 0x4000, 0x5000, 0x9000, 0xE09E, 0xE0A1 };
+                uint16_t code = skips[(r >> 24) % (sizeof(skips) / sizeof(skips[0]))];
+
+                code = (uint16_t)(code | x | ((0x3000 == code || 0x4000 == code) ? (nn & 0x0F) :
+                                              (0x5000 == code || 0x9000 == code) ? y : 0));
+                at = put(p_stream, at, code);
+                // XO-CHIP skips hop the whole of F000 nnnn
+                if(xochip && 0 == (r >> 28) % 3)
+                {
+                    at = put(p_stream, at, 0xF000);
+                    at = put(p_stream, at, index);
+                }
+                else
+                {
+                    at = put(p_stream, at, random_plain(&state, xochip));
+                }
+                break;
+            }
+            case 4:
+            {
+                // Back to an earlier slot, or this one to go idle
+                uint16_t target = slots[next_random(&state) % slot_count];
+
+                at = put(p_stream, at, (uint16_t)(0x1000 | target));
+                break;
+            }
+            case 5:
+                at = put(p_stream, at, (uint16_t)(0x2000 | (SUBROUTINES + (nn % SUBROUTINE_SLOTS) * SUBROUTINE_BYTES)));
+                break;
+            case 6:
+                // Waiting for the delay timer, Fx07 3x00 or 4x00
+                at = put(p_stream, at, (uint16_t)(0xF007 | x));
+                at = put(p_stream, at, (uint16_t)(((r & 0x10) ? 0x3000 : 0x4000) | x));
+                break;
+            default:
+                at = put(p_stream, at, random_plain(&state, xochip));
+                at = put(p_stream, at, random_plain(&state, xochip));
+                break;
+        }
+    }
+    at = put(p_stream, at, (uint16_t)(0x1000 | STREAM_START));
+    put(p_stream, at, (uint16_t)(0x1000 | STREAM_START));
+
+    // Subroutines call nothing, so the stack is never more than one deep
+    for(uint32_t i = 0; i < SUBROUTINE_SLOTS; i++)
+    {
+        size_t sub = STREAM_BYTES + i * SUBROUTINE_BYTES;
+
+        sub = put(p_stream, sub, random_plain(&state, xochip));
+        sub = put(p_stream, sub, random_plain(&state, xochip));
+        put(p_stream, sub, 0x00EE);
+    }
+
+    return STREAM_BYTES + SUBROUTINE_SLOTS * SUBROUTINE_BYTES;
+}
+
+static void run_streams(bool single)
+{
+    static const struct
+    {
+        const char *p_name;
+        uint32_t quirks;
+        uint32_t memory_size;
+    } platforms[] =
+    {
+        { "CHIP-8", QUIRKS_CHIP8, MEMORY_SIZE },
+        { "SUPER-CHIP", QUIRKS_SCHIP, MEMORY_SIZE },
+        { "XO-CHIP", QUIRKS_XOCHIP, XOCHIP_MEMORY_SIZE },
+    };
+    uint8_t stream[STREAM_BYTES + SUBROUTINE_SLOTS * SUBROUTINE_BYTES];
+
+    for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++)
+    {
+        for(size_t p = 0; p < sizeof(platforms) / sizeof(platforms[0]); p++)
+        {
+            for(uint32_t seed = 1; seed <= 16; seed++)
+            {
+                char corpus[64];
+                bool xochip = XOCHIP_MEMORY_SIZE == platforms[p].memory_size;
+                size_t size = random_stream(stream, seed * 0x9E3779B9u, xochip);
+                bool same = false;
+
+                snprintf(corpus, sizeof(corpus), "%s stream %" PRIu32, platforms[p].p_name, seed);
+                make_pair(&engines[e], platforms[p].memory_size, platforms[p].quirks, stream, size);
+                same = lockstep(&engines[e], corpus, STREAM_FRAMES, 7 + seed * 3, single, seed);
+                free_pair();
+                if(!same)
+                {
+                    TEST_FAIL_MESSAGE(message);
+                }
+            }
+        }
+    }
+}
+
+void setUp(void)
+{
+    p_reference = NULL;
+    p_candidate = NULL;
+}
+
+void tearDown(void)
+{
+    free_pair();
+}
+
+void test_streams_each_instruction(void)
+{
+    run_streams(true);
+}
+
+void test_streams_blocks(void)
+{
+    run_streams(false);
+}
+
+void test_programs(void)
+{
+    static const struct
+    {
+        const char *p_name;
+        uint8_t program[24];
+        size_t size;
+        uint32_t quirks;
+    } programs[] =
+    {
+        // Annn Dxyn with the sprite moving right each time round
+        { "sprites", { 0xA0, 0x00, 0xD0, 0x15, 0x70, 0x01, 0x12, 0x00 }, 8, QUIRKS_CHIP8 },
+        // 7xnn 3xnn counting to 0x40, then idle
+        { "counter", { 0x70, 0x01, 0x30, 0x40, 0x12, 0x00, 0x12, 0x06 }, 8, QUIRKS_SCHIP },
+        // Fx07 3x00 waiting on the delay timer, then Fx15 to wait again
+        { "delay", { 0x61, 0x05, 0xF1, 0x15, 0xF0, 0x07, 0x30, 0x00, 0x12, 0x04, 0x12, 0x00 }, 12, QUIRKS_CHIP8 },
+        // 6xnn runs
+        { "loads", { 0x60, 0x01, 0x61, 0x02, 0x62, 0x03, 0x63, 0x04, 0x64, 0x05, 0x12, 0x00 }, 12, QUIRKS_XOCHIP },
+        // Fx0A waiting on a key, drawing it when it comes
+        { "keys", { 0xF0, 0x0A, 0xF0, 0x29, 0xD1, 0x15, 0x12, 0x00 }, 8, QUIRKS_CHIP8 },
+        // 00EE returning to itself, pc stays put but the stack unwinds
+        { "return", { 0x22, 0x02, 0x00, 0xEE }, 4, QUIRKS_CHIP8 },
+    };
+
+    for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++)
+    {
+        for(size_t p = 0; p < sizeof(programs) / sizeof(programs[0]); p++)
+        {
+            bool same = false;
+
+            make_pair(&engines[e], MEMORY_SIZE, programs[p].quirks, programs[p].program, programs[p].size);
+            same = lockstep(&engines[e], programs[p].p_name, 64, 100, false, (uint32_t)(p + 1));
+            free_pair();
+            if(!same)
+            {
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+    }
+}
+
+// ROMs given on the command line, each set up the way the frontends would
+void test_roms(void)
+{
+    rom_cache_t roms;
+
+    rom_cache_init(&roms);
+    for(int r = 0; r < rom_count; r++)
+    {
+        const rom_image_t *p_image = rom_cache_acquire_file(&roms, pp_roms[r]);
+        uint32_t cycles = 0;
+
+        TEST_ASSERT_NOT_NULL(p_image);
+        cycles = (0 != p_image->tickrate) ? p_image->tickrate : 16;
+        for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++)
+        {
+            bool same = false;
+
+            p_reference = rom_image_new_cpu(p_image);
+            p_candidate = rom_image_new_cpu(p_image);
+            TEST_ASSERT_NOT_NULL(p_reference);
+            TEST_ASSERT_NOT_NULL(p_candidate);
+            if(NULL != engines[e].attach)
+            {
+                engines[e].attach(p_candidate);
+            }
+            same = lockstep(&engines[e], pp_roms[r], ROM_FRAMES, cycles, false, (uint32_t)(r + 1));
+            free_pair();
+            if(!same)
+            {
+                rom_cache_free(&roms);
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+    }
+    rom_cache_free(&roms);
+}
+
+int main(int argc, char *argv[])
+{
+    pp_roms = argv + 1;
+    rom_count = argc - 1;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_streams_each_instruction);
+    RUN_TEST(test_streams_blocks);
+    RUN_TEST(test_programs);
+    RUN_TEST(test_roms);
+    return UNITY_END();
+}
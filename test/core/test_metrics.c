@@ -0,0 +1,146 @@
+#include "unity.h"
+#include "cpu.h"
+#include "metrics.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_METRICS_FILE "test_metrics.prom"
+
+chip8_t *p_cpu;
+metrics_t metrics;
+
+static char *read_file(const char *p_filename)
+{
+    FILE *p_fp = fopen(p_filename, "rb");
+    char *p_text = calloc(1, 1 << 16);
+    size_t length = 0;
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_NOT_NULL(p_text);
+    length = fread(p_text, 1, (1 << 16) - 1, p_fp);
+    p_text[length] = '\0';
+    fclose(p_fp);
+
+    return p_text;
+}
+
+void setUp(void)
+{
+    p_cpu = cpu_init();
+    metrics_init(&metrics);
+}
+
+void tearDown(void)
+{
+    cpu_free(p_cpu);
+    remove(TEST_METRICS_FILE);
+}
+
+void test_frame_counts_cycles(void)
+{
+    // Three instructions, then a jump to itself idles out the rest of the frame
+    static const uint8_t rom[] = { 0x60, 0x01, 0x70, 0x01, 0x12, 0x04 };
+
+    memcpy(&p_cpu->memory[START_ADDRESS], rom, sizeof(rom));
+    cpu_run(p_cpu, 100);
+    metrics_frame(&metrics, p_cpu, 1000000);
+    cpu_timer_tick(p_cpu);
+    cpu_run(p_cpu, 100);
+    metrics_frame(&metrics, p_cpu, 1000000);
+
+    TEST_ASSERT_EQUAL(2, metrics.frames);
+    TEST_ASSERT_EQUAL(200, metrics.cycles);
+    TEST_ASSERT_EQUAL(196, metrics.idle_cycles);
+    TEST_ASSERT_EQUAL(100, metrics.cycles_per_frame);
+    TEST_ASSERT_EQUAL(0, metrics.late_frames);
+
+    // A reset cpu starts counting idle cycles again
+    cpu_reset(p_cpu);
+    memcpy(&p_cpu->memory[START_ADDRESS], rom, sizeof(rom));
+    cpu_run(p_cpu, 10);
+    metrics_frame(&metrics, p_cpu, 1000000);
+    TEST_ASSERT_EQUAL(203, metrics.idle_cycles);
+}
+
+void test_late_frames(void)
+{
+    metrics_frame(&metrics, p_cpu, METRICS_FRAME_BUDGET_NS);
+    metrics_frame(&metrics, p_cpu, METRICS_FRAME_BUDGET_NS + 1);
+
+    TEST_ASSERT_EQUAL(1, metrics.late_frames);
+    TEST_ASSERT_EQUAL(METRICS_FRAME_BUDGET_NS + 1, metrics.frame_ns_max);
+}
+
+void test_quantiles(void)
+{
+    TEST_ASSERT_TRUE(metrics_quantile(&metrics, 0.5) <= 0.0);
+
+    // 90 frames of 20us, exact, and 10 of 16.7ms, within a sixteenth
+    for(int i = 0; i < 90; i++)
+    {
+        metrics_frame(&metrics, p_cpu, 20000);
+    }
+    for(int i = 0; i < 10; i++)
+    {
+        metrics_frame(&metrics, p_cpu, METRICS_FRAME_BUDGET_NS);
+    }
+
+    TEST_ASSERT_EQUAL(20, (int)(metrics_quantile(&metrics, 0.5) * 1e6 + 0.5));
+    TEST_ASSERT_EQUAL(20, (int)(metrics_quantile(&metrics, 0.89) * 1e6 + 0.5));
+    TEST_ASSERT_TRUE(metrics_quantile(&metrics, 0.9) >= 0.016666);
+    TEST_ASSERT_TRUE(metrics_quantile(&metrics, 0.999) <= 0.016666 * 17 / 16);
+}
+
+void test_huge_frames_land_in_the_last_bucket(void)
+{
+    metrics_frame(&metrics, p_cpu, UINT64_MAX / 2);
+    TEST_ASSERT_EQUAL(1, metrics.histogram[METRICS_BUCKETS - 1]);
+}
+
+void test_rate(void)
+{
+    metrics.cycles = 1000;
+    metrics.idle_cycles = 400;
+    metrics_rate(&metrics, 1000000000u);
+    TEST_ASSERT_TRUE(metrics.instructions_per_second <= 0.0);
+
+    metrics.cycles = 3000;
+    metrics_rate(&metrics, 1500000000u);
+    TEST_ASSERT_EQUAL(4000, (int)(metrics.instructions_per_second + 0.5));
+}
+
+void test_save(void)
+{
+    char *p_text = NULL;
+
+    metrics_frame(&metrics, p_cpu, 2000000);
+    metrics.audio_underruns = 3;
+    TEST_ASSERT_TRUE(metrics_save(&metrics, TEST_METRICS_FILE));
+
+    p_text = read_file(TEST_METRICS_FILE);
+    TEST_ASSERT_NOT_NULL(strstr(p_text, "# TYPE emueight_frames_total counter\nemueight_frames_total 1\n"));
+    TEST_ASSERT_NOT_NULL(strstr(p_text, "\nemueight_audio_underruns_total 3\n"));
+    TEST_ASSERT_NOT_NULL(strstr(p_text, "# TYPE emueight_frame_seconds summary\n"));
+    TEST_ASSERT_NOT_NULL(strstr(p_text, "\nemueight_frame_seconds{quantile=\"0.99\"} 0.002"));
+    TEST_ASSERT_NOT_NULL(strstr(p_text, "\nemueight_frame_seconds_count 1\n"));
+    free(p_text);
+
+    // Nothing left behind
+    p_text = read_file(TEST_METRICS_FILE);
+    free(p_text);
+    TEST_ASSERT_NULL(fopen(TEST_METRICS_FILE ".tmp", "r"));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_counts_cycles);
+    RUN_TEST(test_late_frames);
+    RUN_TEST(test_quantiles);
+    RUN_TEST(test_huge_frames_land_in_the_last_bucket);
+    RUN_TEST(test_rate);
+    RUN_TEST(test_save);
+    return UNITY_END();
+}
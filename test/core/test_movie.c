@@ -0,0 +1,172 @@
+#include "unity.h"
+#include "cpu.h"
+#include "movie.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MOVIE_FILE "test_movie.e8m"
+#define TEST_CYCLES_PER_FRAME 16
+
+chip8_t *p_cpu;
+movie_t movie;
+
+// Draws a random digit wherever the pressed key says, forever
+static const uint8_t test_rom[] = {
+    0xC0, 0x0F, // 0x200 RND V0, 0x0F
+    0xF0, 0x29, // 0x202 LD F, V0
+    0xF1, 0x0A, // 0x204 LD V1, K
+    0x62, 0x07, // 0x206 LD V2, 7
+    0x81, 0x22, // 0x208 AND V1, V2
+    0x81, 0x1E, // 0x20A SHL V1
+    0xD1, 0x15, // 0x20C DRW V1, V1, 5
+    0x12, 0x00  // 0x20E JP 0x200
+};
+
+static void load_test_rom(chip8_t *p_target)
+{
+    memcpy(&p_target->memory[START_ADDRESS], test_rom, sizeof(test_rom));
+}
+
+void setUp(void)
+{
+    p_cpu = cpu_init();
+    load_test_rom(p_cpu);
+    memset(&movie, 0, sizeof(movie));
+}
+
+void tearDown(void)
+{
+    cpu_free(p_cpu);
+    movie_free(&movie);
+    remove(TEST_MOVIE_FILE);
+}
+
+// Run a session with a changing keypad, recording every frame
+static void record_session(uint32_t frames)
+{
+    movie_record_begin(&movie, p_cpu, TEST_CYCLES_PER_FRAME);
+    for(uint32_t f = 0; f < frames; f++)
+    {
+        p_cpu->keypad_register = (uint16_t)(((f / 7) % 3) ? (1u << ((f / 21) % 16)) : 0);
+        TEST_ASSERT_TRUE(movie_record_frame(&movie, p_cpu->keypad_register));
+        cpu_run(p_cpu, TEST_CYCLES_PER_FRAME);
+        cpu_timer_tick(p_cpu);
+    }
+    movie_record_end(&movie, p_cpu);
+}
+
+void test_run_length_encoding(void)
+{
+    movie_record_begin(&movie, p_cpu, TEST_CYCLES_PER_FRAME);
+    for(int i = 0; i < 100; i++)
+    {
+        movie_record_frame(&movie, 0x0001);
+    }
+    movie_record_frame(&movie, 0x0002);
+    movie_record_frame(&movie, 0x0001);
+    TEST_ASSERT_EQUAL(3, movie.run_count);
+    TEST_ASSERT_EQUAL(102, movie.frame_count);
+    TEST_ASSERT_EQUAL(100, movie.p_runs[0].frames);
+
+    uint16_t keypad = 0;
+    uint32_t frames = 0;
+    while(movie_play_frame(&movie, &keypad))
+    {
+        TEST_ASSERT_EQUAL_HEX16(100 == frames ? 0x0002 : 0x0001, keypad);
+        frames++;
+    }
+    TEST_ASSERT_EQUAL(102, frames);
+}
+
+void test_seek_and_truncate(void)
+{
+    uint16_t keypad = 0;
+
+    movie_record_begin(&movie, p_cpu, TEST_CYCLES_PER_FRAME);
+    for(uint16_t i = 0; i < 30; i++)
+    {
+        // Runs of 10 frames each
+        movie_record_frame(&movie, (uint16_t)(i / 10));
+    }
+
+    TEST_ASSERT_TRUE(movie_play_seek(&movie, 10));
+    TEST_ASSERT_TRUE(movie_play_frame(&movie, &keypad));
+    TEST_ASSERT_EQUAL_HEX16(1, keypad);
+    TEST_ASSERT_TRUE(movie_play_seek(&movie, 29));
+    TEST_ASSERT_TRUE(movie_play_frame(&movie, &keypad));
+    TEST_ASSERT_EQUAL_HEX16(2, keypad);
+    TEST_ASSERT_FALSE(movie_play_frame(&movie, &keypad));
+    TEST_ASSERT_FALSE(movie_play_seek(&movie, 31));
+
+    // Cutting inside a run shortens it, the next frame can extend it again
+    movie_truncate(&movie, 15);
+    TEST_ASSERT_EQUAL(15, movie.frame_count);
+    TEST_ASSERT_EQUAL(2, movie.run_count);
+    TEST_ASSERT_EQUAL(5, movie.p_runs[1].frames);
+    movie_record_frame(&movie, 1);
+    TEST_ASSERT_EQUAL(2, movie.run_count);
+    movie_truncate(&movie, 10);
+    TEST_ASSERT_EQUAL(1, movie.run_count);
+    TEST_ASSERT_EQUAL(10, movie.frame_count);
+}
+
+void test_playback_reproduces_display(void)
+{
+    record_session(600);
+
+    chip8_t *p_replay = cpu_init();
+    load_test_rom(p_replay);
+    // A different seed must be overridden by the movie
+    cpu_seed_rng(p_replay, p_cpu->rng_seed + 1);
+    TEST_ASSERT_EQUAL(600, movie_play_all(&movie, p_replay));
+    TEST_ASSERT_TRUE(movie_play_verify(&movie, p_replay));
+    TEST_ASSERT_EQUAL_MEMORY(p_cpu->V, p_replay->V, sizeof(p_cpu->V));
+    cpu_free(p_replay);
+}
+
+void test_save_load_roundtrip(void)
+{
+    p_cpu->quirks = QUIRKS_CHIP8 & ~QUIRK_VF_RESET;
+    record_session(300);
+    TEST_ASSERT_TRUE(movie_save(&movie, TEST_MOVIE_FILE));
+
+    movie_t loaded;
+    TEST_ASSERT_TRUE(movie_load(&loaded, TEST_MOVIE_FILE));
+    TEST_ASSERT_EQUAL(movie.rng_seed, loaded.rng_seed);
+    TEST_ASSERT_EQUAL(movie.quirks, loaded.quirks);
+    TEST_ASSERT_EQUAL(movie.cycles_per_frame, loaded.cycles_per_frame);
+    TEST_ASSERT_EQUAL(movie.frame_count, loaded.frame_count);
+    TEST_ASSERT_EQUAL(movie.run_count, loaded.run_count);
+    TEST_ASSERT_TRUE(movie.display_hash == loaded.display_hash);
+
+    chip8_t *p_replay = cpu_init();
+    load_test_rom(p_replay);
+    movie_play_all(&loaded, p_replay);
+    TEST_ASSERT_EQUAL(movie.quirks, p_replay->quirks);
+    TEST_ASSERT_TRUE(movie_play_verify(&loaded, p_replay));
+    cpu_free(p_replay);
+    movie_free(&loaded);
+}
+
+void test_load_rejects_garbage(void)
+{
+    FILE *p_fp = fopen(TEST_MOVIE_FILE, "wb");
+    TEST_ASSERT_NOT_NULL(p_fp);
+    fputs("not a movie at all, just some text", p_fp);
+    fclose(p_fp);
+    TEST_ASSERT_FALSE(movie_load(&movie, TEST_MOVIE_FILE));
+    TEST_ASSERT_FALSE(movie_load(&movie, "does_not_exist.e8m"));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_run_length_encoding);
+    RUN_TEST(test_seek_and_truncate);
+    RUN_TEST(test_playback_reproduces_display);
+    RUN_TEST(test_save_load_roundtrip);
+    RUN_TEST(test_load_rejects_garbage);
+    return UNITY_END();
+}
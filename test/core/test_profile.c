@@ -0,0 +1,138 @@
+#include "unity.h"
+#include "cpu.h"
+#include "profile.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_PROFILE_FILE "test_profile.csv"
+
+profile_t profile;
+
+void setUp(void)
+{
+    profile_init(&profile, MEMORY_SIZE);
+}
+
+void tearDown(void)
+{
+    remove(TEST_PROFILE_FILE);
+}
+
+void test_classify(void)
+{
+    TEST_ASSERT_EQUAL(PROFILE_OP_CLS, profile_classify(0x00E0));
+    TEST_ASSERT_EQUAL(PROFILE_OP_SCD, profile_classify(0x00C4));
+    TEST_ASSERT_EQUAL(PROFILE_OP_JP, profile_classify(0x1234));
+    TEST_ASSERT_EQUAL(PROFILE_OP_SAVE_RANGE, profile_classify(0x5122));
+    TEST_ASSERT_EQUAL(PROFILE_OP_SHL, profile_classify(0x812E));
+    TEST_ASSERT_EQUAL(PROFILE_OP_DRW, profile_classify(0xD125));
+    TEST_ASSERT_EQUAL(PROFILE_OP_SKNP, profile_classify(0xE3A1));
+    TEST_ASSERT_EQUAL(PROFILE_OP_LD_I_LONG, profile_classify(0xF000));
+    TEST_ASSERT_EQUAL(PROFILE_OP_PLANE, profile_classify(0xF301));
+    TEST_ASSERT_EQUAL(PROFILE_OP_LOAD, profile_classify(0xF465));
+    TEST_ASSERT_EQUAL(PROFILE_OP_UNKNOWN, profile_classify(0x8008));
+    TEST_ASSERT_EQUAL(PROFILE_OP_UNKNOWN, profile_classify(0xF0FF));
+}
+
+void test_op_names(void)
+{
+    // Every class has a name, the table can't fall out of step with the enum
+    for(int op = 0; op < PROFILE_OP_COUNT; op++)
+    {
+        TEST_ASSERT_NOT_NULL(profile_op_name((profile_op_t)op));
+    }
+    TEST_ASSERT_EQUAL_STRING("DRW Vx, Vy, n", profile_op_name(PROFILE_OP_DRW));
+    TEST_ASSERT_EQUAL_STRING("UNKNOWN", profile_op_name(PROFILE_OP_UNKNOWN));
+}
+
+void test_pc_buckets(void)
+{
+    // 4KB is one bucket per instruction, 64KB folds 32 bytes into a bucket
+    TEST_ASSERT_EQUAL(1, profile.pc_shift);
+    profile_count(&profile, 0x200, 0x6001);
+    profile_count(&profile, 0x202, 0x6001);
+    profile_count(&profile, 0x202, 0x1202);
+    TEST_ASSERT_EQUAL(3, profile.total);
+    TEST_ASSERT_EQUAL(2, profile.op_counts[PROFILE_OP_LD_IMM]);
+    TEST_ASSERT_EQUAL(1, profile.pc_counts[0x100]);
+    TEST_ASSERT_EQUAL(2, profile.pc_counts[0x101]);
+
+    profile_init(&profile, XOCHIP_MEMORY_SIZE);
+    TEST_ASSERT_EQUAL(5, profile.pc_shift);
+    profile_count(&profile, 0xFFFE, 0x00E0);
+    TEST_ASSERT_EQUAL(1, profile.pc_counts[PROFILE_PC_BUCKETS - 1]);
+    profile_reset(&profile);
+    TEST_ASSERT_EQUAL(0, profile.total);
+    TEST_ASSERT_EQUAL(5, profile.pc_shift);
+}
+
+void test_save_csv(void)
+{
+    char line[64];
+    FILE *p_fp = NULL;
+
+    profile_count(&profile, 0x200, 0xD015);
+    TEST_ASSERT_TRUE(profile_save(&profile, TEST_PROFILE_FILE));
+
+    p_fp = fopen(TEST_PROFILE_FILE, "r");
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), p_fp));
+    TEST_ASSERT_EQUAL_STRING("kind,key,count\n", line);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), p_fp));
+    TEST_ASSERT_EQUAL_STRING("total,\"\",1\n", line);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), p_fp));
+    TEST_ASSERT_EQUAL_STRING("opcode,\"DRW Vx, Vy, n\",1\n", line);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), p_fp));
+    TEST_ASSERT_EQUAL_STRING("pc,\"0x0200\",1\n", line);
+    fclose(p_fp);
+}
+
+#ifdef EMUEIGHT_PROFILE
+void test_cpu_counts(void)
+{
+    chip8_t *p_cpu = cpu_init();
+    p_cpu->p_profile = &profile;
+    p_cpu->memory[0x200] = 0x70;
+    p_cpu->memory[0x201] = 0x01;
+    p_cpu->memory[0x202] = 0x12;
+    p_cpu->memory[0x203] = 0x00;
+    cpu_run(p_cpu, 10);
+    TEST_ASSERT_EQUAL(10, profile.total);
+    TEST_ASSERT_EQUAL(5, profile.op_counts[PROFILE_OP_ADD_IMM]);
+    TEST_ASSERT_EQUAL(5, profile.op_counts[PROFILE_OP_JP]);
+    cpu_free(p_cpu);
+}
+
+void test_new_cpu_unprofiled(void)
+{
+    // A new cpu starts unprofiled, even in a block that held garbage
+    chip8_t *p_cpu = cpu_init();
+
+    TEST_ASSERT_NOT_NULL(p_cpu);
+    memset(p_cpu, 0xA5, cpu_state_size(MEMORY_SIZE));
+    cpu_free(p_cpu);
+    p_cpu = cpu_init();
+    TEST_ASSERT_NOT_NULL(p_cpu);
+    TEST_ASSERT_NULL(p_cpu->p_profile);
+    cpu_reset(p_cpu);
+    TEST_ASSERT_NULL(p_cpu->p_profile);
+    cpu_run(p_cpu, 10);
+    cpu_free(p_cpu);
+}
+#endif
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_classify);
+    RUN_TEST(test_op_names);
+    RUN_TEST(test_pc_buckets);
+    RUN_TEST(test_save_csv);
+#ifdef EMUEIGHT_PROFILE
+    RUN_TEST(test_cpu_counts);
+    RUN_TEST(test_new_cpu_unprofiled);
+#endif
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+#include "unity.h"
+#include "rom_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+rom_cache_t cache;
+
+void setUp(void)
+{
+    rom_cache_init(&cache);
+}
+
+void tearDown(void)
+{
+    rom_cache_free(&cache);
+}
+
+void test_hash(void)
+{
+    const uint8_t a[] = { 0x00, 0xE0 };
+    const uint8_t b[] = { 0x00, 0xEE };
+
+    // FNV-1a offset basis for nothing at all
+    TEST_ASSERT_TRUE(0xCBF29CE484222325u == rom_hash(NULL, 0));
+    TEST_ASSERT_TRUE(rom_hash(a, sizeof(a)) == rom_hash(a, sizeof(a)));
+    TEST_ASSERT_TRUE(rom_hash(a, sizeof(a)) != rom_hash(b, sizeof(b)));
+}
+
+void test_shared_image(void)
+{
+    uint8_t rom[] = { 0x60, 0x01, 0x12, 0x02 };
+    const rom_image_t *p_first = rom_cache_acquire(&cache, rom, sizeof(rom));
+    const rom_image_t *p_second = NULL;
+
+    TEST_ASSERT_NOT_NULL(p_first);
+    TEST_ASSERT_EQUAL(1, p_first->refs);
+
+    // Same bytes from another buffer share the image
+    uint8_t copy[sizeof(rom)];
+    memcpy(copy, rom, sizeof(rom));
+    p_second = rom_cache_acquire(&cache, copy, sizeof(copy));
+    TEST_ASSERT_TRUE(p_first == p_second);
+    TEST_ASSERT_EQUAL(2, p_first->refs);
+    TEST_ASSERT_EQUAL(1, cache.count);
+
+    // Different bytes get their own
+    rom[1] = 0x02;
+    p_second = rom_cache_acquire(&cache, rom, sizeof(rom));
+    TEST_ASSERT_TRUE(p_first != p_second);
+    TEST_ASSERT_EQUAL(2, cache.count);
+
+    rom_cache_release(&cache, p_second);
+    rom_cache_release(&cache, p_first);
+    TEST_ASSERT_EQUAL(1, cache.count);
+    rom_cache_release(&cache, p_first);
+    TEST_ASSERT_EQUAL(0, cache.count);
+}
+
+void test_platform(void)
+{
+    const uint8_t chip8[] = { 0x00, 0xE0, 0xD0, 0x15, 0x12, 0x02 };
+    const uint8_t schip[] = { 0x00, 0xFF, 0xD0, 0x10, 0x12, 0x02 };
+    const uint8_t xochip[] = { 0xF0, 0x00, 0x12, 0x34, 0xF2, 0x01, 0x12, 0x04 };
+    // SUPER-CHIP opcodes only in data that is never executed
+    const uint8_t data[] = { 0x12, 0x00, 0x00, 0xFF };
+
+    const rom_image_t *p_image = rom_cache_acquire(&cache, chip8, sizeof(chip8));
+    TEST_ASSERT_EQUAL(ROM_PLATFORM_CHIP8, p_image->platform);
+    TEST_ASSERT_EQUAL(QUIRKS_CHIP8, p_image->quirks);
+    TEST_ASSERT_EQUAL(MEMORY_SIZE, p_image->memory_size);
+    // Not in the database, the frontend picks the speed and keys
+    TEST_ASSERT_FALSE(p_image->known);
+    TEST_ASSERT_EQUAL(0, p_image->tickrate);
+    TEST_ASSERT_EQUAL_HEX8(ROM_DB_KEY_NONE, p_image->keys[ROM_KEY_UP]);
+
+    p_image = rom_cache_acquire(&cache, schip, sizeof(schip));
+    TEST_ASSERT_EQUAL(ROM_PLATFORM_SCHIP, p_image->platform);
+    TEST_ASSERT_EQUAL(QUIRKS_SCHIP, p_image->quirks);
+
+    p_image = rom_cache_acquire(&cache, xochip, sizeof(xochip));
+    TEST_ASSERT_EQUAL(ROM_PLATFORM_XOCHIP, p_image->platform);
+    TEST_ASSERT_EQUAL(QUIRKS_XOCHIP, p_image->quirks);
+    TEST_ASSERT_EQUAL(XOCHIP_MEMORY_SIZE, p_image->memory_size);
+
+    p_image = rom_cache_acquire(&cache, data, sizeof(data));
+    TEST_ASSERT_EQUAL(ROM_PLATFORM_CHIP8, p_image->platform);
+}
+
+void test_database_override(void)
+{
+    // Plain CHIP-8 going by its instructions, both entries say otherwise
+    const uint8_t schip[] = { 0x60, 0x01, 0x12, 0x02 };
+    const uint8_t xochip[] = { 0x60, 0x02, 0x12, 0x02 };
+    const uint8_t unknown[] = { 0x60, 0x03, 0x12, 0x02 };
+    rom_db_entry_t table[2] =
+    {
+        { rom_hash(schip, sizeof(schip)), QUIRK_SHIFT_VX, 30, ROM_PLATFORM_SCHIP,
+          { 5, 8, 7, 9, 6, ROM_DB_KEY_NONE } },
+        { rom_hash(xochip, sizeof(xochip)), QUIRKS_XOCHIP | QUIRK_CLIPPING, 1000, ROM_PLATFORM_XOCHIP,
+          { 2, 8, 4, 6, 5, 0xA } },
+    };
+    const rom_image_t *p_image = NULL;
+    chip8_t *p_cpu = NULL;
+
+    if(table[0].hash > table[1].hash)
+    {
+        rom_db_entry_t swap = table[0];
+        table[0] = table[1];
+        table[1] = swap;
+    }
+    rom_cache_use_db(&cache, table, 2);
+
+    p_image = rom_cache_acquire(&cache, schip, sizeof(schip));
+    TEST_ASSERT_TRUE(p_image->known);
+    TEST_ASSERT_EQUAL(ROM_PLATFORM_SCHIP, p_image->platform);
+    TEST_ASSERT_EQUAL(QUIRK_SHIFT_VX, p_image->quirks);
+    TEST_ASSERT_EQUAL(30, p_image->tickrate);
+    TEST_ASSERT_EQUAL(MEMORY_SIZE, p_image->memory_size);
+    TEST_ASSERT_EQUAL_HEX8(5, p_image->keys[ROM_KEY_UP]);
+    TEST_ASSERT_EQUAL_HEX8(ROM_DB_KEY_NONE, p_image->keys[ROM_KEY_B]);
+
+    p_image = rom_cache_acquire(&cache, xochip, sizeof(xochip));
+    TEST_ASSERT_TRUE(p_image->known);
+    TEST_ASSERT_EQUAL(ROM_PLATFORM_XOCHIP, p_image->platform);
+    TEST_ASSERT_EQUAL(XOCHIP_MEMORY_SIZE, p_image->memory_size);
+    TEST_ASSERT_EQUAL(1000, p_image->tickrate);
+    TEST_ASSERT_EQUAL_HEX8(0xA, p_image->keys[ROM_KEY_B]);
+    p_cpu = rom_image_new_cpu(p_image);
+    TEST_ASSERT_NOT_NULL(p_cpu);
+    TEST_ASSERT_EQUAL(XOCHIP_MEMORY_SIZE, p_cpu->memory_size);
+    TEST_ASSERT_EQUAL(QUIRKS_XOCHIP | QUIRK_CLIPPING, p_cpu->quirks);
+    cpu_free(p_cpu);
+
+    // Anything else still falls back to detection
+    p_image = rom_cache_acquire(&cache, unknown, sizeof(unknown));
+    TEST_ASSERT_FALSE(p_image->known);
+    TEST_ASSERT_EQUAL(QUIRKS_CHIP8, p_image->quirks);
+    TEST_ASSERT_EQUAL(0, p_image->tickrate);
+}
+
+void test_code_map(void)
+{
+    // 0x200 SE V0, 1 / 0x202 F000 nnnn / 0x206 CALL 0x20C / 0x208 JP 0x208 / 0x20A data / 0x20C RET
+    const uint8_t rom[] =
+    {
+        0x30, 0x01, 0xF0, 0x00, 0x12, 0x34, 0x22, 0x0C,
+        0x12, 0x08, 0xFF, 0xFF, 0x00, 0xEE
+    };
+    const rom_image_t *p_image = rom_cache_acquire(&cache, rom, sizeof(rom));
+
+    TEST_ASSERT_TRUE(rom_image_is_code(p_image, 0x200));
+    TEST_ASSERT_TRUE(rom_image_is_code(p_image, 0x202));
+    TEST_ASSERT_FALSE(rom_image_is_code(p_image, 0x204));
+    TEST_ASSERT_TRUE(rom_image_is_code(p_image, 0x206));
+    TEST_ASSERT_TRUE(rom_image_is_code(p_image, 0x208));
+    TEST_ASSERT_FALSE(rom_image_is_code(p_image, 0x20A));
+    TEST_ASSERT_TRUE(rom_image_is_code(p_image, 0x20C));
+    TEST_ASSERT_FALSE(rom_image_is_code(p_image, 0x100));
+    TEST_ASSERT_FALSE(rom_image_is_code(p_image, 0x20E));
+}
+
+void test_new_cpu(void)
+{
+    const uint8_t rom[] = { 0x00, 0xFF, 0x60, 0x2A, 0x12, 0x04 };
+    const rom_image_t *p_image = rom_cache_acquire(&cache, rom, sizeof(rom));
+    chip8_t *p_cpu = rom_image_new_cpu(p_image);
+
+    TEST_ASSERT_NOT_NULL(p_cpu);
+    TEST_ASSERT_EQUAL(QUIRKS_SCHIP, p_cpu->quirks);
+    TEST_ASSERT_EQUAL_MEMORY(rom, &p_cpu->memory[START_ADDRESS], sizeof(rom));
+    cpu_run(p_cpu, 3);
+    TEST_ASSERT_EQUAL(0x2A, p_cpu->V[0]);
+    TEST_ASSERT_TRUE(p_cpu->hires);
+    cpu_free(p_cpu);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hash);
+    RUN_TEST(test_shared_image);
+    RUN_TEST(test_platform);
+    RUN_TEST(test_database_override);
+    RUN_TEST(test_code_map);
+    RUN_TEST(test_new_cpu);
+    return UNITY_END();
+}
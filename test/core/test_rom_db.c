@@ -0,0 +1,60 @@
+#include "unity.h"
+#include "cpu.h"
+#include "rom_db.h"
+#include <stdint.h>
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_table_sorted(void)
+{
+    // Binary search depends on it
+    for(size_t i = 1; i < rom_db_entry_count; i++)
+    {
+        TEST_ASSERT_TRUE(rom_db_entries[i - 1].hash < rom_db_entries[i].hash);
+    }
+    for(size_t i = 0; i < rom_db_entry_count; i++)
+    {
+        TEST_ASSERT_TRUE(rom_db_entries[i].platform <= ROM_PLATFORM_XOCHIP);
+        TEST_ASSERT_TRUE(rom_db_entries[i].tickrate > 0);
+        TEST_ASSERT_TRUE(rom_db_find(rom_db_entries[i].hash) == &rom_db_entries[i]);
+    }
+}
+
+void test_terminator(void)
+{
+    TEST_ASSERT_NULL(rom_db_find(UINT64_MAX));
+}
+
+void test_search(void)
+{
+    static const rom_db_entry_t table[] =
+    {
+        { 0x10, QUIRKS_CHIP8, 10, ROM_PLATFORM_CHIP8, { 5, 8, 7, 9, 6, ROM_DB_KEY_NONE } },
+        { 0x20, QUIRKS_SCHIP, 30, ROM_PLATFORM_SCHIP, { 2, 8, 4, 6, 5, ROM_DB_KEY_NONE } },
+        { 0x30, QUIRKS_XOCHIP, 1000, ROM_PLATFORM_XOCHIP, { 5, 8, 7, 9, 6, 4 } },
+    };
+    const size_t count = sizeof(table) / sizeof(table[0]);
+
+    TEST_ASSERT_TRUE(&table[0] == rom_db_search(table, count, 0x10));
+    TEST_ASSERT_TRUE(&table[1] == rom_db_search(table, count, 0x20));
+    TEST_ASSERT_TRUE(&table[2] == rom_db_search(table, count, 0x30));
+    TEST_ASSERT_NULL(rom_db_search(table, count, 0x08));
+    TEST_ASSERT_NULL(rom_db_search(table, count, 0x18));
+    TEST_ASSERT_NULL(rom_db_search(table, count, 0x38));
+    TEST_ASSERT_NULL(rom_db_search(table, 0, 0x10));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_table_sorted);
+    RUN_TEST(test_terminator);
+    RUN_TEST(test_search);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+#include "unity.h"
+#include "timeline.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_TIMELINE_FILE "test_timeline.json"
+
+timeline_t timeline;
+static uint64_t now;
+
+// Every reading moves the clock on by 1.5 microseconds
+static uint64_t test_clock(void)
+{
+    now += 1500;
+    return now;
+}
+
+static char *read_file(const char *p_filename)
+{
+    FILE *p_fp = fopen(p_filename, "rb");
+    char *p_text = calloc(1, 1 << 16);
+    size_t length = 0;
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_NOT_NULL(p_text);
+    length = fread(p_text, 1, (1 << 16) - 1, p_fp);
+    p_text[length] = '\0';
+    fclose(p_fp);
+
+    return p_text;
+}
+
+void setUp(void)
+{
+    now = 0;
+    TEST_ASSERT_TRUE(timeline_init(&timeline, 4, test_clock, "emulation", 2));
+}
+
+void tearDown(void)
+{
+    timeline_free(&timeline);
+    remove(TEST_TIMELINE_FILE);
+}
+
+void test_nested_phases(void)
+{
+    timeline_begin(&timeline, "frame");
+    timeline_begin(&timeline, "emulate");
+    timeline_end(&timeline);
+    timeline_begin(&timeline, "audio");
+    timeline_end(&timeline);
+    timeline_end(&timeline);
+
+    // Recorded as they finish, the enclosing phase last
+    TEST_ASSERT_EQUAL(3, timeline.head);
+    TEST_ASSERT_EQUAL_STRING("emulate", timeline.p_events[0].p_name);
+    TEST_ASSERT_EQUAL(3000, timeline.p_events[0].start);
+    TEST_ASSERT_EQUAL(1500, timeline.p_events[0].duration);
+    TEST_ASSERT_EQUAL_STRING("audio", timeline.p_events[1].p_name);
+    TEST_ASSERT_EQUAL_STRING("frame", timeline.p_events[2].p_name);
+    TEST_ASSERT_EQUAL(1500, timeline.p_events[2].start);
+    TEST_ASSERT_EQUAL(7500, timeline.p_events[2].duration);
+    TEST_ASSERT_EQUAL(0, timeline.depth);
+}
+
+void test_ring_keeps_the_latest(void)
+{
+    for(int i = 0; i < 6; i++)
+    {
+        timeline_begin(&timeline, (i < 2) ? "old" : "new");
+        timeline_end(&timeline);
+    }
+
+    TEST_ASSERT_EQUAL(3, timeline.mask);
+    TEST_ASSERT_EQUAL(6, timeline.head);
+    for(int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL_STRING("new", timeline.p_events[i].p_name);
+    }
+}
+
+void test_too_deep_not_recorded(void)
+{
+    for(int i = 0; i < TIMELINE_MAX_DEPTH + 2; i++)
+    {
+        timeline_begin(&timeline, (i < TIMELINE_MAX_DEPTH) ? "kept" : "deep");
+    }
+    timeline_end(&timeline);
+    timeline_end(&timeline);
+    TEST_ASSERT_EQUAL(0, timeline.head);
+    timeline_end(&timeline);
+    TEST_ASSERT_EQUAL(1, timeline.head);
+    TEST_ASSERT_EQUAL_STRING("kept", timeline.p_events[0].p_name);
+
+    // Unbalanced ends are ignored
+    while(0 != timeline.depth)
+    {
+        timeline_end(&timeline);
+    }
+    timeline_end(&timeline);
+    TEST_ASSERT_EQUAL(TIMELINE_MAX_DEPTH, timeline.head);
+}
+
+void test_uninitialised_ignores_phases(void)
+{
+    timeline_t off;
+
+    memset(&off, 0, sizeof(off));
+    timeline_begin(&off, "frame");
+    timeline_end(&off);
+    TEST_ASSERT_EQUAL(0, off.head);
+    TEST_ASSERT_EQUAL(0, off.depth);
+}
+
+void test_write_json(void)
+{
+    FILE *p_fp = fopen(TEST_TIMELINE_FILE, "w");
+    timeline_t render;
+    char *p_text = NULL;
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_TRUE(timeline_init(&render, 0, test_clock, "render", 1));
+    timeline_begin(&timeline, "emulate");
+    timeline_end(&timeline);
+    timeline_begin(&render, "present");
+    timeline_end(&render);
+
+    TEST_ASSERT_TRUE(timeline_write_begin(p_fp));
+    TEST_ASSERT_TRUE(timeline_write(&render, p_fp));
+    TEST_ASSERT_TRUE(timeline_write(&timeline, p_fp));
+    TEST_ASSERT_TRUE(timeline_write_end(p_fp));
+    fclose(p_fp);
+    timeline_free(&render);
+
+    p_text = read_file(TEST_TIMELINE_FILE);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"EmuEight\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"render\"}},\n"
+        "{\"name\":\"present\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":4.500,\"dur\":1.500},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"emulation\"}},\n"
+        "{\"name\":\"emulate\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":1.500,\"dur\":1.500}\n"
+        "]}\n",
+        p_text);
+    free(p_text);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_nested_phases);
+    RUN_TEST(test_ring_keeps_the_latest);
+    RUN_TEST(test_too_deep_not_recorded);
+    RUN_TEST(test_uninitialised_ignores_phases);
+    RUN_TEST(test_write_json);
+    return UNITY_END();
+}
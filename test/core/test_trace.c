@@ -0,0 +1,289 @@
+#include "unity.h"
+#include "cpu.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_TRACE_FILE "test_trace.e8t"
+
+chip8_t *p_cpu;
+trace_t trace;
+
+static const uint8_t test_rom[] = {
+    0x60, 0x05, // 0x200 LD V0, 5
+    0x61, 0x05, // 0x202 LD V1, 5
+    0xA3, 0x00, // 0x204 LD I, 0x300
+    0x22, 0x0C, // 0x206 CALL 0x20C
+    0xF0, 0x15, // 0x208 LD DT, V0
+    0x12, 0x0A, // 0x20A JP 0x20A
+    0x80, 0x14, // 0x20C ADD V0, V1
+    0x00, 0xEE  // 0x20E RET
+};
+
+static chip8_t *new_cpu(void)
+{
+    chip8_t *p_new = cpu_init();
+
+    memcpy(&p_new->memory[START_ADDRESS], test_rom, sizeof(test_rom));
+
+    return p_new;
+}
+
+void setUp(void)
+{
+    p_cpu = new_cpu();
+    TEST_ASSERT_TRUE(trace_init(&trace, 0));
+    p_cpu->p_trace = &trace;
+}
+
+void tearDown(void)
+{
+    trace_free(&trace);
+    cpu_free(p_cpu);
+    remove(TEST_TRACE_FILE);
+}
+
+void test_init_rounds_capacity(void)
+{
+    trace_t small;
+
+    TEST_ASSERT_EQUAL(TRACE_DEFAULT_RECORDS - 1, trace.mask);
+    TEST_ASSERT_TRUE(trace_init(&small, 1));
+    TEST_ASSERT_EQUAL(TRACE_CHUNK_RECORDS - 1, small.mask);
+    trace_free(&small);
+    TEST_ASSERT_TRUE(trace_init(&small, TRACE_CHUNK_RECORDS * 3));
+    TEST_ASSERT_EQUAL(TRACE_CHUNK_RECORDS * 4 - 1, small.mask);
+    trace_free(&small);
+}
+
+// Run cycles and write the records out, which fills in what changed
+static void run_and_flush(uint32_t cycles)
+{
+    FILE *p_fp = fopen(TEST_TRACE_FILE, "wb");
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_TRUE(trace_write_header(p_fp));
+    cpu_run(p_cpu, cycles);
+    TEST_ASSERT_TRUE(trace_flush(&trace, p_fp, true));
+    fclose(p_fp);
+}
+
+void test_records(void)
+{
+    const trace_record_t *p_record = trace.p_records;
+
+    run_and_flush(8);
+
+    TEST_ASSERT_EQUAL(8, trace.head);
+    TEST_ASSERT_EQUAL(0, p_record[0].sequence);
+    TEST_ASSERT_EQUAL_HEX16(0x200, p_record[0].pc);
+    TEST_ASSERT_EQUAL_HEX16(0x6005, p_record[0].opcode);
+    TEST_ASSERT_EQUAL_HEX16(0x0001, p_record[0].changed);
+    TEST_ASSERT_EQUAL(0, p_record[0].flags);
+    TEST_ASSERT_EQUAL(5, p_record[0].V[0]);
+
+    TEST_ASSERT_EQUAL_HEX16(0x0002, p_record[1].changed);
+    TEST_ASSERT_EQUAL(TRACE_CHANGED_INDEX, p_record[2].flags);
+    TEST_ASSERT_EQUAL_HEX16(0x300, p_record[2].index);
+    TEST_ASSERT_EQUAL(TRACE_CHANGED_SP, p_record[3].flags);
+    TEST_ASSERT_EQUAL(1, p_record[3].sp);
+
+    TEST_ASSERT_EQUAL_HEX16(0x20C, p_record[4].pc);
+    TEST_ASSERT_EQUAL_HEX16(0x0001, p_record[4].changed);
+    TEST_ASSERT_EQUAL(10, p_record[4].V[0]);
+    TEST_ASSERT_EQUAL(TRACE_CHANGED_SP, p_record[5].flags);
+    TEST_ASSERT_EQUAL(0, p_record[5].sp);
+
+    TEST_ASSERT_EQUAL_HEX16(0xF015, p_record[6].opcode);
+    TEST_ASSERT_EQUAL(TRACE_CHANGED_DT, p_record[6].flags);
+    TEST_ASSERT_EQUAL(10, p_record[6].delay_timer);
+    TEST_ASSERT_EQUAL(7, p_record[7].sequence);
+    TEST_ASSERT_EQUAL_HEX16(0x20A, p_record[7].pc);
+}
+
+// Records only store the registers an instruction writes, flushing fills in the rest
+void test_registers_filled_in(void)
+{
+    static const uint8_t rom[] = {
+        0x63, 0x07, // 0x200 LD V3, 7
+        0xC4, 0xFF, // 0x202 RND V4, 0xFF
+        0x83, 0x44, // 0x204 ADD V3, V4
+        0xF5, 0x07, // 0x206 LD V5, DT
+        0xD3, 0x45, // 0x208 DRW V3, V4, 5
+        0xA2, 0x00, // 0x20A LD I, 0x200
+        0xF2, 0x65, // 0x20C LD V2, [I]
+        0x12, 0x02  // 0x20E JP 0x202
+    };
+    chip8_t *p_plain = cpu_init();
+
+    memcpy(&p_cpu->memory[START_ADDRESS], rom, sizeof(rom));
+    memcpy(&p_plain->memory[START_ADDRESS], rom, sizeof(rom));
+    cpu_seed_rng(p_cpu, 7);
+    cpu_seed_rng(p_plain, 7);
+    p_cpu->delayTimer = 9;
+    p_plain->delayTimer = 9;
+    // No waiting for the display, so nothing idles
+    p_cpu->quirks = 0;
+    p_plain->quirks = 0;
+
+    run_and_flush(50);
+    TEST_ASSERT_EQUAL(50, trace.head);
+    for(uint32_t i = 0; i < 50; i++)
+    {
+        cpu_cycle(p_plain);
+        TEST_ASSERT_EQUAL_MEMORY(p_plain->V, trace.p_records[i].V, sizeof(p_plain->V));
+    }
+    cpu_free(p_plain);
+}
+
+void test_idle_not_recorded(void)
+{
+    cpu_run(p_cpu, 1000);
+
+    // One record for the first time round the wait loop, the rest is skipped
+    TEST_ASSERT_EQUAL(8, trace.head);
+    TEST_ASSERT_EQUAL(1000, p_cpu->frame_cycle);
+    cpu_run(p_cpu, 1000);
+    TEST_ASSERT_EQUAL(9, trace.head);
+}
+
+void test_same_as_untraced(void)
+{
+    chip8_t *p_plain = new_cpu();
+
+    for(int frame = 0; frame < 4; frame++)
+    {
+        cpu_run(p_cpu, 3);
+        cpu_cycle(p_cpu);
+        cpu_timer_tick(p_cpu);
+        cpu_run(p_plain, 3);
+        cpu_cycle(p_plain);
+        cpu_timer_tick(p_plain);
+    }
+
+    // Eight to reach the wait loop, then two a frame, one per cpu_run() and cpu_cycle()
+    TEST_ASSERT_EQUAL(12, trace.head);
+    TEST_ASSERT_EQUAL_MEMORY(p_plain->V, p_cpu->V, sizeof(p_plain->V));
+    TEST_ASSERT_EQUAL_HEX16(p_plain->pc, p_cpu->pc);
+    TEST_ASSERT_EQUAL_HEX16(p_plain->index, p_cpu->index);
+    TEST_ASSERT_EQUAL(p_plain->delayTimer, p_cpu->delayTimer);
+    TEST_ASSERT_EQUAL(p_plain->frame_cycle, p_cpu->frame_cycle);
+    cpu_free(p_plain);
+}
+
+void test_reset_keeps_trace(void)
+{
+    TEST_ASSERT_TRUE(cpu_reset(p_cpu));
+    TEST_ASSERT_TRUE(&trace == p_cpu->p_trace);
+}
+
+void test_flush_and_read(void)
+{
+    FILE *p_fp = fopen(TEST_TRACE_FILE, "wb");
+    trace_reader_t reader;
+    trace_record_t record;
+    uint32_t count = 0;
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_TRUE(trace_write_header(p_fp));
+    cpu_run(p_cpu, 8);
+
+    // Nothing goes out until a chunk is full, unless asked to
+    TEST_ASSERT_TRUE(trace_flush(&trace, p_fp, false));
+    TEST_ASSERT_EQUAL(0, trace.tail);
+    TEST_ASSERT_TRUE(trace_flush(&trace, p_fp, true));
+    TEST_ASSERT_EQUAL(8, trace.tail);
+    fclose(p_fp);
+
+    TEST_ASSERT_TRUE(trace_reader_open(&reader, TEST_TRACE_FILE));
+    while(trace_reader_next(&reader, &record))
+    {
+        TEST_ASSERT_EQUAL_MEMORY(&trace.p_records[count], &record, sizeof(record));
+        count++;
+    }
+    trace_reader_close(&reader);
+    TEST_ASSERT_EQUAL(8, count);
+}
+
+void test_reader_rejects_other_files(void)
+{
+    FILE *p_fp = fopen(TEST_TRACE_FILE, "wb");
+    trace_reader_t reader;
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    fputs("E8MV not a trace", p_fp);
+    fclose(p_fp);
+
+    TEST_ASSERT_FALSE(trace_reader_open(&reader, TEST_TRACE_FILE));
+    TEST_ASSERT_FALSE(trace_reader_open(&reader, "no such file"));
+}
+
+void test_overflow_drops_oldest(void)
+{
+    FILE *p_fp = fopen(TEST_TRACE_FILE, "wb");
+    trace_reader_t reader;
+    trace_record_t record;
+    uint64_t extra = 100;
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_TRUE(trace_write_header(p_fp));
+    for(uint64_t i = 0; i < TRACE_DEFAULT_RECORDS + extra; i++)
+    {
+        trace_append(&trace)->pc = (uint16_t)i;
+    }
+    TEST_ASSERT_TRUE(trace_flush(&trace, p_fp, true));
+    fclose(p_fp);
+
+    TEST_ASSERT_EQUAL(extra, trace.dropped);
+    TEST_ASSERT_TRUE(trace_reader_open(&reader, TEST_TRACE_FILE));
+    TEST_ASSERT_TRUE(trace_reader_next(&reader, &record));
+    TEST_ASSERT_EQUAL(extra, record.sequence);
+    trace_reader_close(&reader);
+}
+
+// A lost record's registers carry over to the oldest one left
+void test_overflow_keeps_registers(void)
+{
+    static const uint8_t rom[] = {
+        0x61, 0x2A, // 0x200 LD V1, 42
+        0x70, 0x01, // 0x202 ADD V0, 1
+        0x12, 0x02  // 0x204 JP 0x202
+    };
+    FILE *p_fp = fopen(TEST_TRACE_FILE, "wb");
+    trace_reader_t reader;
+    trace_record_t record;
+
+    TEST_ASSERT_NOT_NULL(p_fp);
+    TEST_ASSERT_TRUE(trace_write_header(p_fp));
+    memcpy(&p_cpu->memory[START_ADDRESS], rom, sizeof(rom));
+    cpu_run(p_cpu, TRACE_DEFAULT_RECORDS + 101);
+    TEST_ASSERT_TRUE(trace_flush(&trace, p_fp, true));
+    fclose(p_fp);
+
+    TEST_ASSERT_EQUAL(101, trace.dropped);
+    TEST_ASSERT_TRUE(trace_reader_open(&reader, TEST_TRACE_FILE));
+    TEST_ASSERT_TRUE(trace_reader_next(&reader, &record));
+    TEST_ASSERT_EQUAL(101, record.sequence);
+    TEST_ASSERT_EQUAL(42, record.V[1]);
+    // Every other record after the first is an ADD
+    TEST_ASSERT_EQUAL(51, record.V[0]);
+    trace_reader_close(&reader);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_rounds_capacity);
+    RUN_TEST(test_records);
+    RUN_TEST(test_registers_filled_in);
+    RUN_TEST(test_idle_not_recorded);
+    RUN_TEST(test_same_as_untraced);
+    RUN_TEST(test_reset_keeps_trace);
+    RUN_TEST(test_flush_and_read);
+    RUN_TEST(test_reader_rejects_other_files);
+    RUN_TEST(test_overflow_drops_oldest);
+    RUN_TEST(test_overflow_keeps_registers);
+    return UNITY_END();
+}
@@ -0,0 +1,108 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "trace.h"
+
+/*
+ * Fuzz target for the interpreter, for libFuzzer or, through
+ * fuzz_main.c, AFL++ and replaying crashes. An input is
+ *
+ *   byte 0    bits 0-1 platform: CHIP-8, SUPER-CHIP, XO-CHIP, XO-CHIP
+ *             bit 2 run with a trace attached
+ *   byte 1    cycles per frame - 1
+ *   byte 2    frames - 1
+ *   then      the keypad for each frame, two bytes little endian
+ *   the rest  the ROM, loaded at START_ADDRESS and cut off at the end of memory
+ *
+ * Every run starts from a copy of a cpu set up once, so an iteration
+ * costs a memcpy() rather than an allocation and a reset.
+ */
+
+#define FUZZ_HEADER 3
+#define FUZZ_TRACE 0x04
+
+int LLVMFuzzerTestOneInput(const uint8_t *p_data, size_t size);
+
+static chip8_t *p_snapshots[2]; // 4KB and 64KB, as cpu_init_memory() leaves them
+static chip8_t *p_cpus[2];
+static trace_t trace;
+
+static bool fuzz_init(void)
+{
+    static const uint32_t sizes[2] = { MEMORY_SIZE, XOCHIP_MEMORY_SIZE };
+
+    for(int i = 0; i < 2; i++)
+    {
+        p_snapshots[i] = cpu_init_memory(sizes[i]);
+        p_cpus[i] = cpu_init_memory(sizes[i]);
+        if(NULL == p_snapshots[i] || NULL == p_cpus[i])
+        {
+            return false;
+        }
+        cpu_seed_rng(p_snapshots[i], CPU_DEFAULT_SEED);
+    }
+
+    return trace_init(&trace, 1);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *p_data, size_t size)
+{
+    static const uint32_t quirks[4] = { QUIRKS_CHIP8, QUIRKS_SCHIP, QUIRKS_XOCHIP, QUIRKS_XOCHIP };
+    static bool ready;
+    chip8_t *p_cpu = NULL;
+    const chip8_t *p_snapshot = NULL;
+    const uint8_t *p_keys = p_data + FUZZ_HEADER;
+    uint32_t platform = 0;
+    uint32_t cycles = 0;
+    uint32_t frames = 0;
+    size_t rom_size = 0;
+
+    if(!ready)
+    {
+        if(!fuzz_init())
+        {
+            abort();
+        }
+        ready = true;
+    }
+    if(size < FUZZ_HEADER)
+    {
+        return 0;
+    }
+
+    platform = p_data[0] & 0x3;
+    cycles = (uint32_t)p_data[1] + 1;
+    frames = (uint32_t)p_data[2] + 1;
+    if(size - FUZZ_HEADER < (size_t)frames * 2)
+    {
+        frames = (uint32_t)((size - FUZZ_HEADER) / 2);
+    }
+    rom_size = size - FUZZ_HEADER - (size_t)frames * 2;
+
+    p_snapshot = p_snapshots[platform >= 2];
+    p_cpu = p_cpus[platform >= 2];
+    memcpy(p_cpu, p_snapshot, cpu_state_size(p_snapshot->memory_size));
+    if(rom_size > p_cpu->memory_size - START_ADDRESS)
+    {
+        rom_size = p_cpu->memory_size - START_ADDRESS;
+    }
+    memcpy(&p_cpu->memory[START_ADDRESS], p_keys + (size_t)frames * 2, rom_size);
+    p_cpu->quirks = quirks[platform];
+    if(0 != (p_data[0] & FUZZ_TRACE))
+    {
+        p_cpu->p_trace = &trace;
+    }
+
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        p_cpu->keypad_register = (uint16_t)(p_keys[frame * 2] | p_keys[frame * 2 + 1] << 8);
+        cpu_run(p_cpu, cycles);
+        cpu_timer_tick(p_cpu);
+    }
+    cpu_display_hash(p_cpu);
+
+    return 0;
+}
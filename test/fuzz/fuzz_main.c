@@ -0,0 +1,53 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * A main() for fuzz targets built without libFuzzer. Runs each file named
+ * on the command line through the target, or standard input without any,
+ * which is how AFL++ feeds it. Built with afl-clang-fast it loops in
+ * persistent mode. Also what reproduces a crash under a debugger.
+ */
+
+#define FUZZ_MAX_INPUT (1 << 17) // more than a 64KB ROM and a long input sequence
+
+int LLVMFuzzerTestOneInput(const uint8_t *p_data, size_t size);
+
+static uint8_t input[FUZZ_MAX_INPUT];
+
+static size_t read_input(FILE *p_fp)
+{
+    return fread(input, 1, sizeof(input), p_fp);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+#ifdef __AFL_LOOP
+        while(__AFL_LOOP(10000))
+        {
+            LLVMFuzzerTestOneInput(input, read_input(stdin));
+        }
+#else
+        LLVMFuzzerTestOneInput(input, read_input(stdin));
+#endif
+        return EXIT_SUCCESS;
+    }
+
+    for(int i = 1; i < argc; i++)
+    {
+        FILE *p_fp = fopen(argv[i], "rb");
+
+        if(NULL == p_fp)
+        {
+            fprintf(stderr, "Failed to open %s.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        LLVMFuzzerTestOneInput(input, read_input(p_fp));
+        fclose(p_fp);
+        printf("%s: ok\n", argv[i]);
+    }
+
+    return EXIT_SUCCESS;
+}